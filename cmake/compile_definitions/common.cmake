@@ -96,6 +96,8 @@ set(AQUA_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/video.h"
         "${CMAKE_SOURCE_DIR}/src/video_colorspace.cpp"
         "${CMAKE_SOURCE_DIR}/src/video_colorspace.h"
+        "${CMAKE_SOURCE_DIR}/src/video_probe_cache.cpp"
+        "${CMAKE_SOURCE_DIR}/src/video_probe_cache.h"
         "${CMAKE_SOURCE_DIR}/src/input.cpp"
         "${CMAKE_SOURCE_DIR}/src/input.h"
         "${CMAKE_SOURCE_DIR}/src/audio.cpp"
@@ -115,6 +117,24 @@ set(AQUA_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/round_robin.h"
         "${CMAKE_SOURCE_DIR}/src/stat_trackers.h"
         "${CMAKE_SOURCE_DIR}/src/stat_trackers.cpp"
+        "${CMAKE_SOURCE_DIR}/src/startup_timeline.cpp"
+        "${CMAKE_SOURCE_DIR}/src/startup_timeline.h"
+        "${CMAKE_SOURCE_DIR}/src/frame_trace.cpp"
+        "${CMAKE_SOURCE_DIR}/src/frame_trace.h"
+        "${CMAKE_SOURCE_DIR}/src/metrics.cpp"
+        "${CMAKE_SOURCE_DIR}/src/metrics.h"
+        "${CMAKE_SOURCE_DIR}/src/asset_cache.cpp"
+        "${CMAKE_SOURCE_DIR}/src/asset_cache.h"
+        "${CMAKE_SOURCE_DIR}/src/bitrate_control.cpp"
+        "${CMAKE_SOURCE_DIR}/src/bitrate_control.h"
+        "${CMAKE_SOURCE_DIR}/src/compression.cpp"
+        "${CMAKE_SOURCE_DIR}/src/compression.h"
+        "${CMAKE_SOURCE_DIR}/src/log_ring.cpp"
+        "${CMAKE_SOURCE_DIR}/src/log_ring.h"
+        "${CMAKE_SOURCE_DIR}/src/pairing_store.cpp"
+        "${CMAKE_SOURCE_DIR}/src/pairing_store.h"
+        "${CMAKE_SOURCE_DIR}/src/web_assets.cpp"
+        "${CMAKE_SOURCE_DIR}/src/web_assets.h"
         "${CMAKE_SOURCE_DIR}/src/rswrapper.h"
         "${CMAKE_SOURCE_DIR}/src/rswrapper.c"
         ${PLATFORM_TARGET_FILES})
@@ -126,6 +146,35 @@ list(APPEND AQUA_DEFINITIONS AQUA_ASSETS_DIR="${AQUA_ASSETS_DIR_DEF}")
 
 list(APPEND AQUA_DEFINITIONS AQUA_TRAY=${AQUA_TRAY})
 
+# Reference frame invalidation for the software encoder talks to x264 directly,
+# so it needs the x264 headers next to the libx264 we link against.
+# It reads the x264 handle out of libavcodec's private libx264 context, whose layout
+# was checked for libavcodec 58 through 61 (FFmpeg 4.0 through 7.1).
+set(AQUA_X264_LIBAVCODEC_MIN 58)
+set(AQUA_X264_LIBAVCODEC_MAX 61)
+if("${FFMPEG_PREPARED_BINARIES}/lib/libx264.a" IN_LIST FFMPEG_LIBRARIES AND
+        EXISTS "${FFMPEG_PREPARED_BINARIES}/include/x264.h")
+    # FFmpeg 5.1 moved the major version to version_major.h
+    set(LIBAVCODEC_VERSION_MAJOR "")
+    foreach(version_header version_major.h version.h)
+        set(version_header "${FFMPEG_PREPARED_BINARIES}/include/libavcodec/${version_header}")
+        if(NOT LIBAVCODEC_VERSION_MAJOR AND EXISTS "${version_header}")
+            file(STRINGS "${version_header}" LIBAVCODEC_VERSION_MAJOR_LINE
+                    REGEX "^#define LIBAVCODEC_VERSION_MAJOR +[0-9]+")
+            string(REGEX MATCH "[0-9]+$" LIBAVCODEC_VERSION_MAJOR "${LIBAVCODEC_VERSION_MAJOR_LINE}")
+        endif()
+    endforeach()
+
+    if(LIBAVCODEC_VERSION_MAJOR AND
+            NOT LIBAVCODEC_VERSION_MAJOR LESS AQUA_X264_LIBAVCODEC_MIN AND
+            NOT LIBAVCODEC_VERSION_MAJOR GREATER AQUA_X264_LIBAVCODEC_MAX)
+        list(APPEND AQUA_DEFINITIONS AQUA_BUILD_X264=1)
+    else()
+        message(WARNING "libavcodec ${LIBAVCODEC_VERSION_MAJOR} hasn't been checked for reference frame invalidation \
+                with libx264, disabling it")
+    endif()
+endif()
+
 # Publisher metadata
 list(APPEND AQUA_DEFINITIONS AQUA_PUBLISHER_NAME="${AQUA_PUBLISHER_NAME}")
 list(APPEND AQUA_DEFINITIONS AQUA_PUBLISHER_WEBSITE="${AQUA_PUBLISHER_WEBSITE}")
@@ -154,4 +203,5 @@ list(APPEND AQUA_EXTERNAL_LIBRARIES
         ${FFMPEG_LIBRARIES}
         ${Boost_LIBRARIES}
         ${OPENSSL_LIBRARIES}
+        ZLIB::ZLIB
         ${PLATFORM_LIBRARIES})
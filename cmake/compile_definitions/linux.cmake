@@ -238,6 +238,8 @@ endif ()
 
 list(APPEND PLATFORM_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/platform/linux/publish.cpp"
+        "${CMAKE_SOURCE_DIR}/src/platform/linux/capture_scheduler.h"
+        "${CMAKE_SOURCE_DIR}/src/platform/linux/capture_scheduler.cpp"
         "${CMAKE_SOURCE_DIR}/src/platform/linux/graphics.h"
         "${CMAKE_SOURCE_DIR}/src/platform/linux/graphics.cpp"
         "${CMAKE_SOURCE_DIR}/src/platform/linux/misc.h"
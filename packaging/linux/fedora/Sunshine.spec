@@ -28,6 +28,7 @@ BuildRequires: libva-devel
 BuildRequires: libX11-devel
 BuildRequires: libxcb-devel
 BuildRequires: libXcursor-devel
+BuildRequires: libXdamage-devel
 BuildRequires: libXfixes-devel
 BuildRequires: libXi-devel
 BuildRequires: libXinerama-devel
@@ -48,6 +49,7 @@ BuildRequires: systemd-rpm-macros
 %{?sysusers_requires_compat}
 BuildRequires: wget
 BuildRequires: which
+BuildRequires: zlib-devel
 
 # for unit tests
 BuildRequires: xorg-x11-server-Xvfb
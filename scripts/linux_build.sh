@@ -117,6 +117,7 @@ function add_debian_based_deps() {
     "libxcb-shm0-dev"  # X11
     "libxcb-xfixes0-dev"  # X11
     "libxcb1-dev"  # X11
+    "libxdamage-dev"  # X11
     "libxfixes-dev"  # X11
     "libxrandr-dev"  # X11
     "libxtst-dev"  # X11
@@ -125,6 +126,7 @@ function add_debian_based_deps() {
     "udev"
     "wget"  # necessary for cuda install with `run` file
     "xvfb"  # necessary for headless unit testing
+    "zlib1g-dev"
   )
 
   if [ "$skip_libva" == 0 ]; then
@@ -170,6 +172,7 @@ function add_fedora_deps() {
     "libX11-devel"  # X11
     "libxcb-devel"  # X11
     "libXcursor-devel"  # X11
+    "libXdamage-devel"  # X11
     "libXfixes-devel"  # X11
     "libXi-devel"  # X11
     "libXinerama-devel"  # X11
@@ -188,6 +191,7 @@ function add_fedora_deps() {
     "wget"  # necessary for cuda install with `run` file
     "which"  # necessary for cuda install with `run` file
     "xorg-x11-server-Xvfb"  # necessary for headless unit testing
+    "zlib-devel"
   )
 
   if [ "$skip_libva" == 0 ]; then
@@ -0,0 +1,125 @@
+/**
+ * @file src/asset_cache.cpp
+ * @brief Definitions for the in-memory cache of app cover art.
+ */
+// this include
+#include "asset_cache.h"
+
+// standard includes
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace asset_cache {
+  namespace fs = std::filesystem;
+
+  bool matches(std::string_view if_none_match, std::string_view etag) {
+    while (!if_none_match.empty()) {
+      auto end = if_none_match.find(',');
+      auto tag = if_none_match.substr(0, end);
+      if_none_match = end == std::string_view::npos ? std::string_view {} : if_none_match.substr(end + 1);
+
+      while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) {
+        tag.remove_prefix(1);
+      }
+      while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) {
+        tag.remove_suffix(1);
+      }
+
+      // If-None-Match uses the weak comparison
+      if (tag.starts_with("W/")) {
+        tag.remove_prefix(2);
+      }
+
+      if (tag == "*" || tag == etag) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  std::string make_etag(std::uintmax_t file_size, fs::file_time_type mtime) {
+    std::ostringstream etag;
+    etag << '"' << std::hex << file_size << '-' << mtime.time_since_epoch().count() << '"';
+
+    return etag.str();
+  }
+
+  cache_t::cache_t(std::size_t budget):
+      _budget {budget} {
+  }
+
+  std::shared_ptr<const asset_t> cache_t::get(int app_id, const fs::path &path) {
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    auto file_size = ec ? 0 : fs::file_size(path, ec);
+
+    {
+      std::lock_guard lg {_mutex};
+
+      auto it = _entries.find(app_id);
+      if (it != std::end(_entries)) {
+        auto &entry = it->second;
+        if (!ec && entry.path == path && entry.mtime == mtime && entry.file_size == file_size) {
+          _lru.splice(std::begin(_lru), _lru, entry.lru);
+          return entry.asset;
+        }
+
+        _size -= entry.asset->data.size();
+        _lru.erase(entry.lru);
+        _entries.erase(it);
+      }
+    }
+
+    if (ec) {
+      return nullptr;
+    }
+
+    // Read without holding the lock, covers can be several megabytes
+    std::ifstream in {path, std::ios::binary};
+    if (!in) {
+      return nullptr;
+    }
+
+    auto asset = std::make_shared<asset_t>();
+    asset->data.assign(std::istreambuf_iterator<char> {in}, std::istreambuf_iterator<char> {});
+    asset->etag = make_etag(file_size, mtime);
+
+    if (asset->data.size() > _budget) {
+      return asset;
+    }
+
+    std::lock_guard lg {_mutex};
+
+    // Another request may have loaded the same asset in the meantime
+    if (auto it = _entries.find(app_id); it != std::end(_entries)) {
+      _size -= it->second.asset->data.size();
+      _lru.erase(it->second.lru);
+      _entries.erase(it);
+    }
+
+    _lru.push_front(app_id);
+    _entries.emplace(app_id, entry_t {path, mtime, file_size, asset, std::begin(_lru)});
+    _size += asset->data.size();
+
+    evict();
+
+    return asset;
+  }
+
+  std::size_t cache_t::size() {
+    std::lock_guard lg {_mutex};
+
+    return _size;
+  }
+
+  void cache_t::evict() {
+    while (_size > _budget && !_lru.empty()) {
+      auto it = _entries.find(_lru.back());
+      _size -= it->second.asset->data.size();
+      _entries.erase(it);
+      _lru.pop_back();
+    }
+  }
+}  // namespace asset_cache
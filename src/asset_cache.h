@@ -0,0 +1,86 @@
+/**
+ * @file src/asset_cache.h
+ * @brief Declarations for the in-memory cache of app cover art.
+ */
+#pragma once
+
+// standard includes
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace asset_cache {
+  /**
+   * @brief The contents of an asset file.
+   */
+  struct asset_t {
+    std::string data;  ///< The bytes of the file.
+    std::string etag;  ///< Strong entity tag, derived from the size and modification time of the file.
+  };
+
+  /**
+   * @brief Check an If-None-Match header against an entity tag.
+   * @param if_none_match The value of the header, a list of entity tags or `*`.
+   * @param etag The entity tag of the current asset.
+   * @return true if the client already has the asset.
+   */
+  bool matches(std::string_view if_none_match, std::string_view etag);
+
+  /**
+   * @brief Build an entity tag the way common web servers do, from the size and modification time of a file.
+   * @param file_size The size of the file.
+   * @param mtime The modification time of the file.
+   * @return The quoted entity tag.
+   */
+  std::string make_etag(std::uintmax_t file_size, std::filesystem::file_time_type mtime);
+
+  /**
+   * @brief Assets by app ID, reloaded when their file changes.
+   * @details Every lookup checks the size and modification time of the file, so edited covers are picked up
+   *          without invalidating anything. Once the cached bytes exceed the budget, the least recently used
+   *          assets are dropped.
+   */
+  class cache_t {
+  public:
+    /**
+     * @param budget Bytes of asset data to keep at most.
+     */
+    explicit cache_t(std::size_t budget);
+
+    /**
+     * @brief Get the asset of an app, reading the file if it isn't cached or changed.
+     * @param app_id The ID of the app.
+     * @param path The asset file of the app.
+     * @return The asset, or nullptr if the file can't be read.
+     */
+    std::shared_ptr<const asset_t> get(int app_id, const std::filesystem::path &path);
+
+    /**
+     * @brief Bytes of asset data currently cached.
+     */
+    std::size_t size();
+
+  private:
+    struct entry_t {
+      std::filesystem::path path;
+      std::filesystem::file_time_type mtime;
+      std::uintmax_t file_size;
+      std::shared_ptr<const asset_t> asset;
+      std::list<int>::iterator lru;
+    };
+
+    void evict();
+
+    std::mutex _mutex;
+    std::size_t _budget;
+    std::size_t _size = 0;
+    std::unordered_map<int, entry_t> _entries;
+    std::list<int> _lru;  ///< App IDs, most recently used first.
+  };
+}  // namespace asset_cache
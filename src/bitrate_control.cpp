@@ -0,0 +1,109 @@
+/**
+ * @file src/bitrate_control.cpp
+ * @brief Definitions for adapting the video bitrate to the network during a session.
+ */
+// this include
+#include "bitrate_control.h"
+
+// standard includes
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std::literals;
+
+namespace bitrate_control {
+  // Share of frames the client may lose in an interval before backing off
+  static constexpr double loss_threshold = 0.02;
+
+  // Round trip time above the lowest one seen that counts as queueing
+  static constexpr auto min_rtt_headroom = 25ms;
+
+  std::string_view to_string(decision_e decision) {
+    switch (decision) {
+      case decision_e::hold:
+        return "hold"sv;
+      case decision_e::increase:
+        return "increase"sv;
+      case decision_e::decrease_loss:
+        return "decrease_loss"sv;
+      case decision_e::decrease_delay:
+        return "decrease_delay"sv;
+    }
+
+    return "unknown"sv;
+  }
+
+  controller_t::controller_t(int max_kbps, int framerate):
+      _max {max_kbps},
+      _min {std::min(max_kbps, std::max(max_kbps / 8, 500))},
+      _target {max_kbps},
+      _frame_interval {std::chrono::microseconds {1s} / std::max(framerate, 1)} {
+  }
+
+  std::optional<int> controller_t::update(const sample_t &sample) {
+    if (!_last) {
+      _last = sample;
+      _last_decrease = sample.now;
+      return std::nullopt;
+    }
+
+    if (sample.now - _last->now < interval) {
+      return std::nullopt;
+    }
+
+    auto sent = sample.frames_sent > _last->frames_sent ? sample.frames_sent - _last->frames_sent : 0;
+    auto lost = sample.frames_lost > _last->frames_lost ? sample.frames_lost - _last->frames_lost : 0;
+    _last = sample;
+
+    auto loss = sent ? (double) lost / sent : (lost ? 1.0 : 0.0);
+
+    bool queueing = sample.send_latency > _frame_interval;
+    if (sample.rtt.count() > 0) {
+      if (_base_rtt) {
+        queueing = queueing || sample.rtt > *_base_rtt + std::max(min_rtt_headroom, *_base_rtt / 2);
+      }
+
+      // The lowest round trip time is the path without queues. It creeps towards
+      // the current one, so a route that got longer is eventually accepted.
+      if (!_base_rtt || sample.rtt < *_base_rtt) {
+        _base_rtt = sample.rtt;
+      } else {
+        _base_rtt = *_base_rtt + (sample.rtt - *_base_rtt) / 16;
+      }
+    }
+
+    auto target = _target;
+    if (loss > loss_threshold) {
+      _decision = decision_e::decrease_loss;
+      target = (int) (target * std::clamp(1.0 - loss, 0.5, 0.85));
+    } else if (queueing) {
+      _decision = decision_e::decrease_delay;
+      target = (int) (target * 0.85);
+    } else if (!lost && sample.now - _last_decrease >= increase_holdoff) {
+      _decision = decision_e::increase;
+      target += std::max(_max / 20, 1);
+    } else {
+      _decision = decision_e::hold;
+    }
+
+    if (_decision == decision_e::decrease_loss || _decision == decision_e::decrease_delay) {
+      _last_decrease = sample.now;
+    }
+
+    target = std::clamp(target, _min, _max);
+    if (target == _target) {
+      return std::nullopt;
+    }
+
+    _target = target;
+    return _target;
+  }
+
+  bool should_recreate(int current_kbps, int target_kbps, std::chrono::steady_clock::duration since_last) {
+    if (since_last < recreate_interval) {
+      return false;
+    }
+
+    return (std::int64_t) std::abs(target_kbps - current_kbps) * 100 >= (std::int64_t) current_kbps * recreate_change_percent;
+  }
+}  // namespace bitrate_control
@@ -0,0 +1,108 @@
+/**
+ * @file src/bitrate_control.h
+ * @brief Declarations for adapting the video bitrate to the network during a session.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace bitrate_control {
+  /**
+   * @brief What the controller did with the bitrate on an update.
+   */
+  enum class decision_e : int {
+    hold,  ///< Kept the bitrate.
+    increase,  ///< Probed for more bandwidth.
+    decrease_loss,  ///< Backed off because the client lost frames.
+    decrease_delay,  ///< Backed off because the round trip time or the time to send a frame grew.
+  };
+
+  /**
+   * @brief Name of a decision, for logging.
+   */
+  std::string_view to_string(decision_e decision);
+
+  /**
+   * @brief Network state of a session at one point in time.
+   */
+  struct sample_t {
+    std::chrono::steady_clock::time_point now;
+    std::uint64_t frames_sent;  ///< Frames sent since the session started.
+    std::uint64_t frames_lost;  ///< Frames the client reported lost since the session started.
+    std::chrono::milliseconds rtt;  ///< Round trip time of the control stream.
+    std::chrono::microseconds send_latency;  ///< Recent time taken to send a frame.
+  };
+
+  /**
+   * @brief Additive increase, multiplicative decrease of the target bitrate.
+   * @details The bitrate drops as soon as the client loses frames, the round trip time climbs well above the
+   *          lowest one seen, or sending a frame takes longer than the frame interval. After a few seconds
+   *          without congestion it climbs back towards the bitrate requested by the client, a small step at a time.
+   */
+  class controller_t {
+  public:
+    /**
+     * @param max_kbps The bitrate requested by the client, never exceeded.
+     * @param framerate The frame rate of the stream.
+     */
+    controller_t(int max_kbps, int framerate);
+
+    /**
+     * @brief Feed the network state, the controller decides at most once per interval.
+     * @return The new target bitrate in kbps, or std::nullopt if it didn't change.
+     */
+    std::optional<int> update(const sample_t &sample);
+
+    /**
+     * @brief The current target bitrate in kbps.
+     */
+    int target() const {
+      return _target;
+    }
+
+    /**
+     * @brief The lowest bitrate the controller goes down to, in kbps.
+     */
+    int floor() const {
+      return _min;
+    }
+
+    /**
+     * @brief The decision of the last evaluated interval.
+     */
+    decision_e last_decision() const {
+      return _decision;
+    }
+
+    static constexpr auto interval = std::chrono::seconds {1};  ///< Time between decisions.
+    static constexpr auto increase_holdoff = std::chrono::seconds {4};  ///< Time without congestion before probing upwards.
+
+  private:
+    int _max;
+    int _min;
+    int _target;
+    std::chrono::microseconds _frame_interval;
+
+    decision_e _decision = decision_e::hold;
+    std::optional<sample_t> _last;
+    std::chrono::steady_clock::time_point _last_decrease;
+    std::optional<std::chrono::milliseconds> _base_rtt;
+  };
+
+  constexpr auto recreate_interval = std::chrono::seconds {10};  ///< Least time between recreating an encoder.
+  constexpr int recreate_change_percent = 20;  ///< Least change of the bitrate worth recreating an encoder for.
+
+  /**
+   * @brief Whether to recreate an encoder that can't change its bitrate in place.
+   * @details A recreated encoder starts with a key frame, the kind of burst a lower bitrate is meant to avoid.
+   *          The small steps of the controller are held back until they add up to a larger change.
+   * @param current_kbps The bitrate the encoder runs at.
+   * @param target_kbps The bitrate the controller asks for.
+   * @param since_last Time since the encoder was last created.
+   */
+  bool should_recreate(int current_kbps, int target_kbps, std::chrono::steady_clock::duration since_last);
+}  // namespace bitrate_control
@@ -0,0 +1,100 @@
+/**
+ * @file src/compression.cpp
+ * @brief Definitions for compressing HTTP response bodies.
+ */
+// this include
+#include "compression.h"
+
+// standard includes
+#include <cctype>
+
+// lib includes
+#include <zlib.h>
+
+namespace compression {
+  namespace {
+    std::string_view trim(std::string_view value) {
+      while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+      }
+      while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+      }
+
+      return value;
+    }
+
+    bool iequals(std::string_view a, std::string_view b) {
+      if (a.size() != b.size()) {
+        return false;
+      }
+
+      for (std::size_t x = 0; x < a.size(); ++x) {
+        if (std::tolower((unsigned char) a[x]) != std::tolower((unsigned char) b[x])) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+  }  // namespace
+
+  bool accepts(std::string_view accept_encoding, std::string_view coding) {
+    std::optional<bool> wildcard;
+
+    while (!accept_encoding.empty()) {
+      auto end = accept_encoding.find(',');
+      auto item = accept_encoding.substr(0, end);
+      accept_encoding = end == std::string_view::npos ? std::string_view {} : accept_encoding.substr(end + 1);
+
+      auto params = item.find(';');
+      auto name = trim(item.substr(0, params));
+
+      // Only a weight of zero matters, it rejects the coding
+      bool rejected = false;
+      if (params != std::string_view::npos) {
+        auto weight = trim(item.substr(params + 1));
+        if (weight.starts_with("q=") || weight.starts_with("Q=")) {
+          weight.remove_prefix(2);
+          rejected = weight.find_first_not_of("0.") == std::string_view::npos;
+        }
+      }
+
+      if (iequals(name, coding)) {
+        return !rejected;
+      }
+      if (name == "*") {
+        wildcard = !rejected;
+      }
+    }
+
+    return wildcard.value_or(false);
+  }
+
+  std::optional<std::string> gzip(std::string_view data, int level) {
+    z_stream stream {};
+
+    // 16 added to the window bits selects the gzip wrapper
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return std::nullopt;
+    }
+
+    std::string out;
+    out.resize(deflateBound(&stream, data.size()));
+
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *) out.data();
+    stream.avail_out = out.size();
+
+    auto status = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (status != Z_STREAM_END) {
+      return std::nullopt;
+    }
+
+    return out;
+  }
+}  // namespace compression
@@ -0,0 +1,28 @@
+/**
+ * @file src/compression.h
+ * @brief Declarations for compressing HTTP response bodies.
+ */
+#pragma once
+
+// standard includes
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace compression {
+  /**
+   * @brief Check whether a client accepts a content coding.
+   * @param accept_encoding The value of the Accept-Encoding header.
+   * @param coding The content coding, e.g. `gzip`.
+   * @return true if the coding is listed, or covered by `*`, without `q=0`.
+   */
+  bool accepts(std::string_view accept_encoding, std::string_view coding);
+
+  /**
+   * @brief Compress data into the gzip format.
+   * @param data The data to compress.
+   * @param level The zlib compression level, from 1 (fastest) to 9 (smallest).
+   * @return The compressed data, or std::nullopt if zlib failed.
+   */
+  std::optional<std::string> gzip(std::string_view data, int level = 6);
+}  // namespace compression
@@ -516,6 +516,7 @@ namespace config {
 
     1,  // min_fps_factor
     0,  // max_bitrate
+    false,  // dynamic_bitrate
 
     "1920x1080x60",  // fallback_mode
   };
@@ -1197,6 +1198,7 @@ namespace config {
 
     int_between_f(vars, "min_fps_factor", video.min_fps_factor, {1, 3});
     int_f(vars, "max_bitrate", video.max_bitrate);
+    bool_f(vars, "dynamic_bitrate", video.dynamic_bitrate);
     string_f(vars, "fallback_mode", video.fallback_mode);
 
     path_f(vars, "pkey", nvhttp.pkey);
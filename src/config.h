@@ -145,6 +145,7 @@ namespace config {
 
     int min_fps_factor;  // Minimum fps target, determines minimum frame time
     int max_bitrate;  // Maximum bitrate, sets ceiling in kbps for bitrate requested from client
+    bool dynamic_bitrate;  // Lower the bitrate during a session when the network can't keep up
 
     std::string fallback_mode;
   };
@@ -12,7 +12,9 @@
 #include <set>
 #include <sstream>
 #include <thread>
+#include <limits>
 #include <numeric>
+#include <optional>
 #include <algorithm>
 
 // lib includes
@@ -24,21 +26,28 @@
 #include <Simple-Web-Server/server_https.hpp>
 
 // local includes
+#include "asset_cache.h"
+#include "compression.h"
 #include "config.h"
 #include "confighttp.h"
 #include "crypto.h"
 #include "display_device.h"
 #include "file_handler.h"
+#include "frame_trace.h"
 #include "globals.h"
 #include "httpcommon.h"
+#include "log_ring.h"
 #include "logging.h"
+#include "metrics.h"
 #include "network.h"
 #include "nvhttp.h"
 #include "platform/common.h"
 #include "process.h"
+#include "startup_timeline.h"
 #include "utility.h"
 #include "uuid.h"
 #include "version.h"
+#include "web_assets.h"
 
 #ifdef _WIN32
   #include "platform/windows/utils.h"
@@ -238,6 +247,51 @@ namespace confighttp {
     response->write(code, tree.dump(), headers);
   }
 
+  /**
+   * @brief The files of the web UI, compressed and revalidated in memory.
+   */
+  web_assets::cache_t web_cache;
+
+  /**
+   * @brief Send a file of the web UI.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   * @param path The path of the file.
+   * @param content_type The content type of the file.
+   * @param headers Additional headers of the response.
+   */
+  void send_web_asset(resp_https_t response, req_https_t request, const fs::path &path, const std::string &content_type, SimpleWeb::CaseInsensitiveMultimap headers = {}) {
+    auto asset = web_cache.get(path, content_type);
+    if (!asset) {
+      not_found(response, request);
+      return;
+    }
+
+    auto accept_encoding = request->header.find("Accept-Encoding");
+    bool gzip = asset->gzip && accept_encoding != std::end(request->header) && compression::accepts(accept_encoding->second, "gzip");
+    auto &etag = gzip ? asset->gzip_etag : asset->etag;
+
+    headers.emplace("ETag", etag);
+    headers.emplace("Vary", "Accept-Encoding");
+    headers.emplace("Cache-Control", web_assets::immutable(path) ? "public, max-age=31536000, immutable" : "no-cache");
+
+    auto if_none_match = request->header.find("If-None-Match");
+    if (if_none_match != std::end(request->header) && asset_cache::matches(if_none_match->second, etag)) {
+      response->write(SimpleWeb::StatusCode::redirection_not_modified, headers);
+      return;
+    }
+
+    headers.emplace("Content-Type", content_type);
+
+    if (gzip) {
+      headers.emplace("Content-Encoding", "gzip");
+      response->write(SimpleWeb::StatusCode::success_ok, *asset->gzip, headers);
+      return;
+    }
+
+    response->write(SimpleWeb::StatusCode::success_ok, asset->data, headers);
+  }
+
   /**
    * @brief Get the index page.
    * @param response The HTTP response object.
@@ -250,11 +304,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "index.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "index.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -269,11 +319,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "pin.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "pin.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -288,12 +334,9 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "apps.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"},
+    send_web_asset(response, request, WEB_DIR "apps.html", "text/html; charset=utf-8", {
       {"Access-Control-Allow-Origin", "https://images.igdb.com/"}
-    };
-    response->write(content, headers);
+    });
   }
 
   /**
@@ -308,11 +351,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "clients.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "clients.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -327,11 +366,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "config.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "config.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -346,11 +381,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "password.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "password.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -370,11 +401,7 @@ namespace confighttp {
       return;
     }
 
-    std::string content = file_handler::read_file(WEB_DIR "login.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "login.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -390,11 +417,7 @@ namespace confighttp {
       return;
     }
 
-    std::string content = file_handler::read_file(WEB_DIR "welcome.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "welcome.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -409,11 +432,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "troubleshooting.html");
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "text/html; charset=utf-8"}
-    };
-    response->write(content, headers);
+    send_web_asset(response, request, WEB_DIR "troubleshooting.html", "text/html; charset=utf-8");
   }
 
   /**
@@ -424,11 +443,7 @@ namespace confighttp {
   void getFaviconImage(resp_https_t response, req_https_t request) {
     print_req(request);
 
-    std::ifstream in(WEB_DIR "images/apollo.ico", std::ios::binary);
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "image/x-icon"}
-    };
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    send_web_asset(response, request, WEB_DIR "images/apollo.ico", "image/x-icon");
   }
 
   /**
@@ -442,11 +457,7 @@ namespace confighttp {
   void getAquaHostLogoImage(resp_https_t response, req_https_t request) {
     print_req(request);
 
-    std::ifstream in(WEB_DIR "images/logo-apollo-45.png", std::ios::binary);
-    SimpleWeb::CaseInsensitiveMultimap headers {
-      {"Content-Type", "image/png"}
-    };
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    send_web_asset(response, request, WEB_DIR "images/logo-apollo-45.png", "image/png");
   }
 
   /**
@@ -494,10 +505,7 @@ namespace confighttp {
       bad_request(response, request);
       return;
     }
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", mimeType->second);
-    std::ifstream in(filePath.string(), std::ios::binary);
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    send_web_asset(response, request, filePath, mimeType->second);
   }
 
   /**
@@ -694,6 +702,73 @@ namespace confighttp {
     send_response(response, output_tree);
   }
 
+  /**
+   * @brief Get the startup timelines of recent sessions.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * Each timeline holds the milliseconds from the launch request to every phase the session reached,
+   * the summary holds the percentiles of the time to the first frame.
+   *
+   * @api_examples{/api/sessions/timeline| GET| null}
+   */
+  void getSessionTimelines(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    nlohmann::json output_tree = startup_timeline::to_json();
+    output_tree["status"] = true;
+    send_response(response, output_tree);
+  }
+
+  /**
+   * @brief Get a trace of the video pipeline of recent frames.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * The optional `seconds` query parameter selects how far back the trace goes, 5 seconds by default.
+   * The response is in the Chrome trace event format, it can be opened in chrome://tracing or Perfetto.
+   *
+   * @api_examples{/api/trace?seconds=5| GET| null}
+   */
+  void getTrace(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    auto args = request->parse_query_string();
+    auto seconds = std::clamp(util::from_view(nvhttp::get_arg(args, "seconds", "5")), (std::int64_t) 1, (std::int64_t) 60);
+
+    auto events = frame_trace::snapshot(std::chrono::seconds {seconds});
+    send_response(response, frame_trace::to_chrome_trace(events));
+  }
+
+  /**
+   * @brief Get metrics of the streaming sessions in the Prometheus text format.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * Requests need to be logged in like every other API, including those from this PC.
+   *
+   * @api_examples{/metrics| GET| null}
+   */
+  void getMetrics(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    SimpleWeb::CaseInsensitiveMultimap headers;
+    headers.emplace("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    response->write(SimpleWeb::StatusCode::success_ok, metrics::to_prometheus(), headers);
+  }
+
   /**
    * @brief Update client information.
    * @param response The HTTP response object.
@@ -933,11 +1008,20 @@ namespace confighttp {
   }
 
   /**
-   * @brief Get the logs from the log file.
+   * @brief Get the recent lines of the log.
    * @param response The HTTP response object.
    * @param request The HTTP request object.
    *
-   * @api_examples{/api/logs| GET| null}
+   * Lines are served from memory and addressed by byte offsets into the log written since startup.
+   * The optional query parameters are:
+   * - `since`: Offset to continue from, the `X-Log-End` header of the previous response.
+   * - `level`: Leave out lines below this severity, from 0 (verbose) to 5 (fatal).
+   * - `tail`: Return at most this many bytes, taken from the newest lines.
+   *
+   * `X-Log-Start` holds the offset of the oldest line still available.
+   * The body is gzip compressed for clients that accept it.
+   *
+   * @api_examples{/api/logs?since=0&level=2| GET| null}
    */
   void getLogs(resp_https_t response, req_https_t request) {
     if (!authenticate(response, request)) {
@@ -945,7 +1029,14 @@ namespace confighttp {
     }
 
     print_req(request);
-    std::string content = file_handler::read_file(config::sunshine.log_file.c_str());
+
+    auto args = request->parse_query_string();
+    auto since = std::max(util::from_view(nvhttp::get_arg(args, "since", "0")), (std::int64_t) 0);
+    auto level = std::clamp(util::from_view(nvhttp::get_arg(args, "level", "0")), (std::int64_t) 0, (std::int64_t) 5);
+    auto tail = util::from_view(nvhttp::get_arg(args, "tail", "0"));
+
+    auto slice = log_ring::recent.read(since, level, tail > 0 ? tail : std::numeric_limits<std::size_t>::max());
+
     SimpleWeb::CaseInsensitiveMultimap headers;
     std::string contentType = "text/plain";
   #ifdef _WIN32
@@ -953,7 +1044,22 @@ namespace confighttp {
     contentType += currentCodePageToCharset();
   #endif
     headers.emplace("Content-Type", contentType);
-    response->write(SimpleWeb::StatusCode::success_ok, content, headers);
+    headers.emplace("Cache-Control", "no-store");
+    headers.emplace("Vary", "Accept-Encoding");
+    headers.emplace("X-Log-Start", std::to_string(slice.start));
+    headers.emplace("X-Log-End", std::to_string(slice.end));
+
+    // Polls that only pick up a few new lines aren't worth compressing
+    auto accept_encoding = request->header.find("Accept-Encoding");
+    if (slice.text.size() >= 1024 && accept_encoding != std::end(request->header) && compression::accepts(accept_encoding->second, "gzip")) {
+      if (auto compressed = compression::gzip(slice.text, 1)) {
+        headers.emplace("Content-Encoding", "gzip");
+        response->write(SimpleWeb::StatusCode::success_ok, *compressed, headers);
+        return;
+      }
+    }
+
+    response->write(SimpleWeb::StatusCode::success_ok, slice.text, headers);
   }
 
   /**
@@ -1187,28 +1293,25 @@ namespace confighttp {
       return;
     }
     std::string uuid = nvhttp::get_arg(args, "uuid");
-    const auto &apps = proc::proc.get_apps();
-    for (auto &app : apps) {
-      if (app.uuid == uuid) {
-        auto appid = util::from_view(app.id);
-        crypto::named_cert_t named_cert {
-          .name = "",
-          .uuid = http::unique_id,
-          .perm = crypto::PERM::_all,
-        };
-        BOOST_LOG(info) << "Launching app ["sv << app.name << "] from web UI"sv;
-        auto launch_session = nvhttp::make_launch_session(true, false, appid, args, &named_cert);
-        auto err = proc::proc.execute(appid, app, launch_session);
-        if (err) {
-          bad_request(response, request, err == 503 ?
-                      "Failed to initialize video capture/encoding. Is a display connected and turned on?" :
-                      "Failed to start the specified application");
-        } else {
-          output_tree["status"] = true;
-          send_response(response, output_tree);
-        }
-        return;
+    if (auto app = proc::proc.find_app_by_uuid(uuid)) {
+      auto appid = util::from_view(app->id);
+      crypto::named_cert_t named_cert {
+        .name = "",
+        .uuid = http::unique_id,
+        .perm = crypto::PERM::_all,
+      };
+      BOOST_LOG(info) << "Launching app ["sv << app->name << "] from web UI"sv;
+      auto launch_session = nvhttp::make_launch_session(true, false, appid, args, &named_cert);
+      auto err = proc::proc.execute(appid, *app, launch_session);
+      if (err) {
+        bad_request(response, request, err == 503 ?
+                    "Failed to initialize video capture/encoding. Is a display connected and turned on?" :
+                    "Failed to start the specified application");
+      } else {
+        output_tree["status"] = true;
+        send_response(response, output_tree);
       }
+      return;
     }
     BOOST_LOG(error) << "Couldn't find app with uuid ["sv << uuid << ']';
     bad_request(response, request, "Cannot find requested application");
@@ -1337,6 +1440,9 @@ namespace confighttp {
     server.resource["^/api/clients/update$"]["POST"] = updateClient;
     server.resource["^/api/clients/unpair$"]["POST"] = unpair;
     server.resource["^/api/clients/disconnect$"]["POST"] = disconnect;
+    server.resource["^/api/sessions/timeline$"]["GET"] = getSessionTimelines;
+    server.resource["^/api/trace$"]["GET"] = getTrace;
+    server.resource["^/metrics$"]["GET"] = getMetrics;
     server.resource["^/api/covers/upload$"]["POST"] = uploadCover;
     server.resource["^/images/apollo.ico$"]["GET"] = getFaviconImage;
     server.resource["^/images/logo-apollo-45.png$"]["GET"] = getAquaHostLogoImage;
@@ -1345,6 +1451,19 @@ namespace confighttp {
     server.config.address = net::af_to_any_address_string(address_family);
     server.config.port = port_https;
 
+    // Read and compress the web UI ahead of the first visit
+    task_pool.push([]() {
+      web_cache.warm(WEB_DIR, [](const fs::path &path) -> std::optional<std::string> {
+        auto extension = path.extension().string();
+        auto mime_type = extension.empty() ? std::end(mime_types) : mime_types.find(extension.substr(1));
+        if (mime_type == std::end(mime_types)) {
+          return std::nullopt;
+        }
+
+        return mime_type->second == "text/html" ? "text/html; charset=utf-8" : mime_type->second;
+      });
+    });
+
     auto accept_and_run = [&](auto *server) {
       try {
         server->start([port_https](unsigned short port) {
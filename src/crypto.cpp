@@ -2,6 +2,9 @@
  * @file src/crypto.cpp
  * @brief Definitions for cryptography functions.
  */
+// standard includes
+#include <cstring>
+
 // lib includes
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
@@ -12,17 +15,56 @@
 namespace crypto {
   using asn1_string_t = util::safe_ptr<ASN1_STRING, ASN1_STRING_free>;
 
+  sha256_t fingerprint(X509 *cert) {
+    sha256_t fingerprint {};
+    X509_digest(cert, EVP_sha256(), fingerprint.data(), nullptr);
+
+    return fingerprint;
+  }
+
+  std::size_t cert_chain_t::fingerprint_hash_t::operator()(const sha256_t &fingerprint) const noexcept {
+    // The fingerprint is already uniformly distributed
+    std::size_t hash;
+    std::memcpy(&hash, fingerprint.data(), sizeof(hash));
+
+    return hash;
+  }
+
   cert_chain_t::cert_chain_t():
       _certs {}, _cert_ctx { X509_STORE_CTX_new() } {
   }
   void cert_chain_t::add(p_named_cert_t& named_cert_p) {
+    auto cert = x509(named_cert_p->cert);
+    if (!cert) {
+      return;
+    }
+
     x509_store_t x509_store { X509_STORE_new() };
+    X509_STORE_add_cert(x509_store.get(), cert.get());
+
+    std::lock_guard lg {_mutex};
+
+    // A certificate paired twice belongs to the device that paired it first
+    _certs.try_emplace(fingerprint(cert.get()), paired_cert_t {named_cert_p, std::move(x509_store)});
+  }
 
-    X509_STORE_add_cert(x509_store.get(), x509(named_cert_p->cert).get());
-    _certs.emplace_back(std::make_pair(named_cert_p, std::move(x509_store)));
+  void cert_chain_t::remove(const p_named_cert_t &named_cert_p) {
+    auto cert = x509(named_cert_p->cert);
+    if (!cert) {
+      return;
+    }
+
+    std::lock_guard lg {_mutex};
+
+    // Leave the certificate alone if another client paired it first
+    auto it = _certs.find(fingerprint(cert.get()));
+    if (it != std::end(_certs) && it->second.named_cert == named_cert_p) {
+      _certs.erase(it);
+    }
   }
 
   void cert_chain_t::clear() {
+    std::lock_guard lg {_mutex};
     _certs.clear();
   }
 
@@ -51,17 +93,28 @@ namespace crypto {
    * Moonlight to be able to use Sunshine
    *
    * To circumvent this, x509_store_t instance will be created for each instance of the certificates.
+   * Only a paired certificate can verify against its own store, so the store is found by the fingerprint
+   * of the presented certificate and X509_verify_cert runs once per paired certificate.
    * @param cert The certificate to verify.
    * @return nullptr if the certificate is valid, otherwise an error string.
    */
   const char * cert_chain_t::verify(x509_t::element_type *cert, p_named_cert_t& named_cert_out) {
-    int err_code = 0;
-    for (auto &[named_cert_p, x509_store] : _certs) {
+    auto cert_fingerprint = fingerprint(cert);
+
+    std::lock_guard lg {_mutex};
+
+    auto it = _certs.find(cert_fingerprint);
+    if (it == std::end(_certs)) {
+      return X509_verify_cert_error_string(X509_V_ERR_CERT_UNTRUSTED);
+    }
+
+    auto &paired_cert = it->second;
+    if (!paired_cert.err_code) {
       auto fg = util::fail_guard([this]() {
         X509_STORE_CTX_cleanup(_cert_ctx.get());
       });
 
-      X509_STORE_CTX_init(_cert_ctx.get(), x509_store.get(), cert, nullptr);
+      X509_STORE_CTX_init(_cert_ctx.get(), paired_cert.x509_store.get(), cert, nullptr);
       X509_STORE_CTX_set_verify_cb(_cert_ctx.get(), openssl_verify_cb);
 
       // We don't care to validate the entire chain for the purposes of client auth.
@@ -69,21 +122,20 @@ namespace crypto {
       // that OpenSSL doesn't detect as self-signed due to some X509v3 extensions.
       X509_STORE_CTX_set_flags(_cert_ctx.get(), X509_V_FLAG_PARTIAL_CHAIN);
 
-      auto err = X509_verify_cert(_cert_ctx.get());
-
-      if (err == 1) {
-        named_cert_out = named_cert_p;
-        return nullptr;
+      if (X509_verify_cert(_cert_ctx.get()) == 1) {
+        paired_cert.err_code = X509_V_OK;
+      } else {
+        auto err_code = X509_STORE_CTX_get_error(_cert_ctx.get());
+        paired_cert.err_code = err_code != X509_V_OK ? err_code : X509_V_ERR_UNSPECIFIED;
       }
+    }
 
-      err_code = X509_STORE_CTX_get_error(_cert_ctx.get());
-
-      if (err_code != X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT && err_code != X509_V_ERR_INVALID_CA) {
-        return X509_verify_cert_error_string(err_code);
-      }
+    if (*paired_cert.err_code != X509_V_OK) {
+      return X509_verify_cert_error_string(*paired_cert.err_code);
     }
 
-    return X509_verify_cert_error_string(err_code);
+    named_cert_out = paired_cert.named_cert;
+    return nullptr;
   }
 
   namespace cipher {
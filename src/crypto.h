@@ -6,6 +6,9 @@
 
 // standard includes
 #include <array>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 // lib includes
 #include <list>
@@ -131,19 +134,47 @@ namespace crypto {
   std::string rand(std::size_t bytes);
   std::string rand_alphabet(std::size_t bytes, const std::string_view &alphabet = std::string_view {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!%&()=-"});
 
+  /**
+   * @brief The SHA-256 fingerprint of a certificate, the digest of its DER encoding.
+   */
+  sha256_t fingerprint(X509 *cert);
+
+  /**
+   * @brief The certificates of the paired clients.
+   * @details Certificates are indexed by their fingerprint, so verifying a client is a single lookup
+   *          no matter how many clients are paired. The verification result of each certificate is cached
+   *          until the chain is cleared.
+   */
   class cert_chain_t {
   public:
-    KITTY_DECL_CONSTR(cert_chain_t)
+    cert_chain_t();
 
     void add(p_named_cert_t& named_cert_p);
 
+    /**
+     * @brief Remove the certificate of an unpaired client.
+     * @param named_cert_p The client, as it was added.
+     */
+    void remove(const p_named_cert_t &named_cert_p);
+
     void clear();
 
     const char *verify(x509_t::element_type *cert, p_named_cert_t& named_cert_out);
 
   private:
-    std::vector<std::pair<p_named_cert_t, x509_store_t>> _certs;
+    struct fingerprint_hash_t {
+      std::size_t operator()(const sha256_t &fingerprint) const noexcept;
+    };
+
+    struct paired_cert_t {
+      p_named_cert_t named_cert;
+      x509_store_t x509_store;
+      std::optional<int> err_code;  ///< Cached result of X509_verify_cert, empty until the certificate was presented.
+    };
+
+    std::unordered_map<sha256_t, paired_cert_t, fingerprint_hash_t> _certs;
     x509_store_ctx_t _cert_ctx;
+    std::mutex _mutex;
   };
 
   namespace cipher {
@@ -0,0 +1,182 @@
+/**
+ * @file src/frame_trace.cpp
+ * @brief Definitions for the per-frame pipeline tracer.
+ */
+// this include
+#include "frame_trace.h"
+
+// standard includes
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+using namespace std::literals;
+
+namespace frame_trace {
+  // About 20 seconds of history at 240 FPS with a dozen events per frame
+  constexpr std::size_t ring_size = 1 << 16;
+  static_assert((ring_size & (ring_size - 1)) == 0, "ring_size must be a power of two");
+
+  /**
+   * @brief A ring slot guarded by a sequence lock.
+   * @details The sequence is odd while the slot is written and `2 * (ticket + 1)` once it holds the event of that ticket.
+   *          Fields are relaxed atomics, so a reader racing with a writer sees a torn event it then discards, rather than undefined behavior.
+   */
+  struct slot_t {
+    std::atomic<std::uint64_t> sequence {0};
+    std::atomic<std::int64_t> begin_ns {0};
+    std::atomic<std::int64_t> duration_ns {0};
+    std::atomic<std::int64_t> frame {0};
+    std::atomic<std::uint64_t> thread_stage {0};
+  };
+
+  static std::array<slot_t, ring_size> ring;
+  static std::atomic<std::uint64_t> head {0};
+
+  static std::atomic<std::uint32_t> thread_counter {0};
+
+  static std::mutex thread_names_lock;
+  static std::map<std::uint32_t, std::string> thread_names;
+
+  std::uint32_t thread_id() {
+    thread_local std::uint32_t id = ++thread_counter;
+    return id;
+  }
+
+  std::string_view to_string(stage_e stage) {
+    switch (stage) {
+      case stage_e::pool_acquire:
+        return "pool_acquire"sv;
+      case stage_e::capture:
+        return "capture"sv;
+      case stage_e::convert:
+        return "convert"sv;
+      case stage_e::encode_submit:
+        return "encode_submit"sv;
+      case stage_e::encode_receive:
+        return "encode_receive"sv;
+      case stage_e::queue_wait:
+        return "queue_wait"sv;
+      case stage_e::packetize:
+        return "packetize"sv;
+      case stage_e::fec:
+        return "fec"sv;
+      case stage_e::encrypt:
+        return "encrypt"sv;
+      case stage_e::send_batch:
+        return "send_batch"sv;
+      case stage_e::_count:
+        break;
+    }
+
+    return "unknown"sv;
+  }
+
+  void record(stage_e stage, std::int64_t frame, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    auto ticket = head.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = ring[ticket & (ring_size - 1)];
+
+    slot.sequence.store(ticket * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.begin_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(begin.time_since_epoch()).count(), std::memory_order_relaxed);
+    slot.duration_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count(), std::memory_order_relaxed);
+    slot.frame.store(frame, std::memory_order_relaxed);
+    slot.thread_stage.store(((std::uint64_t) thread_id() << 8) | (std::uint8_t) stage, std::memory_order_relaxed);
+
+    slot.sequence.store(ticket * 2 + 2, std::memory_order_release);
+  }
+
+  void name_thread(std::string_view name) {
+    std::lock_guard lg {thread_names_lock};
+    thread_names.insert_or_assign(thread_id(), std::string {name});
+  }
+
+  std::vector<event_t> snapshot(std::chrono::nanoseconds window) {
+    auto cutoff = std::chrono::steady_clock::now() - window;
+
+    auto end = head.load(std::memory_order_acquire);
+    auto begin = end > ring_size ? end - ring_size : 0;
+
+    std::vector<event_t> events;
+    for (auto ticket = begin; ticket < end; ++ticket) {
+      auto &slot = ring[ticket & (ring_size - 1)];
+
+      auto sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != ticket * 2 + 2) {
+        // Still being written, or already overwritten by a newer event
+        continue;
+      }
+
+      std::chrono::steady_clock::time_point event_begin {std::chrono::nanoseconds {slot.begin_ns.load(std::memory_order_relaxed)}};
+      std::chrono::nanoseconds duration {slot.duration_ns.load(std::memory_order_relaxed)};
+      auto frame = slot.frame.load(std::memory_order_relaxed);
+      auto thread_stage = slot.thread_stage.load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+        continue;
+      }
+
+      if (event_begin + duration < cutoff) {
+        continue;
+      }
+
+      events.push_back(event_t {
+        event_begin,
+        duration,
+        frame,
+        (std::uint32_t) (thread_stage >> 8),
+        (stage_e) (thread_stage & 0xFF),
+      });
+    }
+
+    return events;
+  }
+
+  nlohmann::json to_chrome_trace(const std::vector<event_t> &events) {
+    auto trace_events = nlohmann::json::array();
+
+    {
+      std::lock_guard lg {thread_names_lock};
+      for (const auto &[thread, name] : thread_names) {
+        trace_events.push_back({
+          {"name", "thread_name"},
+          {"ph", "M"},
+          {"pid", 1},
+          {"tid", thread},
+          {"args", {{"name", name}}},
+        });
+      }
+    }
+
+    auto to_us = [](auto duration) {
+      return std::chrono::duration<double, std::micro>(duration).count();
+    };
+
+    for (const auto &event : events) {
+      nlohmann::json trace_event {
+        {"name", std::string {to_string(event.stage)}},
+        {"cat", "video"},
+        {"ph", "X"},
+        {"ts", to_us(event.begin.time_since_epoch())},
+        {"dur", to_us(event.duration)},
+        {"pid", 1},
+        {"tid", event.thread},
+      };
+
+      if (event.frame >= 0) {
+        trace_event["args"] = {{"frame", event.frame}};
+      }
+
+      trace_events.push_back(std::move(trace_event));
+    }
+
+    return {
+      {"traceEvents", std::move(trace_events)},
+      {"displayTimeUnit", "ms"},
+    };
+  }
+}  // namespace frame_trace
@@ -0,0 +1,96 @@
+/**
+ * @file src/frame_trace.h
+ * @brief Declarations for the per-frame pipeline tracer.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// lib includes
+#include <nlohmann/json.hpp>
+
+namespace frame_trace {
+  /**
+   * @brief Stages of the video pipeline a frame passes through.
+   */
+  enum class stage_e : std::uint8_t {
+    pool_acquire,  ///< Waiting for a free image in the capture pool.
+    capture,  ///< Capturing into the acquired image.
+    convert,  ///< Converting the captured image for the encoder.
+    encode_submit,  ///< Submitting the frame to the encoder.
+    encode_receive,  ///< Receiving encoded packets from the encoder.
+    queue_wait,  ///< Encoded packet waiting for the network thread.
+    packetize,  ///< Splitting the packet into FEC blocks.
+    fec,  ///< FEC encoding of one block.
+    encrypt,  ///< Preparing and encrypting the shards of one batch.
+    send_batch,  ///< Sending one batch of shards.
+    _count
+  };
+
+  /**
+   * @brief Name of a stage, as shown in the trace.
+   */
+  std::string_view to_string(stage_e stage);
+
+  /**
+   * @brief A completed stage of a frame.
+   */
+  struct event_t {
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::nanoseconds duration;
+    std::int64_t frame;  ///< Frame number, or -1 if the stage doesn't know it.
+    std::uint32_t thread;  ///< Tracer assigned ID of the recording thread.
+    stage_e stage;
+  };
+
+  /**
+   * @brief Record a completed stage.
+   * @details Lock-free and allocation-free, so it's safe to call on the capture, encode and network threads.
+   */
+  void record(stage_e stage, std::int64_t frame, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+  /**
+   * @brief Name the calling thread in the trace.
+   */
+  void name_thread(std::string_view name);
+
+  /**
+   * @brief Records a stage spanning its own lifetime.
+   */
+  class scope_t {
+  public:
+    scope_t(stage_e stage, std::int64_t frame = -1):
+        stage {stage},
+        frame {frame},
+        begin {std::chrono::steady_clock::now()} {
+    }
+
+    ~scope_t() {
+      record(stage, frame, begin, std::chrono::steady_clock::now());
+    }
+
+    scope_t(const scope_t &) = delete;
+    scope_t &operator=(const scope_t &) = delete;
+
+  private:
+    stage_e stage;
+    std::int64_t frame;
+    std::chrono::steady_clock::time_point begin;
+  };
+
+  /**
+   * @brief Copy out recent events.
+   * @param window Only events that ended within this long ago are returned.
+   * @return The events, oldest first. Events overwritten while copying are skipped.
+   */
+  std::vector<event_t> snapshot(std::chrono::nanoseconds window);
+
+  /**
+   * @brief Convert events to the Chrome trace event format, as read by chrome://tracing and Perfetto.
+   */
+  nlohmann::json to_chrome_trace(const std::vector<event_t> &events);
+}  // namespace frame_trace
@@ -7,6 +7,7 @@
 
 safe::mail_t mail::man;
 thread_pool_util::ThreadPool task_pool;
+thread_pool_util::ThreadPool input_pool;
 bool display_cursor = true;
 
 #ifdef _WIN32
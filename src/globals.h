@@ -13,6 +13,13 @@
  */
 extern thread_pool_util::ThreadPool task_pool;
 
+/**
+ * @brief A single thread pool that injects input into the OS.
+ * @details Everything touching the platform input context runs here, which keeps injection serialized
+ *          without sharing a thread with the timers and housekeeping tasks of task_pool.
+ */
+extern thread_pool_util::ThreadPool input_pool;
+
 /**
  * @brief A boolean flag to indicate whether the cursor should be displayed.
  */
@@ -47,12 +54,13 @@ namespace mail {
   MAIL(broadcast_shutdown);
   MAIL(video_packets);
   MAIL(audio_packets);
-  MAIL(switch_display);
 
   // Local mail
+  MAIL(switch_display);
   MAIL(touch_port);
   MAIL(idr);
   MAIL(invalidate_ref_frames);
+  MAIL(bitrate);
   MAIL(gamepad_feedback);
   MAIL(hdr);
 #undef MAIL
@@ -9,10 +9,12 @@ extern "C" {
 }
 
 // standard includes
+#include <array>
+#include <atomic>
 #include <bitset>
 #include <chrono>
 #include <cmath>
-#include <list>
+#include <optional>
 #include <thread>
 #include <unordered_map>
 
@@ -24,6 +26,7 @@ extern "C" {
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
+#include "metrics.h"
 #include "platform/common.h"
 #include "thread_pool.h"
 #include "utility.h"
@@ -132,7 +135,7 @@ namespace input {
 
     ~gamepad_t() {
       if (id >= 0) {
-        task_pool.push([id = this->id]() {
+        input_pool.push([id = this->id]() {
           free_gamepad(platf_input, id);
         });
       }
@@ -152,6 +155,95 @@ namespace input {
     button_state_e back_button_state;
   };
 
+  /**
+   * @brief Input messages of a session waiting for the input thread.
+   * @details The control stream thread is the only producer and the input thread the only consumer, so no lock is needed.
+   *          Messages the consumer batched into an earlier message are cleared in place and skipped once they reach the front.
+   */
+  class input_ring_t {
+  public:
+    static constexpr std::size_t capacity = 1024;
+
+    struct entry_t {
+      std::vector<std::uint8_t> data;
+      std::chrono::steady_clock::time_point received_at;
+    };
+
+    /**
+     * @brief Queue a message, called on the control stream thread.
+     * @param data The message.
+     * @param received_at When the packet holding the message was received.
+     * @return false if the ring is full.
+     */
+    bool push(std::vector<std::uint8_t> &&data, std::chrono::steady_clock::time_point received_at) {
+      auto head = write_index.load(std::memory_order_relaxed);
+      if (head - read_index.load(std::memory_order_acquire) == capacity) {
+        return false;
+      }
+
+      auto &entry = entries[head % capacity];
+      entry.data = std::move(data);
+      entry.received_at = received_at;
+
+      write_index.store(head + 1);
+      return true;
+    }
+
+    bool empty() const {
+      return read_index.load(std::memory_order_relaxed) == write_index.load();
+    }
+
+    /**
+     * @brief Take the oldest message, called on the input thread.
+     * @param entry Receives the message.
+     * @return false if the ring is empty.
+     */
+    bool pop(entry_t &entry) {
+      auto tail = read_index.load(std::memory_order_relaxed);
+      auto head = write_index.load(std::memory_order_acquire);
+
+      // Skip messages that were batched into an earlier one
+      while (tail != head && entries[tail % capacity].data.empty()) {
+        ++tail;
+      }
+
+      if (tail == head) {
+        read_index.store(tail, std::memory_order_release);
+        return false;
+      }
+
+      entry = std::move(entries[tail % capacity]);
+      entries[tail % capacity].data.clear();
+
+      read_index.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * @brief Visit the messages still queued, oldest first, called on the input thread.
+     * @param func Called with the entry, returns false to stop visiting. A message whose data it clears is dropped.
+     */
+    template<class Function>
+    void for_each_pending(Function &&func) {
+      auto head = write_index.load(std::memory_order_acquire);
+      for (auto x = read_index.load(std::memory_order_relaxed); x != head; ++x) {
+        auto &entry = entries[x % capacity];
+        if (entry.data.empty()) {
+          continue;
+        }
+
+        if (!func(entry)) {
+          break;
+        }
+      }
+    }
+
+  private:
+    std::array<entry_t, capacity> entries;
+    std::atomic<std::size_t> read_index {0};
+    std::atomic<std::size_t> write_index {0};
+  };
+
   struct input_t {
     enum shortkey_e {
       CTRL = 0x1,  ///< Control key
@@ -162,13 +254,17 @@ namespace input {
 
     input_t(
       safe::mail_raw_t::event_t<input::touch_port_t> touch_port_event,
-      platf::feedback_queue_t feedback_queue
+      safe::mail_raw_t::event_t<int> switch_display_event,
+      platf::feedback_queue_t feedback_queue,
+      std::shared_ptr<metrics::session_t> metrics
     ):
         shortcutFlags {},
         gamepads(MAX_GAMEPADS),
         client_context {platf::allocate_client_input_context(platf_input)},
         touch_port_event {std::move(touch_port_event)},
+        switch_display_event {std::move(switch_display_event)},
         feedback_queue {std::move(feedback_queue)},
+        metrics {std::move(metrics)},
         mouse_left_button_timeout {},
         touch_port {{0, 0, 0, 0}, 0, 0, 1.0f},
         accumulated_vscroll_delta {},
@@ -182,10 +278,15 @@ namespace input {
     std::unique_ptr<platf::client_input_t> client_context;
 
     safe::mail_raw_t::event_t<input::touch_port_t> touch_port_event;
+    safe::mail_raw_t::event_t<int> switch_display_event;
     platf::feedback_queue_t feedback_queue;
 
-    std::list<std::vector<uint8_t>> input_queue;
-    std::mutex input_queue_lock;
+    std::shared_ptr<metrics::session_t> metrics;
+
+    input_ring_t input_queue;
+
+    // Set while a dispatch of input_queue is queued on or running on the input thread
+    std::atomic<bool> dispatch_scheduled {false};
 
     thread_pool_util::ThreadPool::task_id_t mouse_left_button_timeout;
 
@@ -197,17 +298,19 @@ namespace input {
 
   /**
    * @brief Apply shortcut based on VKEY
+   * @param input The input context of the session that pressed the shortcut.
    * @param keyCode The VKEY code
    * @return 0 if no shortcut applied, > 0 if shortcut applied.
    */
-  inline int apply_shortcut(short keyCode) {
+  inline int apply_shortcut(input_t &input, short keyCode) {
     constexpr auto VK_F1 = 0x70;
     constexpr auto VK_F13 = 0x7C;
 
     BOOST_LOG(debug) << "Apply Shortcut: 0x"sv << util::hex((std::uint8_t) keyCode).to_string_view();
 
     if (keyCode >= VK_F1 && keyCode <= VK_F13) {
-      mail::man->event<int>(mail::switch_display)->raise(keyCode - VK_F1);
+      // Only the session that pressed the shortcut switches displays
+      input.switch_display_event->raise(keyCode - VK_F1);
       return 1;
     }
 
@@ -597,7 +700,7 @@ namespace input {
         input->mouse_left_button_timeout = nullptr;
       };
 
-      input->mouse_left_button_timeout = task_pool.pushDelayed(std::move(f), 10ms).task_id;
+      input->mouse_left_button_timeout = input_pool.pushDelayed(std::move(f), 10ms).task_id;
 
       return;
     }
@@ -716,7 +819,7 @@ namespace input {
 
     send_key_and_modifiers(key_code, false, flags, synthetic_modifiers);
 
-    key_press_repeat_id = task_pool.pushDelayed(repeat_key, config::input.key_repeat_period, key_code, flags, synthetic_modifiers).task_id;
+    key_press_repeat_id = input_pool.pushDelayed(repeat_key, config::input.key_repeat_period, key_code, flags, synthetic_modifiers).task_id;
   }
 
   void passthrough(std::shared_ptr<input_t> &input, PNV_KEYBOARD_PACKET packet) {
@@ -747,16 +850,16 @@ namespace input {
       if (!release) {
         // A new key has been pressed down, we need to check for key combo's
         // If a key-combo has been pressed down, don't pass it through
-        if (input->shortcutFlags == input_t::SHORTCUT && apply_shortcut(keyCode) > 0) {
+        if (input->shortcutFlags == input_t::SHORTCUT && apply_shortcut(*input, keyCode) > 0) {
           return;
         }
 
         if (key_press_repeat_id) {
-          task_pool.cancel(key_press_repeat_id);
+          input_pool.cancel(key_press_repeat_id);
         }
 
         if (config::input.key_repeat_delay.count() > 0) {
-          key_press_repeat_id = task_pool.pushDelayed(repeat_key, config::input.key_repeat_delay, keyCode, packet->flags, synthetic_modifiers).task_id;
+          key_press_repeat_id = input_pool.pushDelayed(repeat_key, config::input.key_repeat_delay, keyCode, packet->flags, synthetic_modifiers).task_id;
         }
       } else {
         // Already released
@@ -1180,10 +1283,10 @@ namespace input {
             gamepad.back_timeout_id = nullptr;
           };
 
-          gamepad.back_timeout_id = task_pool.pushDelayed(std::move(f), config::input.back_button_timeout).task_id;
+          gamepad.back_timeout_id = input_pool.pushDelayed(std::move(f), config::input.back_button_timeout).task_id;
         }
       } else if (gamepad.back_timeout_id) {
-        task_pool.cancel(gamepad.back_timeout_id);
+        input_pool.cancel(gamepad.back_timeout_id);
         gamepad.back_timeout_id = nullptr;
       }
     }
@@ -1475,54 +1578,11 @@ namespace input {
   }
 
   /**
-   * @brief Called on a thread pool thread to process an input message.
+   * @brief Send an input message to the OS.
    * @param input The input context pointer.
+   * @param payload The input message.
    */
-  void passthrough_next_message(std::shared_ptr<input_t> input) {
-    // 'entry' backs the 'payload' pointer, so they must remain in scope together
-    std::vector<uint8_t> entry;
-    PNV_INPUT_HEADER payload;
-
-    // Lock the input queue while batching, but release it before sending
-    // the input to the OS. This avoids potentially lengthy lock contention
-    // in the control stream thread while input is being processed by the OS.
-    {
-      std::lock_guard<std::mutex> lg(input->input_queue_lock);
-
-      // If all entries have already been processed, nothing to do
-      if (input->input_queue.empty()) {
-        return;
-      }
-
-      // Pop off the first entry, which we will send
-      entry = input->input_queue.front();
-      payload = (PNV_INPUT_HEADER) entry.data();
-      input->input_queue.pop_front();
-
-      // Try to batch with remaining items on the queue
-      auto i = input->input_queue.begin();
-      while (i != input->input_queue.end()) {
-        auto batchable_entry = *i;
-        auto batchable_payload = (PNV_INPUT_HEADER) batchable_entry.data();
-
-        auto batch_result = batch(payload, batchable_payload);
-        if (batch_result == batch_result_e::terminate_batch) {
-          // Stop batching
-          break;
-        } else if (batch_result == batch_result_e::batched) {
-          // Erase this entry since it was batched
-          i = input->input_queue.erase(i);
-        } else {
-          // We couldn't batch this entry, but try to batch later entries.
-          i++;
-        }
-      }
-    }
-
-    // Print the final input packet
-    input::print((void *) payload);
-
-    // Send the batched input to the OS
+  void inject(std::shared_ptr<input_t> &input, PNV_INPUT_HEADER payload) {
     switch (util::endian::little(payload->magic)) {
       case MOUSE_MOVE_REL_MAGIC_GEN5:
         passthrough(input, (PNV_REL_MOUSE_MOVE_PACKET) payload);
@@ -1571,17 +1631,129 @@ namespace input {
     }
   }
 
+  /**
+   * @brief Classify an input message for latency reporting.
+   * @param magic The magic of the input message, in host byte order.
+   * @return The input type, or std::nullopt for messages that aren't injected.
+   */
+  std::optional<metrics::input_type_e> input_type(std::uint32_t magic) {
+    switch (magic) {
+      case MOUSE_MOVE_REL_MAGIC_GEN5:
+        return metrics::input_type_e::mouse_rel;
+      case MOUSE_MOVE_ABS_MAGIC:
+        return metrics::input_type_e::mouse_abs;
+      case MOUSE_BUTTON_DOWN_EVENT_MAGIC_GEN5:
+      case MOUSE_BUTTON_UP_EVENT_MAGIC_GEN5:
+      case SCROLL_MAGIC_GEN5:
+      case SS_HSCROLL_MAGIC:
+        return metrics::input_type_e::mouse_button;
+      case KEY_DOWN_EVENT_MAGIC:
+      case KEY_UP_EVENT_MAGIC:
+      case UTF8_TEXT_EVENT_MAGIC:
+        return metrics::input_type_e::keyboard;
+      case MULTI_CONTROLLER_MAGIC_GEN5:
+      case SS_CONTROLLER_ARRIVAL_MAGIC:
+      case SS_CONTROLLER_TOUCH_MAGIC:
+      case SS_CONTROLLER_MOTION_MAGIC:
+      case SS_CONTROLLER_BATTERY_MAGIC:
+        return metrics::input_type_e::gamepad;
+      case SS_TOUCH_MAGIC:
+        return metrics::input_type_e::touch;
+      case SS_PEN_MAGIC:
+        return metrics::input_type_e::pen;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  /**
+   * @brief Called on the input thread to send the queued input messages of a session to the OS.
+   * @details Records the latency from receipt to injection of every packet, including the packets batched into
+   *          the one that was injected, and the number of packets in each batch.
+   * @param input The input context pointer.
+   */
+  void dispatch_messages(std::shared_ptr<input_t> input) {
+    static logging::time_delta_periodic_logger injection_latency_logger {debug, "Input: receipt to injection latency"};
+    static logging::percentile_periodic_logger<int> batch_size_logger {debug, "Input: packets per batch", ""};
+
+    // Receipt times of the packets batched into the current one, only touched on the input thread
+    static std::vector<std::chrono::steady_clock::time_point> batched_received_at;
+
+    input_ring_t::entry_t entry;
+    while (true) {
+      while (input->input_queue.pop(entry)) {
+        auto payload = (PNV_INPUT_HEADER) entry.data.data();
+
+        // Try to batch with the remaining messages, batched messages are cleared in place
+        batched_received_at.clear();
+        input->input_queue.for_each_pending([payload](input_ring_t::entry_t &pending) {
+          auto batch_result = batch(payload, (PNV_INPUT_HEADER) pending.data.data());
+          if (batch_result == batch_result_e::terminate_batch) {
+            // Stop batching
+            return false;
+          }
+
+          if (batch_result == batch_result_e::batched) {
+            batched_received_at.push_back(pending.received_at);
+            pending.data.clear();
+          }
+
+          // We couldn't batch this entry, but try to batch later entries.
+          return true;
+        });
+
+        // Print the final input packet
+        input::print((void *) payload);
+
+        // Send the batched input to the OS
+        inject(input, payload);
+
+        auto injected_at = std::chrono::steady_clock::now();
+        auto batch_size = batched_received_at.size() + 1;
+
+        input->metrics->add(metrics::counter_e::input_batches);
+        input->metrics->input_batch_size.record(batch_size);
+        batch_size_logger.collect_and_log((int) batch_size);
+
+        if (auto type = input_type(util::endian::little(payload->magic))) {
+          auto &latency = input->metrics->input_latency[(int) *type];
+          latency.record(std::chrono::duration_cast<std::chrono::microseconds>(injected_at - entry.received_at).count());
+          for (auto received_at : batched_received_at) {
+            latency.record(std::chrono::duration_cast<std::chrono::microseconds>(injected_at - received_at).count());
+          }
+        }
+
+        injection_latency_logger.first_point(entry.received_at);
+        injection_latency_logger.second_point_and_log(injected_at);
+      }
+
+      input->dispatch_scheduled = false;
+
+      // A message queued after the last pop, but before the flag was cleared, didn't schedule a dispatch
+      if (input->input_queue.empty() || input->dispatch_scheduled.exchange(true)) {
+        return;
+      }
+    }
+  }
+
   /**
    * @brief Called on the control stream thread to queue an input message.
    * @param input The input context pointer.
    * @param input_data The input message.
+   * @param permission The input permissions of the client.
+   * @param received_at When the control stream received the packet holding the message.
    */
-  void passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data, const crypto::PERM& permission) {
+  void passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data, const crypto::PERM& permission, std::chrono::steady_clock::time_point received_at) {
     // No input permissions at all
     if (!(permission & crypto::PERM::_all_inputs)) {
       return;
     }
 
+    // Too short to be an input message, empty entries also mark batched messages in the input queue
+    if (input_data.size() < sizeof(NV_INPUT_HEADER)) {
+      return;
+    }
+
     // Have some input permission
     // Otherwise have all input permission
     if ((permission & crypto::PERM::_all_inputs) != crypto::PERM::_all_inputs) {
@@ -1636,19 +1808,22 @@ namespace input {
       }
     }
 
-    {
-      std::lock_guard<std::mutex> lg(input->input_queue_lock);
-      input->input_queue.push_back(std::move(input_data));
+    if (!input->input_queue.push(std::move(input_data), received_at)) {
+      BOOST_LOG(warning) << "Input queue is full, dropping input message"sv;
+      return;
+    }
+
+    if (!input->dispatch_scheduled.exchange(true)) {
+      input_pool.push(dispatch_messages, input);
     }
-    task_pool.push(passthrough_next_message, input);
   }
 
   void reset(std::shared_ptr<input_t> &input) {
-    task_pool.cancel(key_press_repeat_id);
-    task_pool.cancel(input->mouse_left_button_timeout);
+    input_pool.cancel(key_press_repeat_id);
+    input_pool.cancel(input->mouse_left_button_timeout);
 
-    // Ensure input is synchronous, by using the task_pool
-    task_pool.push([]() {
+    // Ensure input is synchronous, by using the input thread
+    input_pool.push([]() {
       for (int x = 0; x < mouse_press.size(); ++x) {
         if (mouse_press[x]) {
           platf::button_mouse(platf_input, x, true);
@@ -1677,6 +1852,11 @@ namespace input {
   [[nodiscard]] std::unique_ptr<platf::deinit_t> init() {
     platf_input = platf::input();
 
+    // Input is injected on the input thread, it shouldn't wait behind capture or encoding
+    input_pool.push([]() {
+      platf::adjust_thread_priority(platf::thread_priority_e::high);
+    });
+
     return std::make_unique<deinit_t>();
   }
 
@@ -1691,14 +1871,16 @@ namespace input {
     return true;
   }
 
-  std::shared_ptr<input_t> alloc(safe::mail_t mail) {
+  std::shared_ptr<input_t> alloc(safe::mail_t mail, std::shared_ptr<metrics::session_t> metrics) {
     auto input = std::make_shared<input_t>(
       mail->event<input::touch_port_t>(mail::touch_port),
-      mail->queue<platf::gamepad_feedback_msg_t>(mail::gamepad_feedback)
+      mail->event<int>(mail::switch_display),
+      mail->queue<platf::gamepad_feedback_msg_t>(mail::gamepad_feedback),
+      std::move(metrics)
     );
 
     // Workaround to ensure new frames will be captured when a client connects
-    task_pool.pushDelayed([]() {
+    input_pool.pushDelayed([]() {
       platf::move_mouse(platf_input, 1, 1);
       platf::move_mouse(platf_input, -1, -1);
     },
@@ -5,25 +5,27 @@
 #pragma once
 
 // standard includes
+#include <chrono>
 #include <functional>
 
 // local includes
 #include "platform/common.h"
 #include "thread_safe.h"
 #include "crypto.h"
+#include "metrics.h"
 
 namespace input {
   struct input_t;
 
   void print(void *input);
   void reset(std::shared_ptr<input_t> &input);
-  void passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data, const crypto::PERM& permission);
+  void passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data, const crypto::PERM& permission, std::chrono::steady_clock::time_point received_at);
 
   [[nodiscard]] std::unique_ptr<platf::deinit_t> init();
 
   bool probe_gamepads();
 
-  std::shared_ptr<input_t> alloc(safe::mail_t mail);
+  std::shared_ptr<input_t> alloc(safe::mail_t mail, std::shared_ptr<metrics::session_t> metrics);
 
   struct touch_port_t: public platf::touch_port_t {
     int env_width, env_height;
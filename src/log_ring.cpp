@@ -0,0 +1,65 @@
+/**
+ * @file src/log_ring.cpp
+ * @brief Definitions for the in-memory ring of recent log records.
+ */
+// this include
+#include "log_ring.h"
+
+// standard includes
+#include <algorithm>
+
+namespace log_ring {
+  ring_t recent {4 * 1024 * 1024};
+
+  ring_t::ring_t(std::size_t capacity):
+      _capacity {capacity} {
+  }
+
+  void ring_t::push(int severity, const std::string &line) {
+    std::lock_guard lg {_mutex};
+
+    auto &record = _records.emplace_back(record_t {_end, severity, line});
+    record.line += '\n';
+
+    _end += record.line.size();
+    _size += record.line.size();
+
+    while (_size > _capacity && _records.size() > 1) {
+      _size -= _records.front().line.size();
+      _records.pop_front();
+    }
+  }
+
+  slice_t ring_t::read(std::uint64_t since, int min_severity, std::size_t max_bytes) {
+    std::lock_guard lg {_mutex};
+
+    slice_t slice {{}, _records.empty() ? _end : _records.front().offset, _end};
+
+    auto first = std::lower_bound(std::begin(_records), std::end(_records), since, [](const record_t &record, std::uint64_t offset) {
+      return record.offset < offset;
+    });
+
+    // Walk back from the newest line to find where the budget runs out
+    std::size_t bytes = 0;
+    auto begin = std::end(_records);
+    while (begin != first) {
+      auto &record = *std::prev(begin);
+      if (record.severity >= min_severity) {
+        if (bytes + record.line.size() > max_bytes) {
+          break;
+        }
+        bytes += record.line.size();
+      }
+      --begin;
+    }
+
+    slice.text.reserve(bytes);
+    for (auto it = begin; it != std::end(_records); ++it) {
+      if (it->severity >= min_severity) {
+        slice.text += it->line;
+      }
+    }
+
+    return slice;
+  }
+}  // namespace log_ring
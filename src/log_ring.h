@@ -0,0 +1,72 @@
+/**
+ * @file src/log_ring.h
+ * @brief Declarations for the in-memory ring of recent log records.
+ */
+#pragma once
+
+// standard includes
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+
+namespace log_ring {
+  /**
+   * @brief A slice of the log, see `ring_t::read()`.
+   */
+  struct slice_t {
+    std::string text;  ///< The lines of the slice, each terminated by a newline.
+    std::uint64_t start;  ///< Offset of the first line still held by the ring.
+    std::uint64_t end;  ///< Offset just past the last line, pass it as `since` to continue.
+  };
+
+  /**
+   * @brief Recent log records, addressed by byte offsets into the log written since startup.
+   * @details Offsets keep growing as lines are dropped from the front, so a reader that polls with the end offset of
+   *          its previous slice only ever receives new lines. Once the formatted lines exceed the capacity, the
+   *          oldest are dropped.
+   */
+  class ring_t {
+  public:
+    /**
+     * @param capacity Bytes of formatted lines to keep at most.
+     */
+    explicit ring_t(std::size_t capacity);
+
+    /**
+     * @brief Append a formatted log record.
+     * @param severity The severity of the record.
+     * @param line The formatted record, without the trailing newline.
+     */
+    void push(int severity, const std::string &line);
+
+    /**
+     * @brief Read the lines at or after an offset.
+     * @param since Offset to read from, lines the ring has already dropped are skipped.
+     * @param min_severity Leave out lines below this severity, offsets still count them.
+     * @param max_bytes Return at most this many bytes, taken from the end.
+     * @return The lines.
+     */
+    slice_t read(std::uint64_t since, int min_severity = 0, std::size_t max_bytes = std::numeric_limits<std::size_t>::max());
+
+  private:
+    struct record_t {
+      std::uint64_t offset;
+      int severity;
+      std::string line;
+    };
+
+    std::mutex _mutex;
+    std::size_t _capacity;
+    std::size_t _size = 0;
+    std::uint64_t _end = 0;
+    std::deque<record_t> _records;
+  };
+
+  /**
+   * @brief The records of the running process, fed by the log sink.
+   */
+  extern ring_t recent;
+}  // namespace log_ring
@@ -19,6 +19,7 @@
 #include <display_device/logging.h>
 
 // local includes
+#include "log_ring.h"
 #include "logging.h"
 
 extern "C" {
@@ -31,6 +32,18 @@ namespace bl = boost::log;
 
 boost::shared_ptr<boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend>> sink;
 
+/**
+ * @brief Sink backend that keeps formatted records in `log_ring::recent` for the web UI.
+ */
+class ring_backend_t: public boost::log::sinks::basic_formatted_sink_backend<char, boost::log::sinks::synchronized_feeding> {
+public:
+  void consume(const boost::log::record_view &view, const string_type &line) {
+    log_ring::recent.push(view.attribute_values()["Severity"].extract<int>().get(), line);
+  }
+};
+
+boost::shared_ptr<boost::log::sinks::asynchronous_sink<ring_backend_t>> ring_sink;
+
 bl::sources::severity_logger<int> verbose(0);  // Dominating output
 bl::sources::severity_logger<int> debug(1);  // Follow what is happening
 bl::sources::severity_logger<int> info(2);  // Should be informed about
@@ -52,6 +65,8 @@ namespace logging {
     log_flush();
     bl::core::get()->remove_sink(sink);
     sink.reset();
+    bl::core::get()->remove_sink(ring_sink);
+    ring_sink.reset();
   }
 
   void formatter(const boost::log::record_view &view, boost::log::formatting_ostream &os) {
@@ -138,6 +153,12 @@ namespace logging {
     sink->locked_backend()->auto_flush(true);
 
     bl::core::get()->add_sink(sink);
+
+    ring_sink = boost::make_shared<bl::sinks::asynchronous_sink<ring_backend_t>>();
+    ring_sink->set_filter(severity >= min_log_level);
+    ring_sink->set_formatter(&formatter);
+    bl::core::get()->add_sink(ring_sink);
+
     return std::make_unique<deinit_t>();
   }
 
@@ -203,6 +224,9 @@ namespace logging {
     if (sink) {
       sink->flush();
     }
+    if (ring_sink) {
+      ring_sink->flush();
+    }
   }
 
   void print_help(const char *name) {
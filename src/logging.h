@@ -86,22 +86,22 @@ namespace logging {
   void print_help(const char *name);
 
   /**
-   * @brief A helper class for tracking and logging numerical values across a period of time
+   * @brief A helper class for tracking and logging percentiles of numerical values across a period of time
    * @examples
-   * min_max_avg_periodic_logger<int> logger(debug, "Test time value", "ms", 5s);
+   * percentile_periodic_logger<double> logger(debug, "Test time value", "ms", 5s);
    * logger.collect_and_log(1);
    * // ...
    * logger.collect_and_log(2);
    * // after 5 seconds
    * logger.collect_and_log(3);
    * // In the log:
-   * // [2024:01:01:12:00:00]: Debug: Test time value (min/max/avg): 1ms/3ms/2.00ms
+   * // [2024:01:01:12:00:00]: Debug: Test time value (p50/p90/p99/p99.9/max): 1.00ms/2.00ms/2.00ms/2.00ms/2.00ms over 2 samples
    * @examples_end
    */
   template<typename T>
-  class min_max_avg_periodic_logger {
+  class percentile_periodic_logger {
   public:
-    min_max_avg_periodic_logger(boost::log::sources::severity_logger<int> &severity, std::string_view message, std::string_view units, std::chrono::seconds interval_in_seconds = std::chrono::seconds(20)):
+    percentile_periodic_logger(boost::log::sources::severity_logger<int> &severity, std::string_view message, std::string_view units, std::chrono::seconds interval_in_seconds = std::chrono::seconds(20)):
         severity(severity),
         message(message),
         units(units),
@@ -111,12 +111,12 @@ namespace logging {
 
     void collect_and_log(const T &value) {
       if (enabled) {
-        auto print_info = [&](const T &min_value, const T &max_value, double avg_value) {
+        auto print_info = [&](const typename stat_trackers::percentile_tracker<T>::percentiles_t &stats, std::size_t samples) {
           auto f = stat_trackers::two_digits_after_decimal();
           if constexpr (std::is_floating_point_v<T>) {
-            BOOST_LOG(severity.get()) << message << " (min/max/avg): " << f % min_value << units << "/" << f % max_value << units << "/" << f % avg_value << units;
+            BOOST_LOG(severity.get()) << message << " (p50/p90/p99/p99.9/max): " << f % stats.p50 << units << "/" << f % stats.p90 << units << "/" << f % stats.p99 << units << "/" << f % stats.p999 << units << "/" << f % stats.max << units << " over " << samples << " samples";
           } else {
-            BOOST_LOG(severity.get()) << message << " (min/max/avg): " << min_value << units << "/" << max_value << units << "/" << f % avg_value << units;
+            BOOST_LOG(severity.get()) << message << " (p50/p90/p99/p99.9/max): " << stats.p50 << units << "/" << stats.p90 << units << "/" << stats.p99 << units << "/" << stats.p999 << units << "/" << stats.max << units << " over " << samples << " samples";
           }
         };
         tracker.collect_and_callback_on_interval(value, print_info, interval);
@@ -145,7 +145,7 @@ namespace logging {
     std::string units;
     std::chrono::seconds interval;
     bool enabled;
-    stat_trackers::min_max_avg_tracker<T> tracker;
+    stat_trackers::percentile_tracker<T> tracker;
   };
 
   /**
@@ -160,7 +160,7 @@ namespace logging {
    * // ...
    * logger.second_point_now_and_log();
    * // In the log:
-   * // [2024:01:01:12:00:00]: Debug: Test duration (min/max/avg): 1.23ms/3.21ms/2.31ms
+   * // [2024:01:01:12:00:00]: Debug: Test duration (p50/p90/p99/p99.9/max): 1.23ms/3.21ms/3.21ms/3.21ms/3.21ms over 2 samples
    * @examples_end
    */
   class time_delta_periodic_logger {
@@ -205,7 +205,7 @@ namespace logging {
 
   private:
     std::chrono::steady_clock::time_point point1 = std::chrono::steady_clock::now();
-    min_max_avg_periodic_logger<double> logger;
+    percentile_periodic_logger<double> logger;
   };
 
   /**
@@ -244,6 +244,7 @@ int main(int argc, char *argv[]) {
 #endif
 
   task_pool.start(1);
+  input_pool.start(1);
 
 #if defined AQUA_TRAY && AQUA_TRAY >= 1
   // create tray thread and detach it
@@ -359,6 +360,9 @@ int main(int argc, char *argv[]) {
   task_pool.stop();
   task_pool.join();
 
+  input_pool.stop();
+  input_pool.join();
+
   // stop system tray
 #if defined AQUA_TRAY && AQUA_TRAY >= 1
   system_tray::end_tray();
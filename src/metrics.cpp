@@ -0,0 +1,330 @@
+/**
+ * @file src/metrics.cpp
+ * @brief Definitions for streaming session metrics in the Prometheus text format.
+ */
+// this include
+#include "metrics.h"
+
+// standard includes
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <vector>
+
+using namespace std::literals;
+
+namespace metrics {
+  struct counter_info_t {
+    std::string_view name;
+    std::string_view help;
+  };
+
+  static constexpr std::array<counter_info_t, (int) counter_e::_count> counter_info {{
+    {"frames_captured"sv, "Captured frames handed to the encoder."sv},
+    {"frames_dropped"sv, "Captured frames dropped for exceeding the requested frame rate."sv},
+    {"frames_encoded"sv, "Frames encoded and queued for sending."sv},
+    {"frames_sent"sv, "Frames sent to the client."sv},
+    {"video_bytes_sent"sv, "Video bytes sent, including FEC."sv},
+    {"video_packets_sent"sv, "Video packets sent, including FEC."sv},
+    {"video_fec_packets_sent"sv, "Video FEC packets sent."sv},
+    {"audio_bytes_sent"sv, "Audio bytes sent, including FEC."sv},
+    {"audio_packets_sent"sv, "Audio packets sent, including FEC."sv},
+    {"client_lost_frames"sv, "Frames reported lost by the client."sv},
+    {"input_events"sv, "Input packets received from the client."sv},
+    {"input_batches"sv, "Batches of input packets injected into the OS."sv},
+    {"bitrate_increases"sv, "Times the bitrate controller raised the video bitrate."sv},
+    {"bitrate_decreases"sv, "Times the bitrate controller lowered the video bitrate."sv},
+    {"encoder_reconfigurations"sv, "Bitrate changes applied to the running encoder."sv},
+    {"encoder_recreations"sv, "Bitrate changes that required a new encoder."sv},
+    {"idr_frames_sent"sv, "IDR frames sent to the client."sv},
+  }};
+
+  static constexpr std::array<std::string_view, (int) input_type_e::_count> input_type_names {
+    "mouse_rel"sv,
+    "mouse_abs"sv,
+    "mouse_button"sv,
+    "keyboard"sv,
+    "gamepad"sv,
+    "touch"sv,
+    "pen"sv,
+  };
+
+  // Upper bounds of the exported latency buckets, in microseconds
+  static constexpr std::array<std::uint64_t, 11> latency_bounds_us {
+    1000,
+    2000,
+    4000,
+    8000,
+    12000,
+    16000,
+    25000,
+    33000,
+    50000,
+    100000,
+    250000,
+  };
+
+  // Upper bounds of the exported batch sizes
+  static constexpr std::array<std::uint64_t, 7> batch_size_bounds {1, 2, 4, 8, 16, 32, 64};
+
+  // Upper bounds of the exported frame sizes, in bytes
+  static constexpr std::array<std::uint64_t, 10> frame_size_bounds {
+    4096,
+    8192,
+    16384,
+    32768,
+    65536,
+    131072,
+    262144,
+    524288,
+    1048576,
+    2097152,
+  };
+
+  static std::mutex sessions_lock;
+  static std::vector<const session_t *> sessions;
+
+  // Values of the sessions that already ended
+  static std::array<std::uint64_t, (int) counter_e::_count> retired_counters {};
+  static stat_trackers::histogram_t retired_encode_latency;
+  static stat_trackers::histogram_t retired_frame_processing_latency;
+  static stat_trackers::histogram_t retired_frame_size;
+  static std::array<stat_trackers::histogram_t, (int) input_type_e::_count> retired_input_latency;
+  static stat_trackers::histogram_t retired_input_batch_size;
+
+  std::string_view to_string(counter_e counter) {
+    return counter_info[(int) counter].name;
+  }
+
+  std::string_view to_string(input_type_e type) {
+    return input_type_names[(int) type];
+  }
+
+  session_t::session_t(std::uint32_t id, std::string client_name):
+      id {id},
+      client_name {std::move(client_name)} {
+    std::lock_guard lg {sessions_lock};
+    sessions.push_back(this);
+  }
+
+  session_t::~session_t() {
+    std::lock_guard lg {sessions_lock};
+    std::erase(sessions, this);
+
+    for (int x = 0; x < (int) counter_e::_count; ++x) {
+      retired_counters[x] += get((counter_e) x);
+    }
+    retired_encode_latency.merge(encode_latency);
+    retired_frame_processing_latency.merge(frame_processing_latency);
+    retired_frame_size.merge(frame_size);
+    for (int x = 0; x < (int) input_type_e::_count; ++x) {
+      retired_input_latency[x].merge(input_latency[x]);
+    }
+    retired_input_batch_size.merge(input_batch_size);
+  }
+
+  /**
+   * @brief Escape a label value as required by the text format.
+   */
+  static std::string escape_label(std::string_view value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+
+    for (auto ch : value) {
+      switch (ch) {
+        case '\\':
+          escaped += "\\\\"sv;
+          break;
+        case '"':
+          escaped += "\\\""sv;
+          break;
+        case '\n':
+          escaped += "\\n"sv;
+          break;
+        default:
+          escaped += ch;
+      }
+    }
+
+    return escaped;
+  }
+
+  static std::string session_labels(const session_t &session) {
+    return "session=\""s + std::to_string(session.id) + "\",client=\"" + escape_label(session.client_name) + '"';
+  }
+
+  static void write_header(std::ostream &out, std::string_view name, std::string_view type, std::string_view help) {
+    out << "# HELP aqua_"sv << name << ' ' << help << '\n';
+    out << "# TYPE aqua_"sv << name << ' ' << type << '\n';
+  }
+
+  /**
+   * @brief Write a histogram as a Prometheus histogram.
+   * @param labels Labels of the series without braces, may be empty.
+   * @param bounds Upper bounds of the exported buckets, in recorded units.
+   * @param unit Recorded units per exported unit, e.g. 1e6 to export microseconds as seconds.
+   */
+  static void write_histogram(std::ostream &out, std::string_view name, const std::string &labels, const stat_trackers::histogram_t &histogram, std::span<const std::uint64_t> bounds, double unit) {
+    std::array<std::uint64_t, std::max({latency_bounds_us.size(), batch_size_bounds.size(), frame_size_bounds.size()})> counts {};
+    histogram.for_each_bucket([&](std::uint64_t highest_value, std::uint64_t count) {
+      auto bound = std::lower_bound(std::begin(bounds), std::end(bounds), highest_value);
+      if (bound != std::end(bounds)) {
+        counts[bound - std::begin(bounds)] += count;
+      }
+    });
+
+    auto separator = labels.empty() ? ""sv : ","sv;
+
+    std::uint64_t cumulative = 0;
+    for (std::size_t x = 0; x < bounds.size(); ++x) {
+      cumulative += counts[x];
+      out << "aqua_"sv << name << "_bucket{"sv << labels << separator << "le=\""sv << bounds[x] / unit << "\"} "sv << cumulative << '\n';
+    }
+
+    auto count = histogram.count();
+    auto braced = labels.empty() ? std::string {} : '{' + labels + '}';
+    out << "aqua_"sv << name << "_bucket{"sv << labels << separator << "le=\"+Inf\"} "sv << count << '\n';
+    out << "aqua_"sv << name << "_sum"sv << braced << ' ' << histogram.mean() * count / unit << '\n';
+    out << "aqua_"sv << name << "_count"sv << braced << ' ' << count << '\n';
+  }
+
+  /**
+   * @brief Write a histogram of microseconds as a Prometheus histogram in seconds.
+   */
+  static void write_latency_histogram(std::ostream &out, std::string_view name, const std::string &labels, const stat_trackers::histogram_t &histogram) {
+    write_histogram(out, name, labels, histogram, latency_bounds_us, 1e6);
+  }
+
+  static std::string input_type_label(input_type_e type) {
+    return "type=\""s + std::string {to_string(type)} + '"';
+  }
+
+  std::string to_prometheus() {
+    std::ostringstream out;
+
+    std::lock_guard lg {sessions_lock};
+
+    write_header(out, "sessions_active"sv, "gauge"sv, "Streaming sessions currently running."sv);
+    out << "aqua_sessions_active "sv << sessions.size() << '\n';
+
+    for (int x = 0; x < (int) counter_e::_count; ++x) {
+      auto &info = counter_info[x];
+
+      auto total = retired_counters[x];
+      for (auto session : sessions) {
+        total += session->get((counter_e) x);
+      }
+
+      auto name = std::string {info.name} + "_total";
+      write_header(out, name, "counter"sv, info.help);
+      out << "aqua_"sv << name << ' ' << total << '\n';
+
+      if (sessions.empty()) {
+        continue;
+      }
+
+      name = "session_" + name;
+      write_header(out, name, "counter"sv, info.help);
+      for (auto session : sessions) {
+        out << "aqua_"sv << name << '{' << session_labels(*session) << "} "sv << session->get((counter_e) x) << '\n';
+      }
+    }
+
+    if (!sessions.empty()) {
+      write_header(out, "session_video_queue_depth"sv, "gauge"sv, "Encoded frames waiting for the network thread."sv);
+      for (auto session : sessions) {
+        out << "aqua_session_video_queue_depth{"sv << session_labels(*session) << "} "sv << session->video_queue_depth.load(std::memory_order_relaxed) << '\n';
+      }
+
+      write_header(out, "session_fec_overhead_ratio"sv, "gauge"sv, "Video FEC packets sent per data packet."sv);
+      for (auto session : sessions) {
+        auto packets = session->get(counter_e::video_packets_sent);
+        auto fec_packets = session->get(counter_e::video_fec_packets_sent);
+        auto data_packets = packets > fec_packets ? packets - fec_packets : 0;
+        out << "aqua_session_fec_overhead_ratio{"sv << session_labels(*session) << "} "sv << (data_packets ? (double) fec_packets / data_packets : 0.0) << '\n';
+      }
+
+      write_header(out, "session_target_bitrate_bits_per_second"sv, "gauge"sv, "Video bitrate chosen by the bitrate controller."sv);
+      for (auto session : sessions) {
+        if (auto kbps = session->target_bitrate_kbps.load(std::memory_order_relaxed)) {
+          out << "aqua_session_target_bitrate_bits_per_second{"sv << session_labels(*session) << "} "sv << kbps * 1000ull << '\n';
+        }
+      }
+    }
+
+    // The totals merge every session, past and present
+    auto encode_latency = std::make_unique<stat_trackers::histogram_t>();
+    auto frame_processing_latency = std::make_unique<stat_trackers::histogram_t>();
+    encode_latency->merge(retired_encode_latency);
+    frame_processing_latency->merge(retired_frame_processing_latency);
+    auto frame_size = std::make_unique<stat_trackers::histogram_t>();
+    frame_size->merge(retired_frame_size);
+    auto input_batch_size = std::make_unique<stat_trackers::histogram_t>();
+    input_batch_size->merge(retired_input_batch_size);
+    for (auto session : sessions) {
+      encode_latency->merge(session->encode_latency);
+      frame_processing_latency->merge(session->frame_processing_latency);
+      frame_size->merge(session->frame_size);
+      input_batch_size->merge(session->input_batch_size);
+    }
+
+    write_header(out, "encode_latency_seconds"sv, "histogram"sv, "Time spent in the encoder per frame."sv);
+    write_latency_histogram(out, "encode_latency_seconds"sv, {}, *encode_latency);
+
+    write_header(out, "frame_processing_latency_seconds"sv, "histogram"sv, "Time from capture until the frame is picked up for sending."sv);
+    write_latency_histogram(out, "frame_processing_latency_seconds"sv, {}, *frame_processing_latency);
+
+    write_header(out, "frame_size_bytes"sv, "histogram"sv, "Size of each encoded video frame."sv);
+    write_histogram(out, "frame_size_bytes"sv, {}, *frame_size, frame_size_bounds, 1);
+
+    write_header(out, "input_latency_seconds"sv, "histogram"sv, "Time from receipt of an input packet until it was injected into the OS."sv);
+    for (int x = 0; x < (int) input_type_e::_count; ++x) {
+      auto input_latency = std::make_unique<stat_trackers::histogram_t>();
+      input_latency->merge(retired_input_latency[x]);
+      for (auto session : sessions) {
+        input_latency->merge(session->input_latency[x]);
+      }
+
+      write_latency_histogram(out, "input_latency_seconds"sv, input_type_label((input_type_e) x), *input_latency);
+    }
+
+    write_header(out, "input_batch_size"sv, "histogram"sv, "Input packets coalesced into each injected batch."sv);
+    write_histogram(out, "input_batch_size"sv, {}, *input_batch_size, batch_size_bounds, 1);
+
+    if (!sessions.empty()) {
+      write_header(out, "session_encode_latency_seconds"sv, "histogram"sv, "Time spent in the encoder per frame."sv);
+      for (auto session : sessions) {
+        write_latency_histogram(out, "session_encode_latency_seconds"sv, session_labels(*session), session->encode_latency);
+      }
+
+      write_header(out, "session_frame_processing_latency_seconds"sv, "histogram"sv, "Time from capture until the frame is picked up for sending."sv);
+      for (auto session : sessions) {
+        write_latency_histogram(out, "session_frame_processing_latency_seconds"sv, session_labels(*session), session->frame_processing_latency);
+      }
+
+      write_header(out, "session_frame_size_bytes"sv, "histogram"sv, "Size of each encoded video frame."sv);
+      for (auto session : sessions) {
+        write_histogram(out, "session_frame_size_bytes"sv, session_labels(*session), session->frame_size, frame_size_bounds, 1);
+      }
+
+      // Only the input types a session actually used, most clients never send pen or touch input
+      write_header(out, "session_input_latency_seconds"sv, "histogram"sv, "Time from receipt of an input packet until it was injected into the OS."sv);
+      for (auto session : sessions) {
+        for (int x = 0; x < (int) input_type_e::_count; ++x) {
+          if (session->input_latency[x].count()) {
+            write_latency_histogram(out, "session_input_latency_seconds"sv, session_labels(*session) + ',' + input_type_label((input_type_e) x), session->input_latency[x]);
+          }
+        }
+      }
+
+      write_header(out, "session_input_batch_size"sv, "histogram"sv, "Input packets coalesced into each injected batch."sv);
+      for (auto session : sessions) {
+        write_histogram(out, "session_input_batch_size"sv, session_labels(*session), session->input_batch_size, batch_size_bounds, 1);
+      }
+    }
+
+    return out.str();
+  }
+}  // namespace metrics
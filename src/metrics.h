@@ -0,0 +1,139 @@
+/**
+ * @file src/metrics.h
+ * @brief Declarations for streaming session metrics in the Prometheus text format.
+ */
+#pragma once
+
+// standard includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// local includes
+#include "stat_trackers.h"
+
+namespace metrics {
+  /**
+   * @brief Counters kept for every streaming session.
+   */
+  enum class counter_e : int {
+    frames_captured,  ///< Captured frames handed to the encoder of the session.
+    frames_dropped,  ///< Captured frames dropped because they came in faster than the requested frame rate.
+    frames_encoded,  ///< Frames encoded and queued for the network thread.
+    frames_sent,  ///< Frames sent to the client.
+    video_bytes_sent,  ///< Video bytes sent, including FEC and protocol headers.
+    video_packets_sent,  ///< Video packets sent, including FEC packets.
+    video_fec_packets_sent,  ///< Video FEC packets sent.
+    audio_bytes_sent,  ///< Audio bytes sent, including FEC and protocol headers.
+    audio_packets_sent,  ///< Audio packets sent, including FEC packets.
+    client_lost_frames,  ///< Frames the client reported as lost through loss stats.
+    input_events,  ///< Input packets received from the client.
+    input_batches,  ///< Batches of input packets injected into the OS, every batch holds one or more packets.
+    bitrate_increases,  ///< Times the bitrate controller raised the bitrate.
+    bitrate_decreases,  ///< Times the bitrate controller lowered the bitrate.
+    encoder_reconfigurations,  ///< Bitrate changes applied to the running encoder.
+    encoder_recreations,  ///< Bitrate changes that required a new encoder.
+    idr_frames_sent,  ///< IDR frames sent to the client.
+    _count
+  };
+
+  /**
+   * @brief Kinds of input with their own latency histogram.
+   */
+  enum class input_type_e : int {
+    mouse_rel,  ///< Relative mouse motion.
+    mouse_abs,  ///< Absolute mouse motion.
+    mouse_button,  ///< Mouse buttons and scrolling.
+    keyboard,  ///< Keys and text.
+    gamepad,  ///< Gamepad state, arrival, touchpad, motion and battery.
+    touch,  ///< Touch screen.
+    pen,  ///< Pen tablet.
+    _count
+  };
+
+  /**
+   * @brief Name of a counter, as exported without prefix and `_total` suffix.
+   */
+  std::string_view to_string(counter_e counter);
+
+  /**
+   * @brief Name of an input type, as exported in the `type` label.
+   */
+  std::string_view to_string(input_type_e type);
+
+  /**
+   * @brief Metrics of one streaming session.
+   * @details Each counter is only written by one streaming thread, as a relaxed atomic add.
+   *          Scraping reads the atomics, so it never blocks the streaming threads.
+   *          A session registers itself on construction. When it is destroyed, its values are
+   *          folded into the totals of ended sessions, so the exported totals never go backwards.
+   */
+  class session_t {
+  public:
+    session_t(std::uint32_t id, std::string client_name);
+    ~session_t();
+
+    session_t(const session_t &) = delete;
+    session_t &operator=(const session_t &) = delete;
+
+    void add(counter_e counter, std::uint64_t value = 1) noexcept {
+      counters[(int) counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t get(counter_e counter) const noexcept {
+      return counters[(int) counter].load(std::memory_order_relaxed);
+    }
+
+    const std::uint32_t id;  ///< Launch session ID.
+    const std::string client_name;  ///< Name of the client.
+
+    stat_trackers::histogram_t encode_latency;  ///< Time spent in the encoder per frame, in microseconds.
+    stat_trackers::histogram_t frame_processing_latency;  ///< Time from capture until the network thread picks up the frame, in microseconds.
+    stat_trackers::histogram_t frame_size;  ///< Size of each encoded frame, in bytes.
+
+    /**
+     * @brief Time from receipt of an input packet on the control stream until it was injected into the OS, in microseconds.
+     */
+    std::array<stat_trackers::histogram_t, (int) input_type_e::_count> input_latency;
+    stat_trackers::histogram_t input_batch_size;  ///< Input packets coalesced into each injected batch.
+
+    std::atomic<std::uint32_t> target_bitrate_kbps {0};  ///< Video bitrate chosen by the bitrate controller, 0 while it's off.
+    std::atomic<std::int64_t> video_queue_depth {0};  ///< Encoded video packets waiting for the network thread.
+
+  private:
+    std::array<std::atomic<std::uint64_t>, (int) counter_e::_count> counters {};
+  };
+
+  /**
+   * @brief Counts a video packet in the queue depth of its session until the network thread picks it up.
+   * @details Held by the packet, so packets dropped on the way, e.g. when the queue overflows,
+   *          leave the queue depth as well instead of making it drift.
+   */
+  class queued_packet_t {
+  public:
+    explicit queued_packet_t(session_t &session) noexcept:
+        session {&session} {
+      session.video_queue_depth.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~queued_packet_t() {
+      session->video_queue_depth.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    queued_packet_t(const queued_packet_t &) = delete;
+    queued_packet_t &operator=(const queued_packet_t &) = delete;
+
+  private:
+    session_t *session;
+  };
+
+  /**
+   * @brief Render the metrics of all sessions in the Prometheus text exposition format.
+   * @details Per-session series are labelled with the session ID and client name. Totals
+   *          include sessions that already ended, and the latency histograms are merged
+   *          across sessions for fleet-level reporting.
+   */
+  std::string to_prometheus();
+}  // namespace metrics
@@ -209,6 +209,7 @@ namespace nvenc {
     }
 
     encoder_params.rfi = get_encoder_cap(NV_ENC_CAPS_SUPPORT_REF_PIC_INVALIDATION);
+    encoder_params.dynamic_bitrate = get_encoder_cap(NV_ENC_CAPS_SUPPORT_DYN_BITRATE_CHANGE);
 
     init_params.presetGUID = quality_preset_guid_from_number(config.quality_preset);
     init_params.tuningInfo = NV_ENC_TUNING_INFO_ULTRA_LOW_LATENCY;
@@ -383,6 +384,9 @@ namespace nvenc {
       return false;
     }
 
+    encoder_state.init_params = init_params;
+    encoder_state.enc_config = enc_config;
+
     if (async_event_handle) {
       NV_ENC_EVENT_PARAMS event_params = {min_struct_version(NV_ENC_EVENT_PARAMS_VER)};
       event_params.completionEvent = async_event_handle;
@@ -448,7 +452,7 @@ namespace nvenc {
       BOOST_LOG(info) << "NvEnc: created encoder " << video_format_string << quality_preset_string_from_guid(init_params.presetGUID) << extra;
     }
 
-    encoder_state = {};
+    reset_encoder_state();
     fail_guard.disable();
     return true;
   }
@@ -480,10 +484,19 @@ namespace nvenc {
       encoder = nullptr;
     }
 
-    encoder_state = {};
+    reset_encoder_state();
+    encoder_state.init_params = {};
+    encoder_state.enc_config = {};
     encoder_params = {};
   }
 
+  void nvenc_base::reset_encoder_state() {
+    encoder_state.last_encoded_frame_index = 0;
+    encoder_state.rfi_needs_confirmation = false;
+    encoder_state.last_rfi_range = {};
+    encoder_state.frame_size_logger.reset();
+  }
+
   nvenc_encoded_frame nvenc_base::encode_frame(uint64_t frame_index, bool force_idr) {
     if (!encoder) {
       return {};
@@ -606,6 +619,34 @@ namespace nvenc {
     return true;
   }
 
+  bool nvenc_base::set_bitrate(uint32_t bitrate) {
+    if (!encoder || !encoder_params.dynamic_bitrate) {
+      return false;
+    }
+
+    auto enc_config = encoder_state.enc_config;
+    auto &rc_params = enc_config.rcParams;
+    if (rc_params.vbvBufferSize && rc_params.averageBitRate) {
+      // Keep the VBV buffer as many frames long as before
+      rc_params.vbvBufferSize = (uint32_t) ((uint64_t) rc_params.vbvBufferSize * bitrate * 1000 / rc_params.averageBitRate);
+    }
+    rc_params.averageBitRate = bitrate * 1000;
+
+    NV_ENC_RECONFIGURE_PARAMS reconfigure_params = {min_struct_version(NV_ENC_RECONFIGURE_PARAMS_VER)};
+    reconfigure_params.reInitEncodeParams = encoder_state.init_params;
+    reconfigure_params.reInitEncodeParams.encodeConfig = &enc_config;
+
+    if (nvenc_failed(nvenc->nvEncReconfigureEncoder(encoder, &reconfigure_params))) {
+      BOOST_LOG(error) << "NvEnc: NvEncReconfigureEncoder() failed: " << last_nvenc_error_string;
+      return false;
+    }
+
+    encoder_state.enc_config = enc_config;
+    BOOST_LOG(debug) << "NvEnc: bitrate changed to " << bitrate << " kbps";
+
+    return true;
+  }
+
   bool nvenc_base::nvenc_failed(NVENCSTATUS status) {
     auto status_string = [](NVENCSTATUS status) -> std::string {
       switch (status) {
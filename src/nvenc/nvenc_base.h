@@ -69,6 +69,13 @@ namespace nvenc {
      */
     bool invalidate_ref_frames(uint64_t first_frame, uint64_t last_frame);
 
+    /**
+     * @brief Change the target bitrate of the encoder in place, without an IDR frame.
+     * @param bitrate Bitrate in kilobits per second.
+     * @return `true` on success, `false` if the encoder doesn't support dynamic bitrate or on error.
+     */
+    bool set_bitrate(uint32_t bitrate);
+
   protected:
     /**
      * @brief Required. Used for loading NvEnc library and setting `nvenc` variable with `NvEncodeAPICreateInstance()`.
@@ -126,6 +133,7 @@ namespace nvenc {
       NV_ENC_BUFFER_FORMAT buffer_format = NV_ENC_BUFFER_FORMAT_UNDEFINED;
       uint32_t ref_frames_in_dpb = 0;
       bool rfi = false;
+      bool dynamic_bitrate = false;
     } encoder_params;
 
     std::string last_nvenc_error_string;
@@ -141,6 +149,12 @@ namespace nvenc {
                                          ///< Can be set in constructor or `init_library()`, must override `wait_for_async_event()`.
 
   private:
+    /**
+     * @brief Forget the frame indexes and statistics of the previous encoder.
+     *        The frame size logger can't be assigned, so the fields are reset one by one.
+     */
+    void reset_encoder_state();
+
     NV_ENC_OUTPUT_PTR output_bitstream = nullptr;
     uint32_t minimum_api_version = 0;
 
@@ -148,7 +162,9 @@ namespace nvenc {
       uint64_t last_encoded_frame_index = 0;
       bool rfi_needs_confirmation = false;
       std::pair<uint64_t, uint64_t> last_rfi_range;
-      logging::min_max_avg_periodic_logger<double> frame_size_logger = {debug, "NvEnc: encoded frame sizes in kB", ""};
+      logging::percentile_periodic_logger<double> frame_size_logger = {debug, "NvEnc: encoded frame sizes in kB", ""};
+      NV_ENC_INITIALIZE_PARAMS init_params;  ///< Parameters the encoder was initialized with, the base of reconfiguration.
+      NV_ENC_CONFIG enc_config;  ///< Current configuration of the encoder.
     } encoder_state;
   };
 
@@ -6,8 +6,14 @@
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS
 
 // standard includes
+#include <algorithm>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <string>
 
@@ -20,6 +26,7 @@
 #include <Simple-Web-Server/server_http.hpp>
 
 // local includes
+#include "asset_cache.h"
 #include "config.h"
 #include "display_device.h"
 #include "file_handler.h"
@@ -28,9 +35,11 @@
 #include "logging.h"
 #include "network.h"
 #include "nvhttp.h"
+#include "pairing_store.h"
 #include "platform/common.h"
 #include "process.h"
 #include "rtsp.h"
+#include "startup_timeline.h"
 #include "stream.h"
 #include "system_tray.h"
 #include "utility.h"
@@ -73,12 +82,77 @@ namespace nvhttp {
       context.set_options(boost::asio::ssl::context::no_tlsv1_1);
       context.use_certificate_chain_file(certification_file);
       context.use_private_key_file(private_key_file, boost::asio::ssl::context::pem);
+
+      // Clients poll every few seconds, resuming their TLS session skips the key exchange and certificate verification.
+      // Sessions stay in the server cache instead of stateless tickets, so the verified client stays bound to them.
+      auto ctx = context.native_handle();
+      SSL_CTX_set_session_id_context(ctx, (const unsigned char *) session_id_context.data(), session_id_context.size());
+      SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_sess_set_cache_size(ctx, 1024);
+      SSL_CTX_set_timeout(ctx, 60 * 60);
+      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+
+      // OpenSSL drops the session of a connection freed without sending close_notify from its cache
+      on_error = [](std::shared_ptr<Request> request, const SimpleWeb::error_code &ec) {
+        if (ec != boost::asio::error::eof) {
+          return;
+        }
+
+        // The client closed its side with close_notify, answer in kind
+        auto connection = find_connection(request);
+        if (connection) {
+          connection->socket->async_shutdown([connection](const SimpleWeb::error_code &) {});
+        }
+      };
+    }
+
+    /**
+     * @brief The TLS connection a request came in on.
+     * @param request The request.
+     * @return The connection, or nullptr if it's closed.
+     */
+    static SSL *native_handle(const std::shared_ptr<Request> &request) {
+      auto connection = find_connection(request);
+      return connection ? connection->socket->native_handle() : nullptr;
     }
 
     std::function<bool(std::shared_ptr<Request>, SSL*)> verify;
     std::function<void(std::shared_ptr<Response>, std::shared_ptr<Request>)> on_verify_failed;
 
   protected:
+    static constexpr auto session_id_context = "nvhttp"sv;
+
+    /**
+     * @brief Open connections by remote endpoint.
+     * @details Requests don't expose the connection they came in on, and a kept-alive connection serves
+     *          many requests. The remote endpoint tells connections apart, including several from one address.
+     */
+    static inline std::mutex connections_lock;
+    static inline std::map<boost::asio::ip::tcp::endpoint, std::weak_ptr<Connection>> connections;
+
+    static std::shared_ptr<Connection> find_connection(const std::shared_ptr<Request> &request) {
+      auto lg = std::lock_guard(connections_lock);
+
+      auto it = connections.find(request->remote_endpoint());
+      return it != connections.end() ? it->second.lock() : nullptr;
+    }
+
+    static void add_connection(const std::shared_ptr<Connection> &connection) {
+      SimpleWeb::error_code ec;
+      auto endpoint = connection->socket->lowest_layer().remote_endpoint(ec);
+      if (ec) {
+        return;
+      }
+
+      auto lg = std::lock_guard(connections_lock);
+
+      // Forget connections that have been closed since
+      std::erase_if(connections, [](const auto &item) {
+        return item.second.expired();
+      });
+      connections[endpoint] = connection;
+    }
+
     boost::asio::ssl::context context;
 
     void after_bind() override {
@@ -120,6 +194,8 @@ namespace nvhttp {
               return;
             }
             if (!ec) {
+              add_connection(session->connection);
+
               if (verify && !verify(session->request, session->connection->socket->native_handle())) {
                 this->write(session, on_verify_failed);
               } else {
@@ -149,6 +225,9 @@ namespace nvhttp {
   client_t client_root;
   std::atomic<uint32_t> session_id_counter;
 
+  // Incremented whenever the paired clients or their permissions are saved or loaded
+  std::atomic<std::uint64_t> pairing_revision;
+
   using resp_https_t = std::shared_ptr<typename SimpleWeb::ServerBase<SunshineHTTPS>::Response>;
   using req_https_t = std::shared_ptr<typename SimpleWeb::ServerBase<SunshineHTTPS>::Request>;
   using resp_http_t = std::shared_ptr<typename SimpleWeb::ServerBase<SimpleWeb::HTTP>::Response>;
@@ -201,25 +280,64 @@ namespace nvhttp {
     return commands;
   }
 
-  void save_state() {
-    nlohmann::json root = nlohmann::json::object();
-    // If the state file exists, try to read it.
-    if (fs::exists(config::nvhttp.file_state)) {
-      try {
-        std::ifstream in(config::nvhttp.file_state);
-        in >> root;
-      } catch (std::exception &e) {
-        BOOST_LOG(error) << "Couldn't read "sv << config::nvhttp.file_state << ": "sv << e.what();
-        return;
+  /**
+   * @brief The paired clients, as persisted in the state file.
+   */
+  pairing_store::store_t pairing_state;
+
+  /**
+   * @brief Serialize a paired client into its node of "named_devices".
+   */
+  nlohmann::json named_cert_node(const crypto::named_cert_t &named_cert) {
+    nlohmann::json named_cert_node = nlohmann::json::object();
+    named_cert_node["name"] = named_cert.name;
+    named_cert_node["cert"] = named_cert.cert;
+    named_cert_node["uuid"] = named_cert.uuid;
+    named_cert_node["display_mode"] = named_cert.display_mode;
+    named_cert_node["perm"] = static_cast<uint32_t>(named_cert.perm);
+
+    // Add "do" commands if available.
+    if (!named_cert.do_cmds.empty()) {
+      nlohmann::json do_cmds_node = nlohmann::json::array();
+      for (const auto &cmd : named_cert.do_cmds) {
+        do_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
+      }
+      named_cert_node["do"] = do_cmds_node;
+    }
+
+    // Add "undo" commands if available.
+    if (!named_cert.undo_cmds.empty()) {
+      nlohmann::json undo_cmds_node = nlohmann::json::array();
+      for (const auto &cmd : named_cert.undo_cmds) {
+        undo_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
       }
+      named_cert_node["undo"] = undo_cmds_node;
     }
 
-    // Erase any previous "root" key.
-    root.erase("root");
+    return named_cert_node;
+  }
 
-    // Create a new "root" object and set the unique id.
-    root["root"] = nlohmann::json::object();
-    root["root"]["uniqueid"] = http::unique_id;
+  /**
+   * @brief Strip the suffix that tells apart clients of the same name, e.g. " (2)".
+   */
+  std::string base_device_name(const std::string &name) {
+    return name.substr(0, name.find(" ("));
+  }
+
+  /**
+   * @brief Persist a new or changed client without rewriting the others.
+   */
+  void save_client(const crypto::named_cert_t &named_cert) {
+    ++pairing_revision;
+
+    pairing_state.put(named_cert_node(named_cert));
+  }
+
+  /**
+   * @brief Rewrite the state file with all paired clients.
+   */
+  void save_state() {
+    ++pairing_revision;
 
     client_t &client = client_root;
     nlohmann::json named_cert_nodes = nlohmann::json::array();
@@ -230,89 +348,60 @@ namespace nvhttp {
     for (auto &named_cert_p : client.named_devices) {
       // Only add each unique certificate once.
       if (unique_certs.insert(named_cert_p->cert).second) {
-        nlohmann::json named_cert_node = nlohmann::json::object();
-        std::string base_name = named_cert_p->name;
-        // Remove any pending id suffix (e.g., " (2)") if present.
-        size_t pos = base_name.find(" (");
-        if (pos != std::string::npos) {
-          base_name = base_name.substr(0, pos);
-        }
+        std::string base_name = base_device_name(named_cert_p->name);
         int count = name_counts[base_name]++;
         std::string final_name = base_name;
         if (count > 0) {
           final_name += " (" + std::to_string(count + 1) + ")";
         }
-        named_cert_node["name"] = final_name;
-        named_cert_node["cert"] = named_cert_p->cert;
-        named_cert_node["uuid"] = named_cert_p->uuid;
-        named_cert_node["display_mode"] = named_cert_p->display_mode;
-        named_cert_node["perm"] = static_cast<uint32_t>(named_cert_p->perm);
-
-        // Add "do" commands if available.
-        if (!named_cert_p->do_cmds.empty()) {
-          nlohmann::json do_cmds_node = nlohmann::json::array();
-          for (const auto &cmd : named_cert_p->do_cmds) {
-            do_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
-          }
-          named_cert_node["do"] = do_cmds_node;
-        }
-
-        // Add "undo" commands if available.
-        if (!named_cert_p->undo_cmds.empty()) {
-          nlohmann::json undo_cmds_node = nlohmann::json::array();
-          for (const auto &cmd : named_cert_p->undo_cmds) {
-            undo_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
-          }
-          named_cert_node["undo"] = undo_cmds_node;
-        }
 
+        auto named_cert_node = nvhttp::named_cert_node(*named_cert_p);
+        named_cert_node["name"] = final_name;
         named_cert_nodes.push_back(named_cert_node);
       }
     }
 
-    root["root"]["named_devices"] = named_cert_nodes;
+    pairing_state.set_unique_id(http::unique_id);
+    pairing_state.reset(named_cert_nodes);
+  }
+
+  void load_state() {
+    ++pairing_revision;
 
+    std::optional<nlohmann::json> state;
     try {
-      std::ofstream out(config::nvhttp.file_state);
-      out << root.dump(4);  // Pretty-print with an indent of 4 spaces.
+      state = pairing_state.load(config::nvhttp.file_state);
     } catch (std::exception &e) {
-      BOOST_LOG(error) << "Couldn't write "sv << config::nvhttp.file_state << ": "sv << e.what();
+      BOOST_LOG(error) << "Couldn't read "sv << config::nvhttp.file_state << ": "sv << e.what();
       return;
     }
-  }
 
-  void load_state() {
-    if (!fs::exists(config::nvhttp.file_state)) {
+    if (!state) {
       BOOST_LOG(info) << "File "sv << config::nvhttp.file_state << " doesn't exist"sv;
       http::unique_id = uuid_util::uuid_t::generate().string();
+      pairing_state.set_unique_id(http::unique_id);
       return;
     }
 
-    nlohmann::json tree;
-    try {
-      std::ifstream in(config::nvhttp.file_state);
-      in >> tree;
-    } catch (std::exception &e) {
-      BOOST_LOG(error) << "Couldn't read "sv << config::nvhttp.file_state << ": "sv << e.what();
-      return;
-    }
+    auto &root = *state;
 
     // Check that the file contains a "root.uniqueid" value.
-    if (!tree.contains("root") || !tree["root"].contains("uniqueid")) {
+    if (!root.contains("uniqueid")) {
       http::uuid = uuid_util::uuid_t::generate();
       http::unique_id = http::uuid.string();
+      pairing_state.set_unique_id(http::unique_id);
       return;
     }
 
-    std::string uid = tree["root"]["uniqueid"];
+    std::string uid = root["uniqueid"];
     http::uuid = uuid_util::uuid_t::parse(uid);
     http::unique_id = uid;
 
-    nlohmann::json root = tree["root"];
     client_t client;  // Local client to load into
 
     // Import from the old format if available.
-    if (root.contains("devices")) {
+    bool old_format = root.contains("devices");
+    if (old_format) {
       for (auto &device_node : root["devices"]) {
         // For each device, if there is a "certs" array, add a named certificate.
         if (device_node.contains("certs")) {
@@ -352,10 +441,36 @@ namespace nvhttp {
     }
 
     client_root = client;
+
+    // Convert the old format once, the generated uuids must stay the same from now on
+    if (old_format) {
+      save_state();
+    }
   }
 
   void add_authorized_client(const p_named_cert_t& named_cert_p) {
     client_t &client = client_root;
+
+    // A certificate paired twice stays with the device that paired it first
+    for (auto &paired : client.named_devices) {
+      if (paired->cert == named_cert_p->cert) {
+        BOOST_LOG(info) << "Client "sv << named_cert_p->name << " was already paired as "sv << paired->name;
+        return;
+      }
+    }
+
+    // Tell apart clients of the same name, with the smallest suffix left free by unpaired clients
+    auto base_name = base_device_name(named_cert_p->name);
+    std::unordered_set<std::string> names;
+    for (auto &paired : client.named_devices) {
+      names.insert(paired->name);
+    }
+
+    named_cert_p->name = base_name;
+    for (int suffix = 2; names.contains(named_cert_p->name); ++suffix) {
+      named_cert_p->name = base_name + " (" + std::to_string(suffix) + ")";
+    }
+
     client.named_devices.push_back(named_cert_p);
 
 #if defined AQUA_TRAY && AQUA_TRAY >= 1
@@ -363,8 +478,9 @@ namespace nvhttp {
 #endif
 
     if (!config::sunshine.flags[config::flag::FRESH_STATE]) {
-      save_state();
-      load_state();
+      auto added = named_cert_p;
+      cert_chain.add(added);
+      save_client(*named_cert_p);
     }
   }
 
@@ -648,11 +764,79 @@ namespace nvhttp {
     static auto constexpr to_string = "NONE"sv;
   };
 
-  static std::unordered_map<std::string, std::shared_ptr<crypto::named_cert_t>> cert_store;
+  /**
+   * @brief A client that passed certificate verification.
+   */
+  struct verified_client_t {
+    p_named_cert_t named_cert;
+    std::uint64_t pairing_revision;  ///< The paired clients it was verified against.
+  };
 
+  // TLS handshakes of the HTTPS server, resumed ones skip certificate verification
+  static std::uint64_t full_handshakes;
+  static std::uint64_t resumed_handshakes;
+
+  /**
+   * @brief Index of the verified client bound to a TLS session, as a heap allocated `std::shared_ptr<verified_client_t>`.
+   */
+  static int session_client_index = SSL_SESSION_get_ex_new_index(
+    0,
+    nullptr,
+    nullptr,
+#if OPENSSL_VERSION_MAJOR >= 3
+    [](CRYPTO_EX_DATA *, const CRYPTO_EX_DATA *, void **from_d, int, long, void *) {
+#else
+    [](CRYPTO_EX_DATA *, const CRYPTO_EX_DATA *, void *from_d, int, long, void *) {
+#endif
+      auto client = (std::shared_ptr<verified_client_t> **) from_d;
+      if (*client) {
+        *client = new std::shared_ptr<verified_client_t>(**client);
+      }
+      return 1;
+    },
+    [](void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+      delete (std::shared_ptr<verified_client_t> *) ptr;
+    }
+  );
+
+  /**
+   * @brief Index of the client verified by the TLS handshake of a connection, as a heap allocated `verified_client_t`.
+   */
+  static int connection_client_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, [](void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+    delete (verified_client_t *) ptr;
+  });
+
+  /**
+   * @brief The client verified by the TLS handshake of the connection a request came in on.
+   * @details Connections are kept alive, so a client verified before the paired clients changed is verified again.
+   * @return The client, or nullptr if it isn't paired anymore.
+   */
   inline crypto::named_cert_t* get_verified_cert(req_https_t request) {
-    auto it = cert_store.find(request->remote_endpoint().address().to_string());
-    return it != cert_store.end() ? it->second.get() : nullptr;
+    auto ssl = https_server_t::native_handle(request);
+    if (!ssl) {
+      return nullptr;
+    }
+
+    auto client = (verified_client_t *) SSL_get_ex_data(ssl, connection_client_index);
+    if (!client) {
+      return nullptr;
+    }
+
+    if (client->pairing_revision != pairing_revision) {
+      auto revision = pairing_revision.load();
+      auto x509 = crypto::x509(client->named_cert->cert);
+
+      p_named_cert_t named_cert_p;
+      if (!x509 || cert_chain.verify(x509.get(), named_cert_p)) {
+        SSL_set_ex_data(ssl, connection_client_index, nullptr);
+        delete client;
+        return nullptr;
+      }
+
+      *client = {std::move(named_cert_p), revision};
+    }
+
+    return client->named_cert.get();
   }
 
   template <class T>
@@ -868,6 +1052,73 @@ namespace nvhttp {
     return true;
   }
 
+  /**
+   * @brief Pre-rendered serverinfo and applist bodies.
+   * @details Clients poll serverinfo every few seconds, but the bodies only change with the apps, the paired clients,
+   *          the running app and the codec modes. A body is rendered once for every key of the per-client inputs,
+   *          and all bodies are dropped when the state shared by every client changes.
+   */
+  struct response_cache_t {
+    std::mutex mutex;
+    std::string state;  ///< The shared state the cached bodies were rendered for.
+    std::unordered_map<std::string, std::string> serverinfo;  ///< Bodies up to the pairing and app state, without the closing tag.
+    std::unordered_map<std::string, std::string> applist;
+
+    /**
+     * @brief Find a cached body, rendering it on a miss.
+     * @param bodies The cached bodies of the endpoint.
+     * @param current_state The shared state, as returned by `response_state()`.
+     * @param key The per-client inputs of the body.
+     * @param render Renders the body, called without the lock held.
+     */
+    std::string get(std::unordered_map<std::string, std::string> &bodies, const std::string &current_state, const std::string &key, const std::function<std::string()> &render) {
+      std::unique_lock lk {mutex};
+
+      if (current_state != state) {
+        serverinfo.clear();
+        applist.clear();
+        state = current_state;
+      }
+
+      if (auto it = bodies.find(key); it != std::end(bodies)) {
+        return it->second;
+      }
+
+      lk.unlock();
+      auto body = render();
+      lk.lock();
+
+      // Don't cache a body rendered while the state changed
+      if (current_state == state) {
+        bodies.emplace(key, body);
+      }
+
+      return body;
+    }
+  } response_cache;
+
+  /**
+   * @brief Cover art served by appasset, revalidated against the file on every request.
+   */
+  asset_cache::cache_t app_assets {64 * 1024 * 1024};
+
+  /**
+   * @brief The state shared by the serverinfo and applist bodies of every client.
+   */
+  std::string response_state() {
+    std::ostringstream state;
+
+    state << proc::apps_revision() << ':' << pairing_revision << ':' << video::active_hevc_mode << ':' << video::active_av1_mode;
+    for (const auto &supported : video::last_encoder_probe_supported_yuv444_for_codec) {
+      state << ':' << supported;
+    }
+  #ifdef _WIN32
+    state << ':' << (int) proc::vDisplayDriverStatus;
+  #endif
+
+    return state.str();
+  }
+
   template<class T>
   void serverinfo(std::shared_ptr<typename SimpleWeb::ServerBase<T>::Response> response, std::shared_ptr<typename SimpleWeb::ServerBase<T>::Request> request) {
     print_req<T>(request);
@@ -884,119 +1135,134 @@ namespace nvhttp {
 
     auto local_endpoint = request->local_endpoint();
 
-    pt::ptree tree;
+    // Everything but the pairing and app state depends only on the tunnel, the local address and the permissions
+    std::string key {tunnel<T>::to_string};
+    key += ' ' + net::addr_to_normalized_string(local_endpoint.address());
 
-    tree.put("root.<xmlattr>.status_code", 200);
-    tree.put("root.hostname", config::nvhttp.sunshine_name);
+    crypto::named_cert_t *named_cert_p = nullptr;
+    if constexpr (std::is_same_v<SunshineHTTPS, T>) {
+      named_cert_p = get_verified_cert(request);
+      key += ' ' + std::to_string((uint32_t) named_cert_p->perm);
+    }
 
-    tree.put("root.appversion", VERSION);
-    tree.put("root.GfeVersion", GFE_VERSION);
-    tree.put("root.uniqueid", http::unique_id);
-    tree.put("root.HttpsPort", net::map_port(PORT_HTTPS));
-    tree.put("root.ExternalPort", net::map_port(PORT_HTTP));
-    tree.put("root.MaxLumaPixelsHEVC", video::active_hevc_mode > 1 ? "1869449984" : "0");
+    auto body = response_cache.get(response_cache.serverinfo, response_state(), key, [&]() {
+      pt::ptree tree;
 
-    // Only include the MAC address for requests sent from paired clients over HTTPS.
-    // For HTTP requests, use a placeholder MAC address that Moonlight knows to ignore.
-    if constexpr (std::is_same_v<SunshineHTTPS, T>) {
-      tree.put("root.mac", platf::get_mac_address(net::addr_to_normalized_string(local_endpoint.address())));
-
-      auto named_cert_p = get_verified_cert(request);
-      if (!!(named_cert_p->perm & PERM::server_cmd)) {
-        pt::ptree& root_node = tree.get_child("root");
-
-        if (config::sunshine.server_cmds.size() > 0) {
-          // Broadcast server_cmds
-          for (const auto& cmd : config::sunshine.server_cmds) {
-            pt::ptree cmd_node;
-            cmd_node.put_value(cmd.cmd_name);
-            root_node.push_back(std::make_pair("ServerCommand", cmd_node));
+      tree.put("root.<xmlattr>.status_code", 200);
+      tree.put("root.hostname", config::nvhttp.sunshine_name);
+
+      tree.put("root.appversion", VERSION);
+      tree.put("root.GfeVersion", GFE_VERSION);
+      tree.put("root.uniqueid", http::unique_id);
+      tree.put("root.HttpsPort", net::map_port(PORT_HTTPS));
+      tree.put("root.ExternalPort", net::map_port(PORT_HTTP));
+      tree.put("root.MaxLumaPixelsHEVC", video::active_hevc_mode > 1 ? "1869449984" : "0");
+
+      // Only include the MAC address for requests sent from paired clients over HTTPS.
+      // For HTTP requests, use a placeholder MAC address that Moonlight knows to ignore.
+      if constexpr (std::is_same_v<SunshineHTTPS, T>) {
+        tree.put("root.mac", platf::get_mac_address(net::addr_to_normalized_string(local_endpoint.address())));
+
+        if (!!(named_cert_p->perm & PERM::server_cmd)) {
+          pt::ptree& root_node = tree.get_child("root");
+
+          if (config::sunshine.server_cmds.size() > 0) {
+            // Broadcast server_cmds
+            for (const auto& cmd : config::sunshine.server_cmds) {
+              pt::ptree cmd_node;
+              cmd_node.put_value(cmd.cmd_name);
+              root_node.push_back(std::make_pair("ServerCommand", cmd_node));
+            }
           }
+        } else {
+          BOOST_LOG(debug) << "Permission Get ServerCommand denied for [" << named_cert_p->name << "] (" << (uint32_t)named_cert_p->perm << ")";
+        }
+
+        tree.put("root.Permission", std::to_string((uint32_t)named_cert_p->perm));
+
+      #ifdef _WIN32
+        tree.put("root.VirtualDisplayCapable", true);
+        if (!!(named_cert_p->perm & PERM::_all_actions)) {
+          tree.put("root.VirtualDisplayDriverReady", proc::vDisplayDriverStatus == VDISPLAY::DRIVER_STATUS::OK);
+        } else {
+          tree.put("root.VirtualDisplayDriverReady", true);
         }
+      #endif
       } else {
-        BOOST_LOG(debug) << "Permission Get ServerCommand denied for [" << named_cert_p->name << "] (" << (uint32_t)named_cert_p->perm << ")";
+        tree.put("root.mac", "00:00:00:00:00:00");
+        tree.put("root.Permission", "0");
       }
 
-      tree.put("root.Permission", std::to_string((uint32_t)named_cert_p->perm));
-
-    #ifdef _WIN32
-      tree.put("root.VirtualDisplayCapable", true);
-      if (!!(named_cert_p->perm & PERM::_all_actions)) {
-        tree.put("root.VirtualDisplayDriverReady", proc::vDisplayDriverStatus == VDISPLAY::DRIVER_STATUS::OK);
+      // Moonlight clients track LAN IPv6 addresses separately from LocalIP which is expected to
+      // always be an IPv4 address. If we return that same IPv6 address here, it will clobber the
+      // stored LAN IPv4 address. To avoid this, we need to return an IPv4 address in this field
+      // when we get a request over IPv6.
+      //
+      // HACK: We should return the IPv4 address of local interface here, but we don't currently
+      // have that implemented. For now, we will emulate the behavior of GFE+GS-IPv6-Forwarder,
+      // which returns 127.0.0.1 as LocalIP for IPv6 connections. Moonlight clients with IPv6
+      // support know to ignore this bogus address.
+      if (local_endpoint.address().is_v6() && !local_endpoint.address().to_v6().is_v4_mapped()) {
+        tree.put("root.LocalIP", "127.0.0.1");
       } else {
-        tree.put("root.VirtualDisplayDriverReady", true);
+        tree.put("root.LocalIP", net::addr_to_normalized_string(local_endpoint.address()));
       }
-    #endif
-    } else {
-      tree.put("root.mac", "00:00:00:00:00:00");
-      tree.put("root.Permission", "0");
-    }
-
-    // Moonlight clients track LAN IPv6 addresses separately from LocalIP which is expected to
-    // always be an IPv4 address. If we return that same IPv6 address here, it will clobber the
-    // stored LAN IPv4 address. To avoid this, we need to return an IPv4 address in this field
-    // when we get a request over IPv6.
-    //
-    // HACK: We should return the IPv4 address of local interface here, but we don't currently
-    // have that implemented. For now, we will emulate the behavior of GFE+GS-IPv6-Forwarder,
-    // which returns 127.0.0.1 as LocalIP for IPv6 connections. Moonlight clients with IPv6
-    // support know to ignore this bogus address.
-    if (local_endpoint.address().is_v6() && !local_endpoint.address().to_v6().is_v4_mapped()) {
-      tree.put("root.LocalIP", "127.0.0.1");
-    } else {
-      tree.put("root.LocalIP", net::addr_to_normalized_string(local_endpoint.address()));
-    }
 
-    uint32_t codec_mode_flags = SCM_H264;
-    if (video::last_encoder_probe_supported_yuv444_for_codec[0]) {
-      codec_mode_flags |= SCM_H264_HIGH8_444;
-    }
-    if (video::active_hevc_mode >= 2) {
-      codec_mode_flags |= SCM_HEVC;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[1]) {
-        codec_mode_flags |= SCM_HEVC_REXT8_444;
+      uint32_t codec_mode_flags = SCM_H264;
+      if (video::last_encoder_probe_supported_yuv444_for_codec[0]) {
+        codec_mode_flags |= SCM_H264_HIGH8_444;
       }
-    }
-    if (video::active_hevc_mode >= 3) {
-      codec_mode_flags |= SCM_HEVC_MAIN10;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[1]) {
-        codec_mode_flags |= SCM_HEVC_REXT10_444;
+      if (video::active_hevc_mode >= 2) {
+        codec_mode_flags |= SCM_HEVC;
+        if (video::last_encoder_probe_supported_yuv444_for_codec[1]) {
+          codec_mode_flags |= SCM_HEVC_REXT8_444;
+        }
       }
-    }
-    if (video::active_av1_mode >= 2) {
-      codec_mode_flags |= SCM_AV1_MAIN8;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[2]) {
-        codec_mode_flags |= SCM_AV1_HIGH8_444;
+      if (video::active_hevc_mode >= 3) {
+        codec_mode_flags |= SCM_HEVC_MAIN10;
+        if (video::last_encoder_probe_supported_yuv444_for_codec[1]) {
+          codec_mode_flags |= SCM_HEVC_REXT10_444;
+        }
       }
-    }
-    if (video::active_av1_mode >= 3) {
-      codec_mode_flags |= SCM_AV1_MAIN10;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[2]) {
-        codec_mode_flags |= SCM_AV1_HIGH10_444;
+      if (video::active_av1_mode >= 2) {
+        codec_mode_flags |= SCM_AV1_MAIN8;
+        if (video::last_encoder_probe_supported_yuv444_for_codec[2]) {
+          codec_mode_flags |= SCM_AV1_HIGH8_444;
+        }
       }
-    }
-    tree.put("root.ServerCodecModeSupport", codec_mode_flags);
+      if (video::active_av1_mode >= 3) {
+        codec_mode_flags |= SCM_AV1_MAIN10;
+        if (video::last_encoder_probe_supported_yuv444_for_codec[2]) {
+          codec_mode_flags |= SCM_AV1_HIGH10_444;
+        }
+      }
+      tree.put("root.ServerCodecModeSupport", codec_mode_flags);
+
+      std::ostringstream data;
 
-    tree.put("root.PairStatus", pair_status);
+      pt::write_xml(data, tree);
 
+      // The pairing and app state are appended for every request
+      auto body = data.str();
+      body.resize(body.size() - "</root>"sv.size());
+      return body;
+    });
+
+    int current_appid = 0;
     if constexpr (std::is_same_v<SunshineHTTPS, T>) {
-      int current_appid = proc::proc.running();
+      current_appid = proc::proc.running();
       // When input only mode is enabled, the only resume method should be launching the same app again.
       if (config::input.enable_input_only_mode && current_appid != proc::input_only_app_id) {
         current_appid = 0;
       }
-      tree.put("root.currentgame", current_appid);
-      tree.put("root.state", current_appid > 0 ? "AQUA_SERVER_BUSY" : "AQUA_SERVER_FREE");
-    } else {
-      tree.put("root.currentgame", 0);
-      tree.put("root.state", "AQUA_SERVER_FREE");
     }
 
-    std::ostringstream data;
+    body += "<PairStatus>"s + std::to_string(pair_status) + "</PairStatus>";
+    body += "<currentgame>"s + std::to_string(current_appid) + "</currentgame>";
+    body += current_appid > 0 ? "<state>AQUA_SERVER_BUSY</state>"sv : "<state>AQUA_SERVER_FREE</state>"sv;
+    body += "</root>"sv;
 
-    pt::write_xml(data, tree);
-    response->write(data.str());
-    response->close_connection_after_response = true;
+    response->write(body);
   }
 
   nlohmann::json get_all_clients() {
@@ -1053,67 +1319,72 @@ namespace nvhttp {
   void applist(resp_https_t response, req_https_t request) {
     print_req<SunshineHTTPS>(request);
 
-    pt::ptree tree;
+    auto named_cert_p = get_verified_cert(request);
+    if (!(named_cert_p->perm & PERM::_all_actions)) {
+      BOOST_LOG(debug) << "Permission ListApp denied for [" << named_cert_p->name << "] (" << (uint32_t)named_cert_p->perm << ")";
+    }
 
-    auto g = util::fail_guard([&]() {
-      std::ostringstream data;
+    // The list only differs between clients that may or may not see apps, and with the running app
+    auto current_appid = proc::proc.running();
+    auto key = !!(named_cert_p->perm & PERM::_all_actions) ? std::to_string(current_appid) : "denied"s;
 
-      pt::write_xml(data, tree);
-      response->write(data.str());
-      response->close_connection_after_response = true;
-    });
+    auto body = response_cache.get(response_cache.applist, response_state(), key, [&]() {
+      pt::ptree tree;
 
-    auto &apps = tree.add_child("root", pt::ptree {});
+      auto &apps = tree.add_child("root", pt::ptree {});
 
-    apps.put("<xmlattr>.status_code", 200);
+      apps.put("<xmlattr>.status_code", 200);
 
-    auto named_cert_p = get_verified_cert(request);
-    if (!!(named_cert_p->perm & PERM::_all_actions)) {
-      auto current_appid = proc::proc.running();
-      auto should_hide_inactive_apps = config::input.enable_input_only_mode && current_appid > 0 && current_appid != proc::input_only_app_id;
-      for (auto &app : proc::proc.get_apps()) {
-        auto appid = util::from_view(app.id);
-        if (should_hide_inactive_apps) {
-          if (
-            appid != current_appid
-            && appid != proc::input_only_app_id
-            && appid != proc::terminate_app_id
-          ) {
-            continue;
-          }
-        } else {
-          if (appid == proc::terminate_app_id) {
-            continue;
+      if (!!(named_cert_p->perm & PERM::_all_actions)) {
+        auto should_hide_inactive_apps = config::input.enable_input_only_mode && current_appid > 0 && current_appid != proc::input_only_app_id;
+        auto apps_p = proc::proc.get_apps();
+        for (auto &app : *apps_p) {
+          auto appid = util::from_view(app.id);
+          if (should_hide_inactive_apps) {
+            if (
+              appid != current_appid
+              && appid != proc::input_only_app_id
+              && appid != proc::terminate_app_id
+            ) {
+              continue;
+            }
+          } else {
+            if (appid == proc::terminate_app_id) {
+              continue;
+            }
           }
-        }
 
+          pt::ptree app_node;
+
+          app_node.put("IsHdrSupported"s, video::active_hevc_mode == 3 ? 1 : 0);
+          app_node.put("AppTitle"s, app.name);
+          app_node.put("UUID", app.uuid);
+          app_node.put("ID", app.id);
+
+          apps.push_back(std::make_pair("App", std::move(app_node)));
+        }
+      } else {
         pt::ptree app_node;
 
-        app_node.put("IsHdrSupported"s, video::active_hevc_mode == 3 ? 1 : 0);
-        app_node.put("AppTitle"s, app.name);
-        app_node.put("UUID", app.uuid);
-        app_node.put("ID", app.id);
+        app_node.put("IsHdrSupported"s, 0);
+        app_node.put("AppTitle"s, "Permission Denied");
+        app_node.put("UUID", "");
+        app_node.put("ID", "114514");
 
         apps.push_back(std::make_pair("App", std::move(app_node)));
       }
-    } else {
-      BOOST_LOG(debug) << "Permission ListApp denied for [" << named_cert_p->name << "] (" << (uint32_t)named_cert_p->perm << ")";
 
-      pt::ptree app_node;
-
-      app_node.put("IsHdrSupported"s, 0);
-      app_node.put("AppTitle"s, "Permission Denied");
-      app_node.put("UUID", "");
-      app_node.put("ID", "114514");
-
-      apps.push_back(std::make_pair("App", std::move(app_node)));
+      std::ostringstream data;
 
-      return;
-    }
+      pt::write_xml(data, tree);
+      return data.str();
+    });
 
+    response->write(body);
   }
 
   void launch(bool &host_audio, resp_https_t response, req_https_t request) {
+    auto received = std::chrono::steady_clock::now();
     print_req<SunshineHTTPS>(request);
 
     pt::ptree tree;
@@ -1185,6 +1456,7 @@ namespace nvhttp {
 
     host_audio = util::from_view(get_arg(args, "localAudioPlayMode"));
     auto launch_session = make_launch_session(host_audio, is_input_only, appid, args, named_cert_p);
+    startup_timeline::begin(launch_session->id, named_cert_p->name, received);
 
     auto encryption_mode = net::encryption_mode_for_address(request->remote_endpoint().address());
     if (!launch_session->rtsp_cipher && encryption_mode == config::ENCRYPTION_MODE_MANDATORY) {
@@ -1227,6 +1499,7 @@ namespace nvhttp {
 
         if (no_active_sessions && !proc::proc.virtual_display) {
           display_device::configure_display(config::video, *launch_session);
+          startup_timeline::mark(launch_session->id, startup_timeline::phase_e::display_configured);
           if (video::probe_encoders()) {
             tree.put("root.resume", 0);
             tree.put("root.<xmlattr>.status_code", 503);
@@ -1234,14 +1507,12 @@ namespace nvhttp {
 
             return;
           }
+          startup_timeline::mark(launch_session->id, startup_timeline::phase_e::encoders_probed);
         }
       } else {
-        const auto& apps = proc::proc.get_apps();
-        auto app_iter = std::find_if(apps.begin(), apps.end(), [&appid_str](const auto _app) {
-          return _app.id == appid_str;
-        });
+        auto app = proc::proc.find_app(appid);
 
-        if (app_iter == apps.end()) {
+        if (!app) {
           BOOST_LOG(error) << "Couldn't find app with ID ["sv << appid_str << ']';
           tree.put("root.<xmlattr>.status_code", 404);
           tree.put("root.<xmlattr>.status_message", "Cannot find requested application");
@@ -1249,12 +1520,12 @@ namespace nvhttp {
           return;
         }
 
-        if (!app_iter->allow_client_commands) {
+        if (!app->allow_client_commands) {
           launch_session->client_do_cmds.clear();
           launch_session->client_undo_cmds.clear();
         }
 
-        auto err = proc::proc.execute(appid, *app_iter, launch_session);
+        auto err = proc::proc.execute(appid, *app, launch_session);
         if (err) {
           tree.put("root.<xmlattr>.status_code", err);
           tree.put(
@@ -1277,10 +1548,18 @@ namespace nvhttp {
     tree.put("root.sessionUrl0", launch_session->rtsp_url_scheme + net::addr_to_url_escaped_string(request->local_endpoint().address()) + ':' + std::to_string(net::map_port(rtsp_stream::RTSP_SETUP_PORT)));
     tree.put("root.gamesession", 1);
 
+    if (!launch_session->input_only) {
+      // Build the encoder while the client is still setting up the stream
+      video::prewarm_encoder(launch_session->unique_id, {launch_session->width, launch_session->height, launch_session->fps, launch_session->enable_hdr});
+    }
+
+    startup_timeline::mark(launch_session->id, startup_timeline::phase_e::launch_responded);
+    launch_session->client_address = net::addr_to_normalized_string(request->remote_endpoint().address());
     rtsp_stream::launch_session_raise(launch_session);
   }
 
   void resume(bool &host_audio, resp_https_t response, req_https_t request) {
+    auto received = std::chrono::steady_clock::now();
     print_req<SunshineHTTPS>(request);
 
     pt::ptree tree;
@@ -1332,6 +1611,7 @@ namespace nvhttp {
       host_audio = util::from_view(get_arg(args, "localAudioPlayMode"));
     }
     auto launch_session = make_launch_session(host_audio, false, 0, args, named_cert_p);
+    startup_timeline::begin(launch_session->id, named_cert_p->name, received);
 
     if (!proc::proc.allow_client_commands) {
       launch_session->client_do_cmds.clear();
@@ -1347,6 +1627,7 @@ namespace nvhttp {
       // and the current session isn't virtual display at the moment.
       // This should be done before probing encoders as it could change the active displays.
       display_device::configure_display(config::video, *launch_session);
+      startup_timeline::mark(launch_session->id, startup_timeline::phase_e::display_configured);
 
       // Probe encoders again before streaming to ensure our chosen
       // encoder matches the active GPU (which could have changed
@@ -1359,6 +1640,7 @@ namespace nvhttp {
 
         return;
       }
+      startup_timeline::mark(launch_session->id, startup_timeline::phase_e::encoders_probed);
     }
 
     auto encryption_mode = net::encryption_mode_for_address(request->remote_endpoint().address());
@@ -1376,6 +1658,13 @@ namespace nvhttp {
     tree.put("root.sessionUrl0", launch_session->rtsp_url_scheme + net::addr_to_url_escaped_string(request->local_endpoint().address()) + ':' + std::to_string(net::map_port(rtsp_stream::RTSP_SETUP_PORT)));
     tree.put("root.resume", 1);
 
+    if (!launch_session->input_only) {
+      // Build the encoder while the client is still setting up the stream
+      video::prewarm_encoder(launch_session->unique_id, {launch_session->width, launch_session->height, launch_session->fps, launch_session->enable_hdr});
+    }
+
+    startup_timeline::mark(launch_session->id, startup_timeline::phase_e::launch_responded);
+    launch_session->client_address = net::addr_to_normalized_string(request->remote_endpoint().address());
     rtsp_stream::launch_session_raise(launch_session);
 
 #if defined AQUA_TRAY && AQUA_TRAY >= 1
@@ -1439,15 +1728,27 @@ namespace nvhttp {
     }
 
     auto args = request->parse_query_string();
-    auto app_image = proc::proc.get_app_image(util::from_view(get_arg(args, "appid")));
+    auto app_id = util::from_view(get_arg(args, "appid"));
+    auto asset = app_assets.get(app_id, proc::proc.get_app_image(app_id));
 
     fg.disable();
 
-    std::ifstream in(app_image, std::ios::binary);
+    if (!asset) {
+      response->write(SimpleWeb::StatusCode::client_error_not_found);
+      return;
+    }
+
     SimpleWeb::CaseInsensitiveMultimap headers;
+    headers.emplace("ETag", asset->etag);
+
+    auto if_none_match = request->header.find("If-None-Match");
+    if (if_none_match != std::end(request->header) && asset_cache::matches(if_none_match->second, asset->etag)) {
+      response->write(SimpleWeb::StatusCode::redirection_not_modified, headers);
+      return;
+    }
+
     headers.emplace("Content-Type", "image/png");
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
-    response->close_connection_after_response = true;
+    response->write(SimpleWeb::StatusCode::success_ok, asset->data, headers);
   }
 
   void getClipboard(resp_https_t response, req_https_t request) {
@@ -1573,6 +1874,19 @@ namespace nvhttp {
       load_state();
     }
 
+    // Read the covers ahead of the first applist, clients fetch all of them right after
+    std::vector<std::pair<int, std::string>> covers;
+    auto apps = proc::proc.get_apps();
+    for (auto &app : *apps) {
+      auto app_id = util::from_view(app.id);
+      covers.emplace_back(app_id, proc::proc.get_app_image(app_id));
+    }
+    task_pool.push([covers = std::move(covers)]() {
+      for (auto &[app_id, path] : covers) {
+        app_assets.get(app_id, path);
+      }
+    });
+
     auto pkey = file_handler::read_file(config::nvhttp.pkey.c_str());
     auto cert = file_handler::read_file(config::nvhttp.cert.c_str());
     setup(pkey, cert);
@@ -1598,6 +1912,23 @@ namespace nvhttp {
         return false;
       }
 
+      auto session = SSL_get_session(ssl);
+
+      // A resumed session is bound to the client verified by the full handshake
+      if (SSL_session_reused(ssl)) {
+        auto client = (std::shared_ptr<verified_client_t> *) SSL_SESSION_get_ex_data(session, session_client_index);
+        if (client && (*client)->pairing_revision == pairing_revision) {
+          BOOST_LOG(debug) << "resumed session, device name: "sv << (*client)->named_cert->name;
+
+          ++resumed_handshakes;
+          SSL_set_ex_data(ssl, connection_client_index, new verified_client_t {**client});
+          return true;
+        }
+      }
+
+      ++full_handshakes;
+      BOOST_LOG(debug) << "TLS handshakes :: "sv << full_handshakes << " full, "sv << resumed_handshakes << " resumed"sv;
+
       bool verified = false;
       p_named_cert_t named_cert_p;
 
@@ -1614,6 +1945,7 @@ namespace nvhttp {
 
       });
 
+      auto revision = pairing_revision.load();
       auto err_str = cert_chain.verify(x509.get(), named_cert_p);
       if (err_str) {
         BOOST_LOG(warning) << "SSL Verification error :: "sv << err_str;
@@ -1621,8 +1953,12 @@ namespace nvhttp {
       }
 
       verified = true;
-      cert_store[req->remote_endpoint().address().to_string()] = named_cert_p;
-      cert_store[req->remote_endpoint().address().to_string()] = named_cert_p;
+      auto client = std::make_shared<verified_client_t>(verified_client_t {named_cert_p, revision});
+      SSL_set_ex_data(ssl, connection_client_index, new verified_client_t {*client});
+
+      // Replaces the client bound by an earlier handshake, e.g. one that resumed after the paired clients changed
+      delete (std::shared_ptr<verified_client_t> *) SSL_SESSION_get_ex_data(session, session_client_index);
+      SSL_SESSION_set_ex_data(session, session_client_index, new std::shared_ptr<verified_client_t>(std::move(client)));
 
       return true;
     };
@@ -1642,20 +1978,32 @@ namespace nvhttp {
       tree.put("root.<xmlattr>.status_message"s, "The client is not authorized. Certificate verification failed."s);
     };
 
+    // Connections are kept alive, so a request may come from a client unpaired since the handshake
+    auto paired_only = [&https_server](auto handler) -> std::function<void(resp_https_t, req_https_t)> {
+      return [&https_server, handler](resp_https_t resp, req_https_t req) {
+        if (!get_verified_cert(req)) {
+          https_server.on_verify_failed(resp, req);
+          return;
+        }
+
+        handler(resp, req);
+      };
+    };
+
     https_server.default_resource["GET"] = not_found<SunshineHTTPS>;
-    https_server.resource["^/serverinfo$"]["GET"] = serverinfo<SunshineHTTPS>;
-    https_server.resource["^/pair$"]["GET"] = pair<SunshineHTTPS>;
-    https_server.resource["^/applist$"]["GET"] = applist;
-    https_server.resource["^/appasset$"]["GET"] = appasset;
-    https_server.resource["^/launch$"]["GET"] = [&host_audio](auto resp, auto req) {
+    https_server.resource["^/serverinfo$"]["GET"] = paired_only(serverinfo<SunshineHTTPS>);
+    https_server.resource["^/pair$"]["GET"] = paired_only(pair<SunshineHTTPS>);
+    https_server.resource["^/applist$"]["GET"] = paired_only(applist);
+    https_server.resource["^/appasset$"]["GET"] = paired_only(appasset);
+    https_server.resource["^/launch$"]["GET"] = paired_only([&host_audio](auto resp, auto req) {
       launch(host_audio, resp, req);
-    };
-    https_server.resource["^/resume$"]["GET"] = [&host_audio](auto resp, auto req) {
+    });
+    https_server.resource["^/resume$"]["GET"] = paired_only([&host_audio](auto resp, auto req) {
       resume(host_audio, resp, req);
-    };
-    https_server.resource["^/cancel$"]["GET"] = cancel;
-    https_server.resource["^/actions/clipboard$"]["GET"] = getClipboard;
-    https_server.resource["^/actions/clipboard$"]["POST"] = setClipboard;
+    });
+    https_server.resource["^/cancel$"]["GET"] = paired_only(cancel);
+    https_server.resource["^/actions/clipboard$"]["GET"] = paired_only(getClipboard);
+    https_server.resource["^/actions/clipboard$"]["POST"] = paired_only(setClipboard);
 
     https_server.config.reuse_address = true;
     https_server.config.address = net::af_to_any_address_string(address_family);
@@ -1717,7 +2065,6 @@ namespace nvhttp {
     client_root = client;
     cert_chain.clear();
     save_state();
-    load_state();
   }
 
   void stop_session(stream::session_t& session, bool graceful) {
@@ -1770,7 +2117,7 @@ namespace nvhttp {
         named_cert_p->perm = newPerm;
         named_cert_p->do_cmds = do_cmds;
         named_cert_p->undo_cmds = undo_cmds;
-        save_state();
+        save_client(*named_cert_p);
         return true;
       }
     }
@@ -1783,6 +2130,7 @@ namespace nvhttp {
     client_t &client = client_root;
     for (auto it = client.named_devices.begin(); it != client.named_devices.end();) {
       if ((*it)->uuid == uuid) {
+        cert_chain.remove(*it);
         it = client.named_devices.erase(it);
         removed = true;
       } else {
@@ -1790,10 +2138,10 @@ namespace nvhttp {
       }
     }
 
-    save_state();
-    load_state();
-
     if (removed) {
+      ++pairing_revision;
+      pairing_state.remove(std::string {uuid});
+
       auto session = rtsp_stream::find_session(uuid);
       if (session) {
         stop_session(*session, true);
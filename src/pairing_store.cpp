@@ -0,0 +1,304 @@
+/**
+ * @file src/pairing_store.cpp
+ * @brief Definitions for persisting the paired clients with a journal.
+ */
+// this include
+#include "pairing_store.h"
+
+// standard includes
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+  #include <io.h>
+  #include <sys/stat.h>
+#else
+  #include <unistd.h>
+#endif
+
+// local includes
+#include "logging.h"
+
+using namespace std::literals;
+
+namespace pairing_store {
+  namespace fs = std::filesystem;
+
+  /**
+   * @brief Write to a file and flush it to disk before returning.
+   * @param path The file, created if it doesn't exist.
+   * @param data What to write.
+   * @param append Append to the file instead of replacing its contents.
+   * @return `true` on success.
+   */
+  static bool write_synced(const fs::path &path, std::string_view data, bool append) {
+#ifdef _WIN32
+    auto fd = _wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (append ? _O_APPEND : _O_TRUNC), _S_IREAD | _S_IWRITE);
+#else
+    auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666);
+#endif
+    if (fd < 0) {
+      return false;
+    }
+
+    bool ok = true;
+    while (ok && !data.empty()) {
+#ifdef _WIN32
+      auto written = _write(fd, data.data(), (unsigned int) data.size());
+#else
+      auto written = write(fd, data.data(), data.size());
+#endif
+      ok = written > 0;
+      if (ok) {
+        data.remove_prefix(written);
+      }
+    }
+
+#ifdef _WIN32
+    ok = ok && !_commit(fd);
+    _close(fd);
+#else
+    ok = ok && !fsync(fd);
+    close(fd);
+#endif
+
+    return ok;
+  }
+
+  /**
+   * @brief Flush the entries of a directory to disk, so a file renamed into it stays renamed after a crash.
+   * @details Windows can't open directories for this, NTFS journals the rename itself.
+   */
+  static void sync_directory(const fs::path &dir) {
+#ifndef _WIN32
+    auto fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+
+    fsync(fd);
+    close(fd);
+#endif
+  }
+
+  std::optional<nlohmann::json> store_t::load(const fs::path &file) {
+    std::lock_guard lg {_mutex};
+
+    _file = file;
+    _root = nlohmann::json::object();
+    _index.clear();
+    _journaled = 0;
+    _damaged = false;
+
+    if (!fs::exists(file)) {
+      return std::nullopt;
+    }
+
+    nlohmann::json tree;
+    {
+      std::ifstream in {file};
+      in >> tree;
+    }
+
+    if (tree.contains("root") && tree["root"].is_object()) {
+      _root = tree["root"];
+    }
+    if (!_root.contains("named_devices") || !_root["named_devices"].is_array()) {
+      _root["named_devices"] = nlohmann::json::array();
+    }
+    reindex();
+
+    std::vector<std::string> lines;
+    {
+      std::ifstream journal {journal_path(file)};
+      for (std::string line; std::getline(journal, line);) {
+        lines.emplace_back(std::move(line));
+      }
+    }
+
+    bool torn = false;
+    for (std::size_t x = 0; x < lines.size(); ++x) {
+      auto record = nlohmann::json::parse(lines[x], nullptr, false);
+      if (!record.is_discarded() && record.is_object()) {
+        apply(record);
+        ++_journaled;
+        continue;
+      }
+
+      // Only the last record can be cut short, by a crash while appending it
+      if (x + 1 == lines.size()) {
+        BOOST_LOG(warning) << "Dropping incomplete record at the end of "sv << journal_path(file).string();
+        torn = true;
+      } else {
+        BOOST_LOG(error) << "Record "sv << x + 1 << " of "sv << journal_path(file).string() << " is damaged, "sv
+                         << "the records after it weren't replayed. Paired clients won't be saved until it's repaired or removed"sv;
+        _damaged = true;
+      }
+      break;
+    }
+
+    if (torn) {
+      compact();
+    }
+
+    return _root;
+  }
+
+  void store_t::set_unique_id(const std::string &unique_id) {
+    std::lock_guard lg {_mutex};
+
+    _root["uniqueid"] = unique_id;
+  }
+
+  void store_t::put(const nlohmann::json &device) {
+    std::lock_guard lg {_mutex};
+
+    nlohmann::json record {{"op", "put"}, {"device", device}};
+    apply(record);
+    append(record);
+  }
+
+  void store_t::remove(const std::string &uuid) {
+    std::lock_guard lg {_mutex};
+
+    if (!_index.contains(uuid)) {
+      return;
+    }
+
+    nlohmann::json record {{"op", "remove"}, {"uuid", uuid}};
+    apply(record);
+    append(record);
+  }
+
+  void store_t::reset(const nlohmann::json &devices) {
+    std::lock_guard lg {_mutex};
+
+    // Clients in the old format are converted by the caller
+    _root.erase("devices");
+    _root["named_devices"] = devices;
+    reindex();
+
+    compact();
+  }
+
+  std::size_t store_t::journal_size() {
+    std::lock_guard lg {_mutex};
+
+    return _journaled;
+  }
+
+  fs::path store_t::journal_path(const fs::path &file) {
+    auto path = file;
+    path += ".journal";
+
+    return path;
+  }
+
+  void store_t::apply(const nlohmann::json &record) {
+    auto op = record.value("op", "");
+    auto &devices = _root["named_devices"];
+
+    if (op == "put") {
+      auto &device = record["device"];
+      auto uuid = device.value("uuid", "");
+
+      if (auto it = _index.find(uuid); it != std::end(_index)) {
+        devices[it->second] = device;
+      } else {
+        _index.emplace(uuid, devices.size());
+        devices.push_back(device);
+      }
+    } else if (op == "remove") {
+      auto it = _index.find(record.value("uuid", ""));
+      if (it != std::end(_index)) {
+        devices.erase(it->second);
+        reindex();
+      }
+    }
+  }
+
+  void store_t::append(const nlohmann::json &record) {
+    if (_file.empty()) {
+      return;
+    }
+
+    // The journal is relative to a snapshot, the first change writes one
+    if (!fs::exists(_file)) {
+      compact();
+      return;
+    }
+
+    if (_damaged) {
+      BOOST_LOG(error) << "Not saving paired clients, "sv << journal_path(_file).string() << " is damaged"sv;
+      return;
+    }
+
+    if (!write_synced(journal_path(_file), record.dump() + '\n', true)) {
+      BOOST_LOG(error) << "Couldn't append to "sv << journal_path(_file).string() << ", writing a snapshot instead"sv;
+      compact();
+      return;
+    }
+
+    // Compacting after as many records as there are clients keeps the cost per change constant
+    if (++_journaled >= std::max(min_journal_size, _root["named_devices"].size())) {
+      compact();
+    }
+  }
+
+  void store_t::reindex() {
+    _index.clear();
+
+    auto &devices = _root["named_devices"];
+    for (std::size_t x = 0; x < devices.size(); ++x) {
+      _index.emplace(devices[x].value("uuid", ""), x);
+    }
+  }
+
+  void store_t::compact() {
+    if (_file.empty()) {
+      return;
+    }
+
+    // Compacting would drop the records after the damaged one for good
+    if (_damaged) {
+      BOOST_LOG(error) << "Not saving paired clients, "sv << journal_path(_file).string() << " is damaged"sv;
+      return;
+    }
+
+    // Keep whatever else was written to the state file since it was loaded
+    nlohmann::json tree = nlohmann::json::object();
+    if (fs::exists(_file)) {
+      try {
+        std::ifstream in {_file};
+        in >> tree;
+      } catch (std::exception &e) {
+        BOOST_LOG(error) << "Couldn't read "sv << _file.string() << ": "sv << e.what();
+        return;
+      }
+    }
+
+    tree["root"] = _root;
+
+    auto temp = _file;
+    temp += ".tmp";
+    // The snapshot has to be on disk before the rename, or a crash could leave an empty state file
+    if (!write_synced(temp, tree.dump(4), false)) {  // Pretty-print with an indent of 4 spaces.
+      BOOST_LOG(error) << "Couldn't write "sv << temp.string();
+      return;
+    }
+
+    std::error_code ec;
+    fs::rename(temp, _file, ec);
+    if (ec) {
+      BOOST_LOG(error) << "Couldn't replace "sv << _file.string() << ": "sv << ec.message();
+      return;
+    }
+    sync_directory(_file.parent_path());
+
+    fs::remove(journal_path(_file), ec);
+    _journaled = 0;
+  }
+}  // namespace pairing_store
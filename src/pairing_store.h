@@ -0,0 +1,92 @@
+/**
+ * @file src/pairing_store.h
+ * @brief Declarations for persisting the paired clients with a journal.
+ */
+#pragma once
+
+// standard includes
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// lib includes
+#include <nlohmann/json.hpp>
+
+namespace pairing_store {
+  /**
+   * @brief The paired clients of the state file, changed one client at a time.
+   * @details The `root` object of the state file is the snapshot. Every change is appended to a journal next to it,
+   *          one JSON record per line, and replayed onto the snapshot when loading. Once the journal holds as many
+   *          records as there are clients, the snapshot is rewritten through a temporary file and an atomic rename,
+   *          and the journal starts over. Replaying a journal onto the snapshot it was compacted into changes
+   *          nothing, so a crash between the rename and removing the journal loses nothing. Both are flushed to disk
+   *          before anything that depends on them is written.
+   *
+   *          Only the last record of the journal can be incomplete, and it's dropped. A damaged record anywhere else
+   *          stops the replay, and nothing is written until the journal is repaired or removed.
+   *
+   *          Other keys of the state file, like the web UI credentials, are read back from disk on every compaction
+   *          and left as they are.
+   */
+  class store_t {
+  public:
+    /**
+     * @brief Read the snapshot and replay the journal.
+     * @param file The state file.
+     * @return The `root` object with the journal applied, or std::nullopt if the state file doesn't exist.
+     * @throws std::exception if the state file can't be parsed.
+     */
+    std::optional<nlohmann::json> load(const std::filesystem::path &file);
+
+    /**
+     * @brief Set the unique ID written with the next snapshot.
+     */
+    void set_unique_id(const std::string &unique_id);
+
+    /**
+     * @brief Add a client, or replace the client with the same `uuid`.
+     * @param device The `named_devices` node of the client.
+     */
+    void put(const nlohmann::json &device);
+
+    /**
+     * @brief Remove a client.
+     * @param uuid The `uuid` of the client.
+     */
+    void remove(const std::string &uuid);
+
+    /**
+     * @brief Replace all clients and write a new snapshot right away.
+     * @param devices The `named_devices` nodes of the clients.
+     */
+    void reset(const nlohmann::json &devices);
+
+    /**
+     * @brief Records appended to the journal since the last snapshot.
+     */
+    std::size_t journal_size();
+
+    /**
+     * @brief Path of the journal of a state file.
+     */
+    static std::filesystem::path journal_path(const std::filesystem::path &file);
+
+  private:
+    static constexpr std::size_t min_journal_size = 256;  ///< Never compact more often than this many records.
+
+    void append(const nlohmann::json &record);
+    void apply(const nlohmann::json &record);
+    void reindex();
+    void compact();
+
+    std::mutex _mutex;
+    std::filesystem::path _file;
+    nlohmann::json _root = nlohmann::json::object();
+    std::unordered_map<std::string, std::size_t> _index;  ///< Position of each client in `named_devices` by `uuid`.
+    std::size_t _journaled = 0;
+    bool _damaged = false;  ///< A record before the last one of the journal couldn't be read.
+  };
+}  // namespace pairing_store
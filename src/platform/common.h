@@ -10,6 +10,7 @@
 #include <functional>
 #include <mutex>
 #include <string>
+#include <vector>
 
 // lib includes
 #include <boost/core/noncopyable.hpp>
@@ -362,6 +363,16 @@ namespace platf {
     virtual ~deinit_t() = default;
   };
 
+  /**
+   * @brief A rectangle of an image in pixels, relative to the top left corner of the image.
+   */
+  struct img_rect_t {
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t width;
+    std::int32_t height;
+  };
+
   struct img_t: std::enable_shared_from_this<img_t> {
   public:
     img_t() = default;
@@ -379,6 +390,14 @@ namespace platf {
 
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
 
+    /**
+     * Capture backends that track damage number their frames consecutively starting at 1,
+     * and list the regions that changed since the frame with the previous sequence number.
+     * A sequence number of 0 or an empty damage list means that any part of the image may have changed.
+     */
+    std::uint64_t damage_sequence {};
+    std::vector<img_rect_t> damage;
+
     virtual ~img_t() = default;
   };
 
@@ -602,6 +621,12 @@ namespace platf {
    */
   bool needs_encoder_reenumeration();
 
+  /**
+   * @brief Describe the installed GPUs and their drivers.
+   * @return A string that changes whenever a GPU or its driver is replaced.
+   */
+  std::string gpu_fingerprint();
+
   boost::process::v1::child run_command(bool elevated, bool interactive, const std::string &cmd, boost::filesystem::path &working_dir, const boost::process::v1::environment &env, FILE *file, std::error_code &ec, boost::process::v1::group *group);
 
   enum class thread_priority_e : int {
@@ -857,6 +882,18 @@ namespace platf {
      */
     virtual void sleep_for(const std::chrono::nanoseconds &duration) = 0;
 
+    /**
+     * @brief Sleep until the absolute deadline
+     * @param deadline Wake up time point
+     * @note Backends capable of absolute deadlines should override this to avoid accumulating wake up latency
+     */
+    virtual void sleep_until(const std::chrono::steady_clock::time_point &deadline) {
+      auto now = std::chrono::steady_clock::now();
+      if (deadline > now) {
+        sleep_for(deadline - now);
+      }
+    }
+
     /**
      * @brief Check if platform-specific timer backend has been initialized successfully
      * @return `true` on success, `false` on error
@@ -0,0 +1,48 @@
+/**
+ * @file src/platform/linux/capture_scheduler.cpp
+ * @brief Definitions for deadline-driven frame pacing of the Linux capture backends.
+ */
+// local includes
+#include "capture_scheduler.h"
+
+namespace platf {
+  capture_scheduler_t::capture_scheduler_t(std::chrono::nanoseconds frame_interval, logging::time_delta_periodic_logger &overshoot_logger):
+      frame_interval {frame_interval},
+      timer {create_high_precision_timer()},
+      overshoot_logger {overshoot_logger} {
+    if (!*timer) {
+      BOOST_LOG(warning) << "High precision timer is unavailable, frame pacing may be inaccurate";
+    }
+
+    reset();
+  }
+
+  bool capture_scheduler_t::wait_for_next_frame() {
+    auto now = std::chrono::steady_clock::now();
+    auto next_frame = deadline();
+
+    if (next_frame > now) {
+      timer->sleep_until(next_frame);
+      overshoot_logger.first_point(next_frame);
+      overshoot_logger.second_point_now_and_log();
+    } else if (now - next_frame > frame_interval) {
+      // Some major slowdown happened and we couldn't keep up, so don't try to catch up on the missed frames
+      epoch = now;
+      frame_count = 1;
+      return false;
+    }
+
+    ++frame_count;
+    return true;
+  }
+
+  void capture_scheduler_t::reset() {
+    epoch = std::chrono::steady_clock::now();
+    frame_count = 0;
+    overshoot_logger.reset();
+  }
+
+  std::chrono::steady_clock::time_point capture_scheduler_t::deadline() const {
+    return epoch + frame_interval * frame_count;
+  }
+}  // namespace platf
@@ -0,0 +1,61 @@
+/**
+ * @file src/platform/linux/capture_scheduler.h
+ * @brief Declarations for deadline-driven frame pacing of the Linux capture backends.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// local includes
+#include "src/logging.h"
+#include "src/platform/common.h"
+
+namespace platf {
+  /**
+   * @brief Paces a capture loop against absolute frame deadlines.
+   * @details Deadlines are derived from a fixed epoch and the frame count instead of being
+   *          accumulated from the previous wake up, so sleep overshoot on one frame doesn't
+   *          shift the phase of the following frames. When the loop falls behind by more than
+   *          a full frame interval, the epoch is re-anchored to the current time.
+   * @examples
+   * capture_scheduler_t scheduler {delay, sleep_overshoot_logger};
+   * while (true) {
+   *   scheduler.wait_for_next_frame();
+   *   // capture a frame
+   * }
+   * @examples_end
+   */
+  class capture_scheduler_t {
+  public:
+    /**
+     * @brief Create a scheduler, the first frame is due immediately.
+     * @param frame_interval Time between two consecutive frames.
+     * @param overshoot_logger Logger that collects the sleep overshoot of every frame.
+     */
+    capture_scheduler_t(std::chrono::nanoseconds frame_interval, logging::time_delta_periodic_logger &overshoot_logger);
+
+    /**
+     * @brief Block until the next frame is due.
+     * @return `true` if the loop is on schedule, `false` if it fell behind and the schedule was re-anchored.
+     */
+    bool wait_for_next_frame();
+
+    /**
+     * @brief Restart the schedule from the current time.
+     */
+    void reset();
+
+  private:
+    std::chrono::steady_clock::time_point deadline() const;
+
+    std::chrono::nanoseconds frame_interval;
+    std::chrono::steady_clock::time_point epoch;
+    std::uint64_t frame_count;
+
+    std::unique_ptr<high_precision_timer> timer;
+    logging::time_delta_periodic_logger &overshoot_logger;
+  };
+}  // namespace platf
@@ -85,6 +85,27 @@ namespace gl {
     gl::ctx.CopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, offset_x, offset_y, width, height);
   }
 
+  pbo_t::~pbo_t() {
+    if (size() != 0) {
+      ctx.DeleteBuffers(size(), begin());
+    }
+  }
+
+  pbo_t pbo_t::make(std::size_t count, std::size_t size) {
+    pbo_t pbo {count};
+
+    ctx.GenBuffers(pbo.size(), pbo.begin());
+
+    for (auto buf : pbo) {
+      ctx.BindBuffer(GL_PIXEL_PACK_BUFFER, buf);
+      ctx.BufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+
+    ctx.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return pbo;
+  }
+
   std::string shader_t::err_str() {
     int length;
     ctx.GetShaderiv(handle(), GL_INFO_LOG_LENGTH, &length);
@@ -987,6 +1008,136 @@ namespace egl {
 
     return 0;
   }
+
+  std::optional<readback_t> readback_t::make(int width, int height) {
+    readback_t readback;
+
+    readback.width = width;
+    readback.height = height;
+    readback.row_pitch = (std::size_t) width * 4;
+
+    readback.head = 0;
+    readback.count = 0;
+
+    readback.pbo = gl::pbo_t::make(depth, readback.row_pitch * height);
+    readback.slots.resize(depth);
+
+    if (gl::ctx.GetError() != GL_NO_ERROR) {
+      BOOST_LOG(error) << "Couldn't allocate pixel buffers for readback"sv;
+      return std::nullopt;
+    }
+
+    return readback;
+  }
+
+  void readback_t::queue(GLuint texture, int offset_x, int offset_y, const std::optional<std::chrono::steady_clock::time_point> &frame_timestamp, finish_t finish) {
+    if (count == depth) {
+      // The oldest frame was never picked up, reuse its buffer
+      auto &oldest = slots[(head + depth - count) % depth];
+      oldest.fence = gl::fence_t {};
+      oldest.finish = nullptr;
+      --count;
+    }
+
+    auto &slot = slots[head];
+
+    // With a pixel pack buffer bound, the pointer argument is an offset into that buffer
+    gl::ctx.BindBuffer(GL_PIXEL_PACK_BUFFER, pbo[head]);
+    gl::ctx.GetTextureSubImage(texture, 0, offset_x, offset_y, 0, width, height, 1, GL_BGRA, GL_UNSIGNED_BYTE, row_pitch * height, nullptr);
+    gl::ctx.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = gl::fence_t {gl::ctx.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)};
+    slot.frame_timestamp = frame_timestamp;
+    slot.finish = std::move(finish);
+
+    // Submit the copy now, so it runs while the previous frame is being delivered
+    gl::ctx.Flush();
+
+    gl_drain_errors;
+
+    head = (head + 1) % depth;
+    ++count;
+  }
+
+  platf::capture_e readback_t::retrieve(platf::img_t &img, std::chrono::nanoseconds timeout) {
+    if (!count) {
+      return platf::capture_e::timeout;
+    }
+
+    auto index = (head + depth - count) % depth;
+    auto &slot = slots[index];
+
+    auto status = gl::ctx.ClientWaitSync(slot.fence.el, GL_SYNC_FLUSH_COMMANDS_BIT, std::max<std::int64_t>(0, timeout.count()));
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return platf::capture_e::timeout;
+    }
+
+    if (status == GL_WAIT_FAILED) {
+      BOOST_LOG(error) << "Couldn't wait for readback fence"sv;
+      gl_drain_errors;
+
+      return platf::capture_e::error;
+    }
+
+    gl::ctx.BindBuffer(GL_PIXEL_PACK_BUFFER, pbo[index]);
+    auto fg = util::fail_guard([]() {
+      gl::ctx.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    });
+
+    auto data = (const std::uint8_t *) gl::ctx.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, row_pitch * height, GL_MAP_READ_BIT);
+    if (!data) {
+      BOOST_LOG(error) << "Couldn't map readback buffer"sv;
+      gl_drain_errors;
+
+      return platf::capture_e::error;
+    }
+
+    if (img.row_pitch == row_pitch) {
+      std::copy_n(data, row_pitch * height, img.data);
+    } else {
+      for (int y = 0; y < height; ++y) {
+        std::copy_n(data + y * row_pitch, row_pitch, img.data + y * img.row_pitch);
+      }
+    }
+
+    gl::ctx.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+    img.frame_timestamp = slot.frame_timestamp;
+
+    auto finish = std::move(slot.finish);
+    slot.finish = nullptr;
+    slot.fence = gl::fence_t {};
+    --count;
+
+    if (finish) {
+      finish(img);
+    }
+
+    return platf::capture_e::ok;
+  }
+
+  platf::capture_e readback_t::exchange(GLuint texture, int offset_x, int offset_y, const std::optional<std::chrono::steady_clock::time_point> &frame_timestamp, const platf::display_t::pull_free_image_cb_t &pull_free_image_cb, std::shared_ptr<platf::img_t> &img_out, std::chrono::nanoseconds timeout, finish_t finish) {
+    if (!count) {
+      queue(texture, offset_x, offset_y, frame_timestamp, std::move(finish));
+      return platf::capture_e::timeout;
+    }
+
+    // Pull the image first, nothing is queued if the capture is interrupted
+    if (!pull_free_image_cb(img_out)) {
+      return platf::capture_e::interrupted;
+    }
+
+    auto status = retrieve(*img_out, timeout);
+    if (status == platf::capture_e::ok) {
+      queue(texture, offset_x, offset_y, frame_timestamp, std::move(finish));
+    }
+
+    return status;
+  }
+
+  std::size_t readback_t::in_flight() const {
+    return count;
+  }
 }  // namespace egl
 
 void free_frame(AVFrame *frame) {
@@ -5,8 +5,12 @@
 #pragma once
 
 // standard includes
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string_view>
+#include <vector>
 
 // lib includes
 #include <glad/egl.h>
@@ -97,6 +101,32 @@ namespace gl {
     void copy(int id, int texture, int offset_x, int offset_y, int width, int height);
   };
 
+  /**
+   * @brief Pixel buffer objects used as the destination of asynchronous readbacks.
+   */
+  class pbo_t: public util::buffer_t<GLuint> {
+    using util::buffer_t<GLuint>::buffer_t;
+
+  public:
+    pbo_t(pbo_t &&) = default;
+    pbo_t &operator=(pbo_t &&) = default;
+
+    ~pbo_t();
+
+    /**
+     * @brief Create pixel pack buffers.
+     * @param count Number of buffers.
+     * @param size Size in bytes of each buffer.
+     */
+    static pbo_t make(std::size_t count, std::size_t size);
+  };
+
+  KITTY_USING_MOVE_T(fence_t, GLsync, nullptr, {
+    if (el) {
+      ctx.DeleteSync(el);
+    }
+  });
+
   class shader_t {
     KITTY_USING_MOVE_T(shader_internal_t, GLuint, std::numeric_limits<GLuint>::max(), {
       if (el != std::numeric_limits<GLuint>::max()) {
@@ -336,5 +366,93 @@ namespace egl {
     std::uint64_t serial;
   };
 
+  /**
+   * @brief Asynchronous readback of captured frames into system memory.
+   *
+   * Each readback is queued into the next pixel buffer object of a ring and guarded by a fence.
+   * The buffer is only mapped once its fence has signaled, so the copy of frame N can run on the
+   * GPU while frame N - 1 is handed to the encoder instead of stalling the capture thread.
+   */
+  class readback_t {
+  public:
+    /**
+     * @brief Number of buffers in the ring, one being filled while the other is delivered.
+     */
+    static constexpr std::size_t depth = 2;
+
+    /**
+     * @brief Finishes an image once the frame it was queued with is copied into it, e.g. by drawing the cursor.
+     */
+    using finish_t = std::function<void(platf::img_t &)>;
+
+    /**
+     * @brief Create the buffers for a BGRA readback.
+     * @param width Width of the region to read back.
+     * @param height Height of the region to read back.
+     * @return The readback ring, or `std::nullopt` on failure.
+     */
+    static std::optional<readback_t> make(int width, int height);
+
+    /**
+     * @brief Queue the readback of a region of a texture.
+     * @note When every buffer is in flight, the oldest readback is dropped.
+     * @param texture The texture to read from.
+     * @param offset_x Horizontal offset of the region in the texture.
+     * @param offset_y Vertical offset of the region in the texture.
+     * @param frame_timestamp Capture timestamp to attach to the image once it is retrieved.
+     * @param finish Called on the image once it is retrieved.
+     */
+    void queue(GLuint texture, int offset_x, int offset_y, const std::optional<std::chrono::steady_clock::time_point> &frame_timestamp, finish_t finish = {});
+
+    /**
+     * @brief Copy the oldest queued readback into an image.
+     * @param img The image to copy into, it must be at least as large as the readback region.
+     * @param timeout Maximum time to wait for the GPU to complete the copy.
+     * @return `capture_e::ok` on success, `capture_e::timeout` if nothing is ready in time.
+     */
+    platf::capture_e retrieve(platf::img_t &img, std::chrono::nanoseconds timeout);
+
+    /**
+     * @brief Deliver the previous frame, then queue the readback of a new one.
+     * @details The previous frame had a whole frame interval to complete its copy, so its fence has
+     *          usually signaled by now. When nothing older is in flight, the new frame is only queued
+     *          and delivered by the next call. If the previous frame isn't ready in time, the new one
+     *          is dropped rather than piling up behind it.
+     * @param texture The texture to read the new frame from.
+     * @param offset_x Horizontal offset of the region in the texture.
+     * @param offset_y Vertical offset of the region in the texture.
+     * @param frame_timestamp Capture timestamp of the new frame.
+     * @param pull_free_image_cb Provides the image the previous frame is delivered into.
+     * @param img_out Receives the image holding the previous frame.
+     * @param timeout Maximum time to wait for the GPU to complete the copy of the previous frame.
+     * @param finish Called on the image the new frame is delivered into, by a later call.
+     * @return `capture_e::ok` if the previous frame was delivered, `capture_e::timeout` if there was none or it
+     *         wasn't ready, `capture_e::interrupted` if no image could be pulled.
+     */
+    platf::capture_e exchange(GLuint texture, int offset_x, int offset_y, const std::optional<std::chrono::steady_clock::time_point> &frame_timestamp, const platf::display_t::pull_free_image_cb_t &pull_free_image_cb, std::shared_ptr<platf::img_t> &img_out, std::chrono::nanoseconds timeout, finish_t finish = {});
+
+    /**
+     * @brief Number of readbacks that have been queued but not retrieved yet.
+     */
+    std::size_t in_flight() const;
+
+  private:
+    struct slot_t {
+      gl::fence_t fence;
+      std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+      finish_t finish;
+    };
+
+    gl::pbo_t pbo;
+    std::vector<slot_t> slots;
+
+    // Index of the next buffer to fill
+    std::size_t head;
+    std::size_t count;
+
+    int width, height;
+    std::size_t row_pitch;
+  };
+
   bool fail();
 }  // namespace egl
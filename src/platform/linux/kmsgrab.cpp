@@ -18,6 +18,7 @@
 #include <xf86drmMode.h>
 
 // local includes
+#include "capture_scheduler.h"
 #include "cuda.h"
 #include "graphics.h"
 #include "src/config.h"
@@ -284,7 +285,7 @@ namespace platf {
       std::int32_t x, y;
       std::uint32_t dst_w, dst_h;
       std::uint32_t src_w, src_h;
-      std::vector<std::uint8_t> pixels;
+      std::shared_ptr<const std::vector<std::uint8_t>> pixels;  ///< Replaced rather than changed, frames in flight keep theirs
       unsigned long serial;
 
       // Private properties used for tracking cursor changes
@@ -1000,7 +1001,7 @@ namespace platf {
             return;
           }
 
-          captured_cursor.pixels.resize(src_w * src_h * 4);
+          auto cursor_pixels = std::make_shared<std::vector<std::uint8_t>>(src_w * src_h * 4);
 
           // Prepare to read the dmabuf from the CPU
           struct dma_buf_sync sync;
@@ -1009,10 +1010,10 @@ namespace platf {
 
           // If the image is tightly packed, copy it in one shot
           if (fb->pitches[0] == src_w * 4 && src_x == 0) {
-            memcpy(captured_cursor.pixels.data(), &((std::uint8_t *) mapped_data)[src_y * fb->pitches[0]], src_h * fb->pitches[0]);
+            memcpy(cursor_pixels->data(), &((std::uint8_t *) mapped_data)[src_y * fb->pitches[0]], src_h * fb->pitches[0]);
           } else {
             // Copy row by row to deal with mismatched pitch or an X offset
-            auto pixel_dst = captured_cursor.pixels.data();
+            auto pixel_dst = cursor_pixels->data();
             for (int y = 0; y < src_h; y++) {
               memcpy(&pixel_dst[y * (src_w * 4)], &((std::uint8_t *) mapped_data)[(y + src_y) * fb->pitches[0] + (src_x * 4)], src_w * 4);
             }
@@ -1025,6 +1026,7 @@ namespace platf {
           munmap(mapped_data, mapped_size);
 
           captured_cursor.visible = true;
+          captured_cursor.pixels = std::move(cursor_pixels);
           captured_cursor.src_w = src_w;
           captured_cursor.src_h = src_h;
           captured_cursor.prop_src_x = *prop_src_x;
@@ -1154,27 +1156,21 @@ namespace platf {
 
         ctx = std::move(*ctx_opt);
 
+        auto readback_opt = egl::readback_t::make(width, height);
+        if (!readback_opt) {
+          return -1;
+        }
+
+        readback = std::move(*readback_opt);
+
         return 0;
       }
 
       capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
-        auto next_frame = std::chrono::steady_clock::now();
-
-        sleep_overshoot_logger.reset();
+        capture_scheduler_t scheduler {delay, sleep_overshoot_logger};
 
         while (true) {
-          auto now = std::chrono::steady_clock::now();
-
-          if (next_frame > now) {
-            std::this_thread::sleep_for(next_frame - now);
-            sleep_overshoot_logger.first_point(next_frame);
-            sleep_overshoot_logger.second_point_now_and_log();
-          }
-
-          next_frame += delay;
-          if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
-            next_frame = now + delay;
-          }
+          scheduler.wait_for_next_frame();
 
           std::shared_ptr<platf::img_t> img_out;
           auto status = snapshot(pull_free_image_cb, img_out, 1000ms, *cursor);
@@ -1218,7 +1214,7 @@ namespace platf {
         return std::make_unique<avcodec_encode_device_t>();
       }
 
-      void blend_cursor(img_t &img) {
+      void blend_cursor(img_t &img, const cursor_t &frame_cursor) {
         // TODO: Cursor scaling is not supported in this codepath.
         // We always draw the cursor at the source size.
         auto pixels = (int *) img.data;
@@ -1227,16 +1223,16 @@ namespace platf {
         int32_t screen_width = img.width;
 
         // This is the position in the target that we will start drawing the cursor
-        auto cursor_x = std::max<int32_t>(0, captured_cursor.x - img_offset_x);
-        auto cursor_y = std::max<int32_t>(0, captured_cursor.y - img_offset_y);
+        auto cursor_x = std::max<int32_t>(0, frame_cursor.x - img_offset_x);
+        auto cursor_y = std::max<int32_t>(0, frame_cursor.y - img_offset_y);
 
         // If the cursor is partially off screen, the coordinates may be negative
         // which means we will draw the top-right visible portion of the cursor only.
-        auto cursor_delta_x = cursor_x - std::max<int32_t>(-captured_cursor.src_w, captured_cursor.x - img_offset_x);
-        auto cursor_delta_y = cursor_y - std::max<int32_t>(-captured_cursor.src_h, captured_cursor.y - img_offset_y);
+        auto cursor_delta_x = cursor_x - std::max<int32_t>(-frame_cursor.src_w, frame_cursor.x - img_offset_x);
+        auto cursor_delta_y = cursor_y - std::max<int32_t>(-frame_cursor.src_h, frame_cursor.y - img_offset_y);
 
-        auto delta_height = std::min<uint32_t>(captured_cursor.src_h, std::max<int32_t>(0, screen_height - cursor_y)) - cursor_delta_y;
-        auto delta_width = std::min<uint32_t>(captured_cursor.src_w, std::max<int32_t>(0, screen_width - cursor_x)) - cursor_delta_x;
+        auto delta_height = std::min<uint32_t>(frame_cursor.src_h, std::max<int32_t>(0, screen_height - cursor_y)) - cursor_delta_y;
+        auto delta_width = std::min<uint32_t>(frame_cursor.src_w, std::max<int32_t>(0, screen_width - cursor_x)) - cursor_delta_x;
         for (auto y = 0; y < delta_height; ++y) {
           // Offset into the cursor image to skip drawing the parts of the cursor image that are off screen
           //
@@ -1244,8 +1240,8 @@ namespace platf {
           // the first element beyond the valid range of the vector. Using vector's [] operator in that
           // manner is undefined behavior (and triggers errors when using debug libc++), while doing the
           // same with an array is fine.
-          auto cursor_begin = (uint32_t *) &captured_cursor.pixels.data()[((y + cursor_delta_y) * captured_cursor.src_w + cursor_delta_x) * 4];
-          auto cursor_end = (uint32_t *) &captured_cursor.pixels.data()[((y + cursor_delta_y) * captured_cursor.src_w + delta_width + cursor_delta_x) * 4];
+          auto cursor_begin = (uint32_t *) &frame_cursor.pixels->data()[((y + cursor_delta_y) * frame_cursor.src_w + cursor_delta_x) * 4];
+          auto cursor_end = (uint32_t *) &frame_cursor.pixels->data()[((y + cursor_delta_y) * frame_cursor.src_w + delta_width + cursor_delta_x) * 4];
 
           auto pixels_begin = &pixels[(y + cursor_y) * (img.row_pitch / img.pixel_pitch) + cursor_x];
 
@@ -1293,19 +1289,16 @@ namespace platf {
         gl::ctx.GetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
         BOOST_LOG(debug) << "width and height: w "sv << w << " h "sv << h;
 
-        if (!pull_free_image_cb(img_out)) {
-          return platf::capture_e::interrupted;
-        }
-
-        gl::ctx.GetTextureSubImage(rgb->tex[0], 0, img_offset_x, img_offset_y, 0, width, height, 1, GL_BGRA, GL_UNSIGNED_BYTE, img_out->height * img_out->row_pitch, img_out->data);
-
-        img_out->frame_timestamp = frame_timestamp;
-
+        // The cursor is drawn once this frame is delivered, as it was when the frame was captured
+        egl::readback_t::finish_t finish;
         if (cursor && captured_cursor.visible) {
-          blend_cursor(*img_out);
+          finish = [this, frame_cursor = captured_cursor](platf::img_t &img) {
+            blend_cursor(img, frame_cursor);
+          };
         }
 
-        return capture_e::ok;
+        // Deliver the previous frame and leave the copy of this one in flight
+        return readback.exchange(rgb->tex[0], img_offset_x, img_offset_y, frame_timestamp, pull_free_image_cb, img_out, timeout, std::move(finish));
       }
 
       std::shared_ptr<img_t> alloc_img() override {
@@ -1326,6 +1319,7 @@ namespace platf {
       gbm::gbm_t gbm;
       egl::display_t display;
       egl::ctx_t ctx;
+      egl::readback_t readback;
     };
 
     class display_vram_t: public display_t {
@@ -1372,23 +1366,10 @@ namespace platf {
       }
 
       capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) {
-        auto next_frame = std::chrono::steady_clock::now();
-
-        sleep_overshoot_logger.reset();
+        capture_scheduler_t scheduler {delay, sleep_overshoot_logger};
 
         while (true) {
-          auto now = std::chrono::steady_clock::now();
-
-          if (next_frame > now) {
-            std::this_thread::sleep_for(next_frame - now);
-            sleep_overshoot_logger.first_point(next_frame);
-            sleep_overshoot_logger.second_point_now_and_log();
-          }
-
-          next_frame += delay;
-          if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
-            next_frame = now + delay;
-          }
+          scheduler.wait_for_next_frame();
 
           std::shared_ptr<platf::img_t> img_out;
           auto status = snapshot(pull_free_image_cb, img_out, 1000ms, *cursor);
@@ -1435,7 +1416,7 @@ namespace platf {
         if (cursor && captured_cursor.visible) {
           // Copy new cursor pixel data if it's been updated
           if (img->serial != captured_cursor.serial) {
-            img->buffer = captured_cursor.pixels;
+            img->buffer = *captured_cursor.pixels;
             img->serial = captured_cursor.serial;
           }
 
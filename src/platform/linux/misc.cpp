@@ -9,8 +9,11 @@
 #endif
 
 // standard includes
+#include <algorithm>
+#include <ctime>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 // platform includes
 #include <arpa/inet.h>
@@ -18,6 +21,7 @@
 #include <ifaddrs.h>
 #include <netinet/udp.h>
 #include <pwd.h>
+#include <sys/utsname.h>
 
 // lib includes
 #include <boost/asio/ip/address.hpp>
@@ -943,6 +947,55 @@ std::string get_local_ip_for_gateway() {
     return true;
   }
 
+  namespace {
+    std::string read_first_line(const fs::path &path) {
+      std::ifstream in {path};
+
+      std::string line;
+      std::getline(in, line);
+
+      return line;
+    }
+  }  // namespace
+
+  std::string gpu_fingerprint() {
+    std::stringstream ss;
+
+    // In-tree GPU drivers are versioned with the kernel
+    utsname uts;
+    if (!uname(&uts)) {
+      ss << uts.release << '\n';
+    }
+
+    std::error_code ec;
+    std::vector<fs::path> cards;
+    for (auto &entry : fs::directory_iterator {"/sys/class/drm", ec}) {
+      auto name = entry.path().filename().string();
+
+      // Skip the connectors, e.g. card0-HDMI-A-1
+      if (name.starts_with("card"sv) && name.find('-') == std::string::npos) {
+        cards.emplace_back(entry.path());
+      }
+    }
+    std::sort(std::begin(cards), std::end(cards));
+
+    for (auto &card : cards) {
+      auto device = card / "device";
+      auto driver = fs::read_symlink(device / "driver", ec).filename().string();
+
+      ss << card.filename().string() << ' '
+         << read_first_line(device / "vendor") << ' '
+         << read_first_line(device / "device") << ' '
+         << driver << ' '
+         << read_first_line(fs::path {"/sys/module"} / driver / "version") << '\n';
+    }
+
+    // The NVIDIA userspace driver is always updated together with its kernel module
+    ss << read_first_line("/proc/driver/nvidia/version");
+
+    return ss.str();
+  }
+
   std::shared_ptr<display_t> display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config) {
 #ifdef AQUA_BUILD_CUDA
     if (sources[source::NVFBC] && hwdevice_type == mem_type_e::cuda) {
@@ -1042,7 +1095,19 @@ std::string get_local_ip_for_gateway() {
   class linux_high_precision_timer: public high_precision_timer {
   public:
     void sleep_for(const std::chrono::nanoseconds &duration) override {
-      std::this_thread::sleep_for(duration);
+      sleep_until(std::chrono::steady_clock::now() + duration);
+    }
+
+    void sleep_until(const std::chrono::steady_clock::time_point &deadline) override {
+      // std::chrono::steady_clock is backed by CLOCK_MONOTONIC, so its epoch can be handed to clock_nanosleep() directly.
+      // An absolute deadline keeps wake up latency and signal interruptions from pushing the deadline further out.
+      auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+
+      timespec ts;
+      ts.tv_sec = since_epoch.count() / 1'000'000'000;
+      ts.tv_nsec = since_epoch.count() % 1'000'000'000;
+
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
     }
 
     operator bool() override {
@@ -6,6 +6,7 @@
 #include <thread>
 
 // local includes
+#include "capture_scheduler.h"
 #include "cuda.h"
 #include "src/logging.h"
 #include "src/platform/common.h"
@@ -125,23 +126,10 @@ namespace wl {
   class wlr_ram_t: public wlr_t {
   public:
     platf::capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
-      auto next_frame = std::chrono::steady_clock::now();
-
-      sleep_overshoot_logger.reset();
+      platf::capture_scheduler_t scheduler {delay, sleep_overshoot_logger};
 
       while (true) {
-        auto now = std::chrono::steady_clock::now();
-
-        if (next_frame > now) {
-          std::this_thread::sleep_for(next_frame - now);
-          sleep_overshoot_logger.first_point(next_frame);
-          sleep_overshoot_logger.second_point_now_and_log();
-        }
-
-        next_frame += delay;
-        if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
-          next_frame = now + delay;
-        }
+        scheduler.wait_for_next_frame();
 
         std::shared_ptr<platf::img_t> img_out;
         auto status = snapshot(pull_free_image_cb, img_out, 1000ms, *cursor);
@@ -171,6 +159,15 @@ namespace wl {
 
     platf::capture_e snapshot(const pull_free_image_cb_t &pull_free_image_cb, std::shared_ptr<platf::img_t> &img_out, std::chrono::milliseconds timeout, bool cursor) {
       auto status = wlr_t::snapshot(pull_free_image_cb, img_out, timeout, cursor);
+      if (status == platf::capture_e::timeout && readback.in_flight()) {
+        // No new frame, deliver the one still held back in the readback ring
+        if (!pull_free_image_cb(img_out)) {
+          return platf::capture_e::interrupted;
+        }
+
+        return readback.retrieve(*img_out, timeout);
+      }
+
       if (status != platf::capture_e::ok) {
         return status;
       }
@@ -183,10 +180,6 @@ namespace wl {
         return platf::capture_e::reinit;
       }
 
-      if (!pull_free_image_cb(img_out)) {
-        return platf::capture_e::interrupted;
-      }
-
       gl::ctx.BindTexture(GL_TEXTURE_2D, (*rgb_opt)->tex[0]);
 
       // Don't remove these lines, see https://github.com/LizardByte/Sunshine/issues/453
@@ -195,10 +188,10 @@ namespace wl {
       gl::ctx.GetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
       BOOST_LOG(debug) << "width and height: w "sv << w << " h "sv << h;
 
-      gl::ctx.GetTextureSubImage((*rgb_opt)->tex[0], 0, 0, 0, 0, width, height, 1, GL_BGRA, GL_UNSIGNED_BYTE, img_out->height * img_out->row_pitch, img_out->data);
       gl::ctx.BindTexture(GL_TEXTURE_2D, 0);
 
-      return platf::capture_e::ok;
+      // Deliver the previous frame and leave the copy of this one in flight
+      return readback.exchange((*rgb_opt)->tex[0], 0, 0, std::nullopt, pull_free_image_cb, img_out, timeout);
     }
 
     int init(platf::mem_type_e hwdevice_type, const std::string &display_name, const ::video::config_t &config) {
@@ -218,6 +211,13 @@ namespace wl {
 
       ctx = std::move(*ctx_opt);
 
+      auto readback_opt = egl::readback_t::make(width, height);
+      if (!readback_opt) {
+        return -1;
+      }
+
+      readback = std::move(*readback_opt);
+
       return 0;
     }
 
@@ -250,28 +250,16 @@ namespace wl {
 
     egl::display_t egl_display;
     egl::ctx_t ctx;
+    egl::readback_t readback;
   };
 
   class wlr_vram_t: public wlr_t {
   public:
     platf::capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
-      auto next_frame = std::chrono::steady_clock::now();
-
-      sleep_overshoot_logger.reset();
+      platf::capture_scheduler_t scheduler {delay, sleep_overshoot_logger};
 
       while (true) {
-        auto now = std::chrono::steady_clock::now();
-
-        if (next_frame > now) {
-          std::this_thread::sleep_for(next_frame - now);
-          sleep_overshoot_logger.first_point(next_frame);
-          sleep_overshoot_logger.second_point_now_and_log();
-        }
-
-        next_frame += delay;
-        if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
-          next_frame = now + delay;
-        }
+        scheduler.wait_for_next_frame();
 
         std::shared_ptr<platf::img_t> img_out;
         auto status = snapshot(pull_free_image_cb, img_out, 1000ms, *cursor);
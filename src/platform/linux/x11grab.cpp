@@ -3,12 +3,14 @@
  * @brief Definitions for x11 capture.
  */
 // standard includes
+#include <deque>
 #include <fstream>
 #include <thread>
 
 // plaform includes
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xfixes.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/X.h>
@@ -18,6 +20,7 @@
 #include <xcb/xfixes.h>
 
 // local includes
+#include "capture_scheduler.h"
 #include "cuda.h"
 #include "graphics.h"
 #include "misc.h"
@@ -49,6 +52,8 @@ namespace platf {
     _FN(CloseDisplay, int, (Display * display));
     _FN(Free, int, (void *data));
     _FN(InitThreads, Status, (void) );
+    _FN(Pending, int, (Display * display));
+    _FN(NextEvent, int, (Display * display, XEvent *event_return));
 
     namespace rr {
       _FN(GetScreenResources, XRRScreenResources *, (Display * dpy, Window window));
@@ -94,6 +99,9 @@ namespace platf {
 
     namespace fix {
       _FN(GetCursorImage, XFixesCursorImage *, (Display * dpy));
+      _FN(CreateRegion, XserverRegion, (Display * dpy, XRectangle *rectangles, int nrectangles));
+      _FN(DestroyRegion, void, (Display * dpy, XserverRegion region));
+      _FN(FetchRegion, XRectangle *, (Display * dpy, XserverRegion region, int *nrectanglesRet));
 
       static int init() {
         static void *handle {nullptr};
@@ -112,6 +120,9 @@ namespace platf {
 
         std::vector<std::tuple<dyn::apiproc *, const char *>> funcs {
           {(dyn::apiproc *) &GetCursorImage, "XFixesGetCursorImage"},
+          {(dyn::apiproc *) &CreateRegion, "XFixesCreateRegion"},
+          {(dyn::apiproc *) &DestroyRegion, "XFixesDestroyRegion"},
+          {(dyn::apiproc *) &FetchRegion, "XFixesFetchRegion"},
         };
 
         if (dyn::load(handle, funcs)) {
@@ -123,6 +134,43 @@ namespace platf {
       }
     }  // namespace fix
 
+    namespace damage {
+      _FN(QueryExtension, Bool, (Display * dpy, int *event_base_return, int *error_base_return));
+      _FN(Create, Damage, (Display * dpy, Drawable drawable, int level));
+      _FN(Destroy, void, (Display * dpy, Damage damage));
+      _FN(Subtract, void, (Display * dpy, Damage damage, XserverRegion repair, XserverRegion parts));
+
+      static int init() {
+        static void *handle {nullptr};
+        static bool funcs_loaded = false;
+
+        if (funcs_loaded) {
+          return 0;
+        }
+
+        if (!handle) {
+          handle = dyn::handle({"libXdamage.so.1", "libXdamage.so"});
+          if (!handle) {
+            return -1;
+          }
+        }
+
+        std::vector<std::tuple<dyn::apiproc *, const char *>> funcs {
+          {(dyn::apiproc *) &QueryExtension, "XDamageQueryExtension"},
+          {(dyn::apiproc *) &Create, "XDamageCreate"},
+          {(dyn::apiproc *) &Destroy, "XDamageDestroy"},
+          {(dyn::apiproc *) &Subtract, "XDamageSubtract"},
+        };
+
+        if (dyn::load(handle, funcs)) {
+          return -1;
+        }
+
+        funcs_loaded = true;
+        return 0;
+      }
+    }  // namespace damage
+
     static int init() {
       static void *handle {nullptr};
       static bool funcs_loaded = false;
@@ -145,6 +193,8 @@ namespace platf {
         {(dyn::apiproc *) &Free, "XFree"},
         {(dyn::apiproc *) &CloseDisplay, "XCloseDisplay"},
         {(dyn::apiproc *) &InitThreads, "XInitThreads"},
+        {(dyn::apiproc *) &Pending, "XPending"},
+        {(dyn::apiproc *) &NextEvent, "XNextEvent"},
       };
 
       if (dyn::load(handle, funcs)) {
@@ -242,12 +292,14 @@ namespace platf {
 
   void freeImage(XImage *);
   void freeX(XFixesCursorImage *);
+  void freeRects(XRectangle *);
 
   using xcb_connect_t = util::dyn_safe_ptr<xcb_connection_t, &xcb::disconnect>;
   using xcb_img_t = util::c_ptr<xcb_shm_get_image_reply_t>;
 
   using ximg_t = util::safe_ptr<XImage, freeImage>;
   using xcursor_t = util::safe_ptr<XFixesCursorImage, freeX>;
+  using xrects_t = util::safe_ptr<XRectangle, freeRects>;
 
   using crtc_info_t = util::dyn_safe_ptr<_XRRCrtcInfo, &x11::rr::FreeCrtcInfo>;
   using output_info_t = util::dyn_safe_ptr<_XRROutputInfo, &x11::rr::FreeOutputInfo>;
@@ -311,37 +363,35 @@ namespace platf {
       delete[] data;
       data = nullptr;
     }
-  };
 
-  static void blend_cursor(Display *display, img_t &img, int offsetX, int offsetY) {
-    xcursor_t overlay {x11::fix::GetCursorImage(display)};
-
-    if (!overlay) {
-      BOOST_LOG(error) << "Couldn't get cursor from XFixesGetCursorImage"sv;
-      return;
-    }
-
-    overlay->x -= overlay->xhot;
-    overlay->y -= overlay->yhot;
+    // Sequence number of the frame the image was last filled with, 0 if unknown.
+    // Unlike damage_sequence, it survives the image going back to the pool.
+    std::uint64_t frame_sequence = 0;
+  };
 
-    overlay->x -= offsetX;
-    overlay->y -= offsetY;
+  /**
+   * @brief Blend the cursor into the image.
+   * @return The area of the image covered by the cursor, if any.
+   */
+  static std::optional<img_rect_t> blend_cursor(const XFixesCursorImage &overlay, img_t &img, int offsetX, int offsetY) {
+    short overlay_x = overlay.x - overlay.xhot - offsetX;
+    short overlay_y = overlay.y - overlay.yhot - offsetY;
 
-    overlay->x = std::max((short) 0, overlay->x);
-    overlay->y = std::max((short) 0, overlay->y);
+    overlay_x = std::max((short) 0, overlay_x);
+    overlay_y = std::max((short) 0, overlay_y);
 
     auto pixels = (int *) img.data;
 
     auto screen_height = img.height;
     auto screen_width = img.width;
 
-    auto delta_height = std::min<uint16_t>(overlay->height, std::max(0, screen_height - overlay->y));
-    auto delta_width = std::min<uint16_t>(overlay->width, std::max(0, screen_width - overlay->x));
+    auto delta_height = std::min<uint16_t>(overlay.height, std::max(0, screen_height - overlay_y));
+    auto delta_width = std::min<uint16_t>(overlay.width, std::max(0, screen_width - overlay_x));
     for (auto y = 0; y < delta_height; ++y) {
-      auto overlay_begin = &overlay->pixels[y * overlay->width];
-      auto overlay_end = &overlay->pixels[y * overlay->width + delta_width];
+      auto overlay_begin = &overlay.pixels[y * overlay.width];
+      auto overlay_end = &overlay.pixels[y * overlay.width + delta_width];
 
-      auto pixels_begin = &pixels[(y + overlay->y) * (img.row_pitch / img.pixel_pitch) + overlay->x];
+      auto pixels_begin = &pixels[(y + overlay_y) * (img.row_pitch / img.pixel_pitch) + overlay_x];
 
       std::for_each(overlay_begin, overlay_end, [&](long pixel) {
         int *pixel_p = (int *) &pixel;
@@ -360,8 +410,264 @@ namespace platf {
         ++pixels_begin;
       });
     }
+
+    if (!delta_height || !delta_width) {
+      return std::nullopt;
+    }
+
+    return img_rect_t {overlay_x, overlay_y, delta_width, delta_height};
+  }
+
+  static void blend_cursor(Display *display, img_t &img, int offsetX, int offsetY) {
+    xcursor_t overlay {x11::fix::GetCursorImage(display)};
+
+    if (!overlay) {
+      BOOST_LOG(error) << "Couldn't get cursor from XFixesGetCursorImage"sv;
+      return;
+    }
+
+    blend_cursor(*overlay, img, offsetX, offsetY);
+  }
+
+  /**
+   * @brief The smallest rectangle covering all of the given rectangles.
+   */
+  static img_rect_t bounding_rect(const std::vector<img_rect_t> &rects) {
+    auto bounds = rects.front();
+    for (auto &rect : rects) {
+      auto right = std::max(bounds.x + bounds.width, rect.x + rect.width);
+      auto bottom = std::max(bounds.y + bounds.height, rect.y + rect.height);
+      bounds.x = std::min(bounds.x, rect.x);
+      bounds.y = std::min(bounds.y, rect.y);
+      bounds.width = right - bounds.x;
+      bounds.height = bottom - bounds.y;
+    }
+
+    return bounds;
   }
 
+  /**
+   * @brief Copy a rectangle of 32-bit pixels between two buffers.
+   * @param src Start of the rectangle in the source.
+   * @param dst Start of the rectangle in the destination.
+   */
+  static void copy_rect(const std::uint8_t *src, int src_pitch, std::uint8_t *dst, int dst_pitch, const img_rect_t &rect) {
+    for (int y = 0; y < rect.height; ++y) {
+      std::copy_n(src + y * src_pitch, rect.width * 4, dst + y * dst_pitch);
+    }
+  }
+
+  /**
+   * @brief Tracks the parts of the captured area that changed between snapshots using the XDamage extension.
+   * @details The damage is tracked on a dedicated X connection, since the DamageNotify events
+   *          it generates have to be drained by the thread that fetches the damage.
+   */
+  class damage_tracker_t {
+  public:
+    // Beyond this many rectangles, a single bounding rectangle is cheaper to copy than the individual ones
+    static constexpr std::size_t max_rects = 16;
+
+    ~damage_tracker_t() {
+      if (region) {
+        x11::fix::DestroyRegion(xdisplay.get(), region);
+      }
+      if (damage) {
+        x11::damage::Destroy(xdisplay.get(), damage);
+      }
+    }
+
+    /**
+     * @brief Start tracking damage of the captured area.
+     * @return 0 on success, -1 if damage tracking is unavailable.
+     */
+    int init(int offset_x, int offset_y, int width, int height) {
+      area = {offset_x, offset_y, width, height};
+
+      if (x11::damage::init()) {
+        BOOST_LOG(info) << "libXdamage is unavailable, capturing full frames"sv;
+        return -1;
+      }
+
+      xdisplay.reset(x11::OpenDisplay(nullptr));
+      if (!xdisplay) {
+        return -1;
+      }
+
+      int event_base, error_base;
+      if (!x11::damage::QueryExtension(xdisplay.get(), &event_base, &error_base)) {
+        BOOST_LOG(info) << "X server lacks the DAMAGE extension, capturing full frames"sv;
+        return -1;
+      }
+
+      damage = x11::damage::Create(xdisplay.get(), DefaultRootWindow(xdisplay.get()), XDamageReportNonEmpty);
+      region = x11::fix::CreateRegion(xdisplay.get(), nullptr, 0);
+      if (!damage || !region) {
+        return -1;
+      }
+
+      return 0;
+    }
+
+    /**
+     * @brief Fetch and clear the damage accumulated since the previous call.
+     * @param rects Receives the damaged rectangles relative to the captured area.
+     */
+    void fetch(std::vector<img_rect_t> &rects) {
+      rects.clear();
+
+      // The events only signal that damage is pending, the damage itself is read from the region below
+      while (x11::Pending(xdisplay.get())) {
+        XEvent event;
+        x11::NextEvent(xdisplay.get(), &event);
+      }
+
+      x11::damage::Subtract(xdisplay.get(), damage, None, region);
+
+      int count = 0;
+      xrects_t x_rects {x11::fix::FetchRegion(xdisplay.get(), region, &count)};
+      for (int x = 0; x < count; ++x) {
+        auto &x_rect = x_rects.get()[x];
+
+        auto left = std::max<int>(x_rect.x, area.x);
+        auto top = std::max<int>(x_rect.y, area.y);
+        auto right = std::min<int>(x_rect.x + x_rect.width, area.x + area.width);
+        auto bottom = std::min<int>(x_rect.y + x_rect.height, area.y + area.height);
+
+        if (left < right && top < bottom) {
+          rects.emplace_back(img_rect_t {left - area.x, top - area.y, right - left, bottom - top});
+        }
+      }
+
+      if (rects.size() > max_rects) {
+        rects.assign(1, bounding_rect(rects));
+      }
+    }
+
+  private:
+    x11::xdisplay_t xdisplay;
+    Damage damage {};
+    XserverRegion region {};
+    img_rect_t area {};
+  };
+
+  /**
+   * @brief Decides whether a snapshot can be skipped and which parts of the frame it has to refresh.
+   */
+  struct damage_state_t {
+    // Frames handed out recently whose damage is remembered, to bring pooled images up to date
+    static constexpr std::size_t max_history = 8;
+
+    /**
+     * @brief What changed in a frame that was handed out.
+     */
+    struct frame_t {
+      std::uint64_t sequence;
+      std::vector<img_rect_t> rects;  ///< Screen regions that changed since the previous frame.
+      std::optional<img_rect_t> cursor_rect;  ///< Area the cursor was blended into.
+    };
+
+    damage_tracker_t tracker;
+    bool enabled = false;
+
+    // Sequence number of the last frame handed out, 0 before the first frame
+    std::uint64_t sequence = 0;
+
+    // Regions that changed since the previous call to collect()
+    std::vector<img_rect_t> rects;
+
+    // Regions that changed since the last frame handed out. They are kept
+    // when a frame can't be handed out, so they end up in the next one.
+    std::vector<img_rect_t> pending;
+
+    // Position and shape of the cursor at the last call to collect(), and whether
+    // it differs from the last frame handed out
+    std::optional<std::tuple<short, short, unsigned long>> cursor_state;
+    bool cursor_changed = false;
+
+    std::deque<frame_t> history;
+
+    void init(int offset_x, int offset_y, int width, int height) {
+      enabled = !tracker.init(offset_x, offset_y, width, height);
+    }
+
+    /**
+     * @brief Collect the damage for the next frame.
+     * @param overlay The current cursor image or `nullptr` if the cursor isn't captured.
+     * @return `false` if neither the screen content nor the cursor changed.
+     */
+    bool collect(const XFixesCursorImage *overlay) {
+      tracker.fetch(rects);
+
+      pending.insert(std::end(pending), std::begin(rects), std::end(rects));
+      if (pending.size() > damage_tracker_t::max_rects) {
+        pending.assign(1, bounding_rect(pending));
+      }
+
+      std::optional<std::tuple<short, short, unsigned long>> state;
+      if (overlay) {
+        state = std::make_tuple(overlay->x, overlay->y, overlay->cursor_serial);
+      }
+
+      cursor_changed = cursor_changed || state != cursor_state;
+      cursor_state = state;
+
+      return sequence == 0 || !pending.empty() || cursor_changed;
+    }
+
+    /**
+     * @brief Regions of an image filled with an earlier frame that differ from the next frame.
+     * @details Covers the screen damage of all frames handed out since, and the cursor blended into the image.
+     * @param frame_sequence Sequence number of the frame the image holds.
+     * @return The regions to refresh, or std::nullopt if the whole image has to be refreshed.
+     */
+    std::optional<std::vector<img_rect_t>> stale_rects(std::uint64_t frame_sequence) const {
+      if (!frame_sequence || history.empty() || frame_sequence < history.front().sequence || frame_sequence > sequence) {
+        return std::nullopt;
+      }
+
+      auto frame = std::begin(history) + (frame_sequence - history.front().sequence);
+
+      std::vector<img_rect_t> stale = pending;
+      if (frame->cursor_rect) {
+        stale.emplace_back(*frame->cursor_rect);
+      }
+      for (++frame; frame != std::end(history); ++frame) {
+        stale.insert(std::end(stale), std::begin(frame->rects), std::end(frame->rects));
+      }
+
+      return stale;
+    }
+
+    /**
+     * @brief Attach the collected damage to a captured image.
+     * @param new_cursor_rect The area the cursor was blended into, if any.
+     */
+    void apply(img_t &img, const std::optional<img_rect_t> &new_cursor_rect) {
+      img.damage.clear();
+      if (sequence != 0) {
+        img.damage = pending;
+
+        // The old cursor location must be restored, and the new one has to be drawn
+        auto old_cursor_rect = history.empty() ? std::nullopt : history.back().cursor_rect;
+        for (auto &rect : {old_cursor_rect, new_cursor_rect}) {
+          if (rect) {
+            img.damage.emplace_back(*rect);
+          }
+        }
+      }
+
+      img.damage_sequence = ++sequence;
+
+      history.push_back({sequence, std::move(pending), new_cursor_rect});
+      if (history.size() > max_history) {
+        history.pop_front();
+      }
+
+      pending.clear();
+      cursor_changed = false;
+    }
+  };
+
   struct x11_attr_t: public display_t {
     std::chrono::nanoseconds delay;
 
@@ -371,6 +677,8 @@ namespace platf {
 
     mem_type_e mem_type;
 
+    damage_state_t damage;
+
     /**
      * Last X (NOT the streamed monitor!) size.
      * This way we can trigger reinitialization if the dimensions changed while streaming
@@ -446,6 +754,8 @@ namespace platf {
       env_width = xattr.width;
       env_height = xattr.height;
 
+      damage.init(offset_x, offset_y, width, height);
+
       return 0;
     }
 
@@ -457,23 +767,10 @@ namespace platf {
     }
 
     capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
-      auto next_frame = std::chrono::steady_clock::now();
-
-      sleep_overshoot_logger.reset();
+      capture_scheduler_t scheduler {delay, sleep_overshoot_logger};
 
       while (true) {
-        auto now = std::chrono::steady_clock::now();
-
-        if (next_frame > now) {
-          std::this_thread::sleep_for(next_frame - now);
-          sleep_overshoot_logger.first_point(next_frame);
-          sleep_overshoot_logger.second_point_now_and_log();
-        }
-
-        next_frame += delay;
-        if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
-          next_frame = now + delay;
-        }
+        scheduler.wait_for_next_frame();
 
         std::shared_ptr<platf::img_t> img_out;
         auto status = snapshot(pull_free_image_cb, img_out, 1000ms, *cursor);
@@ -510,28 +807,53 @@ namespace platf {
         return capture_e::reinit;
       }
 
+      xcursor_t overlay;
+      if (cursor) {
+        overlay.reset(x11::fix::GetCursorImage(xdisplay.get()));
+        if (!overlay) {
+          BOOST_LOG(error) << "Couldn't get cursor from XFixesGetCursorImage"sv;
+        }
+      }
+
+      // Skip the capture if neither the screen nor the cursor changed since the last frame
+      if (damage.enabled && !damage.collect(overlay.get())) {
+        return capture_e::timeout;
+      }
+
       if (!pull_free_image_cb(img_out)) {
         return platf::capture_e::interrupted;
       }
       auto img = (x11_img_t *) img_out.get();
 
-      XImage *x_img {x11::GetImage(xdisplay.get(), xwindow, offset_x, offset_y, width, height, AllPlanes, ZPixmap)};
-      img->frame_timestamp = std::chrono::steady_clock::now();
+      grab(*img);
 
-      img->width = x_img->width;
-      img->height = x_img->height;
-      img->data = (uint8_t *) x_img->data;
-      img->row_pitch = x_img->bytes_per_line;
-      img->pixel_pitch = x_img->bits_per_pixel / 8;
-      img->img.reset(x_img);
+      std::optional<img_rect_t> cursor_rect;
+      if (overlay) {
+        cursor_rect = blend_cursor(*overlay, *img, offset_x, offset_y);
+      }
 
-      if (cursor) {
-        blend_cursor(xdisplay.get(), *img, offset_x, offset_y);
+      if (damage.enabled) {
+        damage.apply(*img, cursor_rect);
       }
 
       return capture_e::ok;
     }
 
+    /**
+     * @brief Read the whole captured area into the image.
+     */
+    void grab(x11_img_t &img) {
+      XImage *x_img {x11::GetImage(xdisplay.get(), xwindow, offset_x, offset_y, width, height, AllPlanes, ZPixmap)};
+      img.frame_timestamp = std::chrono::steady_clock::now();
+
+      img.width = x_img->width;
+      img.height = x_img->height;
+      img.data = (uint8_t *) x_img->data;
+      img.row_pitch = x_img->bytes_per_line;
+      img.pixel_pitch = x_img->bits_per_pixel / 8;
+      img.img.reset(x_img);
+    }
+
     std::shared_ptr<img_t> alloc_img() override {
       return std::make_shared<x11_img_t>();
     }
@@ -557,12 +879,10 @@ namespace platf {
       if (!img) {
         return -1;
       };
-      auto pull_dummy_img_callback = [&img](std::shared_ptr<platf::img_t> &img_out) -> bool {
-        img_out = img->shared_from_this();
-        return true;
-      };
-      std::shared_ptr<platf::img_t> img_out;
-      snapshot(pull_dummy_img_callback, img_out, 0s, true);
+
+      // Bypass snapshot(), the dummy image must neither be skipped nor consume the damage of the next frame
+      grab(*(x11_img_t *) img);
+      blend_cursor(xdisplay.get(), *img, offset_x, offset_y);
       return 0;
     }
   };
@@ -577,6 +897,9 @@ namespace platf {
 
     shm_data_t data;
 
+    // Persistent copy of the captured area without the cursor, only the damaged parts of it are refreshed
+    std::vector<std::uint8_t> frame;
+
     task_pool_util::TaskPool::task_id_t refresh_task_id;
 
     void delayed_refresh() {
@@ -596,23 +919,10 @@ namespace platf {
     }
 
     capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
-      auto next_frame = std::chrono::steady_clock::now();
-
-      sleep_overshoot_logger.reset();
+      capture_scheduler_t scheduler {delay, sleep_overshoot_logger};
 
       while (true) {
-        auto now = std::chrono::steady_clock::now();
-
-        if (next_frame > now) {
-          std::this_thread::sleep_for(next_frame - now);
-          sleep_overshoot_logger.first_point(next_frame);
-          sleep_overshoot_logger.second_point_now_and_log();
-        }
-
-        next_frame += delay;
-        if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
-          next_frame = now + delay;
-        }
+        scheduler.wait_for_next_frame();
 
         std::shared_ptr<platf::img_t> img_out;
         auto status = snapshot(pull_free_image_cb, img_out, 1000ms, *cursor);
@@ -645,7 +955,17 @@ namespace platf {
       if (xattr.width != env_width || xattr.height != env_height) {
         BOOST_LOG(warning) << "X dimensions changed in SHM mode, request reinit"sv;
         return capture_e::reinit;
-      } else {
+      }
+
+      xcursor_t overlay;
+      if (cursor) {
+        overlay.reset(x11::fix::GetCursorImage(shm_xdisplay.get()));
+        if (!overlay) {
+          BOOST_LOG(error) << "Couldn't get cursor from XFixesGetCursorImage"sv;
+        }
+      }
+
+      if (!damage.enabled) {
         auto img_cookie = xcb::shm_get_image_unchecked(xcb.get(), display->root, offset_x, offset_y, width, height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, seg, 0);
         auto frame_timestamp = std::chrono::steady_clock::now();
 
@@ -662,12 +982,73 @@ namespace platf {
         std::copy_n((std::uint8_t *) data.data, frame_size(), img_out->data);
         img_out->frame_timestamp = frame_timestamp;
 
-        if (cursor) {
-          blend_cursor(shm_xdisplay.get(), *img_out, offset_x, offset_y);
+        if (overlay) {
+          blend_cursor(*overlay, *img_out, offset_x, offset_y);
         }
 
         return capture_e::ok;
       }
+
+      // Skip the capture if neither the screen nor the cursor changed since the last frame
+      if (!damage.collect(overlay.get())) {
+        return capture_e::timeout;
+      }
+
+      // The first frame has to be read in full
+      std::vector<img_rect_t> full_frame {{0, 0, width, height}};
+      const auto &rects = damage.sequence == 0 ? full_frame : damage.rects;
+
+      // Damaged rectangles don't overlap, so they can be read into the SHM segment
+      // back to back with all requests in flight at the same time.
+      std::vector<xcb_shm_get_image_cookie_t> img_cookies;
+      std::uint32_t shm_offset = 0;
+      for (const auto &rect : rects) {
+        img_cookies.emplace_back(xcb::shm_get_image_unchecked(xcb.get(), display->root, offset_x + rect.x, offset_y + rect.y, rect.width, rect.height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, seg, shm_offset));
+        shm_offset += rect.width * rect.height * 4;
+      }
+      auto frame_timestamp = std::chrono::steady_clock::now();
+
+      for (auto &img_cookie : img_cookies) {
+        xcb_img_t img_reply {xcb::shm_get_image_reply(xcb.get(), img_cookie, nullptr)};
+        if (!img_reply) {
+          BOOST_LOG(error) << "Could not get image reply"sv;
+          return capture_e::reinit;
+        }
+      }
+
+      shm_offset = 0;
+      const auto row_pitch = width * 4;
+      for (const auto &rect : rects) {
+        copy_rect((std::uint8_t *) data.data + shm_offset, rect.width * 4, frame.data() + rect.y * row_pitch + rect.x * 4, row_pitch, rect);
+        shm_offset += rect.width * rect.height * 4;
+      }
+
+      // The collected damage stays pending, so the next frame still covers it
+      if (!pull_free_image_cb(img_out)) {
+        return platf::capture_e::interrupted;
+      }
+
+      // Pooled images only miss what changed since they were handed out last
+      auto img = (shm_img_t *) img_out.get();
+      if (auto stale = damage.stale_rects(img->frame_sequence)) {
+        for (const auto &rect : *stale) {
+          auto offset = rect.y * row_pitch + rect.x * 4;
+          copy_rect(frame.data() + offset, row_pitch, img->data + offset, img->row_pitch, rect);
+        }
+      } else {
+        std::copy_n(frame.data(), frame_size(), img_out->data);
+      }
+      img_out->frame_timestamp = frame_timestamp;
+
+      std::optional<img_rect_t> cursor_rect;
+      if (overlay) {
+        cursor_rect = blend_cursor(*overlay, *img_out, offset_x, offset_y);
+      }
+
+      damage.apply(*img_out, cursor_rect);
+      img->frame_sequence = img_out->damage_sequence;
+
+      return capture_e::ok;
     }
 
     std::shared_ptr<img_t> alloc_img() override {
@@ -721,6 +1102,10 @@ namespace platf {
         return -1;
       }
 
+      if (damage.enabled) {
+        frame.resize(frame_size());
+      }
+
       return 0;
     }
 
@@ -808,6 +1193,10 @@ namespace platf {
     x11::Free(p);
   }
 
+  void freeRects(XRectangle *p) {
+    x11::Free(p);
+  }
+
   int load_xcb() {
     // This will be called once only
     static int xcb_status = xcb::init_shm() || xcb::init();
@@ -2,6 +2,9 @@
  * @file src/platform/macos/display.mm
  * @brief Definitions for display capture on macOS.
  */
+// platform includes
+#include <sys/sysctl.h>
+
 // local includes
 #include "src/config.h"
 #include "src/logging.h"
@@ -215,4 +218,18 @@ namespace platf {
     // We don't track GPU state, so we will always reenumerate. Fortunately, it is fast on macOS.
     return true;
   }
+
+  std::string gpu_fingerprint() {
+    // GPU drivers ship with the OS, so the OS build and the hardware model identify them
+    std::string fingerprint;
+    for (auto name : {"kern.osversion", "hw.model"}) {
+      char value[256] {};
+      auto size = sizeof(value);
+      if (!sysctlbyname(name, value, &size, nullptr, 0)) {
+        fingerprint.append(value).push_back('\n');
+      }
+    }
+
+    return fingerprint;
+  }
 }  // namespace platf
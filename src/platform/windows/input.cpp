@@ -292,7 +292,7 @@ namespace platf {
       auto &gamepad = gamepads[nr];
 
       if (gamepad.repeat_task) {
-        task_pool.cancel(gamepad.repeat_task);
+        input_pool.cancel(gamepad.repeat_task);
         gamepad.repeat_task = 0;
       }
 
@@ -413,7 +413,7 @@ namespace platf {
       << "largeMotor: "sv << (int) largeMotor << std::endl
       << "smallMotor: "sv << (int) smallMotor;
 
-    task_pool.push(&vigem_t::rumble, (vigem_t *) userdata, target, largeMotor, smallMotor);
+    input_pool.push(&vigem_t::rumble, (vigem_t *) userdata, target, largeMotor, smallMotor);
   }
 
   void CALLBACK ds4_notify(
@@ -431,8 +431,8 @@ namespace platf {
       << util::hex(led_color.Green).to_string_view() << ' '
       << util::hex(led_color.Blue).to_string_view() << std::endl;
 
-    task_pool.push(&vigem_t::rumble, (vigem_t *) userdata, target, largeMotor, smallMotor);
-    task_pool.push(&vigem_t::set_rgb_led, (vigem_t *) userdata, target, led_color.Red, led_color.Green, led_color.Blue);
+    input_pool.push(&vigem_t::rumble, (vigem_t *) userdata, target, largeMotor, smallMotor);
+    input_pool.push(&vigem_t::set_rgb_led, (vigem_t *) userdata, target, led_color.Red, led_color.Green, led_color.Blue);
   }
 
   struct input_raw_t {
@@ -662,10 +662,10 @@ namespace platf {
 
     ~client_input_raw_t() override {
       if (penRepeatTask) {
-        task_pool.cancel(penRepeatTask);
+        input_pool.cancel(penRepeatTask);
       }
       if (touchRepeatTask) {
-        task_pool.cancel(touchRepeatTask);
+        input_pool.cancel(touchRepeatTask);
       }
 
       if (pen) {
@@ -844,7 +844,7 @@ namespace platf {
       BOOST_LOG(warning) << "Failed to refresh virtual touch input: "sv << err;
     }
 
-    raw->touchRepeatTask = task_pool.pushDelayed(repeat_touch, ISPI_REPEAT_INTERVAL, raw).task_id;
+    raw->touchRepeatTask = input_pool.pushDelayed(repeat_touch, ISPI_REPEAT_INTERVAL, raw).task_id;
   }
 
   /**
@@ -857,7 +857,7 @@ namespace platf {
       BOOST_LOG(warning) << "Failed to refresh virtual pen input: "sv << err;
     }
 
-    raw->penRepeatTask = task_pool.pushDelayed(repeat_pen, ISPI_REPEAT_INTERVAL, raw).task_id;
+    raw->penRepeatTask = input_pool.pushDelayed(repeat_pen, ISPI_REPEAT_INTERVAL, raw).task_id;
   }
 
   /**
@@ -867,7 +867,7 @@ namespace platf {
   void cancel_all_active_touches(client_input_raw_t *raw) {
     // Cancel touch repeat callbacks
     if (raw->touchRepeatTask) {
-      task_pool.cancel(raw->touchRepeatTask);
+      input_pool.cancel(raw->touchRepeatTask);
       raw->touchRepeatTask = nullptr;
     }
 
@@ -929,7 +929,7 @@ namespace platf {
 
     // Cancel touch repeat callbacks
     if (raw->touchRepeatTask) {
-      task_pool.cancel(raw->touchRepeatTask);
+      input_pool.cancel(raw->touchRepeatTask);
       raw->touchRepeatTask = nullptr;
     }
 
@@ -1016,7 +1016,7 @@ namespace platf {
 
     // If we still have an active touch, refresh the touch state periodically
     if (raw->activeTouchSlots > 1 || touchInfo.pointerInfo.pointerFlags != POINTER_FLAG_NONE) {
-      raw->touchRepeatTask = task_pool.pushDelayed(repeat_touch, ISPI_REPEAT_INTERVAL, raw).task_id;
+      raw->touchRepeatTask = input_pool.pushDelayed(repeat_touch, ISPI_REPEAT_INTERVAL, raw).task_id;
     }
   }
 
@@ -1055,7 +1055,7 @@ namespace platf {
 
     // Cancel pen repeat callbacks
     if (raw->penRepeatTask) {
-      task_pool.cancel(raw->penRepeatTask);
+      input_pool.cancel(raw->penRepeatTask);
       raw->penRepeatTask = nullptr;
     }
 
@@ -1135,7 +1135,7 @@ namespace platf {
 
     // If we still have an active pen interaction, refresh the pen state periodically
     if (penInfo.pointerInfo.pointerFlags != POINTER_FLAG_NONE) {
-      raw->penRepeatTask = task_pool.pushDelayed(repeat_pen, ISPI_REPEAT_INTERVAL, raw).task_id;
+      raw->penRepeatTask = input_pool.pushDelayed(repeat_pen, ISPI_REPEAT_INTERVAL, raw).task_id;
     }
   }
 
@@ -1451,7 +1451,7 @@ namespace platf {
 
     // Cancel any pending updates. We will requeue one here when we're finished.
     if (gamepad.repeat_task) {
-      task_pool.cancel(gamepad.repeat_task);
+      input_pool.cancel(gamepad.repeat_task);
       gamepad.repeat_task = 0;
     }
 
@@ -1471,7 +1471,7 @@ namespace platf {
 
       // Repeat at least every 100ms to keep the 16-bit timestamp field from overflowing
       gamepad.last_report_ts = now;
-      gamepad.repeat_task = task_pool.pushDelayed(ds4_update_ts_and_send, 100ms, vigem, nr).task_id;
+      gamepad.repeat_task = input_pool.pushDelayed(ds4_update_ts_and_send, 100ms, vigem, nr).task_id;
     }
   }
 
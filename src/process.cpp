@@ -5,9 +5,13 @@
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS
 
 // standard includes
+#include <atomic>
 #include <filesystem>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 // lib includes
@@ -25,10 +29,12 @@
 #include "crypto.h"
 #include "display_device.h"
 #include "file_handler.h"
+#include "globals.h"
 #include "logging.h"
 #include "platform/common.h"
 #include "process.h"
 #include "httpcommon.h"
+#include "startup_timeline.h"
 #include "system_tray.h"
 #include "utility.h"
 #include "video.h"
@@ -59,6 +65,13 @@ namespace proc {
   int terminate_app_id = -1;
   std::string terminate_app_id_str;
 
+  static std::atomic<std::uint64_t> apps_revision_counter {0};
+
+  /**
+   * @brief Guards replacing the catalog of the apps and the environment that goes with it.
+   */
+  static std::mutex catalog_mutex;
+
 #ifdef _WIN32
   VDISPLAY::DRIVER_STATUS vDisplayDriverStatus = VDISPLAY::DRIVER_STATUS::UNKNOWN;
 
@@ -78,14 +91,40 @@ namespace proc {
   }
 #endif
 
+  static std::mutex watch_mutex;
+  static bool watching = false;
+  static task_pool_util::TaskPool::task_id_t watch_task_id;
+
+  /**
+   * @brief Pick up changes to the apps file made outside the web UI, checked every second.
+   */
+  static void watch_apps_file() {
+    reload_if_changed(config::stream.file_apps);
+
+    std::lock_guard lg {watch_mutex};
+    if (watching) {
+      watch_task_id = task_pool.pushDelayed(watch_apps_file, 1s).task_id;
+    }
+  }
+
   class deinit_t: public platf::deinit_t {
   public:
     ~deinit_t() {
+      {
+        std::lock_guard lg {watch_mutex};
+        watching = false;
+        task_pool.cancel(watch_task_id);
+      }
+
       proc.terminate();
     }
   };
 
   std::unique_ptr<platf::deinit_t> init() {
+    std::lock_guard lg {watch_mutex};
+    watching = true;
+    watch_task_id = task_pool.pushDelayed(watch_apps_file, 1s).task_id;
+
     return std::make_unique<deinit_t>();
   }
 
@@ -304,6 +343,7 @@ namespace proc {
     }
 
     display_device::configure_display(config::video, *launch_session);
+    startup_timeline::mark(launch_session->id, startup_timeline::phase_e::display_configured);
 
     // We should not preserve display state when using virtual display.
     // It is already handled by Windows properly.
@@ -314,6 +354,7 @@ namespace proc {
 #else
 
     display_device::configure_display(config::video, *launch_session);
+    startup_timeline::mark(launch_session->id, startup_timeline::phase_e::display_configured);
 
 #endif
 
@@ -324,35 +365,45 @@ namespace proc {
     if (rtsp_stream::session_count() == 0 && video::probe_encoders()) {
       return 503;
     }
+    startup_timeline::mark(launch_session->id, startup_timeline::phase_e::encoders_probed);
+
+    // The app keeps the environment it was launched with, even if the apps file is reloaded
+    auto env = catalog()->env;
 
     // Add Stream-specific environment variables
-    _env["AQUA_APP_ID"] = _app.id;
-    _env["AQUA_APP_NAME"] = _app.name;
-    _env["AQUA_CLIENT_UID"] = launch_session->unique_id;
-    _env["AQUA_CLIENT_NAME"] = launch_session->device_name;
-    _env["AQUA_CLIENT_WIDTH"] = std::to_string(render_width);
-    _env["AQUA_CLIENT_HEIGHT"] = std::to_string(render_height);
-    _env["AQUA_CLIENT_RENDER_WIDTH"] = std::to_string(launch_session->width);
-    _env["AQUA_CLIENT_RENDER_HEIGHT"] = std::to_string(launch_session->height);
-    _env["AQUA_CLIENT_SCALE_FACTOR"] = std::to_string(scale_factor);
-    _env["AQUA_CLIENT_FPS"] = std::to_string(launch_session->fps);
-    _env["AQUA_CLIENT_HDR"] = launch_session->enable_hdr ? "true" : "false";
-    _env["AQUA_CLIENT_GCMAP"] = std::to_string(launch_session->gcmap);
-    _env["AQUA_CLIENT_HOST_AUDIO"] = launch_session->host_audio ? "true" : "false";
-    _env["AQUA_CLIENT_ENABLE_SOPS"] = launch_session->enable_sops ? "true" : "false";
+    env["AQUA_APP_ID"] = _app.id;
+    env["AQUA_APP_NAME"] = _app.name;
+    env["AQUA_CLIENT_UID"] = launch_session->unique_id;
+    env["AQUA_CLIENT_NAME"] = launch_session->device_name;
+    env["AQUA_CLIENT_WIDTH"] = std::to_string(render_width);
+    env["AQUA_CLIENT_HEIGHT"] = std::to_string(render_height);
+    env["AQUA_CLIENT_RENDER_WIDTH"] = std::to_string(launch_session->width);
+    env["AQUA_CLIENT_RENDER_HEIGHT"] = std::to_string(launch_session->height);
+    env["AQUA_CLIENT_SCALE_FACTOR"] = std::to_string(scale_factor);
+    env["AQUA_CLIENT_FPS"] = std::to_string(launch_session->fps);
+    env["AQUA_CLIENT_HDR"] = launch_session->enable_hdr ? "true" : "false";
+    env["AQUA_CLIENT_GCMAP"] = std::to_string(launch_session->gcmap);
+    env["AQUA_CLIENT_HOST_AUDIO"] = launch_session->host_audio ? "true" : "false";
+    env["AQUA_CLIENT_ENABLE_SOPS"] = launch_session->enable_sops ? "true" : "false";
     int channelCount = launch_session->surround_info & (65535);
     switch (channelCount) {
       case 2:
-        _env["AQUA_CLIENT_AUDIO_CONFIGURATION"] = "2.0";
+        env["AQUA_CLIENT_AUDIO_CONFIGURATION"] = "2.0";
         break;
       case 6:
-        _env["AQUA_CLIENT_AUDIO_CONFIGURATION"] = "5.1";
+        env["AQUA_CLIENT_AUDIO_CONFIGURATION"] = "5.1";
         break;
       case 8:
-        _env["AQUA_CLIENT_AUDIO_CONFIGURATION"] = "7.1";
+        env["AQUA_CLIENT_AUDIO_CONFIGURATION"] = "7.1";
         break;
     }
-    _env["AQUA_CLIENT_AUDIO_SURROUND_PARAMS"] = launch_session->surround_params;
+    env["AQUA_CLIENT_AUDIO_SURROUND_PARAMS"] = launch_session->surround_params;
+
+    {
+      std::lock_guard lg {catalog_mutex};
+      _env = std::move(env);
+      _env_in_use = true;
+    }
 
     if (!_app.output.empty() && _app.output != "null"sv) {
 #ifdef _WIN32
@@ -404,6 +455,7 @@ namespace proc {
         return -1;
       }
     }
+    startup_timeline::mark(launch_session->id, startup_timeline::phase_e::prep_commands_done);
 
     for (auto &cmd : _app.detached) {
       boost::filesystem::path working_dir = _app.working_dir.empty() ?
@@ -434,6 +486,7 @@ namespace proc {
     }
 
     _app_launch_time = std::chrono::steady_clock::now();
+    startup_timeline::mark(launch_session->id, startup_timeline::phase_e::app_started);
 
   #ifdef _WIN32
     auto resetHDRThread = std::thread([this, enable_hdr = launch_session->enable_hdr]{
@@ -637,14 +690,68 @@ namespace proc {
     _launch_session.reset();
     virtual_display = false;
     allow_client_commands = false;
+
+    {
+      std::lock_guard lg {catalog_mutex};
+      _env = _catalog->env;
+      _env_in_use = false;
+    }
   }
 
-  const std::vector<ctx_t> &proc_t::get_apps() const {
-    return _apps;
+  proc_t::proc_t(
+    boost::process::v1::environment &&env,
+    std::vector<ctx_t> &&apps
+  ):
+      _app_id(0),
+      _env(env) {
+    auto catalog = std::make_shared<catalog_t>();
+    catalog->env = std::move(env);
+    catalog->apps = std::move(apps);
+
+    for (std::size_t x = 0; x < catalog->apps.size(); ++x) {
+      catalog->app_by_id.emplace(util::from_view(catalog->apps[x].id), x);
+      catalog->app_by_uuid.emplace(catalog->apps[x].uuid, x);
+    }
+
+    _catalog = std::move(catalog);
+  }
+
+  std::shared_ptr<const catalog_t> proc_t::catalog() const {
+    std::lock_guard lg {catalog_mutex};
+
+    return _catalog;
   }
 
-  std::vector<ctx_t> &proc_t::get_apps() {
-    return _apps;
+  std::shared_ptr<const std::vector<ctx_t>> proc_t::get_apps() const {
+    auto apps = catalog();
+
+    return {apps, &apps->apps};
+  }
+
+  std::shared_ptr<const ctx_t> proc_t::find_app(int app_id) const {
+    auto apps = catalog();
+
+    auto it = apps->app_by_id.find(app_id);
+    return it == std::end(apps->app_by_id) ? nullptr : std::shared_ptr<const ctx_t> {apps, &apps->apps[it->second]};
+  }
+
+  std::shared_ptr<const ctx_t> proc_t::find_app_by_uuid(const std::string &uuid) const {
+    auto apps = catalog();
+
+    auto it = apps->app_by_uuid.find(uuid);
+    return it == std::end(apps->app_by_uuid) ? nullptr : std::shared_ptr<const ctx_t> {apps, &apps->apps[it->second]};
+  }
+
+  void proc_t::update_apps(proc_t &&loaded) {
+    auto apps = loaded.catalog();
+
+    std::lock_guard lg {catalog_mutex};
+    _catalog = std::move(apps);
+
+    // The running app keeps its environment
+    if (!_env_in_use) {
+      _env = _catalog->env;
+    }
   }
 
   // Gets application image from application list.
@@ -652,10 +759,8 @@ namespace proc {
   // Returns default image if image configuration is not set.
   // Returns http content-type header compatible image type.
   std::string proc_t::get_app_image(int app_id) {
-    auto iter = std::find_if(_apps.begin(), _apps.end(), [&app_id](const auto app) {
-      return app.id == std::to_string(app_id);
-    });
-    auto app_image_path = iter == _apps.end() ? std::string() : iter->image_path;
+    auto app = find_app(app_id);
+    auto app_image_path = app ? app->image_path : std::string();
 
     return validate_app_image_path(app_image_path);
   }
@@ -669,6 +774,8 @@ namespace proc {
   }
 
   boost::process::environment proc_t::get_env() {
+    std::lock_guard lg {catalog_mutex};
+
     return _env;
   }
 
@@ -828,6 +935,44 @@ namespace proc {
     return ss.str();
   }
 
+  /**
+   * @brief The SHA-256 of an image file, remembered until the file changes.
+   * @details App IDs hash the image of every app, this keeps reloading the apps from hashing all of them again.
+   */
+  static std::optional<std::string> image_sha256(const std::string &filename) {
+    struct image_hash_t {
+      std::filesystem::file_time_type mtime;
+      std::uintmax_t file_size;
+      std::optional<std::string> hash;
+    };
+
+    static std::mutex mutex;
+    static std::unordered_map<std::string, image_hash_t> image_hashes;
+
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(filename, ec);
+    auto file_size = ec ? 0 : std::filesystem::file_size(filename, ec);
+    if (ec) {
+      return calculate_sha256(filename);
+    }
+
+    {
+      std::lock_guard lg {mutex};
+
+      auto it = image_hashes.find(filename);
+      if (it != std::end(image_hashes) && it->second.mtime == mtime && it->second.file_size == file_size) {
+        return it->second.hash;
+      }
+    }
+
+    auto hash = calculate_sha256(filename);
+
+    std::lock_guard lg {mutex};
+    image_hashes.insert_or_assign(filename, image_hash_t {mtime, file_size, hash});
+
+    return hash;
+  }
+
   uint32_t calculate_crc32(const std::string &input) {
     boost::crc_32_type result;
     result.process_bytes(input.data(), input.length());
@@ -840,7 +985,7 @@ namespace proc {
     to_hash.push_back(app_name);
     auto file_path = validate_app_image_path(app_image_path);
     if (file_path != DEFAULT_APP_IMAGE_PATH) {
-      auto file_hash = calculate_sha256(file_path);
+      auto file_hash = image_sha256(file_path);
       if (file_hash) {
         to_hash.push_back(file_hash.value());
       } else {
@@ -1299,6 +1444,16 @@ namespace proc {
     };
   }
 
+  /**
+   * @brief Serializes loading the apps file between the web UI and the watcher.
+   */
+  static std::mutex apps_file_mutex;
+
+  /**
+   * @brief Modification time of the apps file when it was last loaded.
+   */
+  static std::filesystem::file_time_type apps_file_mtime;
+
   void refresh(const std::string &file_name) {
     proc.terminate();
   #ifdef _WIN32
@@ -1307,10 +1462,45 @@ namespace proc {
     }
   #endif
 
+    std::lock_guard lg {apps_file_mutex};
+
     auto proc_opt = proc::parse(file_name);
 
+    // Parsing may have migrated the file
+    std::error_code ec;
+    apps_file_mtime = std::filesystem::last_write_time(file_name, ec);
+
     if (proc_opt) {
-      proc = std::move(*proc_opt);
+      proc.update_apps(std::move(*proc_opt));
+      ++apps_revision_counter;
+    }
+  }
+
+  bool reload_if_changed(const std::string &file_name) {
+    std::lock_guard lg {apps_file_mutex};
+
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(file_name, ec);
+    if (ec || mtime == apps_file_mtime) {
+      return false;
     }
+
+    BOOST_LOG(info) << "Reloading apps from "sv << file_name;
+
+    auto proc_opt = proc::parse(file_name);
+    apps_file_mtime = std::filesystem::last_write_time(file_name, ec);
+
+    if (!proc_opt) {
+      return false;
+    }
+
+    proc.update_apps(std::move(*proc_opt));
+    ++apps_revision_counter;
+
+    return true;
+  }
+
+  std::uint64_t apps_revision() {
+    return apps_revision_counter;
   }
 }  // namespace proc
@@ -9,6 +9,8 @@
 #endif
 
 // standard includes
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <unordered_map>
 
@@ -84,6 +86,16 @@ namespace proc {
     std::chrono::seconds exit_timeout;
   };
 
+  /**
+   * @brief The apps file as loaded, never changed once published.
+   */
+  struct catalog_t {
+    boost::process::v1::environment env;
+    std::vector<ctx_t> apps;
+    std::unordered_map<int, std::size_t> app_by_id;  ///< Position of each app in `apps` by numeric ID.
+    std::unordered_map<std::string, std::size_t> app_by_uuid;  ///< Position of each app in `apps` by UUID.
+  };
+
   class proc_t {
   public:
     KITTY_DEFAULT_CONSTR_MOVE_THROW(proc_t)
@@ -99,11 +111,7 @@ namespace proc {
     proc_t(
       boost::process::v1::environment &&env,
       std::vector<ctx_t> &&apps
-    ):
-        _app_id(0),
-        _env(std::move(env)),
-        _apps(std::move(apps)) {
-    }
+    );
 
     void launch_input_only();
 
@@ -116,8 +124,32 @@ namespace proc {
 
     ~proc_t();
 
-    const std::vector<ctx_t> &get_apps() const;
-    std::vector<ctx_t> &get_apps();
+    /**
+     * @brief The apps, as of the last time the apps file was loaded.
+     * @details The apps file may be reloaded from another thread at any time, the apps stay valid as long as
+     *          the returned pointer is held.
+     */
+    std::shared_ptr<const std::vector<ctx_t>> get_apps() const;
+
+    /**
+     * @brief Find an app by its numeric ID.
+     * @return The app, or nullptr if there is no app with the ID. It stays valid as long as it's held.
+     */
+    std::shared_ptr<const ctx_t> find_app(int app_id) const;
+
+    /**
+     * @brief Find an app by its UUID.
+     * @return The app, or nullptr if there is no app with the UUID. It stays valid as long as it's held.
+     */
+    std::shared_ptr<const ctx_t> find_app_by_uuid(const std::string &uuid) const;
+
+    /**
+     * @brief Take over the apps and environment of a freshly parsed apps file, without touching the running app.
+     * @details Safe to call while other threads look up apps.
+     * @param loaded The result of `parse()`.
+     */
+    void update_apps(proc_t &&loaded);
+
     std::string get_app_image(int app_id);
     std::string get_last_run_app_name();
     std::string get_running_app_uuid();
@@ -128,11 +160,19 @@ namespace proc {
     int _app_id;
     std::string _app_name;
 
+    /**
+     * @brief The environment of the running app, or of the apps file while no app runs.
+     * @details Only replaced while holding the catalog lock. While `_env_in_use` is set, only the thread
+     *          launching or terminating the app changes it.
+     */
     boost::process::v1::environment _env;
+    bool _env_in_use = false;
 
     std::shared_ptr<rtsp_stream::launch_session_t> _launch_session;
 
-    std::vector<ctx_t> _apps;
+    std::shared_ptr<const catalog_t> catalog() const;
+
+    std::shared_ptr<const catalog_t> _catalog = std::make_shared<catalog_t>();  ///< Replaced as a whole under the catalog lock.
     ctx_t _app;
     std::chrono::steady_clock::time_point _app_launch_time;
 
@@ -157,12 +197,29 @@ namespace proc {
   std::tuple<std::string, std::string> calculate_app_id(const std::string &app_name, std::string app_image_path, int index);
 
   std::string validate_app_image_path(std::string app_image_path);
+
+  /**
+   * @brief Stop the running app and load the apps from a file.
+   * @param file_name The apps file.
+   */
   void refresh(const std::string &file_name);
+
+  /**
+   * @brief Load the apps from a file if it changed since it was last loaded, leaving the running app alone.
+   * @param file_name The apps file.
+   * @return true if the apps were reloaded.
+   */
+  bool reload_if_changed(const std::string &file_name);
+
+  /**
+   * @brief Incremented every time the apps are reloaded, to invalidate anything rendered from them.
+   */
+  std::uint64_t apps_revision();
   void migrate_apps(nlohmann::json* fileTree_p, nlohmann::json* inputTree_p);
   std::optional<proc::proc_t> parse(const std::string &file_name);
 
   /**
-   * @brief Initialize proc functions
+   * @brief Initialize proc functions, and start watching the apps file for changes.
    * @return Unique pointer to `deinit_t` to manage cleanup
    */
   std::unique_ptr<platf::deinit_t> init();
@@ -27,6 +27,7 @@ extern "C" {
 #include "logging.h"
 #include "network.h"
 #include "rtsp.h"
+#include "startup_timeline.h"
 #include "stream.h"
 #include "sync.h"
 #include "video.h"
@@ -460,7 +461,9 @@ namespace rtsp_stream {
 
       auto socket = std::move(next_socket);
 
-      auto launch_session {launch_event.view(0s)};
+      boost::system::error_code peer_ec;
+      auto peer = socket->sock.remote_endpoint(peer_ec);
+      auto launch_session = peer_ec ? nullptr : find_pending(net::addr_to_normalized_string(peer.address()));
       if (launch_session) {
         // Associate the current RTSP session with this socket and start reading
         socket->session = launch_session;
@@ -494,32 +497,53 @@ namespace rtsp_stream {
      * @param launch_session Streaming session information.
      */
     void session_raise(std::shared_ptr<launch_session_t> launch_session) {
-      auto now = std::chrono::steady_clock::now();
+      auto expires = std::chrono::steady_clock::now() + config::stream.ping_timeout;
 
-      // If a launch event is still pending, don't overwrite it.
-      if (raised_timeout > now && launch_event.peek()) {
-        return;
-      }
-      raised_timeout = now + config::stream.ping_timeout;
+      auto lg = _pending_launches.lock();
+
+      // A client launching again before it connected has given up on the previous launch
+      std::erase_if(*_pending_launches, [&](const auto &item) {
+        return item.second.session->unique_id == launch_session->unique_id;
+      });
 
-      launch_event.raise(std::move(launch_session));
+      auto id = launch_session->id;
+      _pending_launches->insert_or_assign(id, pending_launch_t {std::move(launch_session), expires});
     }
 
     /**
-     * @brief Clear state for the oldest launch session.
+     * @brief Clear state for a launch session once its client has connected.
      * @param launch_session_id The ID of the session to clear.
      */
     void session_clear(uint32_t launch_session_id) {
-      // We currently only support a single pending RTSP session,
-      // so the ID should always match the one for that session.
-      auto launch_session = launch_event.view(0s);
-      if (launch_session) {
-        if (launch_session->id != launch_session_id) {
-          BOOST_LOG(error) << "Attempted to clear unexpected session: "sv << launch_session_id << " vs "sv << launch_session->id;
-        } else {
-          launch_event.pop();
+      auto lg = _pending_launches.lock();
+      if (!_pending_launches->erase(launch_session_id)) {
+        BOOST_LOG(debug) << "Launch session already cleared: "sv << launch_session_id;
+      }
+    }
+
+    /**
+     * @brief Find the pending launch session of the client behind an incoming RTSP connection.
+     * @details Launch sessions stay pending until their control stream connects, since clients may open a new
+     *          RTSP connection for every request. The newest session launched from the address wins. A connection
+     *          from an address without a launch, e.g. through a proxy, gets the only pending session, if there is one.
+     * @param address The normalized address of the client.
+     * @return The launch session, or nullptr if none is pending for the client.
+     */
+    std::shared_ptr<launch_session_t> find_pending(const std::string &address) {
+      auto lg = _pending_launches.lock();
+
+      const pending_launch_t *match = nullptr;
+      for (auto &[id, pending] : *_pending_launches) {
+        if (pending.session->client_address == address && (!match || pending.expires > match->expires)) {
+          match = &pending;
         }
       }
+
+      if (!match && _pending_launches->size() == 1) {
+        match = &std::begin(*_pending_launches)->second;
+      }
+
+      return match ? match->session : nullptr;
     }
 
     /**
@@ -531,8 +555,6 @@ namespace rtsp_stream {
       return _session_slots->size();
     }
 
-    safe::event_t<std::shared_ptr<launch_session_t>> launch_event;
-
     /**
      * @brief Clear launch sessions.
      * @param all If true, clear all sessions. Otherwise, only clear timed out and stopped sessions.
@@ -541,12 +563,19 @@ namespace rtsp_stream {
      * @examples_end
      */
     void clear(bool all = true) {
-      // if a launch event timed out --> Remove it.
-      if (raised_timeout < std::chrono::steady_clock::now()) {
-        auto discarded = launch_event.pop(0s);
-        if (discarded) {
-          BOOST_LOG(debug) << "Event timeout: "sv << discarded->unique_id;
-        }
+      // Remove launch sessions whose client never connected
+      {
+        auto now = std::chrono::steady_clock::now();
+
+        auto lg = _pending_launches.lock();
+        std::erase_if(*_pending_launches, [&](const auto &item) {
+          if (item.second.expires < now) {
+            BOOST_LOG(debug) << "Event timeout: "sv << item.second.session->unique_id;
+            return true;
+          }
+
+          return all;
+        });
       }
 
       auto lg = _session_slots.lock();
@@ -613,7 +642,12 @@ namespace rtsp_stream {
 
     sync_util::sync_t<std::set<std::shared_ptr<stream::session_t>>> _session_slots;
 
-    std::chrono::steady_clock::time_point raised_timeout;
+    struct pending_launch_t {
+      std::shared_ptr<launch_session_t> session;
+      std::chrono::steady_clock::time_point expires;
+    };
+
+    sync_util::sync_t<std::unordered_map<uint32_t, pending_launch_t>> _pending_launches;  ///< Launch sessions awaiting their client, by ID.
 
     boost::asio::io_context io_context;
     tcp::acceptor acceptor {io_context};
@@ -758,6 +792,8 @@ namespace rtsp_stream {
   }
 
   void cmd_describe(rtsp_server_t *server, tcp::socket &sock, launch_session_t &session, msg_t &&req) {
+    startup_timeline::mark(session.id, startup_timeline::phase_e::rtsp_describe);
+
     OPTION_ITEM option {};
 
     // I know these string literals will not be modified
@@ -841,6 +877,8 @@ namespace rtsp_stream {
   }
 
   void cmd_setup(rtsp_server_t *server, tcp::socket &sock, launch_session_t &session, msg_t &&req) {
+    startup_timeline::mark(session.id, startup_timeline::phase_e::rtsp_setup);
+
     OPTION_ITEM options[4] {};
 
     auto &seqn = options[0];
@@ -998,6 +1036,8 @@ namespace rtsp_stream {
       config.monitor.bitrate = util::from_view(args.at("x-nv-vqos[0].bw.maximumBitrateKbps"sv));
       config.monitor.slicesPerFrame = util::from_view(args.at("x-nv-video[0].videoEncoderSlicesPerFrame"sv));
       config.monitor.numRefFrames = util::from_view(args.at("x-nv-video[0].maxNumReferenceFrames"sv));
+      // Moonlight only lifts the reference frame limit when it takes up the refPicInvalidation we announced
+      config.monitor.refPicInvalidation = config.monitor.numRefFrames == 0 && video::last_encoder_probe_supported_ref_frames_invalidation;
       config.monitor.encoderCscMode = util::from_view(args.at("x-nv-video[0].encoderCscMode"sv));
       config.monitor.videoFormat = util::from_view(args.at("x-nv-vqos[0].bitStreamFormat"sv));
       config.monitor.dynamicRange = util::from_view(args.at("x-nv-video[0].dynamicRangeMode"sv));
@@ -1148,10 +1188,17 @@ namespace rtsp_stream {
       return;
     }
 
+    startup_timeline::mark(session.id, startup_timeline::phase_e::rtsp_announce);
+
+    // Lets the next launch of this client prewarm an encoder with the same configuration
+    video::remember_client_config(session.unique_id, {session.width, session.height, session.fps, session.enable_hdr}, config.monitor);
+
     respond(sock, session, &option, 200, "OK", req->sequenceNumber, {});
   }
 
   void cmd_play(rtsp_server_t *server, tcp::socket &sock, launch_session_t &session, msg_t &&req) {
+    startup_timeline::mark(session.id, startup_timeline::phase_e::rtsp_play);
+
     OPTION_ITEM option {};
 
     // I know these string literals will not be modified
@@ -36,6 +36,7 @@ namespace rtsp_stream {
 
     std::string device_name;
     std::string unique_id;
+    std::string client_address;  ///< Normalized address the client launched from, to match its RTSP connections.
     crypto::PERM perm;
 
     bool input_only;
@@ -0,0 +1,195 @@
+/**
+ * @file src/startup_timeline.cpp
+ * @brief Definitions for the per-session startup timeline.
+ */
+// this include
+#include "startup_timeline.h"
+
+// standard includes
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+// local includes
+#include "logging.h"
+
+using namespace std::literals;
+
+namespace startup_timeline {
+  // Sessions that were launched but never connected are dropped after this many newer launches
+  constexpr std::size_t max_pending = 16;
+
+  // Completed timelines kept for the API
+  constexpr std::size_t max_history = 64;
+
+  static std::mutex timelines_lock;
+  static std::map<std::uint32_t, timeline_t> pending;
+  static std::deque<timeline_t> history;
+
+  std::string_view to_string(phase_e phase) {
+    switch (phase) {
+      case phase_e::launch_received:
+        return "launch_received"sv;
+      case phase_e::display_configured:
+        return "display_configured"sv;
+      case phase_e::encoders_probed:
+        return "encoders_probed"sv;
+      case phase_e::prep_commands_done:
+        return "prep_commands_done"sv;
+      case phase_e::app_started:
+        return "app_started"sv;
+      case phase_e::launch_responded:
+        return "launch_responded"sv;
+      case phase_e::rtsp_describe:
+        return "rtsp_describe"sv;
+      case phase_e::rtsp_setup:
+        return "rtsp_setup"sv;
+      case phase_e::rtsp_announce:
+        return "rtsp_announce"sv;
+      case phase_e::rtsp_play:
+        return "rtsp_play"sv;
+      case phase_e::video_ping:
+        return "video_ping"sv;
+      case phase_e::audio_ping:
+        return "audio_ping"sv;
+      case phase_e::capture_started:
+        return "capture_started"sv;
+      case phase_e::first_frame_encoded:
+        return "first_frame_encoded"sv;
+      case phase_e::first_frame_sent:
+        return "first_frame_sent"sv;
+      case phase_e::_count:
+        break;
+    }
+
+    return "unknown"sv;
+  }
+
+  std::optional<std::chrono::milliseconds> timeline_t::offset(phase_e phase) const {
+    auto &start = phases[(int) phase_e::launch_received];
+    auto &reached = phases[(int) phase];
+    if (!start || !reached) {
+      return std::nullopt;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(*reached - *start);
+  }
+
+  void begin(std::uint32_t id, std::string client_name, std::chrono::steady_clock::time_point received) {
+    timeline_t timeline {id, std::move(client_name), std::chrono::system_clock::now()};
+    timeline.phases[(int) phase_e::launch_received] = received;
+
+    std::lock_guard lg {timelines_lock};
+
+    // Launch session IDs increase monotonically, so the first entry is the oldest
+    if (pending.size() >= max_pending) {
+      pending.erase(pending.begin());
+    }
+    pending.insert_or_assign(id, std::move(timeline));
+  }
+
+  void mark(std::uint32_t id, phase_e phase) {
+    auto now = std::chrono::steady_clock::now();
+
+    std::optional<timeline_t> completed;
+    {
+      std::lock_guard lg {timelines_lock};
+
+      auto it = pending.find(id);
+      if (it == pending.end()) {
+        return;
+      }
+
+      auto &reached = it->second.phases[(int) phase];
+      if (!reached) {
+        reached = now;
+      }
+
+      if (phase != phase_e::first_frame_sent) {
+        return;
+      }
+
+      completed = std::move(it->second);
+      pending.erase(it);
+
+      if (history.size() >= max_history) {
+        history.pop_front();
+      }
+      history.push_back(*completed);
+    }
+
+    BOOST_LOG(info) << format(*completed);
+  }
+
+  void discard(std::uint32_t id) {
+    std::lock_guard lg {timelines_lock};
+    pending.erase(id);
+  }
+
+  std::string format(const timeline_t &timeline) {
+    std::stringstream ss;
+    ss << "Startup timeline of session "sv << timeline.id << " ["sv << timeline.client_name << "]:"sv;
+
+    for (int x = (int) phase_e::launch_received + 1; x < (int) phase_e::_count; ++x) {
+      auto phase = (phase_e) x;
+      if (auto offset = timeline.offset(phase)) {
+        ss << ' ' << to_string(phase) << "=+"sv << offset->count() << "ms"sv;
+      }
+    }
+
+    return ss.str();
+  }
+
+  nlohmann::json to_json() {
+    std::vector<timeline_t> timelines;
+    {
+      std::lock_guard lg {timelines_lock};
+      timelines.assign(history.begin(), history.end());
+    }
+
+    auto json = nlohmann::json::object();
+    json["timelines"] = nlohmann::json::array();
+
+    std::vector<std::int64_t> totals;
+    for (const auto &timeline : timelines) {
+      nlohmann::json phases = nlohmann::json::object();
+      for (int x = 0; x < (int) phase_e::_count; ++x) {
+        auto phase = (phase_e) x;
+        if (auto offset = timeline.offset(phase)) {
+          phases[std::string {to_string(phase)}] = offset->count();
+        }
+      }
+
+      auto total = timeline.offset(phase_e::first_frame_sent)->count();
+      totals.push_back(total);
+
+      json["timelines"].push_back({
+        {"id", timeline.id},
+        {"client_name", timeline.client_name},
+        {"started_at", std::chrono::duration_cast<std::chrono::milliseconds>(timeline.started_at.time_since_epoch()).count()},
+        {"total_ms", total},
+        {"phases_ms", std::move(phases)},
+      });
+    }
+
+    std::sort(totals.begin(), totals.end());
+    auto percentile = [&](double p) -> std::int64_t {
+      if (totals.empty()) {
+        return 0;
+      }
+      return totals[std::min(totals.size() - 1, (std::size_t) (p * totals.size()))];
+    };
+
+    json["summary"] = {
+      {"count", totals.size()},
+      {"p50_ms", percentile(0.50)},
+      {"p95_ms", percentile(0.95)},
+      {"max_ms", totals.empty() ? 0 : totals.back()},
+    };
+
+    return json;
+  }
+}  // namespace startup_timeline
@@ -0,0 +1,95 @@
+/**
+ * @file src/startup_timeline.h
+ * @brief Declarations for the per-session startup timeline.
+ */
+#pragma once
+
+// standard includes
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// lib includes
+#include <nlohmann/json.hpp>
+
+namespace startup_timeline {
+  /**
+   * @brief The phases of a session startup, in the order they usually complete.
+   */
+  enum class phase_e : int {
+    launch_received,  ///< /launch or /resume request received.
+    display_configured,  ///< Display configuration applied, including virtual display creation.
+    encoders_probed,  ///< Encoder probe finished.
+    prep_commands_done,  ///< App prep commands finished.
+    app_started,  ///< App process spawned.
+    launch_responded,  ///< Response to /launch or /resume sent.
+    rtsp_describe,  ///< RTSP DESCRIBE received.
+    rtsp_setup,  ///< First RTSP SETUP received.
+    rtsp_announce,  ///< RTSP ANNOUNCE received, the stream session is started.
+    rtsp_play,  ///< RTSP PLAY received.
+    video_ping,  ///< First video ping received from the client.
+    audio_ping,  ///< First audio ping received from the client.
+    capture_started,  ///< Video capture and encoder creation started.
+    first_frame_encoded,  ///< First video packet handed to the network thread.
+    first_frame_sent,  ///< First video frame sent to the client, this completes the timeline.
+    _count
+  };
+
+  /**
+   * @brief Name of a phase, as used in logs and the API.
+   */
+  std::string_view to_string(phase_e phase);
+
+  /**
+   * @brief Timestamps of the phases a session went through.
+   */
+  struct timeline_t {
+    std::uint32_t id;  ///< Launch session ID.
+    std::string client_name;  ///< Name of the client that launched the session.
+    std::chrono::system_clock::time_point started_at;  ///< Wall clock time of the launch request.
+    std::array<std::optional<std::chrono::steady_clock::time_point>, (int) phase_e::_count> phases;
+
+    /**
+     * @brief Time from the launch request to the given phase.
+     * @return The offset, or `std::nullopt` if the phase wasn't reached.
+     */
+    std::optional<std::chrono::milliseconds> offset(phase_e phase) const;
+  };
+
+  /**
+   * @brief Start the timeline of a launch session.
+   * @param id The launch session ID.
+   * @param client_name Name of the client.
+   * @param received When the launch request was received.
+   */
+  void begin(std::uint32_t id, std::string client_name, std::chrono::steady_clock::time_point received);
+
+  /**
+   * @brief Record that a session reached a phase.
+   * @details Only the first time a phase is reached is recorded, sessions without a timeline are ignored.
+   *          Reaching `phase_e::first_frame_sent` completes the timeline and logs it.
+   * @param id The launch session ID.
+   * @param phase The phase reached.
+   */
+  void mark(std::uint32_t id, phase_e phase);
+
+  /**
+   * @brief Drop the timeline of a session that won't complete.
+   * @param id The launch session ID.
+   */
+  void discard(std::uint32_t id);
+
+  /**
+   * @brief Format a timeline as a single log line.
+   */
+  std::string format(const timeline_t &timeline);
+
+  /**
+   * @brief Recent completed timelines and their latency percentiles.
+   * @return JSON with the `timelines` array, newest last, and a `summary` object.
+   */
+  nlohmann::json to_json();
+}  // namespace startup_timeline
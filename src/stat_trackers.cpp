@@ -2,9 +2,13 @@
  * @file src/stat_trackers.cpp
  * @brief Definitions for streaming statistic tracking.
  */
-// local includes
+// this include
 #include "stat_trackers.h"
 
+// standard includes
+#include <algorithm>
+#include <bit>
+
 namespace stat_trackers {
 
   boost::format one_digit_after_decimal() {
@@ -15,4 +19,116 @@ namespace stat_trackers {
     return boost::format("%1$.2f");
   }
 
+  std::size_t histogram_t::bucket_index(std::uint64_t value) noexcept {
+    value = std::min(value, (std::uint64_t {1} << max_bits) - 1);
+    if (value < sub_bucket_count) {
+      return value;
+    }
+
+    // Keep the top significant_bits - 1 bits below the leading one
+    auto shift = std::bit_width(value) - significant_bits;
+    auto mantissa = value >> shift;
+
+    return sub_bucket_count + (shift - 1) * half_sub_bucket_count + (mantissa - half_sub_bucket_count);
+  }
+
+  std::uint64_t histogram_t::bucket_highest_value(std::size_t index) noexcept {
+    if (index < sub_bucket_count) {
+      return index;
+    }
+
+    auto shift = (index - sub_bucket_count) / half_sub_bucket_count + 1;
+    auto mantissa = (index - sub_bucket_count) % half_sub_bucket_count + half_sub_bucket_count;
+
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+  void histogram_t::record(std::uint64_t value, std::uint64_t count) noexcept {
+    buckets[bucket_index(value)].fetch_add(count, std::memory_order_relaxed);
+    total_count.fetch_add(count, std::memory_order_relaxed);
+    total_sum.fetch_add(value * count, std::memory_order_relaxed);
+
+    auto current_min = min_value.load(std::memory_order_relaxed);
+    while (value < current_min && !min_value.compare_exchange_weak(current_min, value, std::memory_order_relaxed)) {}
+
+    auto current_max = max_value.load(std::memory_order_relaxed);
+    while (value > current_max && !max_value.compare_exchange_weak(current_max, value, std::memory_order_relaxed)) {}
+  }
+
+  void histogram_t::merge(const histogram_t &other) noexcept {
+    for (std::size_t x = 0; x < bucket_count; ++x) {
+      if (auto count = other.buckets[x].load(std::memory_order_relaxed)) {
+        buckets[x].fetch_add(count, std::memory_order_relaxed);
+      }
+    }
+    total_count.fetch_add(other.total_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    total_sum.fetch_add(other.total_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    auto other_min = other.min_value.load(std::memory_order_relaxed);
+    auto current_min = min_value.load(std::memory_order_relaxed);
+    while (other_min < current_min && !min_value.compare_exchange_weak(current_min, other_min, std::memory_order_relaxed)) {}
+
+    auto other_max = other.max_value.load(std::memory_order_relaxed);
+    auto current_max = max_value.load(std::memory_order_relaxed);
+    while (other_max > current_max && !max_value.compare_exchange_weak(current_max, other_max, std::memory_order_relaxed)) {}
+  }
+
+  void histogram_t::reset() noexcept {
+    for (auto &bucket : buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    total_count.store(0, std::memory_order_relaxed);
+    total_sum.store(0, std::memory_order_relaxed);
+    min_value.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+    max_value.store(0, std::memory_order_relaxed);
+  }
+
+  std::uint64_t histogram_t::count() const noexcept {
+    return total_count.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t histogram_t::min() const noexcept {
+    return count() ? min_value.load(std::memory_order_relaxed) : 0;
+  }
+
+  std::uint64_t histogram_t::max() const noexcept {
+    return max_value.load(std::memory_order_relaxed);
+  }
+
+  double histogram_t::mean() const noexcept {
+    auto samples = count();
+    return samples ? (double) total_sum.load(std::memory_order_relaxed) / samples : 0.0;
+  }
+
+  std::uint64_t histogram_t::value_at_percentile(double percentile) const noexcept {
+    // Count from the buckets themselves, the totals may be ahead of them while other threads record
+    std::uint64_t samples = 0;
+    for (auto &bucket : buckets) {
+      samples += bucket.load(std::memory_order_relaxed);
+    }
+    if (samples == 0) {
+      return 0;
+    }
+
+    auto rank = std::min(samples, (std::uint64_t) (std::clamp(percentile, 0.0, 1.0) * samples) + 1);
+
+    std::uint64_t seen = 0;
+    for (std::size_t x = 0; x < bucket_count; ++x) {
+      seen += buckets[x].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return std::min(bucket_highest_value(x), max());
+      }
+    }
+
+    return max();
+  }
+
+  void histogram_t::for_each_bucket(const std::function<void(std::uint64_t highest_value, std::uint64_t count)> &func) const {
+    for (std::size_t x = 0; x < bucket_count; ++x) {
+      if (auto count = buckets[x].load(std::memory_order_relaxed)) {
+        func(bucket_highest_value(x), count);
+      }
+    }
+  }
+
 }  // namespace stat_trackers
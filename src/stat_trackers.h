@@ -5,9 +5,14 @@
 #pragma once
 
 // standard includes
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 #include <limits>
+#include <type_traits>
 
 // lib includes
 #include <boost/format.hpp>
@@ -18,36 +23,145 @@ namespace stat_trackers {
 
   boost::format two_digits_after_decimal();
 
+  /**
+   * @brief Fixed-memory histogram with log-linear buckets, in the style of HdrHistogram.
+   * @details Values below 128 are counted exactly, larger values land in buckets no wider than 1/64 of their value.
+   *          Recording is lock-free and allocation-free, so any number of threads may record concurrently.
+   *          Histograms with the same layout can be merged, e.g. to aggregate sessions.
+   */
+  class histogram_t {
+  public:
+    static constexpr int significant_bits = 7;  ///< Values below 2^significant_bits are exact.
+    static constexpr int max_bits = 40;  ///< Larger values are clamped to 2^max_bits - 1.
+
+    histogram_t() = default;
+    histogram_t(const histogram_t &) = delete;
+    histogram_t &operator=(const histogram_t &) = delete;
+
+    /**
+     * @brief Record a value.
+     * @param value The value.
+     * @param count How many times the value was seen.
+     */
+    void record(std::uint64_t value, std::uint64_t count = 1) noexcept;
+
+    /**
+     * @brief Add all values recorded by another histogram.
+     */
+    void merge(const histogram_t &other) noexcept;
+
+    /**
+     * @brief Forget all recorded values.
+     * @note Values recorded concurrently with a reset may be partially kept.
+     */
+    void reset() noexcept;
+
+    std::uint64_t count() const noexcept;
+    std::uint64_t min() const noexcept;
+    std::uint64_t max() const noexcept;
+    double mean() const noexcept;
+
+    /**
+     * @brief The value below which the given fraction of the recorded values fall.
+     * @param percentile Fraction between 0 and 1, e.g. 0.999 for p99.9.
+     * @return The highest value equivalent to the bucket holding that rank, or 0 if nothing was recorded.
+     */
+    std::uint64_t value_at_percentile(double percentile) const noexcept;
+
+    /**
+     * @brief Call a function for every non-empty bucket, in increasing order.
+     * @param func Called with the highest value of the bucket and its count.
+     */
+    void for_each_bucket(const std::function<void(std::uint64_t highest_value, std::uint64_t count)> &func) const;
+
+  private:
+    static constexpr std::size_t sub_bucket_count = std::size_t {1} << significant_bits;
+    static constexpr std::size_t half_sub_bucket_count = sub_bucket_count / 2;
+    static constexpr std::size_t bucket_count = sub_bucket_count + (max_bits - significant_bits) * half_sub_bucket_count;
+
+    static std::size_t bucket_index(std::uint64_t value) noexcept;
+    static std::uint64_t bucket_highest_value(std::size_t index) noexcept;
+
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets {};
+    std::atomic<std::uint64_t> total_count {0};
+    std::atomic<std::uint64_t> total_sum {0};
+    std::atomic<std::uint64_t> min_value {std::numeric_limits<std::uint64_t>::max()};
+    std::atomic<std::uint64_t> max_value {0};
+  };
+
+  /**
+   * @brief Collects samples over an interval and reports their percentiles.
+   * @details Samples are counted in a histogram_t, so memory use doesn't depend on the number of samples.
+   *          Floating point samples are recorded with a resolution of 1/1000 of their unit.
+   */
   template<typename T>
-  class min_max_avg_tracker {
+  class percentile_tracker {
   public:
-    using callback_function = std::function<void(T stat_min, T stat_max, double stat_avg)>;
+    struct percentiles_t {
+      T p50;
+      T p90;
+      T p99;
+      T p999;
+      T max;
+    };
+
+    using callback_function = std::function<void(const percentiles_t &stats, std::size_t samples)>;
 
     void collect_and_callback_on_interval(T stat, const callback_function &callback, std::chrono::seconds interval_in_seconds) {
-      if (data.calls == 0) {
-        data.last_callback_time = std::chrono::steady_clock::now();
-      } else if (std::chrono::steady_clock::now() > data.last_callback_time + interval_in_seconds) {
-        callback(data.stat_min, data.stat_max, data.stat_total / data.calls);
-        data = {};
+      if (histogram.count() == 0) {
+        last_callback_time = std::chrono::steady_clock::now();
+      } else if (std::chrono::steady_clock::now() > last_callback_time + interval_in_seconds) {
+        callback(calculate(), histogram.count());
+        histogram.reset();
+        last_callback_time = std::chrono::steady_clock::now();
+      }
+      histogram.record(to_histogram(stat));
+    }
+
+    /**
+     * @brief Calculate percentiles of the samples collected so far.
+     */
+    percentiles_t calculate() const {
+      if (histogram.count() == 0) {
+        return {};
       }
-      data.stat_min = std::min(data.stat_min, stat);
-      data.stat_max = std::max(data.stat_max, stat);
-      data.stat_total += stat;
-      data.calls += 1;
+
+      return {
+        from_histogram(histogram.value_at_percentile(0.50)),
+        from_histogram(histogram.value_at_percentile(0.90)),
+        from_histogram(histogram.value_at_percentile(0.99)),
+        from_histogram(histogram.value_at_percentile(0.999)),
+        from_histogram(histogram.max()),
+      };
+    }
+
+    /**
+     * @brief The samples of the current interval, e.g. to merge them into an aggregate.
+     */
+    const histogram_t &samples() const {
+      return histogram;
     }
 
     void reset() {
-      data = {};
+      histogram.reset();
     }
 
   private:
-    struct {
-      std::chrono::steady_clock::time_point last_callback_time = std::chrono::steady_clock::now();
-      T stat_min = std::numeric_limits<T>::max();
-      T stat_max = std::numeric_limits<T>::min();
-      double stat_total = 0;
-      uint32_t calls = 0;
-    } data;
+    static constexpr double scale = std::is_floating_point_v<T> ? 1000.0 : 1.0;
+
+    static std::uint64_t to_histogram(T stat) {
+      if (stat <= T {}) {
+        return 0;
+      }
+      return (std::uint64_t) std::llround((double) stat * scale);
+    }
+
+    static T from_histogram(std::uint64_t value) {
+      return (T) (value / scale);
+    }
+
+    std::chrono::steady_clock::time_point last_callback_time = std::chrono::steady_clock::now();
+    histogram_t histogram;
   };
 
 }  // namespace stat_trackers
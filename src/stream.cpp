@@ -20,15 +20,19 @@ extern "C" {
 }
 
 // local includes
+#include "bitrate_control.h"
 #include "config.h"
 #include "crypto.h"
 #include "display_device.h"
+#include "frame_trace.h"
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
+#include "metrics.h"
 #include "network.h"
 #include "platform/common.h"
 #include "process.h"
+#include "startup_timeline.h"
 #include "stream.h"
 #include "sync.h"
 #include "system_tray.h"
@@ -354,6 +358,8 @@ namespace stream {
 
     std::shared_ptr<input::input_t> input;
 
+    std::shared_ptr<metrics::session_t> metrics;
+
     std::thread audioThread;
     std::thread videoThread;
 
@@ -374,8 +380,18 @@ namespace stream {
 
       safe::mail_raw_t::event_t<bool> idr_events;
       safe::mail_raw_t::event_t<std::pair<int64_t, int64_t>> invalidate_ref_frames_events;
+      safe::mail_raw_t::event_t<int> bitrate_events;
+
+      // Only set when dynamic bitrate is enabled, driven by the control thread
+      std::optional<bitrate_control::controller_t> bitrate_controller;
+
+      // Moving average of the time to packetize and send a frame, written by the video thread
+      std::atomic<std::int64_t> send_latency_us {0};
 
       std::unique_ptr<platf::deinit_t> qos;
+
+      // Only the first frame completes the startup timeline
+      bool first_frame_sent = false;
     } video;
 
     struct {
@@ -927,6 +943,33 @@ namespace stream {
     return 0;
   }
 
+  /**
+   * @brief Feed the network state of a session to its bitrate controller and pass changes to the encoder.
+   */
+  void update_bitrate(session_t *session, std::chrono::steady_clock::time_point now) {
+    auto &controller = session->video.bitrate_controller;
+    if (!controller) {
+      return;
+    }
+
+    auto previous = controller->target();
+    auto bitrate = controller->update({
+      now,
+      session->metrics->get(metrics::counter_e::frames_sent),
+      session->metrics->get(metrics::counter_e::client_lost_frames),
+      std::chrono::milliseconds {session->control.peer->roundTripTime},
+      std::chrono::microseconds {session->video.send_latency_us.load(std::memory_order_relaxed)},
+    });
+    if (!bitrate) {
+      return;
+    }
+
+    BOOST_LOG(info) << "Bitrate "sv << bitrate_control::to_string(controller->last_decision()) << ": "sv << previous << " -> "sv << *bitrate << " kbps"sv;
+    session->metrics->add(*bitrate > previous ? metrics::counter_e::bitrate_increases : metrics::counter_e::bitrate_decreases);
+    session->metrics->target_bitrate_kbps = *bitrate;
+    session->video.bitrate_events->raise(*bitrate);
+  }
+
   void controlBroadcastThread(control_server_t *server) {
     server->map(packetTypes[IDX_PERIODIC_PING], [](session_t *session, const std::string_view &payload) {
       BOOST_LOG(verbose) << "type [IDX_PERIODIC_PING]"sv;
@@ -954,6 +997,10 @@ namespace stream {
         << "time in milli since last report [" << t.count() << ']' << std::endl
         << "last good frame [" << lastGoodFrame << ']' << std::endl
         << "---end stats---";
+
+      if (count > 0) {
+        session->metrics->add(metrics::counter_e::client_lost_frames, count);
+      }
     });
 
     server->map(packetTypes[IDX_REQUEST_IDR_FRAME], [&](session_t *session, const std::string_view &payload) {
@@ -978,6 +1025,9 @@ namespace stream {
     server->map(packetTypes[IDX_INPUT_DATA], [&](session_t *session, const std::string_view &payload) {
       BOOST_LOG(debug) << "type [IDX_INPUT_DATA]"sv;
 
+      // Input latency is measured from here, before decryption
+      auto received_at = std::chrono::steady_clock::now();
+
       auto tagged_cipher_length = util::endian::big(*(int32_t *) payload.data());
       std::string_view tagged_cipher {payload.data() + sizeof(tagged_cipher_length), (size_t) tagged_cipher_length};
 
@@ -998,7 +1048,8 @@ namespace stream {
         std::copy(payload.end() - 16, payload.end(), std::begin(iv));
       }
 
-      input::passthrough(session->input, std::move(plaintext), session->permission);
+      session->metrics->add(metrics::counter_e::input_events);
+      input::passthrough(session->input, std::move(plaintext), session->permission, received_at);
     });
 
     server->map(packetTypes[IDX_EXEC_SERVER_CMD], [server](session_t *session, const std::string_view &payload) {
@@ -1055,6 +1106,8 @@ namespace stream {
     server->map(packetTypes[IDX_ENCRYPTED], [server](session_t *session, const std::string_view &payload) {
       BOOST_LOG(verbose) << "type [IDX_ENCRYPTED]"sv;
 
+      auto received_at = std::chrono::steady_clock::now();
+
       auto header = (control_encrypted_p) (payload.data() - 2);
 
       auto length = util::endian::little(header->length);
@@ -1112,7 +1165,8 @@ namespace stream {
       // IDX_INPUT_DATA callback will attempt to decrypt unencrypted data, therefore we need pass it directly
       if (type == packetTypes[IDX_INPUT_DATA]) {
         plaintext.erase(std::begin(plaintext), std::begin(plaintext) + 4);
-        input::passthrough(session->input, std::move(plaintext), session->permission);
+        session->metrics->add(metrics::counter_e::input_events);
+        input::passthrough(session->input, std::move(plaintext), session->permission, received_at);
       } else {
         server->call(type, session, next_payload, true);
       }
@@ -1183,6 +1237,10 @@ namespace stream {
 
               send_hdr_mode(session, std::move(hdr_info));
             }
+
+            if (session->control.peer) {
+              update_bitrate(session, now);
+            }
           }
 
           ++pos;
@@ -1331,8 +1389,9 @@ namespace stream {
 
     // Video traffic is sent on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::high);
+    frame_trace::name_thread("Video broadcast");
 
-    logging::min_max_avg_periodic_logger<double> frame_processing_latency_logger(debug, "Frame processing latency", "ms");
+    logging::percentile_periodic_logger<double> frame_processing_latency_logger(debug, "Frame processing latency", "ms");
 
     logging::time_delta_periodic_logger frame_send_batch_latency_logger(debug, "Network: each send_batch() latency");
     logging::time_delta_periodic_logger frame_fec_latency_logger(debug, "Network: each FEC block latency");
@@ -1355,9 +1414,22 @@ namespace stream {
 
       frame_network_latency_logger.first_point_now();
 
+      // The packet has left the queue, whether it's sent or dropped from here on
+      packet->queued.reset();
+
+      auto packetize_begin = std::chrono::steady_clock::now();
+      auto frame_index = packet->frame_index();
+      if (packet->queued_at != std::chrono::steady_clock::time_point {}) {
+        frame_trace::record(frame_trace::stage_e::queue_wait, frame_index, packet->queued_at, packetize_begin);
+      }
+
       auto session = (session_t *) packet->channel_data;
       auto lowseq = session->video.lowseq;
 
+      if (!session->video.first_frame_sent) {
+        startup_timeline::mark(session->launch_session_id, startup_timeline::phase_e::first_frame_encoded);
+      }
+
       std::string_view payload {(char *) packet->data(), packet->data_size()};
       std::vector<uint8_t> payload_with_replacements;
 
@@ -1394,6 +1466,7 @@ namespace stream {
         uint16_t latency = duration_to_latency(std::chrono::steady_clock::now() - *packet->frame_timestamp);
         frame_header.frame_processing_latency = latency;
         frame_processing_latency_logger.collect_and_log(latency / 10.);
+        session->metrics->frame_processing_latency.record(latency * 100);
       } else {
         frame_header.frame_processing_latency = 0;
       }
@@ -1459,6 +1532,8 @@ namespace stream {
         }
       }
 
+      frame_trace::record(frame_trace::stage_e::packetize, frame_index, packetize_begin, std::chrono::steady_clock::now());
+
       try {
         // Use around 80% of 1Gbps          1Gbps            percent    ms     packet      byte
         size_t ratecontrol_packets_in_1ms = std::giga::num * 80 / 100 / 1000 / blocksize / 8;
@@ -1503,8 +1578,10 @@ namespace stream {
           }
 
           frame_fec_latency_logger.first_point_now();
+          auto fec_begin = std::chrono::steady_clock::now();
           // If video encryption is enabled, we allocate space for the encryption header before each shard
           auto shards = fec::encode(current_payload, blocksize, fecPercentage, session->config.minRequiredFecPackets, session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0);
+          frame_trace::record(frame_trace::stage_e::fec, frame_index, fec_begin, std::chrono::steady_clock::now());
           frame_fec_latency_logger.second_point_now_and_log();
 
           auto peer_address = session->video.peer.address();
@@ -1522,6 +1599,7 @@ namespace stream {
           };
 
           size_t next_shard_to_send = 0;
+          auto batch_begin = std::chrono::steady_clock::now();
 
           // set FEC info now that we know for sure what our percentage will be for this frame
           for (auto x = 0; x < shards.size(); ++x) {
@@ -1566,6 +1644,10 @@ namespace stream {
 
             if (x - next_shard_to_send + 1 >= send_batch_size ||
                 x + 1 == shards.size()) {
+              if (session->video.cipher) {
+                frame_trace::record(frame_trace::stage_e::encrypt, frame_index, batch_begin, std::chrono::steady_clock::now());
+              }
+
               // Do pacing within the frame.
               // Also trigger pacing before the first send_batch() of the frame
               // to account for the last send_batch() of the previous frame.
@@ -1588,6 +1670,7 @@ namespace stream {
               batch_info.block_count = current_batch_size;
 
               frame_send_batch_latency_logger.first_point_now();
+              auto send_begin = std::chrono::steady_clock::now();
               // Use a batched send if it's supported on this platform
               if (!platf::send_batch(batch_info)) {
                 // Batched send is not available, so send each packet individually
@@ -1608,6 +1691,8 @@ namespace stream {
                 }
               }
               frame_send_batch_latency_logger.second_point_now_and_log();
+              batch_begin = std::chrono::steady_clock::now();
+              frame_trace::record(frame_trace::stage_e::send_batch, frame_index, send_begin, batch_begin);
 
               ratecontrol_group_packets_sent += current_batch_size;
               ratecontrol_frame_packets_sent += current_batch_size;
@@ -1628,11 +1713,31 @@ namespace stream {
             BOOST_LOG(verbose) << "Frame ["sv << packet->frame_index() << "] :: send ["sv << shards.size() << "] shards..."sv << std::endl;
           }
 
+          session->metrics->add(metrics::counter_e::video_packets_sent, shards.size());
+          session->metrics->add(metrics::counter_e::video_fec_packets_sent, shards.size() - shards.data_shards);
+          session->metrics->add(metrics::counter_e::video_bytes_sent, shards.size() * (shards.prefixsize + shards.blocksize));
+
           ++blockIndex;
           lowseq += shards.size();
         });
 
         session->video.lowseq = lowseq;
+        session->metrics->add(metrics::counter_e::frames_sent);
+        session->metrics->frame_size.record(packet->data_size());
+        if (packet->is_idr()) {
+          session->metrics->add(metrics::counter_e::idr_frames_sent);
+        }
+
+        {
+          auto send_latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - packetize_begin).count();
+          auto average = session->video.send_latency_us.load(std::memory_order_relaxed);
+          session->video.send_latency_us.store(average + (send_latency - average) / 8, std::memory_order_relaxed);
+        }
+
+        if (!session->video.first_frame_sent) {
+          session->video.first_frame_sent = true;
+          startup_timeline::mark(session->launch_session_id, startup_timeline::phase_e::first_frame_sent);
+        }
       } catch (const std::exception &e) {
         BOOST_LOG(error) << "Broadcast video failed "sv << e.what();
         std::this_thread::sleep_for(100ms);
@@ -1705,6 +1810,8 @@ namespace stream {
           session->localAddress,
         };
         platf::send(send_info);
+        session->metrics->add(metrics::counter_e::audio_packets_sent);
+        session->metrics->add(metrics::counter_e::audio_bytes_sent, sizeof(audio_packet) + bytes);
         BOOST_LOG(verbose) << "Audio ["sv << sequenceNumber << "] ::  send..."sv;
 
         auto &fec_packet = session->audio.fec_packet;
@@ -1733,6 +1840,8 @@ namespace stream {
               session->localAddress,
             };
             platf::send(send_info);
+            session->metrics->add(metrics::counter_e::audio_packets_sent);
+            session->metrics->add(metrics::counter_e::audio_bytes_sent, sizeof(fec_packet) + bytes);
             BOOST_LOG(verbose) << "Audio FEC ["sv << (sequenceNumber & ~(RTPA_DATA_SHARDS - 1)) << ' ' << x << "] ::  send..."sv;
           }
         }
@@ -1904,13 +2013,15 @@ namespace stream {
     if (error < 0) {
       return;
     }
+    startup_timeline::mark(session->launch_session_id, startup_timeline::phase_e::video_ping);
 
     // Enable local prioritization and QoS tagging on video traffic if requested by the client
     auto address = session->video.peer.address();
     session->video.qos = platf::enable_socket_qos(ref->video_sock.native_handle(), address, session->video.peer.port(), platf::qos_data_type_e::video, session->config.videoQosType != 0);
 
     BOOST_LOG(debug) << "Start capturing Video"sv;
-    video::capture(session->mail, session->config.monitor, session);
+    startup_timeline::mark(session->launch_session_id, startup_timeline::phase_e::capture_started);
+    video::capture(session->mail, session->config.monitor, session, session->metrics, session->device_uuid);
   }
 
   void audioThread(session_t *session) {
@@ -1925,6 +2036,7 @@ namespace stream {
     if (error < 0) {
       return;
     }
+    startup_timeline::mark(session->launch_session_id, startup_timeline::phase_e::audio_ping);
 
     // Enable local prioritization and QoS tagging on audio traffic if requested by the client
     auto address = session->audio.peer.address();
@@ -2036,6 +2148,8 @@ namespace stream {
       session.audioThread.join();
       BOOST_LOG(debug) << "Waiting for control to end..."sv;
       session.controlEnd.view();
+      // A session that ended before its first frame won't complete its startup timeline
+      startup_timeline::discard(session.launch_session_id);
       // Reset input on session stop to avoid stuck repeated keys
       BOOST_LOG(debug) << "Resetting Input..."sv;
       input::reset(session.input);
@@ -2082,7 +2196,7 @@ namespace stream {
     }
 
     int start(session_t &session, const std::string &addr_string) {
-      session.input = input::alloc(session.mail);
+      session.input = input::alloc(session.mail, session.metrics);
 
       session.broadcast_ref = broadcast.ref();
       if (!session.broadcast_ref) {
@@ -2149,6 +2263,7 @@ namespace stream {
       session->device_name = launch_session.device_name;
       session->device_uuid = launch_session.unique_id;
       session->permission = launch_session.perm;
+      session->metrics = std::make_shared<metrics::session_t>(launch_session.id, launch_session.device_name);
 
       session->do_cmds = std::move(launch_session.client_do_cmds);
       session->undo_cmds = std::move(launch_session.client_undo_cmds);
@@ -2166,6 +2281,11 @@ namespace stream {
 
       session->video.idr_events = mail->event<bool>(mail::idr);
       session->video.invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
+      session->video.bitrate_events = mail->event<int>(mail::bitrate);
+      if (config::video.dynamic_bitrate) {
+        session->video.bitrate_controller.emplace(config.monitor.bitrate, config.monitor.framerate);
+        session->metrics->target_bitrate_kbps = config.monitor.bitrate;
+      }
       session->video.lowseq = 0;
       session->video.ping_payload = launch_session.av_ping_payload;
       if (config.encryptionFlagsEnabled & SS_ENC_VIDEO) {
@@ -5,12 +5,19 @@
 #pragma once
 
 // standard includes
+#include <algorithm>
 #include <chrono>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <future>
+#include <limits>
 #include <mutex>
+#include <new>
 #include <optional>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -21,133 +28,202 @@
 
 namespace task_pool_util {
 
-  class _ImplBase {
+  /**
+   * @brief Identifies a delayed task, to delay or cancel it.
+   * @details Holds the slot of the task together with the generation of that slot, so the ID of a task
+   *          that already ran or was cancelled never matches a later task reusing the slot.
+   */
+  class task_id_t {
   public:
-    // _unique_base_type _this_ptr;
+    constexpr task_id_t(std::nullptr_t = nullptr) noexcept:
+        _value {0} {
+    }
 
-    inline virtual ~_ImplBase() = default;
+    constexpr explicit task_id_t(std::uint64_t value) noexcept:
+        _value {value} {
+    }
 
-    virtual void run() = 0;
-  };
+    constexpr explicit operator bool() const noexcept {
+      return _value != 0;
+    }
+
+    constexpr auto operator<=>(const task_id_t &) const = default;
 
-  template<class Function>
-  class _Impl: public _ImplBase {
-    Function _func;
+    constexpr std::uint64_t value() const noexcept {
+      return _value;
+    }
+
+  private:
+    std::uint64_t _value;
+  };
 
+  /**
+   * @brief Storage of one task, recycled by the pool.
+   * @details Small callables are stored inline, so scheduling them doesn't allocate once the pool has warmed up.
+   */
+  class _TaskNode {
   public:
-    _Impl(Function &&f):
-        _func(std::forward<Function>(f)) {
+    static constexpr std::size_t inline_size = 64;
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    _TaskNode(std::uint32_t slot):
+        slot {slot} {
     }
 
-    void run() override {
-      _func();
+    _TaskNode(const _TaskNode &) = delete;
+    _TaskNode &operator=(const _TaskNode &) = delete;
+
+    ~_TaskNode() {
+      reset();
+    }
+
+    template<class Function>
+    void emplace(Function &&f) {
+      using callable_t = std::decay_t<Function>;
+
+      if constexpr (sizeof(callable_t) <= inline_size && alignof(callable_t) <= alignof(std::max_align_t)) {
+        _callable = new (_storage) callable_t(std::forward<Function>(f));
+        _destroy = [](void *callable) {
+          static_cast<callable_t *>(callable)->~callable_t();
+        };
+      } else {
+        _callable = new callable_t(std::forward<Function>(f));
+        _destroy = [](void *callable) {
+          delete static_cast<callable_t *>(callable);
+        };
+      }
+
+      _invoke = [](void *callable) {
+        (*static_cast<callable_t *>(callable))();
+      };
     }
+
+    void run() {
+      try {
+        _invoke(_callable);
+      } catch (...) {
+        // Tasks have never been able to take down the thread running them
+      }
+    }
+
+    void reset() {
+      if (_callable) {
+        _destroy(_callable);
+        _callable = nullptr;
+      }
+    }
+
+    task_id_t id() const {
+      return task_id_t {(std::uint64_t) generation << 32 | (slot + 1)};
+    }
+
+    std::chrono::steady_clock::time_point deadline;
+    std::size_t heap_index = npos;  ///< Position in the timer heap, `npos` when not scheduled.
+    _TaskNode *next = nullptr;  ///< Next node in the queue of immediate tasks or in the free list.
+    const std::uint32_t slot;
+    std::uint32_t generation = 1;
+
+  private:
+    alignas(std::max_align_t) std::byte _storage[inline_size];
+    void *_callable = nullptr;
+    void (*_invoke)(void *) = nullptr;
+    void (*_destroy)(void *) = nullptr;
   };
 
+  /**
+   * @brief A queue of immediate tasks and a timer heap of delayed tasks.
+   * @details Delayed tasks are kept in a 4-ary min-heap of intrusive nodes. Task IDs address their node directly,
+   *          so delaying or cancelling a task doesn't search for it.
+   */
   class TaskPool {
   public:
-    typedef std::unique_ptr<_ImplBase> __task;
-    typedef _ImplBase *task_id_t;
-
+    typedef task_pool_util::task_id_t task_id_t;
     typedef std::chrono::steady_clock::time_point __time_point;
 
-    template<class R>
-    class timer_task_t {
+    /**
+     * @brief A task taken off the pool, returned to the pool when destroyed.
+     */
+    class __task {
     public:
-      task_id_t task_id;
-      std::future<R> future;
+      __task(TaskPool *pool, _TaskNode *node):
+          _pool {pool},
+          _node {node} {
+      }
+
+      __task(__task &&other) noexcept:
+          _pool {other._pool},
+          _node {std::exchange(other._node, nullptr)} {
+      }
+
+      __task &operator=(__task &&other) = delete;
+
+      ~__task() {
+        if (_node) {
+          _pool->release(_node);
+        }
+      }
 
-      timer_task_t(task_id_t task_id, std::future<R> &future):
-          task_id {task_id},
-          future {std::move(future)} {
+      void run() {
+        _node->run();
       }
+
+    private:
+      TaskPool *_pool;
+      _TaskNode *_node;
+    };
+
+    struct timer_task_t {
+      task_id_t task_id;
     };
 
   protected:
-    std::deque<__task> _tasks;
-    std::vector<std::pair<__time_point, __task>> _timer_tasks;
+    std::deque<_TaskNode> _nodes;
+    _TaskNode *_free = nullptr;
+    _TaskNode *_tasks_front = nullptr;
+    _TaskNode *_tasks_back = nullptr;
+    std::vector<_TaskNode *> _timer_tasks;
     std::mutex _task_mutex;
 
   public:
     TaskPool() = default;
 
-    TaskPool(TaskPool &&other) noexcept:
-        _tasks {std::move(other._tasks)},
-        _timer_tasks {std::move(other._timer_tasks)} {
-    }
-
-    TaskPool &operator=(TaskPool &&other) noexcept {
-      std::swap(_tasks, other._tasks);
-      std::swap(_timer_tasks, other._timer_tasks);
-
-      return *this;
-    }
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
 
     template<class Function, class... Args>
-    auto push(Function &&newTask, Args &&...args) {
+    void push(Function &&newTask, Args &&...args) {
       static_assert(std::is_invocable_v<Function, Args &&...>, "arguments don't match the function");
 
-      using __return = std::invoke_result_t<Function, Args &&...>;
-      using task_t = std::packaged_task<__return()>;
-
-      auto bind = [task = std::forward<Function>(newTask), tuple_args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
-        return std::apply(task, std::move(tuple_args));
-      };
-
-      task_t task(std::move(bind));
-
-      auto future = task.get_future();
-
-      std::lock_guard<std::mutex> lg(_task_mutex);
-      _tasks.emplace_back(toRunnable(std::move(task)));
-
-      return future;
-    }
-
-    void pushDelayed(std::pair<__time_point, __task> &&task) {
       std::lock_guard lg(_task_mutex);
 
-      auto it = _timer_tasks.cbegin();
-      for (; it < _timer_tasks.cend(); ++it) {
-        if (std::get<0>(*it) < task.first) {
-          break;
-        }
-      }
+      auto node = acquire();
+      node->emplace(bind(std::forward<Function>(newTask), std::forward<Args>(args)...));
 
-      _timer_tasks.emplace(it, task.first, std::move(task.second));
+      if (_tasks_back) {
+        _tasks_back->next = node;
+      } else {
+        _tasks_front = node;
+      }
+      _tasks_back = node;
     }
 
     /**
-     * @return An id to potentially delay the task.
+     * @return An id to delay or cancel the task.
      */
     template<class Function, class X, class Y, class... Args>
-    auto pushDelayed(Function &&newTask, std::chrono::duration<X, Y> duration, Args &&...args) {
+    timer_task_t pushDelayed(Function &&newTask, std::chrono::duration<X, Y> duration, Args &&...args) {
       static_assert(std::is_invocable_v<Function, Args &&...>, "arguments don't match the function");
 
-      using __return = std::invoke_result_t<Function, Args &&...>;
-      using task_t = std::packaged_task<__return()>;
+      auto time_point = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
 
-      __time_point time_point;
-      if constexpr (std::is_floating_point_v<X>) {
-        time_point = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
-      } else {
-        time_point = std::chrono::steady_clock::now() + duration;
-      }
-
-      auto bind = [task = std::forward<Function>(newTask), tuple_args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
-        return std::apply(task, std::move(tuple_args));
-      };
-
-      task_t task(std::move(bind));
-
-      auto future = task.get_future();
-      auto runnable = toRunnable(std::move(task));
-
-      task_id_t task_id = &*runnable;
+      std::lock_guard lg(_task_mutex);
 
-      pushDelayed(std::pair {time_point, std::move(runnable)});
+      auto node = acquire();
+      node->emplace(bind(std::forward<Function>(newTask), std::forward<Args>(args)...));
+      node->deadline = time_point;
+      heap_push(node);
 
-      return timer_task_t<__return> {task_id, future};
+      return timer_task_t {node->id()};
     }
 
     /**
@@ -158,102 +234,189 @@ namespace task_pool_util {
     void delay(task_id_t task_id, std::chrono::duration<X, Y> duration) {
       std::lock_guard<std::mutex> lg(_task_mutex);
 
-      auto it = _timer_tasks.begin();
-      for (; it < _timer_tasks.cend(); ++it) {
-        const __task &task = std::get<1>(*it);
-
-        if (&*task == task_id) {
-          std::get<0>(*it) = std::chrono::steady_clock::now() + duration;
-
-          break;
-        }
-      }
-
-      if (it == _timer_tasks.cend()) {
+      auto node = find(task_id);
+      if (!node) {
         return;
       }
 
-      // smaller time goes to the back
-      auto prev = it - 1;
-      while (it > _timer_tasks.cbegin()) {
-        if (std::get<0>(*it) > std::get<0>(*prev)) {
-          std::swap(*it, *prev);
+      node->deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+      sift_up(node->heap_index);
+      sift_down(node->heap_index);
+    }
+
+    /**
+     * @return true if the task was still waiting and won't run.
+     */
+    bool cancel(task_id_t task_id) {
+      _TaskNode *node;
+      {
+        std::lock_guard lg(_task_mutex);
+
+        node = find(task_id);
+        if (!node) {
+          return false;
         }
 
-        --prev;
-        --it;
+        heap_remove(node);
       }
+
+      // Destroyed outside of the lock, the destructors of captured objects may push tasks
+      release(node);
+      return true;
     }
 
-    bool cancel(task_id_t task_id) {
+    std::optional<__task> pop() {
       std::lock_guard lg(_task_mutex);
 
-      auto it = _timer_tasks.begin();
-      for (; it < _timer_tasks.cend(); ++it) {
-        const __task &task = std::get<1>(*it);
+      if (_tasks_front) {
+        auto node = _tasks_front;
+        _tasks_front = std::exchange(node->next, nullptr);
+        if (!_tasks_front) {
+          _tasks_back = nullptr;
+        }
 
-        if (&*task == task_id) {
-          _timer_tasks.erase(it);
+        return __task {this, node};
+      }
 
-          return true;
-        }
+      if (!_timer_tasks.empty() && _timer_tasks.front()->deadline <= std::chrono::steady_clock::now()) {
+        auto node = _timer_tasks.front();
+        heap_remove(node);
+
+        return __task {this, node};
       }
 
-      return false;
+      return std::nullopt;
     }
 
-    std::optional<std::pair<__time_point, __task>> pop(task_id_t task_id) {
-      std::lock_guard lg(_task_mutex);
+    bool ready() {
+      std::lock_guard<std::mutex> lg(_task_mutex);
 
-      auto pos = std::find_if(std::begin(_timer_tasks), std::end(_timer_tasks), [&task_id](const auto &t) {
-        return t.second.get() == task_id;
-      });
+      return _tasks_front || (!_timer_tasks.empty() && _timer_tasks.front()->deadline <= std::chrono::steady_clock::now());
+    }
+
+    std::optional<__time_point> next() {
+      std::lock_guard<std::mutex> lg(_task_mutex);
 
-      if (pos == std::end(_timer_tasks)) {
+      if (_timer_tasks.empty()) {
         return std::nullopt;
       }
 
-      return std::move(*pos);
+      return _timer_tasks.front()->deadline;
     }
 
-    std::optional<__task> pop() {
+  private:
+    template<class Function, class... Args>
+    static auto bind(Function &&newTask, Args &&...args) {
+      return [task = std::forward<Function>(newTask), tuple_args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        std::apply(task, std::move(tuple_args));
+      };
+    }
+
+    /**
+     * @brief Take a free node, called with the lock held.
+     */
+    _TaskNode *acquire() {
+      if (_free) {
+        return std::exchange(_free, _free->next);
+      }
+
+      return &_nodes.emplace_back((std::uint32_t) _nodes.size());
+    }
+
+    /**
+     * @brief Destroy the task of a node taken off the pool and make the node available again.
+     */
+    void release(_TaskNode *node) {
+      node->reset();
+
       std::lock_guard lg(_task_mutex);
 
-      if (!_tasks.empty()) {
-        __task task = std::move(_tasks.front());
-        _tasks.pop_front();
-        return task;
+      // IDs handed out for the previous task must not match the next one
+      ++node->generation;
+      node->next = std::exchange(_free, node);
+    }
+
+    /**
+     * @brief Find a waiting delayed task, called with the lock held.
+     */
+    _TaskNode *find(task_id_t task_id) {
+      auto slot = (task_id.value() & 0xFFFFFFFF) - 1;
+      if (slot >= _nodes.size()) {
+        return nullptr;
       }
 
-      if (!_timer_tasks.empty() && std::get<0>(_timer_tasks.back()) <= std::chrono::steady_clock::now()) {
-        __task task = std::move(std::get<1>(_timer_tasks.back()));
-        _timer_tasks.pop_back();
-        return task;
+      auto node = &_nodes[slot];
+      if (node->id() != task_id || node->heap_index == _TaskNode::npos) {
+        return nullptr;
       }
 
-      return std::nullopt;
+      return node;
     }
 
-    bool ready() {
-      std::lock_guard<std::mutex> lg(_task_mutex);
+    void heap_push(_TaskNode *node) {
+      _timer_tasks.push_back(node);
+      node->heap_index = _timer_tasks.size() - 1;
+      sift_up(node->heap_index);
+    }
 
-      return !_tasks.empty() || (!_timer_tasks.empty() && std::get<0>(_timer_tasks.back()) <= std::chrono::steady_clock::now());
+    void heap_remove(_TaskNode *node) {
+      auto index = node->heap_index;
+      auto last = _timer_tasks.back();
+      _timer_tasks.pop_back();
+      node->heap_index = _TaskNode::npos;
+
+      if (last != node) {
+        _timer_tasks[index] = last;
+        last->heap_index = index;
+        sift_up(index);
+        sift_down(last->heap_index);
+      }
     }
 
-    std::optional<__time_point> next() {
-      std::lock_guard<std::mutex> lg(_task_mutex);
+    void sift_up(std::size_t index) {
+      auto node = _timer_tasks[index];
+      while (index > 0) {
+        auto parent = (index - 1) / 4;
+        if (!(node->deadline < _timer_tasks[parent]->deadline)) {
+          break;
+        }
 
-      if (_timer_tasks.empty()) {
-        return std::nullopt;
+        _timer_tasks[index] = _timer_tasks[parent];
+        _timer_tasks[index]->heap_index = index;
+        index = parent;
       }
 
-      return std::get<0>(_timer_tasks.back());
+      _timer_tasks[index] = node;
+      node->heap_index = index;
     }
 
-  private:
-    template<class Function>
-    std::unique_ptr<_ImplBase> toRunnable(Function &&f) {
-      return std::make_unique<_Impl<Function>>(std::forward<Function &&>(f));
+    void sift_down(std::size_t index) {
+      auto node = _timer_tasks[index];
+      auto size = _timer_tasks.size();
+      while (true) {
+        auto first_child = index * 4 + 1;
+        if (first_child >= size) {
+          break;
+        }
+
+        auto earliest = first_child;
+        for (auto child = first_child + 1; child < std::min(first_child + 4, size); ++child) {
+          if (_timer_tasks[child]->deadline < _timer_tasks[earliest]->deadline) {
+            earliest = child;
+          }
+        }
+
+        if (!(_timer_tasks[earliest]->deadline < node->deadline)) {
+          break;
+        }
+
+        _timer_tasks[index] = _timer_tasks[earliest];
+        _timer_tasks[index]->heap_index = index;
+        index = earliest;
+      }
+
+      _timer_tasks[index] = node;
+      node->heap_index = index;
     }
   };
 }  // namespace task_pool_util
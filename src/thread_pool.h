@@ -49,28 +49,21 @@ namespace thread_pool_util {
     }
 
     template<class Function, class... Args>
-    auto push(Function &&newTask, Args &&...args) {
+    void push(Function &&newTask, Args &&...args) {
       std::lock_guard lg(_lock);
-      auto future = TaskPool::push(std::forward<Function>(newTask), std::forward<Args>(args)...);
+      TaskPool::push(std::forward<Function>(newTask), std::forward<Args>(args)...);
 
       _cv.notify_one();
-      return future;
-    }
-
-    void pushDelayed(std::pair<__time_point, __task> &&task) {
-      std::lock_guard lg(_lock);
-
-      TaskPool::pushDelayed(std::move(task));
     }
 
     template<class Function, class X, class Y, class... Args>
     auto pushDelayed(Function &&newTask, std::chrono::duration<X, Y> duration, Args &&...args) {
       std::lock_guard lg(_lock);
-      auto future = TaskPool::pushDelayed(std::forward<Function>(newTask), duration, std::forward<Args>(args)...);
+      auto timer_task = TaskPool::pushDelayed(std::forward<Function>(newTask), duration, std::forward<Args>(args)...);
 
       // Update all timers for wait_until
       _cv.notify_all();
-      return future;
+      return timer_task;
     }
 
     void start(int threads) {
@@ -100,7 +93,7 @@ namespace thread_pool_util {
     void _main() {
       while (_continue) {
         if (auto task = this->pop()) {
-          (*task)->run();
+          task->run();
         } else {
           std::unique_lock uniq_lock(_lock);
 
@@ -122,7 +115,7 @@ namespace thread_pool_util {
 
       // Execute remaining tasks
       while (auto task = this->pop()) {
-        (*task)->run();
+        task->run();
       }
     }
   };
@@ -5,8 +5,14 @@
 // standard includes
 #include <atomic>
 #include <bitset>
+#include <condition_variable>
+#include <future>
 #include <list>
+#include <map>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 
 // lib includes
 #include <boost/pointer_cast.hpp>
@@ -16,13 +22,19 @@ extern "C" {
 #include <libavutil/mastering_display_metadata.h>
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
+
+#ifdef AQUA_BUILD_X264
+  #include <x264.h>
+#endif
 }
 
 // local includes
 #include "process.h"
+#include "bitrate_control.h"
 #include "cbs.h"
 #include "config.h"
 #include "display_device.h"
+#include "frame_trace.h"
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
@@ -30,6 +42,7 @@ extern "C" {
 #include "platform/common.h"
 #include "sync.h"
 #include "video.h"
+#include "video_probe_cache.h"
 
 #ifdef _WIN32
 extern "C" {
@@ -134,6 +147,19 @@ namespace video {
       sws_input_frame->data[0] = img.data;
       sws_input_frame->linesize[0] = img.row_pitch;
 
+      // The previously converted frame is still in sw_frame, so if the capture backend
+      // told us what changed since then, only the damaged rows need to be converted again.
+      auto previous_damage_sequence = std::exchange(last_damage_sequence, img.damage_sequence);
+      if (!requires_padding && previous_damage_sequence && img.damage_sequence == previous_damage_sequence + 1) {
+        auto status = convert_damaged_rows(img);
+        if (status >= 0) {
+          return transfer_to_hw_frame();
+        }
+        if (status != AVERROR(EINVAL)) {
+          return -1;
+        }
+      }
+
       // Perform color conversion and scaling to the final size
       auto status = sws_scale_frame(sws.get(), requires_padding ? sws_output_frame.get() : sw_frame.get(), sws_input_frame.get());
       if (status < 0) {
@@ -158,6 +184,67 @@ namespace video {
         }
       }
 
+      return transfer_to_hw_frame();
+    }
+
+    /**
+     * @brief Convert only the rows of the image that changed since the last converted image.
+     * @param img The captured image, its damage must be relative to the last converted image.
+     * @return 0 on success, `AVERROR(EINVAL)` if a full conversion is required, or another negative error code.
+     */
+    int convert_damaged_rows(platf::img_t &img) {
+      // Rows only map 1:1 to the output frame when no scaling takes place
+      if (img.damage.empty() || sws_input_frame->width != sws_output_frame->width || sws_input_frame->height != sws_output_frame->height) {
+        return AVERROR(EINVAL);
+      }
+
+      auto top = sws_input_frame->height;
+      auto bottom = 0;
+      for (auto &rect : img.damage) {
+        top = std::min(top, rect.y);
+        bottom = std::max(bottom, rect.y + rect.height);
+      }
+
+      // Chroma subsampling requires slices to be aligned
+      auto alignment = (int) sws_receive_slice_alignment(sws.get());
+      top = std::max(0, top / alignment * alignment);
+      bottom = std::min(sws_input_frame->height, (bottom + alignment - 1) / alignment * alignment);
+      if (top >= bottom) {
+        return AVERROR(EINVAL);
+      }
+
+      // Reference the caller's image instead of letting libswscale copy the whole frame
+      sws_input_frame->buf[0] = av_buffer_create(img.data, img.row_pitch * img.height, [](void *, uint8_t *) {}, nullptr, AV_BUFFER_FLAG_READONLY);
+      if (!sws_input_frame->buf[0]) {
+        return AVERROR(ENOMEM);
+      }
+      auto fg = util::fail_guard([this]() {
+        av_buffer_unref(&sws_input_frame->buf[0]);
+      });
+
+      auto status = sws_frame_start(sws.get(), sw_frame.get(), sws_input_frame.get());
+      if (status >= 0) {
+        status = sws_send_slice(sws.get(), 0, sws_input_frame->height);
+        if (status >= 0) {
+          status = sws_receive_slice(sws.get(), top, bottom - top);
+        }
+        sws_frame_end(sws.get());
+      }
+
+      if (status < 0) {
+        char string[AV_ERROR_MAX_STRING_SIZE];
+        BOOST_LOG(error) << "Couldn't scale damaged rows: "sv << av_make_error_string(string, AV_ERROR_MAX_STRING_SIZE, status);
+        return status == AVERROR(EINVAL) ? -1 : status;
+      }
+
+      return 0;
+    }
+
+    /**
+     * @brief Upload the converted software frame if the encoder consumes hardware frames.
+     * @return 0 on success, -1 on failure.
+     */
+    int transfer_to_hw_frame() {
       // If frame is not a software frame, it means we still need to transfer from main memory
       // to vram memory
       if (frame->hw_frames_ctx) {
@@ -286,6 +373,9 @@ namespace video {
     // Offset of input image to output frame in pixels
     int offsetW;
     int offsetH;
+
+    // Damage sequence number of the image currently held in sw_frame, 0 if unknown
+    std::uint64_t last_damage_sequence {};
   };
 
   enum flag_e : uint32_t {
@@ -330,6 +420,10 @@ namespace video {
       vps = std::move(other.vps);
 
       inject = other.inject;
+      intra_refresh = other.intra_refresh;
+      last_frame = other.last_frame;
+      last_idr_frame = other.last_idr_frame;
+      after_ref_frame_invalidation = other.after_ref_frame_invalidation;
 
       return *this;
     }
@@ -358,13 +452,127 @@ namespace video {
     }
 
     void invalidate_ref_frames(int64_t first_frame, int64_t last_frame) override {
+      if (intra_refresh) {
+        // A full refresh wave after the lost frames cleans up the picture without an IDR frame
+        BOOST_LOG(debug) << "Recovering from the loss of frames "sv << first_frame << '-' << last_frame << " with intra refresh"sv;
+#ifdef AQUA_BUILD_X264
+        if (auto x264 = x264_encoder()) {
+          x264_encoder_intra_refresh(x264);
+        }
+#endif
+        after_ref_frame_invalidation = true;
+        return;
+      }
+
+#ifdef AQUA_BUILD_X264
+      if (auto x264 = x264_encoder()) {
+        if (invalidate_x264_ref_frames(x264, first_frame)) {
+          BOOST_LOG(debug) << "Invalidated reference frames "sv << first_frame << '-' << last_frame;
+          after_ref_frame_invalidation = true;
+        } else {
+          BOOST_LOG(debug) << "Reference frames "sv << first_frame << '-' << last_frame << " can't be invalidated, requesting an IDR frame"sv;
+          request_idr_frame();
+        }
+        return;
+      }
+
+      // The software encoder announces invalidation for all codecs, but only libx264 implements it.
+      // HEVC and AV1 clients get the IDR frame they would have asked for without it.
+      if (avcodec_ctx && avcodec_ctx->codec->name != "libx264"sv) {
+        BOOST_LOG(debug) << "Requesting an IDR frame for the loss of frames "sv << first_frame << '-' << last_frame << " in "sv << avcodec_ctx->codec->name;
+        request_idr_frame();
+        return;
+      }
+#endif
+
       BOOST_LOG(error) << "Encoder doesn't support reference frame invalidation";
       request_idr_frame();
     }
 
+    bool set_bitrate(int bitrate) override {
+      // Of the encoders behind avcodec, only libx264 picks up rate control changes between frames
+      if (!avcodec_ctx || avcodec_ctx->codec->name != "libx264"sv) {
+        return false;
+      }
+
+      std::int64_t bits = (std::int64_t) bitrate * 1000;
+      if (avcodec_ctx->rc_buffer_size && avcodec_ctx->rc_max_rate) {
+        // Keep the VBV buffer as many frames long as before
+        avcodec_ctx->rc_buffer_size = (int) (avcodec_ctx->rc_buffer_size * bits / avcodec_ctx->rc_max_rate);
+      }
+
+      // Keep rc_max_rate != bit_rate for encoders simulating CBR with VBR
+      auto vbr_offset = avcodec_ctx->rc_max_rate - avcodec_ctx->bit_rate;
+      avcodec_ctx->rc_max_rate = bits;
+      avcodec_ctx->bit_rate = bits - vbr_offset;
+      if (avcodec_ctx->rc_min_rate) {
+        avcodec_ctx->rc_min_rate = bits;
+      }
+
+      return true;
+    }
+
+#ifdef AQUA_BUILD_X264
+    /**
+     * @brief The x264 encoder behind libavcodec's libx264 wrapper.
+     * @return The encoder, or `nullptr` if this session doesn't encode with libx264.
+     */
+    x264_t *x264_encoder() const {
+      if (!avcodec_ctx || avcodec_ctx->codec->name != "libx264"sv) {
+        return nullptr;
+      }
+
+      // FFmpeg has no API to reach the x264 handle. Its private context starts with
+      // the AVClass, followed by the x264 parameters and the encoder.
+      // The build only enables this for libavcodec versions checked to match.
+      static_assert(LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MAJOR <= 61, "Check X264Context in libavcodec/libx264.c before allowing this libavcodec version");
+      struct libx264_context_t {
+        const AVClass *av_class;
+        x264_param_t params;
+        x264_t *enc;
+      };
+
+      auto libx264 = (const libx264_context_t *) avcodec_ctx->priv_data;
+      if (!libx264 || !libx264->enc || libx264->params.i_width != avcodec_ctx->width || libx264->params.i_height != avcodec_ctx->height) {
+        BOOST_LOG(warning) << "Unexpected libx264 context layout, reference frame invalidation is unavailable"sv;
+        return nullptr;
+      }
+
+      return libx264->enc;
+    }
+
+    /**
+     * @brief Stop x264 from predicting from `first_frame` and everything encoded after it.
+     * @return `true` if a frame before `first_frame` is still available to predict from.
+     */
+    bool invalidate_x264_ref_frames(x264_t *x264, int64_t first_frame) {
+      x264_param_t params;
+      x264_encoder_parameters(x264, &params);
+
+      // x264 ignores invalidations reaching back before the last IDR frame, and the
+      // frame in front of the lost ones must not have left the reference list yet
+      if (first_frame <= last_idr_frame || last_frame + 1 - first_frame >= params.i_frame_reference) {
+        return false;
+      }
+
+      // Frame pts are the frame numbers the client reports
+      return x264_encoder_invalidate_reference(x264, first_frame) == 0;
+    }
+#endif
+
     avcodec_ctx_t avcodec_ctx;
     std::unique_ptr<platf::avcodec_encode_device_t> device;
 
+    // Frame numbers of the last frame sent to the encoder and of the last IDR frame it produced
+    int64_t last_frame = -1;
+    int64_t last_idr_frame = -1;
+
+    // The next packet is the first one encoded after invalidating reference frames
+    bool after_ref_frame_invalidation = false;
+
+    // The encoder refreshes the picture in waves of intra-coded columns
+    bool intra_refresh = false;
+
     std::vector<packet_raw_t::replace_t> replacements;
 
     cbs::nal_t sps;
@@ -405,6 +613,14 @@ namespace video {
       }
     }
 
+    bool set_bitrate(int bitrate) override {
+      if (!device || !device->nvenc) {
+        return false;
+      }
+
+      return device->nvenc->set_bitrate(bitrate);
+    }
+
     nvenc::nvenc_encoded_frame encode_frame(uint64_t frame_index) {
       if (!device || !device->nvenc) {
         return {};
@@ -427,10 +643,12 @@ namespace video {
     safe::mail_raw_t::event_t<bool> idr_events;
     safe::mail_raw_t::event_t<hdr_info_t> hdr_events;
     safe::mail_raw_t::event_t<input::touch_port_t> touch_port_events;
+    safe::mail_raw_t::event_t<int> switch_display_events;
 
     config_t config;
     int frame_nr;
     void *channel_data;
+    std::shared_ptr<metrics::session_t> metrics;
   };
 
   struct sync_session_t {
@@ -453,6 +671,9 @@ namespace video {
     safe::signal_t reinit_event;
     const encoder_t *encoder_p;
     sync_util::sync_t<std::weak_ptr<platf::display_t>> display_wp;
+
+    // The display captured by this thread
+    std::string display_name;
   };
 
   struct capture_thread_sync_ctx_t {
@@ -465,9 +686,35 @@ namespace video {
   void end_capture_async(capture_thread_async_ctx_t &ctx);
 
   // Keep a reference counter to ensure the capture thread only runs when other threads have a reference to the capture thread
-  auto capture_thread_async = safe::make_shared<capture_thread_async_ctx_t>(start_capture_async, end_capture_async);
   auto capture_thread_sync = safe::make_shared<capture_thread_sync_ctx_t>(start_capture_sync, end_capture_sync);
 
+  // Asynchronous capture runs one capture thread per display, each with its own image pool and reinit lifecycle
+  std::mutex capture_threads_async_lock;
+  std::map<std::string, std::unique_ptr<safe::shared_t<capture_thread_async_ctx_t>>> capture_threads_async;
+
+  /**
+   * @brief Get a reference to the capture thread of a display.
+   * @details The capture thread is started by the first reference and stopped when the last reference is released.
+   * @param display_name The name of the display to capture.
+   * @return A reference to the capture thread context.
+   */
+  safe::shared_t<capture_thread_async_ctx_t>::ptr_t ref_capture_thread_async(const std::string &display_name) {
+    std::lock_guard lg {capture_threads_async_lock};
+
+    auto &capture_thread = capture_threads_async[display_name];
+    if (!capture_thread) {
+      capture_thread = std::make_unique<safe::shared_t<capture_thread_async_ctx_t>>(
+        [display_name](capture_thread_async_ctx_t &ctx) {
+          ctx.display_name = display_name;
+          return start_capture_async(ctx);
+        },
+        end_capture_async
+      );
+    }
+
+    return capture_thread->ref();
+  }
+
 #ifdef _WIN32
   encoder_t nvenc {
     "nvenc"sv,
@@ -872,7 +1119,11 @@ namespace video {
       {},  // Fallback options
       "libx264"s,
     },
+#ifdef AQUA_BUILD_X264
+    H264_ONLY | PARALLEL_ENCODING | REF_FRAMES_INVALIDATION | ALWAYS_REPROBE | YUV444_SUPPORT
+#else
     H264_ONLY | PARALLEL_ENCODING | ALWAYS_REPROBE | YUV444_SUPPORT
+#endif
   };
 
 #ifdef __linux__
@@ -1020,10 +1271,18 @@ namespace video {
   };
 
   static encoder_t *chosen_encoder;
-  int active_hevc_mode;
-  int active_av1_mode;
-  bool last_encoder_probe_supported_ref_frames_invalidation = false;
-  std::array<bool, 3> last_encoder_probe_supported_yuv444_for_codec = {
+
+  // Serializes probes with the revalidation of cached probe results in the background.
+  // Declared last, so shutdown waits for the revalidation before anything it uses is destroyed.
+  static std::mutex probe_lock;
+  static std::condition_variable probe_revalidated;
+  static bool probe_revalidation_pending = false;
+  static std::future<void> probe_revalidation;
+
+  std::atomic<int> active_hevc_mode;
+  std::atomic<int> active_av1_mode;
+  std::atomic<bool> last_encoder_probe_supported_ref_frames_invalidation = false;
+  std::array<std::atomic<bool>, 3> last_encoder_probe_supported_yuv444_for_codec = {
     true,
     true,
     true
@@ -1110,7 +1369,8 @@ namespace video {
     std::shared_ptr<safe::queue_t<capture_ctx_t>> capture_ctx_queue,
     sync_util::sync_t<std::weak_ptr<platf::display_t>> &display_wp,
     safe::signal_t &reinit_event,
-    const encoder_t &encoder
+    const encoder_t &encoder,
+    std::string display_name
   ) {
     std::vector<capture_ctx_t> capture_ctxs;
 
@@ -1126,8 +1386,6 @@ namespace video {
       }
     });
 
-    auto switch_display_event = mail::man->event<int>(mail::switch_display);
-
     // Wait for the initial capture context or a request to stop the queue
     auto initial_capture_ctx = capture_ctx_queue->pop();
     if (!initial_capture_ctx) {
@@ -1137,18 +1395,13 @@ namespace video {
 
     std::vector<std::string> display_names;
     int display_p = -1;
-    std::shared_ptr<platf::display_t> disp;
-    if (!proc::proc.display_name.empty()) {
-      disp = platf::display(encoder.platform_formats->dev_type, proc::proc.display_name, capture_ctxs.front().config);
-    }
+    std::shared_ptr<platf::display_t> disp = platf::display(encoder.platform_formats->dev_type, display_name, capture_ctxs.front().config);
     if (!disp) {
       // Get all the monitor names now, rather than at boot, to
       // get the most up-to-date list available monitors
-      refresh_displays(encoder.platform_formats->dev_type, display_names, display_p);
+      refresh_displays(encoder.platform_formats->dev_type, display_names, display_p, display_name);
       disp = platf::display(encoder.platform_formats->dev_type, display_names[display_p], capture_ctxs.front().config);
-      if (disp) {
-        proc::proc.display_name = display_names[display_p];
-      } else {
+      if (!disp) {
         return;
       }
     }
@@ -1208,7 +1461,11 @@ namespace video {
       }
     };
 
+    // Set once an image is handed to the capture backend, until the backend pushes it back
+    std::optional<std::chrono::steady_clock::time_point> capture_begin;
+
     auto pull_free_image_callback = [&](std::shared_ptr<platf::img_t> &img_out) -> bool {
+      auto acquire_begin = std::chrono::steady_clock::now();
       img_out.reset();
       while (capture_ctx_queue->running()) {
         // pick first allocated but unused
@@ -1243,6 +1500,11 @@ namespace video {
           // trim allocated but unused portion of the pool based on timeouts
           trim_imgs();
           img_out->frame_timestamp.reset();
+          img_out->damage_sequence = 0;
+          img_out->damage.clear();
+
+          capture_begin = std::chrono::steady_clock::now();
+          frame_trace::record(frame_trace::stage_e::pool_acquire, -1, acquire_begin, *capture_begin);
           return true;
         } else {
           // sleep and retry if image pool is full
@@ -1254,11 +1516,15 @@ namespace video {
 
     // Capture takes place on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::critical);
+    frame_trace::name_thread("Capture ["s + display_name + ']');
 
     while (capture_ctx_queue->running()) {
-      bool artificial_reinit = false;
-
       auto push_captured_image_callback = [&](std::shared_ptr<platf::img_t> &&img, bool frame_captured) -> bool {
+        if (frame_captured && capture_begin) {
+          frame_trace::record(frame_trace::stage_e::capture, -1, *capture_begin, std::chrono::steady_clock::now());
+        }
+        capture_begin.reset();
+
         KITTY_WHILE_LOOP(auto capture_ctx = std::begin(capture_ctxs), capture_ctx != std::end(capture_ctxs), {
           if (!capture_ctx->images->running()) {
             capture_ctx = capture_ctxs.erase(capture_ctx);
@@ -1281,22 +1547,11 @@ namespace video {
           capture_ctxs.emplace_back(std::move(*capture_ctx_queue->pop()));
         }
 
-        if (switch_display_event->peek()) {
-          artificial_reinit = true;
-          return false;
-        }
-
         return true;
       };
 
       auto status = disp->capture(push_captured_image_callback, pull_free_image_callback, &display_cursor);
 
-      if (artificial_reinit && status != platf::capture_e::error) {
-        status = platf::capture_e::reinit;
-
-        artificial_reinit = false;
-      }
-
       switch (status) {
         case platf::capture_e::reinit:
           {
@@ -1337,17 +1592,11 @@ namespace video {
               disp.reset();
 
               // Refresh display names since a display removal might have caused the reinitialization
-              refresh_displays(encoder.platform_formats->dev_type, display_names, display_p, proc::proc.display_name);
-
-              // Process any pending display switch with the new list of displays
-              if (switch_display_event->peek()) {
-                display_p = std::clamp(*switch_display_event->pop(), 0, (int) display_names.size() - 1);
-              }
+              refresh_displays(encoder.platform_formats->dev_type, display_names, display_p, display_name);
 
               // reset_display() will sleep between retries
               reset_display(disp, encoder.platform_formats->dev_type, display_names[display_p], capture_ctxs.front().config);
               if (disp) {
-                proc::proc.display_name = display_names[display_p];
                 break;
               }
             }
@@ -1372,7 +1621,7 @@ namespace video {
     }
   }
 
-  int encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  int encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, metrics::session_t *metrics, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
     auto &frame = session.device->frame;
     frame->pts = frame_nr;
 
@@ -1382,19 +1631,26 @@ namespace video {
     auto &vps = session.vps;
 
     // send the frame to the encoder
-    auto ret = avcodec_send_frame(ctx.get(), frame);
+    auto ret = [&]() {
+      frame_trace::scope_t trace {frame_trace::stage_e::encode_submit, frame_nr};
+      return avcodec_send_frame(ctx.get(), frame);
+    }();
     if (ret < 0) {
       char err_str[AV_ERROR_MAX_STRING_SIZE] {0};
       BOOST_LOG(error) << "Could not send a frame for encoding: "sv << av_make_error_string(err_str, AV_ERROR_MAX_STRING_SIZE, ret);
 
       return -1;
     }
+    session.last_frame = frame_nr;
 
     while (ret >= 0) {
       auto packet = std::make_unique<packet_raw_avcodec>();
       auto av_packet = packet.get()->av_packet;
 
-      ret = avcodec_receive_packet(ctx.get(), av_packet);
+      {
+        frame_trace::scope_t trace {frame_trace::stage_e::encode_receive, frame_nr};
+        ret = avcodec_receive_packet(ctx.get(), av_packet);
+      }
       if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
         return 0;
       } else if (ret < 0) {
@@ -1403,6 +1659,7 @@ namespace video {
 
       if (av_packet->flags & AV_PKT_FLAG_KEY) {
         BOOST_LOG(debug) << "Frame "sv << frame_nr << ": IDR Keyframe (AV_FRAME_FLAG_KEY)"sv;
+        session.last_idr_frame = av_packet->pts;
       }
 
       if ((frame->flags & AV_FRAME_FLAG_KEY) && !(av_packet->flags & AV_PKT_FLAG_KEY)) {
@@ -1440,14 +1697,23 @@ namespace video {
 
       packet->replacements = &session.replacements;
       packet->channel_data = channel_data;
+      packet->after_ref_frame_invalidation = std::exchange(session.after_ref_frame_invalidation, false);
+      packet->queued_at = std::chrono::steady_clock::now();
+      if (metrics) {
+        packet->queued.emplace(*metrics);
+      }
       packets->raise(std::move(packet));
     }
 
     return 0;
   }
 
-  int encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
-    auto encoded_frame = session.encode_frame(frame_nr);
+  int encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, metrics::session_t *metrics, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+    // NVENC submits and waits for the bitstream in one call
+    auto encoded_frame = [&]() {
+      frame_trace::scope_t trace {frame_trace::stage_e::encode_submit, frame_nr};
+      return session.encode_frame(frame_nr);
+    }();
     if (encoded_frame.data.empty()) {
       BOOST_LOG(error) << "NvENC returned empty packet";
       return -1;
@@ -1461,16 +1727,20 @@ namespace video {
     packet->channel_data = channel_data;
     packet->after_ref_frame_invalidation = encoded_frame.after_ref_frame_invalidation;
     packet->frame_timestamp = frame_timestamp;
+    packet->queued_at = std::chrono::steady_clock::now();
+    if (metrics) {
+      packet->queued.emplace(*metrics);
+    }
     packets->raise(std::move(packet));
 
     return 0;
   }
 
-  int encode(int64_t frame_nr, encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  int encode(int64_t frame_nr, encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, metrics::session_t *metrics, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
     if (auto avcodec_session = dynamic_cast<avcodec_encode_session_t *>(&session)) {
-      return encode_avcodec(frame_nr, *avcodec_session, packets, channel_data, frame_timestamp);
+      return encode_avcodec(frame_nr, *avcodec_session, packets, channel_data, metrics, frame_timestamp);
     } else if (auto nvenc_session = dynamic_cast<nvenc_encode_session_t *>(&session)) {
-      return encode_nvenc(frame_nr, *nvenc_session, packets, channel_data, frame_timestamp);
+      return encode_nvenc(frame_nr, *nvenc_session, packets, channel_data, metrics, frame_timestamp);
     }
 
     return -1;
@@ -1514,6 +1784,10 @@ namespace video {
       return nullptr;
     }
 
+    // Clients that can live with a few frames of artifacts ask for intra refresh,
+    // which spreads the cost of an IDR frame over many frames
+    bool intra_refresh = config.enableIntraRefresh == 1 && (video_format.name == "libx264"sv || video_format.name == "libx265"sv);
+
     auto colorspace = encode_device->colorspace;
     auto sw_fmt = (colorspace.bit_depth == 8 && config.chromaSamplingType == 0)  ? platform_formats->avcodec_pix_fmt_8bit :
                   (colorspace.bit_depth == 8 && config.chromaSamplingType == 1)  ? platform_formats->avcodec_pix_fmt_yuv444_8bit :
@@ -1575,6 +1849,13 @@ namespace video {
           BOOST_LOG(warning) << "Client requested reference frame limit, but encoder doesn't support it!"sv;
         }
       }
+#ifdef AQUA_BUILD_X264
+      else if (config.refPicInvalidation && video_format.name == "libx264"sv) {
+        // The fast presets keep a single reference frame, which leaves nothing
+        // to fall back on when the client asks to invalidate the latest ones
+        ctx->refs = 4;
+      }
+#endif
 
       // We forcefully reset the flags to avoid clash on reuse of AVCodecContext
       ctx->flags = 0;
@@ -1711,6 +1992,18 @@ namespace video {
         }
       }
 
+      // A refresh wave sweeps over the picture once per second of frames
+      if (intra_refresh) {
+        if (video_format.name == "libx264"sv) {
+          av_dict_set_int(&options, "intra-refresh", 1, 0);
+          ctx->gop_size = config.framerate;
+        } else {
+          auto x265_params = av_dict_get(options, "x265-params", nullptr, 0);
+          auto params = (x265_params ? x265_params->value + ":"s : ""s) + "intra-refresh=1:keyint="s + std::to_string(config.framerate);
+          av_dict_set(&options, "x265-params", params.c_str(), 0);
+        }
+      }
+
       auto bitrate = config.bitrate * 1000;
       ctx->rc_max_rate = bitrate;
       ctx->bit_rate = bitrate;
@@ -1841,6 +2134,11 @@ namespace video {
       // 0 ==> don't inject, 1 ==> inject for h264, 2 ==> inject for hevc
       config.videoFormat <= 1 ? (1 - (int) video_format[encoder_t::VUI_PARAMETERS]) * (1 + config.videoFormat) : 0
     );
+    session->intra_refresh = intra_refresh;
+
+    if (intra_refresh) {
+      BOOST_LOG(info) << video_format.name << ": using intra refresh instead of IDR frames to recover from loss"sv;
+    }
 
     return session;
   }
@@ -1865,37 +2163,57 @@ namespace video {
     return nullptr;
   }
 
-  void encode_run(
-    int &frame_nr,  // Store progress of the frame number
-    safe::mail_t mail,
-    img_event_t images,
-    config_t config,
-    std::shared_ptr<platf::display_t> disp,
-    std::unique_ptr<platf::encode_device_t> encode_device,
-    safe::signal_t &reinit_event,
-    const encoder_t &encoder,
-    void *channel_data
-  ) {
-    auto session = make_encode_session(disp.get(), encoder, config, disp->width, disp->height, std::move(encode_device));
-    if (!session) {
+  /**
+   * @brief Log how long a session waited for its first video packet, once.
+   * @param session_start When the session started capturing, reset after logging.
+   */
+  void log_time_to_first_frame(std::optional<std::chrono::steady_clock::time_point> &session_start) {
+    if (!session_start) {
       return;
     }
 
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - *session_start);
+    BOOST_LOG(info) << "Time to first frame: "sv << delay.count() << "ms"sv;
+    session_start.reset();
+  }
+
+  std::unique_ptr<platf::encode_device_t> make_encode_device(platf::display_t &disp, const encoder_t &encoder, const config_t &config);
+
+  /**
+   * @brief Destroy an encode session, on a separate thread if the encoder supports it.
+   */
+  void release_encode_session(const encoder_t &encoder, std::unique_ptr<encode_session_t> session) {
     // As a workaround for NVENC hangs and to generally speed up encoder reinit,
     // we will complete the encoder teardown in a separate thread if supported.
     // This will move expensive processing off the encoder thread to allow us
     // to restart encoding as soon as possible. For cases where the NVENC driver
     // hang occurs, this thread may probably never exit, but it will allow
     // streaming to continue without requiring a full restart of Sunshine.
+    if (encoder.flags & ASYNC_TEARDOWN) {
+      std::thread encoder_teardown_thread {[session = std::move(session)]() mutable {
+        BOOST_LOG(info) << "Starting async encoder teardown";
+        session.reset();
+        BOOST_LOG(info) << "Async encoder teardown complete";
+      }};
+      encoder_teardown_thread.detach();
+    }
+  }
+
+  void encode_run(
+    int &frame_nr,  // Store progress of the frame number
+    safe::mail_t mail,
+    img_event_t images,
+    config_t &config,  // Keeps the bitrate changed during the session across reinit
+    std::shared_ptr<platf::display_t> disp,
+    std::unique_ptr<encode_session_t> session,
+    safe::signal_t &reinit_event,
+    const encoder_t &encoder,
+    void *channel_data,
+    metrics::session_t &metrics,
+    std::optional<std::chrono::steady_clock::time_point> &session_start
+  ) {
     auto fail_guard = util::fail_guard([&encoder, &session] {
-      if (encoder.flags & ASYNC_TEARDOWN) {
-        std::thread encoder_teardown_thread {[session = std::move(session)]() mutable {
-          BOOST_LOG(info) << "Starting async encoder teardown";
-          session.reset();
-          BOOST_LOG(info) << "Async encoder teardown complete";
-        }};
-        encoder_teardown_thread.detach();
-      }
+      release_encode_session(encoder, std::move(session));
     });
 
     // set minimum frame time, avoiding violation of client-requested target framerate
@@ -1905,9 +2223,19 @@ namespace video {
     BOOST_LOG(info) << "Frame threshold: "sv << frame_threshold;
 
     auto shutdown_event = mail->event<bool>(mail::shutdown);
+    auto switch_display_event = mail->event<int>(mail::switch_display);
     auto packets = mail::man->queue<packet_t>(mail::video_packets);
     auto idr_events = mail->event<bool>(mail::idr);
+    frame_trace::name_thread("Encode");
     auto invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
+    auto bitrate_events = mail->event<int>(mail::bitrate);
+
+    // The last converted image, loaded into a recreated encoder
+    std::shared_ptr<platf::img_t> last_img;
+
+    // Bitrate asked for while the encoder has to be recreated to change it
+    std::optional<int> pending_bitrate;
+    auto last_recreation = std::chrono::steady_clock::now();
 
     {
       // Load a dummy image into the AVFrame to ensure we have something to encode
@@ -1924,13 +2252,14 @@ namespace video {
       BOOST_LOG(info) << "Input only session, video will not be captured."sv;
 
       // Encode the dummy img only once
-      if (encode(frame_nr++, *session, packets, channel_data, std::chrono::steady_clock::now())) {
+      if (encode(frame_nr++, *session, packets, channel_data, &metrics, std::chrono::steady_clock::now())) {
         BOOST_LOG(error) << "Could not encode dummy video packet"sv;
         return;
       }
+      log_time_to_first_frame(session_start);
 
       while (true) {
-        if (shutdown_event->peek() || !images->running() || (reinit_event.peek())) {
+        if (shutdown_event->peek() || !images->running() || reinit_event.peek() || switch_display_event->peek()) {
           return;
         } else {
           std::this_thread::sleep_for(300ms);
@@ -1945,10 +2274,11 @@ namespace video {
       // a) The stream is ending
       // b) Sunshine is quitting
       // c) The capture side is waiting to reinit and we've encoded at least one frame
+      // d) The client asked to switch to another display
       //
       // If we have to reinit before we have received any captured frames, we will encode
       // the blank dummy frame just to let Moonlight know that we're alive.
-      if (shutdown_event->peek() || !images->running() || (reinit_event.peek() && frame_nr > 1)) {
+      if (shutdown_event->peek() || !images->running() || (reinit_event.peek() && frame_nr > 1) || switch_display_event->peek()) {
         break;
       }
 
@@ -1965,6 +2295,54 @@ namespace video {
         idr_events->pop();
       }
 
+      if (bitrate_events->peek()) {
+        if (auto bitrate = bitrate_events->pop(0ms)) {
+          if (session->set_bitrate(*bitrate)) {
+            config.bitrate = *bitrate;
+            pending_bitrate.reset();
+            metrics.add(metrics::counter_e::encoder_reconfigurations);
+          } else {
+            // The encoder can't change its bitrate in place, it's replaced once the change is worth a key frame
+            pending_bitrate = *bitrate;
+          }
+        }
+      }
+
+      if (pending_bitrate && bitrate_control::should_recreate(config.bitrate, *pending_bitrate, std::chrono::steady_clock::now() - last_recreation)) {
+        BOOST_LOG(info) << "Recreating encoder for a bitrate of "sv << *pending_bitrate << " kbps"sv;
+        last_recreation = std::chrono::steady_clock::now();
+
+        auto new_config = config;
+        new_config.bitrate = *pending_bitrate;
+        pending_bitrate.reset();
+
+        auto encode_device = make_encode_device(*disp, encoder, new_config);
+        auto new_session = encode_device ? make_encode_session(disp.get(), encoder, new_config, disp->width, disp->height, std::move(encode_device)) : nullptr;
+
+        if (new_session && !last_img) {
+          last_img = disp->alloc_img();
+          if (last_img && disp->dummy_img(last_img.get())) {
+            last_img.reset();
+          }
+        }
+
+        // The current encoder keeps going at its bitrate if the new one can't take over
+        if (!new_session || !last_img || new_session->convert(*last_img)) {
+          BOOST_LOG(warning) << "Couldn't recreate the encoder, keeping "sv << config.bitrate << " kbps"sv;
+          if (new_session) {
+            release_encode_session(encoder, std::move(new_session));
+          }
+        } else {
+          release_encode_session(encoder, std::move(session));
+          session = std::move(new_session);
+          config.bitrate = new_config.bitrate;
+          metrics.add(metrics::counter_e::encoder_recreations);
+
+          // A new encoder starts with a key frame
+          requested_idr_frame = true;
+        }
+      }
+
       if (requested_idr_frame) {
         session->request_idr_frame();
       }
@@ -1975,14 +2353,18 @@ namespace video {
       if (!requested_idr_frame || images->peek()) {
         if (auto img = images->pop(minimum_frame_time)) {
           frame_timestamp = img->frame_timestamp;
+          metrics.add(metrics::counter_e::frames_captured);
           // If new frame comes in way too fast, just drop
           if (*frame_timestamp < next_frame_start) {
+            metrics.add(metrics::counter_e::frames_dropped);
             continue;
           }
+          frame_trace::scope_t trace {frame_trace::stage_e::convert, frame_nr};
           if (session->convert(*img)) {
             BOOST_LOG(error) << "Could not convert image"sv;
             break;
           }
+          last_img = std::move(img);
         } else if (!images->running()) {
           break;
         }
@@ -1999,10 +2381,14 @@ namespace video {
         }
       }
 
-      if (encode(frame_nr++, *session, packets, channel_data, frame_timestamp)) {
+      auto encode_begin = std::chrono::steady_clock::now();
+      if (encode(frame_nr++, *session, packets, channel_data, &metrics, frame_timestamp)) {
         BOOST_LOG(error) << "Could not encode video packet"sv;
         break;
       }
+      metrics.encode_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - encode_begin).count());
+      metrics.add(metrics::counter_e::frames_encoded);
+      log_time_to_first_frame(session_start);
 
       session->request_normal_frame();
     }
@@ -2139,7 +2525,12 @@ namespace video {
 
     std::shared_ptr<platf::display_t> disp;
 
-    auto switch_display_event = mail::man->event<int>(mail::switch_display);
+    // All synced sessions share a single display, so a display switch from any of them applies to all
+    auto switch_display_requested = [&synced_session_ctxs]() {
+      return std::any_of(std::begin(synced_session_ctxs), std::end(synced_session_ctxs), [](const auto &ctx) {
+        return ctx->switch_display_events->peek();
+      });
+    };
 
     if (synced_session_ctxs.empty()) {
       auto ctx = encode_session_ctx_queue.pop();
@@ -2155,8 +2546,10 @@ namespace video {
       refresh_displays(encoder.platform_formats->dev_type, display_names, display_p);
 
       // Process any pending display switch with the new list of displays
-      if (switch_display_event->peek()) {
-        display_p = std::clamp(*switch_display_event->pop(), 0, (int) display_names.size() - 1);
+      for (auto &ctx : synced_session_ctxs) {
+        if (ctx->switch_display_events->peek()) {
+          display_p = std::clamp(*ctx->switch_display_events->pop(), 0, (int) display_names.size() - 1);
+        }
       }
 
       // reset_display() will sleep between retries
@@ -2228,6 +2621,10 @@ namespace video {
             ctx->idr_events->pop();
           }
 
+          if (frame_captured) {
+            ctx->metrics->add(metrics::counter_e::frames_captured);
+          }
+
           if (frame_captured && pos->session->convert(*img)) {
             BOOST_LOG(error) << "Could not convert image"sv;
             ctx->shutdown_event->raise(true);
@@ -2240,19 +2637,22 @@ namespace video {
             frame_timestamp = img->frame_timestamp;
           }
 
-          if (encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, frame_timestamp)) {
+          auto encode_begin = std::chrono::steady_clock::now();
+          if (encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, ctx->metrics.get(), frame_timestamp)) {
             BOOST_LOG(error) << "Could not encode video packet"sv;
             ctx->shutdown_event->raise(true);
 
             continue;
           }
+          ctx->metrics->encode_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - encode_begin).count());
+          ctx->metrics->add(metrics::counter_e::frames_encoded);
 
           pos->session->request_normal_frame();
 
           ++pos;
         })
 
-        if (switch_display_event->peek()) {
+        if (switch_display_requested()) {
           ec = platf::capture_e::reinit;
           return false;
         }
@@ -2263,6 +2663,8 @@ namespace video {
       auto pull_free_image_callback = [&img](std::shared_ptr<platf::img_t> &img_out) -> bool {
         img_out = img;
         img_out->frame_timestamp.reset();
+        img_out->damage_sequence = 0;
+        img_out->damage.clear();
         return true;
       };
 
@@ -2308,100 +2710,482 @@ namespace video {
     while (encode_run_sync(synced_session_ctxs, ctx, display_names, display_p) == encode_e::reinit) {}
   }
 
+  /**
+   * @brief An encoder built during launch, waiting for its session to start.
+   */
+  struct prewarmed_encoder_t {
+    prewarmed_encoder_t() = default;
+    prewarmed_encoder_t(prewarmed_encoder_t &&) = default;
+    prewarmed_encoder_t &operator=(prewarmed_encoder_t &&) = default;
+
+    ~prewarmed_encoder_t() {
+      // Unsubscribe from the capture thread, it drops stopped capture contexts on its own
+      if (images) {
+        images->stop();
+      }
+    }
+
+    std::string display_name;
+    config_t config;
+    const encoder_t *encoder = nullptr;
+
+    // Keeps the capture thread, and thus the display, alive until the session subscribes to it
+    safe::shared_t<capture_thread_async_ctx_t>::ptr_t ref;
+    img_event_t images;
+
+    std::weak_ptr<platf::display_t> display;
+    sunshine_colorspace_t colorspace;
+    std::unique_ptr<encode_session_t> session;
+  };
+
+  /**
+   * @brief The prewarmed encoder of a client whose launch is pending.
+   */
+  struct prewarm_slot_t {
+    // Identifies the prewarm, so superseded builds and expiry tasks know to back off
+    std::uint64_t generation;
+
+    bool building;
+    std::string display_name;
+    config_t config;
+
+    std::optional<prewarmed_encoder_t> ready;
+  };
+
+  /**
+   * @brief Launches of several clients can be pending at once, each one gets its own slot.
+   */
+  struct prewarm_slots_t {
+    std::mutex lock;
+    std::condition_variable cv;
+
+    // Bumped by every prewarm
+    std::uint64_t generation = 0;
+
+    // Keyed by the unique ID of the client
+    std::unordered_map<std::string, prewarm_slot_t> clients;
+  };
+
+  struct client_config_t {
+    launch_mode_t mode;
+    config_t config;
+  };
+
+  // Unclaimed encoders are released after this long, the client connects within seconds of the launch
+  constexpr auto prewarm_timeout = 20s;
+
+  // How long to wait for the display of the predicted session to come up
+  constexpr auto prewarm_display_timeout = 5s;
+
+  // Each prewarmed encoder holds a hardware encode session, launches beyond this evict the oldest one
+  constexpr std::size_t max_prewarmed_encoders = 4;
+
+  static std::mutex client_configs_lock;
+  static std::unordered_map<std::string, client_config_t> client_configs;
+
+  static prewarm_slots_t prewarm;
+
+  bool same_config(const config_t &a, const config_t &b) {
+    auto fields = [](const config_t &c) {
+      return std::tie(
+        c.width,
+        c.height,
+        c.framerate,
+        c.bitrate,
+        c.slicesPerFrame,
+        c.numRefFrames,
+        c.encoderCscMode,
+        c.videoFormat,
+        c.dynamicRange,
+        c.chromaSamplingType,
+        c.enableIntraRefresh,
+        c.encodingFramerate,
+        c.input_only,
+        c.refPicInvalidation
+      );
+    };
+
+    return fields(a) == fields(b);
+  }
+
+  void remember_client_config(const std::string &client_id, const launch_mode_t &mode, const config_t &config) {
+    if (config.input_only) {
+      return;
+    }
+
+    std::lock_guard lg {client_configs_lock};
+    client_configs.insert_or_assign(client_id, client_config_t {mode, config});
+  }
+
+  void build_prewarmed_encoder(std::string client_id, std::uint64_t generation, std::string display_name, config_t config) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::optional<prewarmed_encoder_t> built;
+    auto fg = util::fail_guard([&]() {
+      {
+        std::lock_guard lg {prewarm.lock};
+
+        // If this build has been superseded, the encoder is destroyed with built instead
+        auto it = prewarm.clients.find(client_id);
+        if (it != prewarm.clients.end() && it->second.generation == generation) {
+          it->second.building = false;
+          it->second.ready.swap(built);
+        }
+      }
+
+      prewarm.cv.notify_all();
+    });
+
+    auto &encoder = *chosen_encoder;
+
+    built.emplace();
+    built->display_name = display_name;
+    built->config = config;
+    built->encoder = &encoder;
+
+    built->ref = ref_capture_thread_async(display_name);
+    if (!built->ref) {
+      built.reset();
+      return;
+    }
+
+    built->images = std::make_shared<img_event_t::element_type>();
+    built->ref->capture_ctx_queue->raise(capture_ctx_t {built->images, config});
+
+    // Wait for the capture thread to open the display
+    std::shared_ptr<platf::display_t> display;
+    while (!display) {
+      if (!built->ref->capture_ctx_queue->running() || std::chrono::steady_clock::now() - start > prewarm_display_timeout) {
+        BOOST_LOG(warning) << "Display ["sv << display_name << "] didn't come up in time to prewarm an encoder"sv;
+        built.reset();
+        return;
+      }
+
+      if (!built->ref->reinit_event.peek()) {
+        auto lg = built->ref->display_wp.lock();
+        display = built->ref->display_wp->lock();
+      }
+
+      if (!display) {
+        std::this_thread::sleep_for(20ms);
+      }
+    }
+
+    auto encode_device = make_encode_device(*display, encoder, config);
+    if (!encode_device) {
+      built.reset();
+      return;
+    }
+
+    built->colorspace = encode_device->colorspace;
+    built->session = make_encode_session(display.get(), encoder, config, display->width, display->height, std::move(encode_device));
+    if (!built->session) {
+      built.reset();
+      return;
+    }
+    built->display = display;
+
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    BOOST_LOG(info) << "Prewarmed encoder for ["sv << display_name << "] in "sv << delay.count() << "ms"sv;
+  }
+
+  void expire_prewarmed_encoder(const std::string &client_id, std::uint64_t generation) {
+    std::optional<prewarmed_encoder_t> expired;
+    {
+      std::lock_guard lg {prewarm.lock};
+      auto it = prewarm.clients.find(client_id);
+      if (it == prewarm.clients.end() || it->second.generation != generation) {
+        return;
+      }
+
+      // Abandon a build that is still running as well
+      expired.swap(it->second.ready);
+      prewarm.clients.erase(it);
+    }
+
+    prewarm.cv.notify_all();
+
+    if (expired) {
+      BOOST_LOG(info) << "No session claimed the prewarmed encoder for ["sv << expired->display_name << ']';
+    }
+  }
+
+  void prewarm_encoder(const std::string &client_id, const launch_mode_t &mode) {
+    // Synchronous capture shares a single encoding thread between sessions, there's nothing to hand over
+    if (!chosen_encoder || !(chosen_encoder->flags & PARALLEL_ENCODING)) {
+      return;
+    }
+
+    config_t config;
+    {
+      std::lock_guard lg {client_configs_lock};
+
+      auto it = client_configs.find(client_id);
+      if (it == client_configs.end() || it->second.mode != mode) {
+        BOOST_LOG(debug) << "No previous session of this client to predict the encoding configuration from"sv;
+        return;
+      }
+
+      config = it->second.config;
+    }
+
+    // Mirror the display selection of capture_async()
+    std::string display_name = proc::proc.display_name;
+    if (display_name.empty()) {
+      std::vector<std::string> display_names;
+      int display_p = -1;
+      refresh_displays(chosen_encoder->platform_formats->dev_type, display_names, display_p);
+      display_name = display_names[display_p];
+    }
+
+    std::optional<prewarmed_encoder_t> discarded;
+    std::optional<prewarmed_encoder_t> evicted;
+    std::uint64_t generation;
+    {
+      std::lock_guard lg {prewarm.lock};
+
+      if (!prewarm.clients.count(client_id) && prewarm.clients.size() >= max_prewarmed_encoders) {
+        auto oldest = std::min_element(std::begin(prewarm.clients), std::end(prewarm.clients), [](const auto &a, const auto &b) {
+          return a.second.generation < b.second.generation;
+        });
+
+        evicted.swap(oldest->second.ready);
+        prewarm.clients.erase(oldest);
+      }
+
+      generation = ++prewarm.generation;
+
+      auto &slot = prewarm.clients[client_id];
+      slot.generation = generation;
+      slot.building = true;
+      slot.display_name = display_name;
+      slot.config = config;
+      slot.ready.swap(discarded);
+    }
+
+    // A claim may be waiting on the evicted build
+    prewarm.cv.notify_all();
+
+    std::thread {build_prewarmed_encoder, client_id, generation, std::move(display_name), config}.detach();
+    task_pool.pushDelayed(&expire_prewarmed_encoder, prewarm_timeout, client_id, generation);
+  }
+
+  /**
+   * @brief Take over the prewarmed encoder of a client if it was built for this display and configuration.
+   * @param client_id Unique ID of the client.
+   * @param display_name The display the session captures.
+   * @param config The negotiated encoding configuration of the session.
+   * @return The prewarmed encoder, or `std::nullopt` if there is none or it doesn't match.
+   */
+  std::optional<prewarmed_encoder_t> claim_prewarmed_encoder(const std::string &client_id, const std::string &display_name, const config_t &config) {
+    std::optional<prewarmed_encoder_t> prewarmed;
+    {
+      std::unique_lock ul {prewarm.lock};
+
+      auto it = prewarm.clients.find(client_id);
+      if (it == prewarm.clients.end()) {
+        return std::nullopt;
+      }
+
+      // Waiting for a matching build to finish is never slower than starting another one
+      if (it->second.building && it->second.display_name == display_name && same_config(it->second.config, config)) {
+        auto generation = it->second.generation;
+
+        // Other clients may come and go while waiting, so the slot is looked up again every time
+        prewarm.cv.wait_for(ul, prewarm_timeout, [&] {
+          it = prewarm.clients.find(client_id);
+          return it == prewarm.clients.end() || it->second.generation != generation || !it->second.building;
+        });
+
+        if (it == prewarm.clients.end()) {
+          return std::nullopt;
+        }
+      }
+
+      // Whatever is left over must not hold on to the capture thread
+      prewarmed.swap(it->second.ready);
+      prewarm.clients.erase(it);
+    }
+
+    if (!prewarmed) {
+      return std::nullopt;
+    }
+
+    if (prewarmed->display_name != display_name || prewarmed->encoder != chosen_encoder || !same_config(prewarmed->config, config)) {
+      BOOST_LOG(info) << "Prewarmed encoder doesn't match the session configuration, discarding it"sv;
+      return std::nullopt;
+    }
+
+    BOOST_LOG(info) << "Using the prewarmed encoder for ["sv << display_name << ']';
+    return prewarmed;
+  }
+
   void capture_async(
     safe::mail_t mail,
     config_t &config,
-    void *channel_data
+    void *channel_data,
+    metrics::session_t &metrics,
+    const std::string &client_id
   ) {
+    std::optional<std::chrono::steady_clock::time_point> session_start = std::chrono::steady_clock::now();
+
     auto shutdown_event = mail->event<bool>(mail::shutdown);
+    auto switch_display_event = mail->event<int>(mail::switch_display);
 
-    auto images = std::make_shared<img_event_t::element_type>();
+    img_event_t images;
     auto lg = util::fail_guard([&]() {
-      images->stop();
+      if (images) {
+        images->stop();
+      }
       shutdown_event->raise(true);
     });
 
-    auto ref = capture_thread_async.ref();
-    if (!ref) {
-      return;
-    }
+    const auto dev_type = chosen_encoder->platform_formats->dev_type;
 
-    ref->capture_ctx_queue->raise(capture_ctx_t {images, config});
+    std::vector<std::string> display_names;
+    int display_p = -1;
 
-    if (!ref->capture_ctx_queue->running()) {
-      return;
+    // Start on the display the app runs on, or the configured output display otherwise
+    std::string display_name = proc::proc.display_name;
+    if (display_name.empty()) {
+      // Get all the monitor names now, rather than at boot, to
+      // get the most up-to-date list available monitors
+      refresh_displays(dev_type, display_names, display_p);
+      display_name = display_names[display_p];
+      proc::proc.display_name = display_name;
     }
 
+    // Claimed before subscribing to the capture thread, so a mismatching encoder
+    // can't keep a display opened with the wrong configuration alive
+    auto prewarmed = claim_prewarmed_encoder(client_id, display_name, config);
+
     int frame_nr = 1;
 
     auto touch_port_event = mail->event<input::touch_port_t>(mail::touch_port);
     auto hdr_event = mail->event<hdr_info_t>(mail::hdr);
+    auto idr_events = mail->event<bool>(mail::idr);
 
     // Encoding takes place on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::high);
 
-    while (!shutdown_event->peek() && images->running()) {
-      // Wait for the main capture event when the display is being reinitialized
-      if (ref->reinit_event.peek()) {
-        std::this_thread::sleep_for(20ms);
-        continue;
-      }
-      // Wait for the display to be ready
-      std::shared_ptr<platf::display_t> display;
-      {
-        auto lg = ref->display_wp.lock();
-        if (ref->display_wp->expired()) {
-          continue;
-        }
-
-        display = ref->display_wp->lock();
+    safe::shared_t<capture_thread_async_ctx_t>::ptr_t ref;
+    while (!shutdown_event->peek()) {
+      // Subscribe to the capture thread of the requested display. The previous
+      // reference is only released once the new one is held, so switching
+      // back and forth between displays doesn't restart a shared capture thread.
+      ref = ref_capture_thread_async(display_name);
+      if (!ref) {
+        return;
       }
 
-      auto &encoder = *chosen_encoder;
+      images = std::make_shared<img_event_t::element_type>();
+      ref->capture_ctx_queue->raise(capture_ctx_t {images, config});
 
-      auto encode_device = make_encode_device(*display, encoder, config);
-      if (!encode_device) {
+      if (!ref->capture_ctx_queue->running()) {
         return;
       }
 
-      // absolute mouse coordinates require that the dimensions of the screen are known
-      touch_port_event->raise(make_port(display.get(), config));
+      while (!shutdown_event->peek() && images->running() && !switch_display_event->peek()) {
+        // Wait for the main capture event when the display is being reinitialized
+        if (ref->reinit_event.peek()) {
+          std::this_thread::sleep_for(20ms);
+          continue;
+        }
+        // Wait for the display to be ready
+        std::shared_ptr<platf::display_t> display;
+        {
+          auto lg = ref->display_wp.lock();
+          if (ref->display_wp->expired()) {
+            continue;
+          }
+
+          display = ref->display_wp->lock();
+        }
+
+        auto &encoder = *chosen_encoder;
 
-      // Update client with our current HDR display state
-      hdr_info_t hdr_info = std::make_unique<hdr_info_raw_t>(false);
-      if (colorspace_is_hdr(encode_device->colorspace)) {
-        if (display->get_hdr_metadata(hdr_info->metadata)) {
-          hdr_info->enabled = true;
+        std::unique_ptr<encode_session_t> session;
+        sunshine_colorspace_t colorspace;
+        if (prewarmed && prewarmed->display.lock() == display) {
+          session = std::move(prewarmed->session);
+          colorspace = prewarmed->colorspace;
         } else {
-          BOOST_LOG(error) << "Couldn't get display hdr metadata when colorspace selection indicates it should have one";
+          auto encode_device = make_encode_device(*display, encoder, config);
+          if (!encode_device) {
+            return;
+          }
+
+          colorspace = encode_device->colorspace;
+          session = make_encode_session(display.get(), encoder, config, display->width, display->height, std::move(encode_device));
+        }
+
+        // This session is subscribed to the capture thread by now
+        prewarmed.reset();
+
+        // absolute mouse coordinates require that the dimensions of the screen are known
+        touch_port_event->raise(make_port(display.get(), config));
+
+        // Update client with our current HDR display state
+        hdr_info_t hdr_info = std::make_unique<hdr_info_raw_t>(false);
+        if (colorspace_is_hdr(colorspace)) {
+          if (display->get_hdr_metadata(hdr_info->metadata)) {
+            hdr_info->enabled = true;
+          } else {
+            BOOST_LOG(error) << "Couldn't get display hdr metadata when colorspace selection indicates it should have one";
+          }
+        }
+        hdr_event->raise(std::move(hdr_info));
+
+        if (!session) {
+          continue;
         }
+
+        encode_run(
+          frame_nr,
+          mail,
+          images,
+          config,
+          display,
+          std::move(session),
+          ref->reinit_event,
+          *ref->encoder_p,
+          channel_data,
+          metrics,
+          session_start
+        );
       }
-      hdr_event->raise(std::move(hdr_info));
 
-      encode_run(
-        frame_nr,
-        mail,
-        images,
-        config,
-        display,
-        std::move(encode_device),
-        ref->reinit_event,
-        *ref->encoder_p,
-        channel_data
-      );
+      if (!switch_display_event->peek()) {
+        return;
+      }
+
+      // Unsubscribe from the current display, the capture thread drops stopped capture contexts
+      // on its own, so other sessions streaming the same display are not interrupted.
+      images->stop();
+
+      refresh_displays(dev_type, display_names, display_p, display_name);
+      display_p = std::clamp(*switch_display_event->pop(), 0, (int) display_names.size() - 1);
+
+      BOOST_LOG(info) << "Switching session capture from ["sv << display_name << "] to ["sv << display_names[display_p] << ']';
+      display_name = display_names[display_p];
+
+      // The client can't decode frames of the new display without a fresh IDR frame
+      idr_events->raise(true);
     }
   }
 
   void capture(
     safe::mail_t mail,
     config_t config,
-    void *channel_data
+    void *channel_data,
+    std::shared_ptr<metrics::session_t> metrics,
+    const std::string &client_id
   ) {
     auto idr_events = mail->event<bool>(mail::idr);
 
     idr_events->raise(true);
     if (chosen_encoder->flags & PARALLEL_ENCODING) {
-      capture_async(std::move(mail), config, channel_data);
+      capture_async(std::move(mail), config, channel_data, *metrics, client_id);
     } else {
       safe::signal_t join_event;
       auto ref = capture_thread_sync.ref();
@@ -2412,9 +3196,11 @@ namespace video {
         std::move(idr_events),
         mail->event<hdr_info_t>(mail::hdr),
         mail->event<input::touch_port_t>(mail::touch_port),
+        mail->event<int>(mail::switch_display),
         config,
         1,
         channel_data,
+        std::move(metrics),
       });
 
       // Wait for join signal
@@ -2449,7 +3235,7 @@ namespace video {
 
     auto packets = mail::man->queue<packet_t>(mail::video_packets);
     while (!packets->peek()) {
-      if (encode(1, *session, packets, nullptr, {})) {
+      if (encode(1, *session, packets, nullptr, nullptr, {})) {
         return -1;
       }
     }
@@ -2478,7 +3264,15 @@ namespace video {
     return flag;
   }
 
-  bool validate_encoder(encoder_t &encoder, bool expect_failure) {
+  /**
+   * @brief Validate an encoder against the given codec modes.
+   * @param encoder The encoder to validate, its capabilities are updated in place.
+   * @param expect_failure Whether the encoder is expected to fail, which changes the order of the checks.
+   * @param hevc_mode The HEVC mode the probe is looking for.
+   * @param av1_mode The AV1 mode the probe is looking for.
+   * @return `true` if the encoder works.
+   */
+  static bool validate_encoder(encoder_t &encoder, bool expect_failure, int hevc_mode, int av1_mode) {
     const auto output_name {display_device::map_output_name(config::video.output_name)};
     std::shared_ptr<platf::display_t> disp;
 
@@ -2487,8 +3281,8 @@ namespace video {
       BOOST_LOG(info) << "Encoder ["sv << encoder.name << "] failed"sv;
     });
 
-    auto test_hevc = active_hevc_mode >= 2 || (active_hevc_mode == 0 && !(encoder.flags & H264_ONLY));
-    auto test_av1 = active_av1_mode >= 2 || (active_av1_mode == 0 && !(encoder.flags & H264_ONLY));
+    auto test_hevc = hevc_mode >= 2 || (hevc_mode == 0 && !(encoder.flags & H264_ONLY));
+    auto test_av1 = av1_mode >= 2 || (av1_mode == 0 && !(encoder.flags & H264_ONLY));
 
     encoder.h264.capabilities.set();
     encoder.hevc.capabilities.set();
@@ -2659,42 +3453,112 @@ namespace video {
     return true;
   }
 
-  int probe_encoders() {
-    if (!allow_encoder_probing()) {
-      // Error already logged
-      return -1;
+  bool validate_encoder(encoder_t &encoder, bool expect_failure) {
+    return validate_encoder(encoder, expect_failure, active_hevc_mode, active_av1_mode);
+  }
+
+  /**
+   * @brief Outcome of an encoder probe, so it can be published all at once.
+   */
+  struct probe_result_t {
+    encoder_t *encoder;
+    int hevc_mode;
+    int av1_mode;
+  };
+
+  /**
+   * @brief Publish the results of a probe. Must be called with `probe_lock` held.
+   * @param result The results to publish, the automatic codec modes must already be resolved.
+   */
+  static void apply_probe_results(const probe_result_t &result) {
+    auto &encoder = *result.encoder;
+
+    BOOST_LOG(debug) << "------  h264 ------"sv;
+    for (int x = 0; x < encoder_t::MAX_FLAGS; ++x) {
+      auto flag = (encoder_t::flag_e) x;
+      BOOST_LOG(debug) << encoder_t::from_flag(flag) << (encoder.h264[flag] ? ": supported"sv : ": unsupported"sv);
     }
+    BOOST_LOG(debug) << "-------------------"sv;
+    BOOST_LOG(info) << "Found H.264 encoder: "sv << encoder.h264.name << " ["sv << encoder.name << ']';
 
-    auto encoder_list = encoders;
+    if (encoder.hevc[encoder_t::PASSED]) {
+      BOOST_LOG(debug) << "------  hevc ------"sv;
+      for (int x = 0; x < encoder_t::MAX_FLAGS; ++x) {
+        auto flag = (encoder_t::flag_e) x;
+        BOOST_LOG(debug) << encoder_t::from_flag(flag) << (encoder.hevc[flag] ? ": supported"sv : ": unsupported"sv);
+      }
+      BOOST_LOG(debug) << "-------------------"sv;
 
-    // If we already have a good encoder, check to see if another probe is required
-    if (chosen_encoder && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration()) {
-      return 0;
+      BOOST_LOG(info) << "Found HEVC encoder: "sv << encoder.hevc.name << " ["sv << encoder.name << ']';
     }
 
-    // Restart encoder selection
-    auto previous_encoder = chosen_encoder;
+    if (encoder.av1[encoder_t::PASSED]) {
+      BOOST_LOG(debug) << "------  av1 ------"sv;
+      for (int x = 0; x < encoder_t::MAX_FLAGS; ++x) {
+        auto flag = (encoder_t::flag_e) x;
+        BOOST_LOG(debug) << encoder_t::from_flag(flag) << (encoder.av1[flag] ? ": supported"sv : ": unsupported"sv);
+      }
+      BOOST_LOG(debug) << "-------------------"sv;
+
+      BOOST_LOG(info) << "Found AV1 encoder: "sv << encoder.av1.name << " ["sv << encoder.name << ']';
+    }
+
+    chosen_encoder = &encoder;
+    active_hevc_mode = result.hevc_mode;
+    active_av1_mode = result.av1_mode;
+    last_encoder_probe_supported_ref_frames_invalidation = (encoder.flags & REF_FRAMES_INVALIDATION);
+    last_encoder_probe_supported_yuv444_for_codec[0] = encoder.h264[encoder_t::PASSED] &&
+                                                       encoder.h264[encoder_t::YUV444];
+    last_encoder_probe_supported_yuv444_for_codec[1] = encoder.hevc[encoder_t::PASSED] &&
+                                                       encoder.hevc[encoder_t::YUV444];
+    last_encoder_probe_supported_yuv444_for_codec[2] = encoder.av1[encoder_t::PASSED] &&
+                                                       encoder.av1[encoder_t::YUV444];
+  }
+
+  /**
+   * @brief Forget the chosen encoder after a failed probe, so the next one starts over. Must be called with `probe_lock` held.
+   */
+  static void clear_probe_results() {
     chosen_encoder = nullptr;
     active_hevc_mode = config::video.hevc_mode;
     active_av1_mode = config::video.av1_mode;
     last_encoder_probe_supported_ref_frames_invalidation = false;
+  }
+
+  /**
+   * @brief Probe every encoder, then store the results in the probe cache.
+   * @details Only the capabilities of the encoders are updated in place, the caller publishes the rest.
+   * @param result Receives the chosen encoder and the resolved codec modes.
+   * @return 0 on success, -1 if no working encoder was found.
+   */
+  static int probe_all_encoders(probe_result_t &result) {
+    auto probe_start = std::chrono::steady_clock::now();
+    auto fingerprint = probe_cache::fingerprint();
+
+    auto encoder_list = encoders;
+
+    // Restart encoder selection
+    auto previous_encoder = chosen_encoder;
+    encoder_t *chosen = nullptr;
+    int hevc_mode = config::video.hevc_mode;
+    int av1_mode = config::video.av1_mode;
 
     auto adjust_encoder_constraints = [&](encoder_t *encoder) {
       // If we can't satisfy both the encoder and codec requirement, prefer the encoder over codec support
-      if (active_hevc_mode == 3 && !encoder->hevc[encoder_t::DYNAMIC_RANGE]) {
+      if (hevc_mode == 3 && !encoder->hevc[encoder_t::DYNAMIC_RANGE]) {
         BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support HEVC Main10 on this system"sv;
-        active_hevc_mode = 0;
-      } else if (active_hevc_mode == 2 && !encoder->hevc[encoder_t::PASSED]) {
+        hevc_mode = 0;
+      } else if (hevc_mode == 2 && !encoder->hevc[encoder_t::PASSED]) {
         BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support HEVC on this system"sv;
-        active_hevc_mode = 0;
+        hevc_mode = 0;
       }
 
-      if (active_av1_mode == 3 && !encoder->av1[encoder_t::DYNAMIC_RANGE]) {
+      if (av1_mode == 3 && !encoder->av1[encoder_t::DYNAMIC_RANGE]) {
         BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support AV1 Main10 on this system"sv;
-        active_av1_mode = 0;
-      } else if (active_av1_mode == 2 && !encoder->av1[encoder_t::PASSED]) {
+        av1_mode = 0;
+      } else if (av1_mode == 2 && !encoder->av1[encoder_t::PASSED]) {
         BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support AV1 on this system"sv;
-        active_av1_mode = 0;
+        av1_mode = 0;
       }
     };
 
@@ -2705,7 +3569,7 @@ namespace video {
 
         if (encoder->name == config::video.encoder) {
           // Remove the encoder from the list entirely if it fails validation
-          if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+          if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder, hevc_mode, av1_mode)) {
             pos = encoder_list.erase(pos);
             break;
           }
@@ -2713,14 +3577,14 @@ namespace video {
           // We will return an encoder here even if it fails one of the codec requirements specified by the user
           adjust_encoder_constraints(encoder);
 
-          chosen_encoder = encoder;
+          chosen = encoder;
           break;
         }
 
         pos++;
       });
 
-      if (chosen_encoder == nullptr) {
+      if (chosen == nullptr) {
         BOOST_LOG(error) << "Couldn't find any working encoder matching ["sv << config::video.encoder << ']';
       }
     }
@@ -2728,49 +3592,49 @@ namespace video {
     BOOST_LOG(info) << "// Testing for available encoders, this may generate errors. You can safely ignore those errors. //"sv;
 
     // If we haven't found an encoder yet, but we want one with specific codec support, search for that now.
-    if (chosen_encoder == nullptr && (active_hevc_mode >= 2 || active_av1_mode >= 2)) {
+    if (chosen == nullptr && (hevc_mode >= 2 || av1_mode >= 2)) {
       KITTY_WHILE_LOOP(auto pos = std::begin(encoder_list), pos != std::end(encoder_list), {
         auto encoder = *pos;
 
         // Remove the encoder from the list entirely if it fails validation
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder, hevc_mode, av1_mode)) {
           pos = encoder_list.erase(pos);
           continue;
         }
 
         // Skip it if it doesn't support the specified codec at all
-        if ((active_hevc_mode >= 2 && !encoder->hevc[encoder_t::PASSED]) ||
-            (active_av1_mode >= 2 && !encoder->av1[encoder_t::PASSED])) {
+        if ((hevc_mode >= 2 && !encoder->hevc[encoder_t::PASSED]) ||
+            (av1_mode >= 2 && !encoder->av1[encoder_t::PASSED])) {
           pos++;
           continue;
         }
 
         // Skip it if it doesn't support HDR on the specified codec
-        if ((active_hevc_mode == 3 && !encoder->hevc[encoder_t::DYNAMIC_RANGE]) ||
-            (active_av1_mode == 3 && !encoder->av1[encoder_t::DYNAMIC_RANGE])) {
+        if ((hevc_mode == 3 && !encoder->hevc[encoder_t::DYNAMIC_RANGE]) ||
+            (av1_mode == 3 && !encoder->av1[encoder_t::DYNAMIC_RANGE])) {
           pos++;
           continue;
         }
 
-        chosen_encoder = encoder;
+        chosen = encoder;
         break;
       });
 
-      if (chosen_encoder == nullptr) {
+      if (chosen == nullptr) {
         BOOST_LOG(error) << "Couldn't find any working encoder that meets HEVC/AV1 requirements"sv;
       }
     }
 
     // If no encoder was specified or the specified encoder was unusable, keep trying
     // the remaining encoders until we find one that passes validation.
-    if (chosen_encoder == nullptr) {
+    if (chosen == nullptr) {
       KITTY_WHILE_LOOP(auto pos = std::begin(encoder_list), pos != std::end(encoder_list), {
         auto encoder = *pos;
 
         // If we've used a previous encoder and it's not this one, we expect this encoder to
         // fail to validate. It will use a slightly different order of checks to more quickly
         // eliminate failing encoders.
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder, hevc_mode, av1_mode)) {
           pos = encoder_list.erase(pos);
           continue;
         }
@@ -2778,12 +3642,12 @@ namespace video {
         // We will return an encoder here even if it fails one of the codec requirements specified by the user
         adjust_encoder_constraints(encoder);
 
-        chosen_encoder = encoder;
+        chosen = encoder;
         break;
       });
     }
 
-    if (chosen_encoder == nullptr) {
+    if (chosen == nullptr) {
       const auto output_name {display_device::map_output_name(config::video.output_name)};
       BOOST_LOG(fatal) << "Unable to find display or encoder during startup."sv;
       if (!config::video.adapter_name.empty() || !output_name.empty()) {
@@ -2791,6 +3655,11 @@ namespace video {
       } else {
         BOOST_LOG(fatal) << "Please check that a display is connected and powered on."sv;
       }
+
+      // Don't let the next startup trust results that can no longer be reproduced
+      std::error_code ec;
+      std::filesystem::remove(probe_cache::default_path(), ec);
+
       return -1;
     }
 
@@ -2798,54 +3667,142 @@ namespace video {
     BOOST_LOG(info) << "// Ignore any errors mentioned above, they are not relevant. //"sv;
     BOOST_LOG(info);
 
-    auto &encoder = *chosen_encoder;
+    auto &encoder = *chosen;
 
-    last_encoder_probe_supported_ref_frames_invalidation = (encoder.flags & REF_FRAMES_INVALIDATION);
-    last_encoder_probe_supported_yuv444_for_codec[0] = encoder.h264[encoder_t::PASSED] &&
-                                                       encoder.h264[encoder_t::YUV444];
-    last_encoder_probe_supported_yuv444_for_codec[1] = encoder.hevc[encoder_t::PASSED] &&
-                                                       encoder.hevc[encoder_t::YUV444];
-    last_encoder_probe_supported_yuv444_for_codec[2] = encoder.av1[encoder_t::PASSED] &&
-                                                       encoder.av1[encoder_t::YUV444];
+    // Resolve the automatic codec modes
+    if (hevc_mode == 0) {
+      hevc_mode = encoder.hevc[encoder_t::PASSED] ? (encoder.hevc[encoder_t::DYNAMIC_RANGE] ? 3 : 2) : 1;
+    }
 
-    BOOST_LOG(debug) << "------  h264 ------"sv;
-    for (int x = 0; x < encoder_t::MAX_FLAGS; ++x) {
-      auto flag = (encoder_t::flag_e) x;
-      BOOST_LOG(debug) << encoder_t::from_flag(flag) << (encoder.h264[flag] ? ": supported"sv : ": unsupported"sv);
+    if (av1_mode == 0) {
+      av1_mode = encoder.av1[encoder_t::PASSED] ? (encoder.av1[encoder_t::DYNAMIC_RANGE] ? 3 : 2) : 1;
     }
-    BOOST_LOG(debug) << "-------------------"sv;
-    BOOST_LOG(info) << "Found H.264 encoder: "sv << encoder.h264.name << " ["sv << encoder.name << ']';
 
-    if (encoder.hevc[encoder_t::PASSED]) {
-      BOOST_LOG(debug) << "------  hevc ------"sv;
-      for (int x = 0; x < encoder_t::MAX_FLAGS; ++x) {
-        auto flag = (encoder_t::flag_e) x;
-        BOOST_LOG(debug) << encoder_t::from_flag(flag) << (encoder.hevc[flag] ? ": supported"sv : ": unsupported"sv);
-      }
-      BOOST_LOG(debug) << "-------------------"sv;
+    auto probe_duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - probe_start);
+    BOOST_LOG(info) << "Encoder probe took "sv << probe_duration.count() << "ms"sv;
 
-      BOOST_LOG(info) << "Found HEVC encoder: "sv << encoder.hevc.name << " ["sv << encoder.name << ']';
+    probe_cache::entry_t entry {
+      std::move(fingerprint),
+      std::string {encoder.name},
+      {
+        encoder.h264.capabilities.to_ullong(),
+        encoder.hevc.capabilities.to_ullong(),
+        encoder.av1.capabilities.to_ullong(),
+      },
+      hevc_mode,
+      av1_mode,
+      probe_duration,
+    };
+    probe_cache::save(probe_cache::default_path(), entry);
+
+    result = {chosen, hevc_mode, av1_mode};
+    return 0;
+  }
+
+  /**
+   * @brief Restore the results of the last probe, if nothing that could affect them has changed since.
+   * @return `true` if an encoder was restored.
+   */
+  static bool restore_cached_probe() {
+    auto entry = probe_cache::load(probe_cache::default_path(), probe_cache::fingerprint());
+    if (!entry) {
+      return false;
     }
 
-    if (encoder.av1[encoder_t::PASSED]) {
-      BOOST_LOG(debug) << "------  av1 ------"sv;
-      for (int x = 0; x < encoder_t::MAX_FLAGS; ++x) {
-        auto flag = (encoder_t::flag_e) x;
-        BOOST_LOG(debug) << encoder_t::from_flag(flag) << (encoder.av1[flag] ? ": supported"sv : ": unsupported"sv);
-      }
-      BOOST_LOG(debug) << "-------------------"sv;
+    auto pos = std::find_if(std::begin(encoders), std::end(encoders), [&](auto encoder) {
+      return encoder->name == entry->encoder;
+    });
+    if (pos == std::end(encoders)) {
+      return false;
+    }
 
-      BOOST_LOG(info) << "Found AV1 encoder: "sv << encoder.av1.name << " ["sv << encoder.name << ']';
+    auto &encoder = **pos;
+    encoder.h264.capabilities = decltype(encoder.h264.capabilities) {entry->capabilities[0]};
+    encoder.hevc.capabilities = decltype(encoder.hevc.capabilities) {entry->capabilities[1]};
+    encoder.av1.capabilities = decltype(encoder.av1.capabilities) {entry->capabilities[2]};
+
+    apply_probe_results({&encoder, entry->hevc_mode, entry->av1_mode});
+
+    BOOST_LOG(info) << "Using cached encoder probe results, saved "sv << entry->probe_duration.count() << "ms of probing"sv;
+    return true;
+  }
+
+  /**
+   * @brief Probe all encoders again and compare the outcome with the cached results in use.
+   * @details The cached results stay published while the probe runs, and are replaced in one step once it completes.
+   */
+  static void revalidate_cached_probe() {
+    auto lg = std::lock_guard(probe_lock);
+
+    // Let sessions through once this is done, whatever the outcome
+    auto fg = util::fail_guard([]() {
+      probe_revalidation_pending = false;
+      probe_revalidated.notify_all();
+    });
+
+    auto cached_encoder = chosen_encoder;
+    std::array cached_capabilities {
+      cached_encoder->h264.capabilities,
+      cached_encoder->hevc.capabilities,
+      cached_encoder->av1.capabilities,
+    };
+    std::array cached_modes {active_hevc_mode.load(), active_av1_mode.load()};
+
+    BOOST_LOG(info) << "Revalidating cached encoder probe results"sv;
+    probe_result_t result;
+    if (probe_all_encoders(result)) {
+      clear_probe_results();
+      return;
+    }
+
+    if (
+      result.encoder == cached_encoder &&
+      result.encoder->h264.capabilities == cached_capabilities[0] &&
+      result.encoder->hevc.capabilities == cached_capabilities[1] &&
+      result.encoder->av1.capabilities == cached_capabilities[2] &&
+      result.hevc_mode == cached_modes[0] &&
+      result.av1_mode == cached_modes[1]
+    ) {
+      BOOST_LOG(info) << "Cached encoder probe results are up to date"sv;
+    } else {
+      BOOST_LOG(warning) << "Cached encoder probe results were outdated, the new results are used from now on"sv;
     }
 
-    if (active_hevc_mode == 0) {
-      active_hevc_mode = encoder.hevc[encoder_t::PASSED] ? (encoder.hevc[encoder_t::DYNAMIC_RANGE] ? 3 : 2) : 1;
+    apply_probe_results(result);
+  }
+
+  int probe_encoders() {
+    if (!allow_encoder_probing()) {
+      // Error already logged
+      return -1;
+    }
+
+    // Waits for a revalidation in the background, even one that hasn't taken the lock yet
+    auto lg = std::unique_lock(probe_lock);
+    probe_revalidated.wait(lg, []() {
+      return !probe_revalidation_pending;
+    });
+
+    // On startup, use the results of the last probe and confirm them in the background
+    if (!chosen_encoder && restore_cached_probe()) {
+      probe_revalidation_pending = true;
+      probe_revalidation = std::async(std::launch::async, revalidate_cached_probe);
+      return 0;
+    }
+
+    // If we already have a good encoder, check to see if another probe is required.
+    // The cached results only stand in for the probe at startup, the fingerprint doesn't cover displays.
+    if (chosen_encoder && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration()) {
+      return 0;
     }
 
-    if (active_av1_mode == 0) {
-      active_av1_mode = encoder.av1[encoder_t::PASSED] ? (encoder.av1[encoder_t::DYNAMIC_RANGE] ? 3 : 2) : 1;
+    probe_result_t result;
+    if (probe_all_encoders(result)) {
+      clear_probe_results();
+      return -1;
     }
 
+    apply_probe_results(result);
     return 0;
   }
 
@@ -2947,7 +3904,8 @@ namespace video {
       capture_thread_ctx.capture_ctx_queue,
       std::ref(capture_thread_ctx.display_wp),
       std::ref(capture_thread_ctx.reinit_event),
-      std::ref(*capture_thread_ctx.encoder_p)
+      std::ref(*capture_thread_ctx.encoder_p),
+      capture_thread_ctx.display_name
     };
 
     return 0;
@@ -4,8 +4,12 @@
  */
 #pragma once
 
+// standard includes
+#include <atomic>
+
 // local includes
 #include "input.h"
+#include "metrics.h"
 #include "platform/common.h"
 #include "thread_safe.h"
 #include "video_colorspace.h"
@@ -48,6 +52,8 @@ namespace video {
 
     int encodingFramerate; // Requested display framerate
     bool input_only;
+
+    bool refPicInvalidation;  // The client invalidates lost reference frames instead of requesting IDR frames
   };
 
   platf::mem_type_e map_base_dev_type(AVHWDeviceType type);
@@ -213,6 +219,13 @@ namespace video {
     virtual void request_normal_frame() = 0;
 
     virtual void invalidate_ref_frames(int64_t first_frame, int64_t last_frame) = 0;
+
+    /**
+     * @brief Change the target bitrate without recreating the encoder.
+     * @param bitrate Bitrate in kilobits per second.
+     * @return `false` if the encoder can't change its bitrate in place.
+     */
+    virtual bool set_bitrate(int bitrate) = 0;
   };
 
   // encoders
@@ -262,6 +275,8 @@ namespace video {
     void *channel_data = nullptr;
     bool after_ref_frame_invalidation = false;
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+    std::chrono::steady_clock::time_point queued_at;  // When the encoder handed the packet to the network thread
+    std::optional<metrics::queued_packet_t> queued;  // Counts the packet in the video queue depth of its session
   };
 
   struct packet_raw_avcodec: packet_raw_t {
@@ -336,17 +351,51 @@ namespace video {
 
   using hdr_info_t = std::unique_ptr<hdr_info_raw_t>;
 
-  extern int active_hevc_mode;
-  extern int active_av1_mode;
-  extern bool last_encoder_probe_supported_ref_frames_invalidation;
-  extern std::array<bool, 3> last_encoder_probe_supported_yuv444_for_codec;  // 0 - H.264, 1 - HEVC, 2 - AV1
+  // Published by the encoder probe, and read by the web servers without holding its lock
+  extern std::atomic<int> active_hevc_mode;
+  extern std::atomic<int> active_av1_mode;
+  extern std::atomic<bool> last_encoder_probe_supported_ref_frames_invalidation;
+  extern std::array<std::atomic<bool>, 3> last_encoder_probe_supported_yuv444_for_codec;  // 0 - H.264, 1 - HEVC, 2 - AV1
 
   void capture(
     safe::mail_t mail,
     config_t config,
-    void *channel_data
+    void *channel_data,
+    std::shared_ptr<metrics::session_t> metrics,
+    const std::string &client_id
   );
 
+  /**
+   * @brief The display mode a client asks for when launching or resuming an app.
+   */
+  struct launch_mode_t {
+    int width;
+    int height;
+    int fps;
+    bool enable_hdr;
+
+    bool operator==(const launch_mode_t &) const = default;
+  };
+
+  /**
+   * @brief Remember the encoding configuration a client streamed with.
+   * @param client_id Unique ID of the client.
+   * @param mode The display mode the session was launched with.
+   * @param config The encoding configuration negotiated for the session.
+   */
+  void remember_client_config(const std::string &client_id, const launch_mode_t &mode, const config_t &config);
+
+  /**
+   * @brief Build an encoder in the background for a session that is about to start.
+   * The encoding configuration is only negotiated once the client connects, so it's predicted
+   * from the last session of the same client with the same display mode. The session takes
+   * over the encoder when it starts capturing if the prediction was right. Each client with a
+   * pending launch has its own encoder, a few at most, and unclaimed encoders expire on their own.
+   * @param client_id Unique ID of the client.
+   * @param mode The display mode the client launched with.
+   */
+  void prewarm_encoder(const std::string &client_id, const launch_mode_t &mode);
+
   bool validate_encoder(encoder_t &encoder, bool expect_failure);
 
   /**
@@ -0,0 +1,141 @@
+/**
+ * @file src/video_probe_cache.cpp
+ * @brief Definitions for the persistent encoder probe cache.
+ */
+// this include
+#include "video_probe_cache.h"
+
+// standard includes
+#include <fstream>
+#include <sstream>
+
+// lib includes
+#include <nlohmann/json.hpp>
+
+// local includes
+#include "config.h"
+#include "crypto.h"
+#include "logging.h"
+#include "platform/common.h"
+#include "utility.h"
+#include "version.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+}
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+namespace video::probe_cache {
+  std::string fingerprint() {
+    std::stringstream ss;
+
+    ss << PROJECT_VER << '\n';
+    ss << platf::gpu_fingerprint() << '\n';
+    ss << av_version_info() << ' ' << avcodec_version() << ' ' << avcodec_configuration() << '\n';
+
+    auto opt = [](const std::optional<int> &value) {
+      return value.value_or(-1);
+    };
+
+    // Only the settings that are taken into account while probing
+    const auto &video = config::video;
+    ss << video.capture << '\n'
+       << video.encoder << '\n'
+       << video.adapter_name << '\n'
+       << video.output_name << '\n'
+       << video.hevc_mode << ' ' << video.av1_mode << ' ' << video.min_threads << '\n'
+       << video.sw.sw_preset << ' ' << video.sw.sw_tune << ' ' << opt(video.sw.svtav1_preset) << '\n'
+       << video.nv.quality_preset << ' ' << (int) video.nv.two_pass << ' ' << video.nv.h264_cavlc << ' '
+       << video.nv.insert_filler_data << ' ' << video.nv.intra_refresh << '\n'
+       << video.nv_legacy.preset << ' ' << video.nv_legacy.multipass << ' ' << video.nv_legacy.h264_coder << '\n'
+       << opt(video.qsv.qsv_preset) << ' ' << opt(video.qsv.qsv_cavlc) << ' ' << video.qsv.qsv_slow_hevc << '\n'
+       << opt(video.amd.amd_usage_h264) << ' ' << opt(video.amd.amd_usage_hevc) << ' ' << opt(video.amd.amd_usage_av1) << ' '
+       << opt(video.amd.amd_rc_h264) << ' ' << opt(video.amd.amd_rc_hevc) << ' ' << opt(video.amd.amd_rc_av1) << ' '
+       << opt(video.amd.amd_enforce_hrd) << ' ' << opt(video.amd.amd_preanalysis) << ' ' << video.amd.amd_coder << '\n'
+       << video.vt.vt_allow_sw << ' ' << video.vt.vt_require_sw << ' ' << video.vt.vt_realtime << ' ' << video.vt.vt_coder << '\n'
+       << video.vaapi.strict_rc_buffer << '\n'
+       << config::sunshine.flags[config::flag::FORCE_VIDEO_HEADER_REPLACE];
+
+    return util::hex_vec(crypto::hash(ss.str()));
+  }
+
+  fs::path default_path() {
+    return platf::appdata() / "encoder_cache.json";
+  }
+
+  std::optional<entry_t> load(const fs::path &path, const std::string &fingerprint) {
+    if (!fs::exists(path)) {
+      return std::nullopt;
+    }
+
+    entry_t entry;
+    try {
+      std::ifstream in {path};
+      auto root = nlohmann::json::parse(in);
+
+      entry.fingerprint = root.at("fingerprint").get<std::string>();
+      entry.encoder = root.at("encoder").get<std::string>();
+
+      auto &capabilities = root.at("capabilities");
+      entry.capabilities[0] = capabilities.at("h264").get<std::uint64_t>();
+      entry.capabilities[1] = capabilities.at("hevc").get<std::uint64_t>();
+      entry.capabilities[2] = capabilities.at("av1").get<std::uint64_t>();
+
+      entry.hevc_mode = root.at("hevc_mode").get<int>();
+      entry.av1_mode = root.at("av1_mode").get<int>();
+      entry.probe_duration = std::chrono::milliseconds {root.at("probe_duration_ms").get<std::int64_t>()};
+    } catch (const std::exception &e) {
+      BOOST_LOG(warning) << "Couldn't read encoder probe cache "sv << path << ": "sv << e.what();
+      return std::nullopt;
+    }
+
+    if (entry.fingerprint != fingerprint) {
+      BOOST_LOG(info) << "GPUs, drivers or encoder settings changed since the last encoder probe"sv;
+      return std::nullopt;
+    }
+
+    return entry;
+  }
+
+  int save(const fs::path &path, const entry_t &entry) {
+    nlohmann::json root {
+      {"fingerprint", entry.fingerprint},
+      {"encoder", entry.encoder},
+      {"capabilities", {
+                         {"h264", entry.capabilities[0]},
+                         {"hevc", entry.capabilities[1]},
+                         {"av1", entry.capabilities[2]},
+                       }},
+      {"hevc_mode", entry.hevc_mode},
+      {"av1_mode", entry.av1_mode},
+      {"probe_duration_ms", entry.probe_duration.count()},
+    };
+
+    // Write to a temporary file first, so a crash can't leave a truncated cache behind
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+
+    {
+      std::ofstream out {tmp_path, std::ios::trunc};
+      out << root.dump(2);
+
+      if (!out) {
+        BOOST_LOG(warning) << "Couldn't write encoder probe cache "sv << tmp_path;
+        return -1;
+      }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    if (ec) {
+      BOOST_LOG(warning) << "Couldn't replace encoder probe cache "sv << path << ": "sv << ec.message();
+      fs::remove(tmp_path, ec);
+      return -1;
+    }
+
+    return 0;
+  }
+}  // namespace video::probe_cache
@@ -0,0 +1,55 @@
+/**
+ * @file src/video_probe_cache.h
+ * @brief Declarations for the persistent encoder probe cache.
+ */
+#pragma once
+
+// standard includes
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace video::probe_cache {
+  /**
+   * @brief Results of an encoder probe, as stored on disk.
+   */
+  struct entry_t {
+    std::string fingerprint;  ///< Fingerprint of the system the probe ran on.
+    std::string encoder;  ///< Name of the chosen encoder.
+    std::array<std::uint64_t, 3> capabilities;  ///< Capability bits for H.264, HEVC and AV1.
+    int hevc_mode;  ///< HEVC mode resolved by the probe.
+    int av1_mode;  ///< AV1 mode resolved by the probe.
+    std::chrono::milliseconds probe_duration;  ///< How long the probe took.
+  };
+
+  /**
+   * @brief Fingerprint everything that can change the outcome of an encoder probe.
+   * @details Covers the GPUs and their drivers, the FFmpeg build, the encoder settings and the version of this build.
+   * @return A hex encoded hash of those inputs.
+   */
+  std::string fingerprint();
+
+  /**
+   * @brief Location of the cache file.
+   */
+  std::filesystem::path default_path();
+
+  /**
+   * @brief Load cached probe results.
+   * @param path The cache file.
+   * @param fingerprint The fingerprint of the current system.
+   * @return The cached results, or `std::nullopt` if missing, unreadable or made on a different system.
+   */
+  std::optional<entry_t> load(const std::filesystem::path &path, const std::string &fingerprint);
+
+  /**
+   * @brief Atomically replace the cache file.
+   * @param path The cache file.
+   * @param entry The results to store.
+   * @return 0 on success, -1 on failure.
+   */
+  int save(const std::filesystem::path &path, const entry_t &entry);
+}  // namespace video::probe_cache
@@ -0,0 +1,103 @@
+/**
+ * @file src/web_assets.cpp
+ * @brief Definitions for serving the static files of the web UI from memory.
+ */
+// this include
+#include "web_assets.h"
+
+// standard includes
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+// local includes
+#include "asset_cache.h"
+#include "compression.h"
+
+namespace web_assets {
+  namespace fs = std::filesystem;
+
+  bool compressible(std::string_view content_type) {
+    return content_type.starts_with("text/") ||
+           content_type.starts_with("application/javascript") ||
+           content_type.starts_with("application/json") ||
+           content_type.starts_with("image/svg+xml") ||
+           content_type.starts_with("image/x-icon") ||
+           content_type.starts_with("font/ttf");
+  }
+
+  bool immutable(const fs::path &path) {
+    auto stem = path.stem().string();
+
+    // The hash is base64url, so it may hold dashes itself
+    if (stem.size() < 10 || stem[stem.size() - 9] != '-') {
+      return false;
+    }
+
+    for (auto c : std::string_view {stem}.substr(stem.size() - 8)) {
+      if (!std::isalnum((unsigned char) c) && c != '_' && c != '-') {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  std::shared_ptr<const asset_t> cache_t::get(const fs::path &path, std::string_view content_type) {
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    auto file_size = ec ? 0 : fs::file_size(path, ec);
+    if (ec) {
+      return nullptr;
+    }
+
+    auto key = path.string();
+    {
+      std::lock_guard lg {_mutex};
+
+      auto it = _entries.find(key);
+      if (it != std::end(_entries) && it->second.mtime == mtime && it->second.file_size == file_size) {
+        return it->second.asset;
+      }
+    }
+
+    std::ifstream in {path, std::ios::binary};
+    if (!in) {
+      return nullptr;
+    }
+
+    auto asset = std::make_shared<asset_t>();
+    asset->data.assign(std::istreambuf_iterator<char> {in}, std::istreambuf_iterator<char> {});
+    asset->etag = asset_cache::make_etag(file_size, mtime);
+
+    // Compressed once per change, so spend the time on the smallest output
+    if (compressible(content_type)) {
+      auto compressed = compression::gzip(asset->data, 9);
+      if (compressed && compressed->size() < asset->data.size()) {
+        asset->gzip = std::move(compressed);
+
+        // Representations must not share a strong entity tag
+        asset->gzip_etag = asset->etag;
+        asset->gzip_etag.insert(asset->gzip_etag.size() - 1, "-gzip");
+      }
+    }
+
+    std::lock_guard lg {_mutex};
+    _entries.insert_or_assign(std::move(key), entry_t {mtime, file_size, asset});
+
+    return asset;
+  }
+
+  void cache_t::warm(const fs::path &dir, const std::function<std::optional<std::string>(const fs::path &)> &content_type) {
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator {dir, ec}; !ec && it != fs::recursive_directory_iterator {}; it.increment(ec)) {
+      if (!it->is_regular_file(ec)) {
+        continue;
+      }
+
+      if (auto type = content_type(it->path())) {
+        get(it->path(), *type);
+      }
+    }
+  }
+}  // namespace web_assets
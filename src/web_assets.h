@@ -0,0 +1,76 @@
+/**
+ * @file src/web_assets.h
+ * @brief Declarations for serving the static files of the web UI from memory.
+ */
+#pragma once
+
+// standard includes
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace web_assets {
+  /**
+   * @brief A file of the web UI, with its compressed variant.
+   */
+  struct asset_t {
+    std::string data;  ///< The bytes of the file.
+    std::optional<std::string> gzip;  ///< The file in the gzip format, if the type compresses and it came out smaller.
+    std::string etag;  ///< Strong entity tag of the file.
+    std::string gzip_etag;  ///< Strong entity tag of the compressed variant.
+  };
+
+  /**
+   * @brief Check whether files of a content type are worth compressing.
+   * @param content_type The content type, e.g. `text/html; charset=utf-8`.
+   * @return true for text, scripts, styles and SVG images.
+   */
+  bool compressible(std::string_view content_type);
+
+  /**
+   * @brief Check whether a file name carries a content hash, as the web UI build gives its bundles.
+   * @details Such files never change under the same name, so clients may cache them indefinitely.
+   * @param path The path of the file.
+   * @return true if the stem ends with a dash and an eight character hash.
+   */
+  bool immutable(const std::filesystem::path &path);
+
+  /**
+   * @brief Files of the web UI by path, reloaded when they change.
+   * @details Every lookup checks the size and modification time of the file, so a reinstalled web UI is picked up
+   *          without a restart. Files are compressed once, when they are loaded.
+   */
+  class cache_t {
+  public:
+    /**
+     * @brief Get a file, reading and compressing it if it isn't cached or changed.
+     * @param path The path of the file.
+     * @param content_type The content type the file is served as.
+     * @return The file, or nullptr if it can't be read.
+     */
+    std::shared_ptr<const asset_t> get(const std::filesystem::path &path, std::string_view content_type);
+
+    /**
+     * @brief Load every file below a directory.
+     * @param dir The directory.
+     * @param content_type Maps a path to its content type, files without one are skipped.
+     */
+    void warm(const std::filesystem::path &dir, const std::function<std::optional<std::string>(const std::filesystem::path &)> &content_type);
+
+  private:
+    struct entry_t {
+      std::filesystem::file_time_type mtime;
+      std::uintmax_t file_size;
+      std::shared_ptr<const asset_t> asset;
+    };
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, entry_t> _entries;
+  };
+}  // namespace web_assets
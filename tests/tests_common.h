@@ -3,6 +3,11 @@
  * @brief Common declarations.
  */
 #pragma once
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
 #include <gtest/gtest.h>
 #include <src/globals.h>
 #include <src/logging.h>
@@ -25,3 +30,37 @@ struct PlatformTestSuite: testing::Test {
 private:
   inline static std::unique_ptr<platf::deinit_t> platf_deinit;
 };
+
+/**
+ * @brief Gives each test an empty directory of its own, removed once the test is done.
+ */
+struct TempDirTest: testing::Test {
+  void SetUp() override {
+    std::random_device rd;
+
+    // Retry on a name that's taken, so tests running in parallel never share a directory
+    do {
+      dir = std::filesystem::temp_directory_path() / ("aqua_test_" + std::to_string(rd()) + "_" + std::to_string(rd()));
+    } while (!std::filesystem::create_directory(dir));
+  }
+
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+  }
+
+  /**
+   * @brief Write a file in the test's directory.
+   * @param name Path of the file, relative to the test's directory.
+   * @param contents Contents of the file.
+   * @return The path of the file.
+   */
+  std::filesystem::path write(const std::string &name, const std::string &contents) {
+    auto path = dir / name;
+    std::ofstream {path, std::ios::binary} << contents;
+
+    return path;
+  }
+
+  std::filesystem::path dir;
+};
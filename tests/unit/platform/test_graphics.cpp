@@ -0,0 +1,181 @@
+/**
+ * @file tests/unit/platform/test_graphics.cpp
+ * @brief Test src/platform/linux/graphics.*.
+ */
+#ifdef __linux__
+  #include "../../tests_common.h"
+
+  #include <src/platform/linux/graphics.h>
+
+using namespace std::literals;
+
+namespace {
+  constexpr auto EGL_PLATFORM_SURFACELESS_MESA = 0x31DD;
+  const auto EGL_NO_CONFIG_KHR = (EGLConfig) nullptr;
+
+  constexpr int width = 16;
+  constexpr int height = 8;
+
+  struct test_img_t: platf::img_t {
+    test_img_t() {
+      buffer.resize(width * height * 4);
+      data = buffer.data();
+      this->width = ::width;
+      this->height = ::height;
+      pixel_pitch = 4;
+      row_pitch = ::width * 4;
+    }
+
+    std::vector<std::uint8_t> buffer;
+  };
+}  // namespace
+
+/**
+ * @brief Runs the readback on Mesa's llvmpipe through a surfaceless EGL display, so no GPU is needed.
+ */
+class ReadbackTest: public ::testing::Test {
+protected:
+  void SetUp() override {
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+
+    if (!gladLoaderLoadEGL(EGL_NO_DISPLAY) || !eglGetPlatformDisplay) {
+      GTEST_SKIP() << "EGL is not available";
+    }
+
+    display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    int major, minor;
+    if (!display || !eglInitialize(display.get(), &major, &minor)) {
+      GTEST_SKIP() << "Surfaceless EGL is not available";
+    }
+
+    // egl::make_ctx() asks for a window config, which a surfaceless display doesn't have
+    constexpr int attr[] {
+      EGL_CONTEXT_CLIENT_VERSION,
+      3,
+      EGL_NONE
+    };
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+      GTEST_SKIP() << "OpenGL is not available";
+    }
+
+    ctx = egl::ctx_t {display.get(), eglCreateContext(display.get(), EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attr)};
+    if (!std::get<1>(ctx.el) || !eglMakeCurrent(display.get(), EGL_NO_SURFACE, EGL_NO_SURFACE, std::get<1>(ctx.el))) {
+      GTEST_SKIP() << "Couldn't create an OpenGL context";
+    }
+
+    if (!gladLoadGLContext(&gl::ctx, eglGetProcAddress) || !gl::ctx.GetTextureSubImage) {
+      GTEST_SKIP() << "OpenGL 4.5 is not available";
+    }
+
+    texture = gl::tex_t::make(1);
+    auto readback_opt = egl::readback_t::make(width, height);
+    ASSERT_TRUE(readback_opt);
+    readback = std::move(*readback_opt);
+  }
+
+  void TearDown() override {
+    unsetenv("LIBGL_ALWAYS_SOFTWARE");
+  }
+
+  /**
+   * @brief Fill the texture with a single value, standing in for frame `frame`.
+   */
+  void draw(std::uint8_t frame) {
+    std::vector<std::uint8_t> pixels(width * height * 4, frame);
+
+    gl::ctx.BindTexture(GL_TEXTURE_2D, texture[0]);
+    gl::ctx.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+    gl::ctx.BindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  /**
+   * @brief Capture frame `frame` the way the capture backends do.
+   */
+  platf::capture_e capture(std::uint8_t frame, std::shared_ptr<platf::img_t> &img_out, bool interrupt = false) {
+    draw(frame);
+
+    auto now = std::chrono::steady_clock::now();
+    timestamps[frame] = now;
+
+    return readback.exchange(texture[0], 0, 0, now, [&](std::shared_ptr<platf::img_t> &img) {
+      if (interrupt) {
+        return false;
+      }
+
+      img = std::make_shared<test_img_t>();
+      return true;
+    }, img_out, 1s, [this, frame](platf::img_t &img) {
+      finished[frame] = img.data[0];
+    });
+  }
+
+  egl::display_t display;
+  egl::ctx_t ctx;
+  gl::tex_t texture;
+  egl::readback_t readback;
+  std::map<std::uint8_t, std::chrono::steady_clock::time_point> timestamps;
+  std::map<std::uint8_t, std::uint8_t> finished;  ///< What the image held when the finish callback of each frame ran
+};
+
+TEST_F(ReadbackTest, DeliversThePreviousFrame) {
+  std::shared_ptr<platf::img_t> img;
+
+  // Nothing is delivered until a second frame comes in
+  EXPECT_EQ(capture(1, img), platf::capture_e::timeout);
+  EXPECT_FALSE(img);
+  EXPECT_EQ(readback.in_flight(), 1);
+
+  for (std::uint8_t frame = 2; frame < 5; ++frame) {
+    ASSERT_EQ(capture(frame, img), platf::capture_e::ok);
+    ASSERT_TRUE(img);
+    EXPECT_EQ(img->data[0], frame - 1);
+    EXPECT_EQ(img->data[width * height * 4 - 1], frame - 1);
+    EXPECT_EQ(img->frame_timestamp, timestamps[frame - 1]);
+
+    // The frame just captured stays in flight
+    EXPECT_EQ(readback.in_flight(), 1);
+  }
+}
+
+TEST_F(ReadbackTest, FinishesTheDeliveredFrame) {
+  std::shared_ptr<platf::img_t> img;
+  capture(1, img);
+  EXPECT_TRUE(finished.empty());
+
+  // The callback queued with a frame runs on the image that frame is delivered into
+  ASSERT_EQ(capture(2, img), platf::capture_e::ok);
+  EXPECT_EQ(finished.size(), 1);
+  EXPECT_EQ(finished[1], 1);
+
+  ASSERT_EQ(capture(3, img), platf::capture_e::ok);
+  EXPECT_EQ(finished.size(), 2);
+  EXPECT_EQ(finished[2], 2);
+}
+
+TEST_F(ReadbackTest, QueuesNothingWhenInterrupted) {
+  std::shared_ptr<platf::img_t> img;
+  capture(1, img);
+
+  EXPECT_EQ(capture(2, img, true), platf::capture_e::interrupted);
+  EXPECT_EQ(readback.in_flight(), 1);
+
+  // The frame held back is delivered next, and the ring doesn't fall further behind
+  ASSERT_EQ(capture(3, img), platf::capture_e::ok);
+  EXPECT_EQ(img->data[0], 1);
+  ASSERT_EQ(capture(4, img), platf::capture_e::ok);
+  EXPECT_EQ(img->data[0], 3);
+}
+
+TEST_F(ReadbackTest, RetrieveDeliversTheFrameHeldBack) {
+  std::shared_ptr<platf::img_t> img;
+  capture(1, img);
+
+  // What the wlroots backend does when the compositor has no new frame
+  test_img_t held;
+  ASSERT_EQ(readback.retrieve(held, 1s), platf::capture_e::ok);
+  EXPECT_EQ(held.data[0], 1);
+  EXPECT_EQ(readback.in_flight(), 0);
+  EXPECT_EQ(readback.retrieve(held, 1s), platf::capture_e::timeout);
+}
+#endif
@@ -0,0 +1,74 @@
+/**
+ * @file tests/unit/test_asset_cache.cpp
+ * @brief Test src/asset_cache.*.
+ */
+// standard includes
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/asset_cache.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+  using AssetCacheTest = TempDirTest;
+}  // namespace
+
+TEST(AssetCacheMatchesTest, IfNoneMatch) {
+  EXPECT_TRUE(asset_cache::matches(R"("a")", R"("a")"));
+  EXPECT_TRUE(asset_cache::matches(R"("b", "a")", R"("a")"));
+  EXPECT_TRUE(asset_cache::matches(R"(W/"a")", R"("a")"));
+  EXPECT_TRUE(asset_cache::matches("*", R"("a")"));
+  EXPECT_FALSE(asset_cache::matches(R"("b")", R"("a")"));
+  EXPECT_FALSE(asset_cache::matches("", R"("a")"));
+}
+
+TEST_F(AssetCacheTest, ServesCachedBytesUntilTheFileChanges) {
+  asset_cache::cache_t cache {1024};
+  auto path = write("cover.png", "first");
+
+  auto first = cache.get(1, path);
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first->data, "first");
+  EXPECT_EQ(cache.get(1, path), first);
+
+  write("cover.png", "changed");
+  fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(1));
+
+  auto second = cache.get(1, path);
+  ASSERT_TRUE(second);
+  EXPECT_EQ(second->data, "changed");
+  EXPECT_NE(second->etag, first->etag);
+}
+
+TEST_F(AssetCacheTest, MissingFile) {
+  asset_cache::cache_t cache {1024};
+
+  EXPECT_FALSE(cache.get(1, dir / "missing.png"));
+}
+
+TEST_F(AssetCacheTest, EvictsLeastRecentlyUsed) {
+  asset_cache::cache_t cache {10};
+  auto a = write("a.png", "aaaa");
+  auto b = write("b.png", "bbbb");
+  auto c = write("c.png", "cccc");
+
+  auto cached_a = cache.get(1, a);
+  cache.get(2, b);
+  cache.get(1, a);
+  cache.get(3, c);
+
+  // b was used least recently
+  EXPECT_EQ(cache.size(), 8);
+  EXPECT_EQ(cache.get(1, a), cached_a);
+
+  // Larger than the budget, served but not kept
+  auto large = write("large.png", std::string(64, 'x'));
+  EXPECT_EQ(cache.get(4, large)->data.size(), 64);
+  EXPECT_EQ(cache.size(), 8);
+}
@@ -0,0 +1,102 @@
+/**
+ * @file tests/unit/test_bitrate_control.cpp
+ * @brief Test src/bitrate_control.*.
+ */
+#include "../tests_common.h"
+
+#include <src/bitrate_control.h>
+
+using namespace std::literals;
+
+namespace {
+  /**
+   * @brief Feeds the controller one interval of 60 FPS at a time.
+   */
+  struct stream_t {
+    std::optional<int> step(std::uint64_t lost = 0, std::chrono::milliseconds rtt = 5ms, std::chrono::microseconds send_latency = 2ms) {
+      now += bitrate_control::controller_t::interval;
+      sent += 60;
+      total_lost += lost;
+
+      return controller.update({now, sent, total_lost, rtt, send_latency});
+    }
+
+    bitrate_control::controller_t controller {20000, 60};
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::uint64_t sent = 0;
+    std::uint64_t total_lost = 0;
+  };
+}  // namespace
+
+TEST(BitrateControlTest, HoldsTheRequestedBitrateOnACleanNetwork) {
+  stream_t stream;
+
+  for (int x = 0; x < 20; ++x) {
+    EXPECT_FALSE(stream.step());
+  }
+  EXPECT_EQ(stream.controller.target(), 20000);
+}
+
+TEST(BitrateControlTest, BacksOffOnLossAndRecovers) {
+  stream_t stream;
+  stream.step();
+
+  auto target = stream.step(12);
+  ASSERT_TRUE(target);
+  EXPECT_LT(*target, 20000);
+  EXPECT_EQ(stream.controller.last_decision(), bitrate_control::decision_e::decrease_loss);
+
+  // No probing until the hold-off passed
+  EXPECT_FALSE(stream.step());
+
+  for (int x = 0; x < 30; ++x) {
+    stream.step();
+  }
+  EXPECT_EQ(stream.controller.target(), 20000);
+}
+
+TEST(BitrateControlTest, BacksOffWhenTheRoundTripTimeClimbs) {
+  stream_t stream;
+  stream.step();
+  stream.step();
+
+  auto target = stream.step(0, 80ms);
+  ASSERT_TRUE(target);
+  EXPECT_EQ(stream.controller.last_decision(), bitrate_control::decision_e::decrease_delay);
+
+  target = stream.step(0, 5ms, 40ms);
+  ASSERT_TRUE(target);
+  EXPECT_EQ(stream.controller.last_decision(), bitrate_control::decision_e::decrease_delay);
+}
+
+TEST(BitrateControlTest, NeverDropsBelowTheFloor) {
+  stream_t stream;
+  stream.step();
+
+  for (int x = 0; x < 50; ++x) {
+    stream.step(30);
+  }
+  EXPECT_EQ(stream.controller.target(), stream.controller.floor());
+  EXPECT_EQ(stream.controller.floor(), 2500);
+}
+
+TEST(BitrateControlTest, DecidesOncePerInterval) {
+  stream_t stream;
+  stream.step();
+
+  stream.now += 100ms;
+  EXPECT_FALSE(stream.controller.update({stream.now, stream.sent, stream.total_lost + 50, 5ms, 2ms}));
+  EXPECT_EQ(stream.controller.target(), 20000);
+}
+
+TEST(BitrateControlTest, RecreatesOnlyForLargeInfrequentChanges) {
+  using bitrate_control::should_recreate;
+
+  // One step of the controller isn't worth a key frame
+  EXPECT_FALSE(should_recreate(20000, 19000, 1min));
+  EXPECT_FALSE(should_recreate(10000, 10500, 1min));
+
+  EXPECT_TRUE(should_recreate(20000, 16000, bitrate_control::recreate_interval));
+  EXPECT_TRUE(should_recreate(10000, 12000, 1min));
+  EXPECT_FALSE(should_recreate(20000, 10000, bitrate_control::recreate_interval - 1s));
+}
@@ -0,0 +1,56 @@
+/**
+ * @file tests/unit/test_compression.cpp
+ * @brief Test src/compression.*.
+ */
+// standard includes
+#include <string>
+
+// lib includes
+#include <zlib.h>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/compression.h>
+
+namespace {
+  std::string gunzip(const std::string &data) {
+    z_stream stream {};
+    inflateInit2(&stream, 15 + 16);
+
+    std::string out(64 * 1024, '\0');
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *) out.data();
+    stream.avail_out = out.size();
+
+    inflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    inflateEnd(&stream);
+
+    return out;
+  }
+}  // namespace
+
+TEST(CompressionTest, Accepts) {
+  EXPECT_TRUE(compression::accepts("gzip, deflate, br", "gzip"));
+  EXPECT_TRUE(compression::accepts("deflate, GZIP;q=0.5", "gzip"));
+  EXPECT_TRUE(compression::accepts("*", "gzip"));
+  EXPECT_FALSE(compression::accepts("gzip;q=0", "gzip"));
+  EXPECT_FALSE(compression::accepts("*, gzip;q=0.0", "gzip"));
+  EXPECT_FALSE(compression::accepts("deflate, br", "gzip"));
+  EXPECT_FALSE(compression::accepts("", "gzip"));
+}
+
+TEST(CompressionTest, GzipRoundTrip) {
+  std::string text;
+  for (int x = 0; x < 1000; ++x) {
+    text += "[2025-01-01 00:00:00.000]: Info: line " + std::to_string(x) + "\n";
+  }
+
+  auto compressed = compression::gzip(text);
+  ASSERT_TRUE(compressed);
+  EXPECT_LT(compressed->size(), text.size() / 4);
+  EXPECT_EQ(gunzip(*compressed), text);
+}
@@ -0,0 +1,121 @@
+/**
+ * @file tests/unit/test_crypto.cpp
+ * @brief Test src/crypto.* client certificate verification.
+ */
+// standard includes
+#include <string>
+#include <vector>
+
+// lib includes
+#include <openssl/rsa.h>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/crypto.h>
+
+using namespace std::literals;
+
+namespace {
+  /**
+   * @brief Generate a self-signed client certificate.
+   * @details Certificates share the key to keep generating many of them cheap, they still differ in serial and name.
+   */
+  crypto::x509_t make_client_cert(crypto::pkey_t &pkey, const std::string &cn) {
+    crypto::x509_t x509 {X509_new()};
+    X509_set_version(x509.get(), 2);
+
+    crypto::bignum_t serial {BN_new()};
+    BN_rand(serial.get(), 159, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+    BN_to_ASN1_INTEGER(serial.get(), X509_get_serialNumber(x509.get()));
+
+    X509_gmtime_adj(X509_getm_notBefore(x509.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509.get()), 60 * 60 * 24);
+    X509_set_pubkey(x509.get(), pkey.get());
+
+    auto name = X509_get_subject_name(x509.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const std::uint8_t *) cn.data(), cn.size(), -1, 0);
+    X509_set_issuer_name(x509.get(), name);
+    X509_sign(x509.get(), pkey.get(), EVP_sha256());
+
+    return x509;
+  }
+
+  crypto::p_named_cert_t make_named_cert(crypto::x509_t &x509, const std::string &name) {
+    auto named_cert = std::make_shared<crypto::named_cert_t>();
+    named_cert->name = name;
+    named_cert->cert = crypto::pem(x509);
+
+    return named_cert;
+  }
+
+  class CertChainTest: public ::testing::Test {
+  protected:
+    void SetUp() override {
+      auto creds = crypto::gen_creds("Test Client"sv, 2048);
+      pkey = crypto::pkey(creds.pkey);
+    }
+
+    crypto::pkey_t pkey;
+  };
+}  // namespace
+
+TEST_F(CertChainTest, VerifiesPairedClients) {
+  auto first = make_client_cert(pkey, "first");
+  auto second = make_client_cert(pkey, "second");
+  auto unpaired = make_client_cert(pkey, "unpaired");
+
+  auto first_named = make_named_cert(first, "first");
+  auto second_named = make_named_cert(second, "second");
+
+  crypto::cert_chain_t cert_chain;
+  cert_chain.add(first_named);
+  cert_chain.add(second_named);
+
+  crypto::p_named_cert_t named_cert;
+  EXPECT_EQ(cert_chain.verify(second.get(), named_cert), nullptr);
+  EXPECT_EQ(named_cert, second_named);
+
+  // The cached result must map to the same client
+  EXPECT_EQ(cert_chain.verify(first.get(), named_cert), nullptr);
+  EXPECT_EQ(cert_chain.verify(first.get(), named_cert), nullptr);
+  EXPECT_EQ(named_cert, first_named);
+
+  named_cert.reset();
+  EXPECT_NE(cert_chain.verify(unpaired.get(), named_cert), nullptr);
+  EXPECT_FALSE(named_cert);
+
+  cert_chain.remove(second_named);
+  EXPECT_NE(cert_chain.verify(second.get(), named_cert), nullptr);
+  EXPECT_EQ(cert_chain.verify(first.get(), named_cert), nullptr);
+
+  cert_chain.clear();
+  EXPECT_NE(cert_chain.verify(first.get(), named_cert), nullptr);
+}
+
+TEST_F(CertChainTest, OneThousandPairedClients) {
+  constexpr int clients = 1000;
+
+  std::vector<crypto::x509_t> certs;
+  std::vector<crypto::p_named_cert_t> named_certs;
+  crypto::cert_chain_t cert_chain;
+  for (int x = 0; x < clients; ++x) {
+    certs.emplace_back(make_client_cert(pkey, "client " + std::to_string(x)));
+    named_certs.emplace_back(make_named_cert(certs.back(), "client " + std::to_string(x)));
+    cert_chain.add(named_certs.back());
+  }
+
+  for (int x = 0; x < clients; ++x) {
+    crypto::p_named_cert_t named_cert;
+    ASSERT_EQ(cert_chain.verify(certs[x].get(), named_cert), nullptr);
+    ASSERT_EQ(named_cert, named_certs[x]);
+  }
+
+  // Clients poll serverinfo, so most verifications are of certificates seen before
+  for (int x = 0; x < clients; ++x) {
+    crypto::p_named_cert_t named_cert;
+    ASSERT_EQ(cert_chain.verify(certs[clients - 1 - x].get(), named_cert), nullptr);
+    ASSERT_EQ(named_cert, named_certs[clients - 1 - x]);
+  }
+}
@@ -0,0 +1,84 @@
+/**
+ * @file tests/unit/test_frame_trace.cpp
+ * @brief Test src/frame_trace.*.
+ */
+// standard includes
+#include <algorithm>
+#include <thread>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/frame_trace.h>
+
+using namespace std::literals;
+
+TEST(FrameTraceTest, SnapshotReturnsRecordedEvents) {
+  auto now = std::chrono::steady_clock::now();
+  frame_trace::record(frame_trace::stage_e::convert, 4242, now - 3ms, now - 1ms);
+
+  auto events = frame_trace::snapshot(1s);
+  auto it = std::find_if(events.begin(), events.end(), [](const auto &event) {
+    return event.frame == 4242;
+  });
+  ASSERT_NE(it, events.end());
+  EXPECT_EQ(it->stage, frame_trace::stage_e::convert);
+  EXPECT_EQ(it->duration, 2ms);
+}
+
+TEST(FrameTraceTest, SnapshotSkipsOldEvents) {
+  auto now = std::chrono::steady_clock::now();
+  frame_trace::record(frame_trace::stage_e::fec, 4343, now - 10s, now - 9s);
+
+  auto events = frame_trace::snapshot(1s);
+  EXPECT_TRUE(std::none_of(events.begin(), events.end(), [](const auto &event) {
+    return event.frame == 4343;
+  }));
+}
+
+TEST(FrameTraceTest, ConcurrentWriters) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t]() {
+      for (int x = 0; x < 1000; ++x) {
+        frame_trace::scope_t trace {frame_trace::stage_e::send_batch, 100000 * (t + 1) + x};
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto events = frame_trace::snapshot(10s);
+  auto count = std::count_if(events.begin(), events.end(), [](const auto &event) {
+    return event.stage == frame_trace::stage_e::send_batch && event.frame >= 100000;
+  });
+  EXPECT_EQ(count, 4000);
+}
+
+TEST(FrameTraceTest, ChromeTraceFormat) {
+  frame_trace::name_thread("Test");
+
+  auto now = std::chrono::steady_clock::now();
+  std::vector<frame_trace::event_t> events {
+    {now, 1500us, 7, 1, frame_trace::stage_e::encode_submit},
+    {now, 500us, -1, 1, frame_trace::stage_e::capture},
+  };
+
+  auto trace = frame_trace::to_chrome_trace(events);
+  auto &trace_events = trace.at("traceEvents");
+
+  auto complete = std::count_if(trace_events.begin(), trace_events.end(), [](const auto &event) {
+    return event.at("ph") == "X";
+  });
+  EXPECT_EQ(complete, 2);
+
+  auto &encode = trace_events[trace_events.size() - 2];
+  EXPECT_EQ(encode.at("name"), "encode_submit");
+  EXPECT_DOUBLE_EQ(encode.at("dur").get<double>(), 1500.0);
+  EXPECT_EQ(encode.at("args").at("frame"), 7);
+
+  auto &capture = trace_events.back();
+  EXPECT_FALSE(capture.contains("args"));
+}
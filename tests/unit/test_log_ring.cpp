@@ -0,0 +1,63 @@
+/**
+ * @file tests/unit/test_log_ring.cpp
+ * @brief Test src/log_ring.*.
+ */
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/log_ring.h>
+
+TEST(LogRingTest, ContinuesFromTheEndOffset) {
+  log_ring::ring_t ring {1024};
+
+  ring.push(2, "first");
+  ring.push(2, "second");
+
+  auto slice = ring.read(0);
+  EXPECT_EQ(slice.text, "first\nsecond\n");
+  EXPECT_EQ(slice.start, 0);
+  EXPECT_EQ(slice.end, 13);
+
+  ring.push(2, "third");
+
+  slice = ring.read(slice.end);
+  EXPECT_EQ(slice.text, "third\n");
+  EXPECT_EQ(slice.end, 19);
+
+  slice = ring.read(slice.end);
+  EXPECT_EQ(slice.text, "");
+  EXPECT_EQ(slice.end, 19);
+}
+
+TEST(LogRingTest, FiltersBySeverity) {
+  log_ring::ring_t ring {1024};
+
+  ring.push(1, "debug");
+  ring.push(4, "error");
+  ring.push(2, "info");
+
+  auto slice = ring.read(0, 2);
+  EXPECT_EQ(slice.text, "error\ninfo\n");
+
+  // Offsets still count the lines that were left out
+  EXPECT_EQ(slice.end, 17);
+}
+
+TEST(LogRingTest, TailAndCapacity) {
+  log_ring::ring_t ring {16};
+
+  ring.push(2, "aaaa");
+  ring.push(2, "bbbb");
+  ring.push(2, "cccc");
+  ring.push(2, "dddd");
+
+  // Only the newest lines fit, the offsets keep counting the dropped ones
+  auto slice = ring.read(0);
+  EXPECT_EQ(slice.text, "bbbb\ncccc\ndddd\n");
+  EXPECT_EQ(slice.start, 5);
+  EXPECT_EQ(slice.end, 20);
+
+  slice = ring.read(0, 0, 12);
+  EXPECT_EQ(slice.text, "cccc\ndddd\n");
+}
@@ -0,0 +1,145 @@
+/**
+ * @file tests/unit/test_metrics.cpp
+ * @brief Test src/metrics.*.
+ */
+// standard includes
+#include <optional>
+#include <sstream>
+#include <string>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/metrics.h>
+
+namespace {
+  /**
+   * @brief Find the value of a sample line, e.g. `aqua_frames_sent_total`.
+   */
+  std::optional<double> find_sample(const std::string &text, const std::string &series) {
+    std::istringstream in {text};
+    for (std::string line; std::getline(in, line);) {
+      if (line.starts_with(series + ' ')) {
+        return std::stod(line.substr(series.size() + 1));
+      }
+    }
+
+    return std::nullopt;
+  }
+}  // namespace
+
+TEST(MetricsTest, ExportsSessionCounters) {
+  metrics::session_t session {0xF0000001, "Living \"Room\""};
+  session.add(metrics::counter_e::frames_encoded, 5);
+  session.add(metrics::counter_e::frames_sent, 3);
+  session.add(metrics::counter_e::video_packets_sent, 120);
+  session.add(metrics::counter_e::video_fec_packets_sent, 20);
+
+  auto text = metrics::to_prometheus();
+  std::string labels = R"({session="4026531841",client="Living \"Room\""})";
+
+  EXPECT_EQ(find_sample(text, "aqua_session_frames_sent_total" + labels), 3);
+  EXPECT_EQ(find_sample(text, "aqua_session_video_queue_depth" + labels), 0);
+  EXPECT_DOUBLE_EQ(*find_sample(text, "aqua_session_fec_overhead_ratio" + labels), 0.2);
+  EXPECT_GE(*find_sample(text, "aqua_sessions_active"), 1);
+  EXPECT_NE(text.find("# TYPE aqua_frames_sent_total counter"), std::string::npos);
+}
+
+TEST(MetricsTest, QueueDepthFollowsQueuedPackets) {
+  metrics::session_t session {0xF0000007, "Queue"};
+  std::string sample = R"(aqua_session_video_queue_depth{session="4026531847",client="Queue"})";
+
+  std::optional<metrics::queued_packet_t> sent;
+  sent.emplace(session);
+  {
+    metrics::queued_packet_t dropped {session};
+    EXPECT_EQ(find_sample(metrics::to_prometheus(), sample), 2);
+  }
+
+  // A packet dropped before the network thread got to it doesn't count anymore
+  EXPECT_EQ(find_sample(metrics::to_prometheus(), sample), 1);
+
+  sent.reset();
+  EXPECT_EQ(find_sample(metrics::to_prometheus(), sample), 0);
+}
+
+TEST(MetricsTest, TotalsKeepEndedSessions) {
+  auto before = find_sample(metrics::to_prometheus(), "aqua_input_events_total").value_or(0);
+
+  {
+    metrics::session_t session {0xF0000002, "client"};
+    session.add(metrics::counter_e::input_events, 7);
+  }
+
+  auto text = metrics::to_prometheus();
+  EXPECT_EQ(find_sample(text, "aqua_input_events_total"), before + 7);
+  EXPECT_EQ(text.find("session=\"4026531842\""), std::string::npos);
+}
+
+TEST(MetricsTest, ExportsLatencyHistograms) {
+  metrics::session_t session {0xF0000003, "client"};
+  session.encode_latency.record(500);
+  session.encode_latency.record(3000);
+  session.encode_latency.record(1000000);
+
+  auto text = metrics::to_prometheus();
+  std::string labels = R"(session="4026531843",client="client")";
+
+  EXPECT_EQ(find_sample(text, "aqua_session_encode_latency_seconds_bucket{" + labels + R"(,le="0.001"})"), 1);
+  EXPECT_EQ(find_sample(text, "aqua_session_encode_latency_seconds_bucket{" + labels + R"(,le="0.004"})"), 2);
+  EXPECT_EQ(find_sample(text, "aqua_session_encode_latency_seconds_bucket{" + labels + R"(,le="+Inf"})"), 3);
+  EXPECT_EQ(find_sample(text, "aqua_session_encode_latency_seconds_count{" + labels + "}"), 3);
+  EXPECT_GE(*find_sample(text, "aqua_encode_latency_seconds_count"), 3);
+}
+
+TEST(MetricsTest, ExportsInputLatencyAndBatchSize) {
+  metrics::session_t session {0xF0000004, "client"};
+  session.input_latency[(int) metrics::input_type_e::mouse_rel].record(700);
+  session.input_latency[(int) metrics::input_type_e::mouse_rel].record(3000);
+  session.input_batch_size.record(1);
+  session.input_batch_size.record(3);
+
+  auto text = metrics::to_prometheus();
+  std::string labels = R"(session="4026531844",client="client")";
+
+  EXPECT_EQ(find_sample(text, "aqua_session_input_latency_seconds_bucket{" + labels + R"(,type="mouse_rel",le="0.001"})"), 1);
+  EXPECT_EQ(find_sample(text, "aqua_session_input_latency_seconds_count{" + labels + R"(,type="mouse_rel"})"), 2);
+  EXPECT_EQ(text.find("aqua_session_input_latency_seconds_count{" + labels + R"(,type="pen"})"), std::string::npos);
+  EXPECT_GE(*find_sample(text, R"(aqua_input_latency_seconds_count{type="mouse_rel"})"), 2);
+
+  EXPECT_EQ(find_sample(text, "aqua_session_input_batch_size_bucket{" + labels + R"(,le="2"})"), 1);
+  EXPECT_EQ(find_sample(text, "aqua_session_input_batch_size_bucket{" + labels + R"(,le="4"})"), 2);
+  EXPECT_EQ(find_sample(text, "aqua_session_input_batch_size_sum{" + labels + "}"), 4);
+}
+
+TEST(MetricsTest, ExportsTargetBitrateOnlyWhileControlled) {
+  metrics::session_t session {0xF0000005, "client"};
+  std::string sample = R"(aqua_session_target_bitrate_bits_per_second{session="4026531845",client="client"})";
+
+  EXPECT_FALSE(find_sample(metrics::to_prometheus(), sample));
+
+  session.target_bitrate_kbps = 15000;
+  session.add(metrics::counter_e::bitrate_decreases);
+
+  auto text = metrics::to_prometheus();
+  EXPECT_EQ(find_sample(text, sample), 15000000);
+  EXPECT_EQ(find_sample(text, R"(aqua_session_bitrate_decreases_total{session="4026531845",client="client"})"), 1);
+}
+
+TEST(MetricsTest, ExportsFrameSizesAndIdrFrames) {
+  metrics::session_t session {0xF0000006, "client"};
+  session.frame_size.record(3000);
+  session.frame_size.record(20000);
+  session.frame_size.record(400000);
+  session.add(metrics::counter_e::idr_frames_sent);
+
+  auto text = metrics::to_prometheus();
+  std::string labels = R"(session="4026531846",client="client")";
+
+  EXPECT_EQ(find_sample(text, "aqua_session_frame_size_bytes_bucket{" + labels + R"(,le="4096"})"), 1);
+  EXPECT_EQ(find_sample(text, "aqua_session_frame_size_bytes_bucket{" + labels + R"(,le="32768"})"), 2);
+  EXPECT_EQ(find_sample(text, "aqua_session_frame_size_bytes_bucket{" + labels + R"(,le="+Inf"})"), 3);
+  EXPECT_EQ(find_sample(text, "aqua_session_idr_frames_sent_total{" + labels + "}"), 1);
+  EXPECT_GE(*find_sample(text, "aqua_frame_size_bytes_count"), 3);
+}
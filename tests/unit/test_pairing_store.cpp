@@ -0,0 +1,184 @@
+/**
+ * @file tests/unit/test_pairing_store.cpp
+ * @brief Test src/pairing_store.*.
+ */
+// standard includes
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/pairing_store.h>
+
+using namespace std::literals;
+
+namespace fs = std::filesystem;
+
+namespace {
+  nlohmann::json make_device(int x, const std::string &name) {
+    return {
+      {"name", name},
+      {"cert", "-----BEGIN CERTIFICATE-----\n" + std::string(1200, 'A' + x % 26) + "\n-----END CERTIFICATE-----\n"},
+      {"uuid", "uuid-" + std::to_string(x)},
+      {"display_mode", ""},
+      {"perm", 0x04000000}
+    };
+  }
+
+  class PairingStoreTest: public TempDirTest {
+  protected:
+    void SetUp() override {
+      TempDirTest::SetUp();
+      file = dir / "sunshine_state.json";
+    }
+
+    fs::path file;
+  };
+}  // namespace
+
+TEST_F(PairingStoreTest, ReplaysTheJournal) {
+  {
+    pairing_store::store_t store;
+    EXPECT_FALSE(store.load(file));
+    store.set_unique_id("unique");
+
+    // The first change writes the snapshot, the others go to the journal
+    store.put(make_device(0, "first"));
+    EXPECT_TRUE(fs::exists(file));
+    store.put(make_device(1, "second"));
+    store.put(make_device(2, "third"));
+    store.put(make_device(1, "renamed"));
+    store.remove("uuid-0");
+    EXPECT_EQ(store.journal_size(), 4);
+  }
+
+  pairing_store::store_t store;
+  auto root = store.load(file);
+  ASSERT_TRUE(root);
+  EXPECT_EQ((*root)["uniqueid"], "unique");
+
+  auto &devices = (*root)["named_devices"];
+  ASSERT_EQ(devices.size(), 2);
+  EXPECT_EQ(devices[0]["name"], "renamed");
+  EXPECT_EQ(devices[1]["name"], "third");
+}
+
+TEST_F(PairingStoreTest, KeepsOtherKeysAndDropsTornRecords) {
+  {
+    pairing_store::store_t store;
+    store.load(file);
+    store.set_unique_id("unique");
+    store.put(make_device(0, "first"));
+    store.put(make_device(1, "second"));
+  }
+
+  // The web UI credentials live in the same file
+  nlohmann::json tree;
+  std::ifstream {file} >> tree;
+  tree["username"] = "admin";
+  std::ofstream {file} << tree.dump(4);
+
+  // A crash while appending leaves half a record
+  std::ofstream {pairing_store::store_t::journal_path(file), std::ios::app} << R"({"op":"remove","uu)";
+
+  pairing_store::store_t store;
+  auto root = store.load(file);
+  ASSERT_TRUE(root);
+  EXPECT_EQ((*root)["named_devices"].size(), 2);
+
+  // Loading compacted the journal away
+  EXPECT_FALSE(fs::exists(pairing_store::store_t::journal_path(file)));
+
+  std::ifstream {file} >> tree;
+  EXPECT_EQ(tree["username"], "admin");
+  EXPECT_EQ(tree["root"]["named_devices"].size(), 2);
+}
+
+TEST_F(PairingStoreTest, KeepsADamagedJournal) {
+  {
+    pairing_store::store_t store;
+    store.load(file);
+    store.set_unique_id("unique");
+    store.put(make_device(0, "first"));
+    store.put(make_device(1, "second"));
+    store.put(make_device(2, "third"));
+  }
+
+  // Damage the first record, the one after it is still complete
+  auto journal = pairing_store::store_t::journal_path(file);
+  std::string contents;
+  {
+    std::ifstream in {journal};
+    contents.assign(std::istreambuf_iterator<char> {in}, {});
+  }
+  contents[0] = '#';
+  std::ofstream {journal} << contents;
+
+  pairing_store::store_t store;
+  auto root = store.load(file);
+  ASSERT_TRUE(root);
+  EXPECT_EQ((*root)["named_devices"].size(), 1);
+
+  // Neither loading nor later changes touch the journal
+  store.put(make_device(3, "fourth"));
+  store.reset(nlohmann::json::array());
+
+  std::string after;
+  {
+    std::ifstream in {journal};
+    after.assign(std::istreambuf_iterator<char> {in}, {});
+  }
+  EXPECT_EQ(after, contents);
+
+  nlohmann::json tree;
+  std::ifstream {file} >> tree;
+  EXPECT_EQ(tree["root"]["named_devices"].size(), 1);
+}
+
+TEST_F(PairingStoreTest, Reset) {
+  pairing_store::store_t store;
+  store.load(file);
+  store.set_unique_id("unique");
+  store.put(make_device(0, "first"));
+  store.put(make_device(1, "second"));
+
+  store.reset(nlohmann::json::array());
+  EXPECT_EQ(store.journal_size(), 0);
+
+  pairing_store::store_t reloaded;
+  auto root = reloaded.load(file);
+  ASSERT_TRUE(root);
+  EXPECT_TRUE((*root)["named_devices"].empty());
+}
+
+TEST_F(PairingStoreTest, OneThousandClients) {
+  constexpr int clients = 1000;
+
+  pairing_store::store_t store;
+  store.load(file);
+  store.set_unique_id("unique");
+
+  for (int x = 0; x < clients; ++x) {
+    store.put(make_device(x, "client " + std::to_string(x)));
+  }
+
+  // Changing one client rewrites only that client
+  for (int x = 0; x < 100; ++x) {
+    auto device = make_device(x, "renamed " + std::to_string(x));
+    device["perm"] = 0;
+    store.put(device);
+  }
+
+  pairing_store::store_t reloaded;
+  auto root = reloaded.load(file);
+
+  ASSERT_TRUE(root);
+  ASSERT_EQ((*root)["named_devices"].size(), clients);
+  EXPECT_EQ((*root)["named_devices"][99]["name"], "renamed 99");
+  EXPECT_EQ((*root)["named_devices"][99]["perm"], 0);
+  EXPECT_EQ((*root)["named_devices"][100]["name"], "client 100");
+}
@@ -0,0 +1,73 @@
+/**
+ * @file tests/unit/test_process.cpp
+ * @brief Test src/process.*.
+ */
+#include "../tests_common.h"
+
+#include <src/process.h>
+
+namespace {
+  proc::ctx_t make_app(const std::string &id, const std::string &uuid, const std::string &name) {
+    proc::ctx_t app {};
+    app.id = id;
+    app.uuid = uuid;
+    app.name = name;
+
+    return app;
+  }
+}  // namespace
+
+TEST(ProcessTests, FindsAppsByIdAndUuid) {
+  std::vector<proc::ctx_t> apps;
+  apps.push_back(make_app("1234", "AAAA-1", "Desktop"));
+  apps.push_back(make_app("5678", "BBBB-2", "Steam"));
+
+  proc::proc_t proc {boost::process::v1::environment {}, std::move(apps)};
+
+  auto app = proc.find_app(5678);
+  ASSERT_NE(app, nullptr);
+  EXPECT_EQ(app->name, "Steam");
+
+  app = proc.find_app_by_uuid("AAAA-1");
+  ASSERT_NE(app, nullptr);
+  EXPECT_EQ(app->name, "Desktop");
+
+  EXPECT_EQ(proc.find_app(42), nullptr);
+  EXPECT_EQ(proc.find_app_by_uuid("CCCC-3"), nullptr);
+}
+
+TEST(ProcessTests, UpdateAppsReindexes) {
+  std::vector<proc::ctx_t> apps;
+  apps.push_back(make_app("1234", "AAAA-1", "Desktop"));
+  proc::proc_t proc {boost::process::v1::environment {}, std::move(apps)};
+
+  std::vector<proc::ctx_t> reloaded;
+  reloaded.push_back(make_app("9999", "DDDD-4", "Emulator"));
+  proc.update_apps(proc::proc_t {boost::process::v1::environment {}, std::move(reloaded)});
+
+  EXPECT_EQ(proc.find_app(1234), nullptr);
+  auto app = proc.find_app(9999);
+  ASSERT_NE(app, nullptr);
+  EXPECT_EQ(app->uuid, "DDDD-4");
+  EXPECT_EQ(proc.get_apps()->size(), 1);
+}
+
+TEST(ProcessTests, FoundAppsOutliveReloads) {
+  std::vector<proc::ctx_t> apps;
+  apps.push_back(make_app("1234", "AAAA-1", "Desktop"));
+  proc::proc_t proc {boost::process::v1::environment {}, std::move(apps)};
+
+  // Launching holds on to the app while the apps file is reloaded underneath it
+  auto app = proc.find_app(1234);
+  auto listed = proc.get_apps();
+
+  std::vector<proc::ctx_t> reloaded;
+  reloaded.push_back(make_app("9999", "DDDD-4", "Emulator"));
+  proc.update_apps(proc::proc_t {boost::process::v1::environment {}, std::move(reloaded)});
+
+  ASSERT_NE(app, nullptr);
+  EXPECT_EQ(app->name, "Desktop");
+  ASSERT_EQ(listed->size(), 1);
+  EXPECT_EQ((*listed)[0].uuid, "AAAA-1");
+  EXPECT_EQ(proc.get_apps()->front().uuid, "DDDD-4");
+}
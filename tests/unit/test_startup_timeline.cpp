@@ -0,0 +1,72 @@
+/**
+ * @file tests/unit/test_startup_timeline.cpp
+ * @brief Test src/startup_timeline.*.
+ */
+#include "../tests_common.h"
+
+#include <src/startup_timeline.h>
+
+using namespace std::literals;
+
+namespace {
+  const nlohmann::json *find_timeline(const nlohmann::json &json, std::uint32_t id) {
+    for (const auto &timeline : json.at("timelines")) {
+      if (timeline.at("id").get<std::uint32_t>() == id) {
+        return &timeline;
+      }
+    }
+
+    return nullptr;
+  }
+}  // namespace
+
+TEST(StartupTimelineTest, OffsetsAreRelativeToLaunch) {
+  auto start = std::chrono::steady_clock::now();
+
+  startup_timeline::timeline_t timeline {1, "client"};
+  timeline.phases[(int) startup_timeline::phase_e::launch_received] = start;
+  timeline.phases[(int) startup_timeline::phase_e::rtsp_play] = start + 250ms;
+
+  EXPECT_EQ(timeline.offset(startup_timeline::phase_e::rtsp_play), 250ms);
+  EXPECT_FALSE(timeline.offset(startup_timeline::phase_e::first_frame_sent));
+
+  auto line = startup_timeline::format(timeline);
+  EXPECT_NE(line.find("rtsp_play=+250ms"), std::string::npos);
+  EXPECT_EQ(line.find("first_frame_sent"), std::string::npos);
+}
+
+TEST(StartupTimelineTest, CompletesOnFirstFrame) {
+  constexpr std::uint32_t id = 0xF0000001;
+
+  startup_timeline::begin(id, "client", std::chrono::steady_clock::now() - 100ms);
+  startup_timeline::mark(id, startup_timeline::phase_e::rtsp_announce);
+  EXPECT_FALSE(find_timeline(startup_timeline::to_json(), id));
+
+  startup_timeline::mark(id, startup_timeline::phase_e::first_frame_sent);
+
+  auto json = startup_timeline::to_json();
+  auto timeline = find_timeline(json, id);
+  ASSERT_TRUE(timeline);
+  EXPECT_EQ(timeline->at("client_name"), "client");
+  EXPECT_GE(timeline->at("total_ms").get<std::int64_t>(), 100);
+  EXPECT_TRUE(timeline->at("phases_ms").contains("rtsp_announce"));
+  EXPECT_FALSE(timeline->at("phases_ms").contains("rtsp_play"));
+  EXPECT_GE(json.at("summary").at("count").get<std::size_t>(), 1);
+
+  // Marks after completion are ignored
+  startup_timeline::mark(id, startup_timeline::phase_e::rtsp_play);
+  json = startup_timeline::to_json();
+  timeline = find_timeline(json, id);
+  ASSERT_TRUE(timeline);
+  EXPECT_FALSE(timeline->at("phases_ms").contains("rtsp_play"));
+}
+
+TEST(StartupTimelineTest, DiscardedSessionsNeverComplete) {
+  constexpr std::uint32_t id = 0xF0000002;
+
+  startup_timeline::begin(id, "client", std::chrono::steady_clock::now());
+  startup_timeline::discard(id);
+  startup_timeline::mark(id, startup_timeline::phase_e::first_frame_sent);
+
+  EXPECT_FALSE(find_timeline(startup_timeline::to_json(), id));
+}
@@ -0,0 +1,145 @@
+/**
+ * @file tests/unit/test_stat_trackers.cpp
+ * @brief Test src/stat_trackers.*.
+ */
+// standard includes
+#include <thread>
+#include <vector>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/stat_trackers.h>
+
+TEST(PercentileTrackerTest, CalculatesPercentiles) {
+  stat_trackers::percentile_tracker<int> tracker;
+
+  // collected with a large interval so the callback never fires
+  for (int i = 100; i >= 1; --i) {
+    tracker.collect_and_callback_on_interval(i, [](auto &&...) {
+      FAIL() << "Unexpected callback";
+    }, std::chrono::seconds(3600));
+  }
+
+  const auto stats = tracker.calculate();
+  EXPECT_EQ(stats.p50, 51);
+  EXPECT_EQ(stats.p90, 91);
+  EXPECT_EQ(stats.p99, 100);
+  EXPECT_EQ(stats.max, 100);
+}
+
+TEST(PercentileTrackerTest, EmptyTrackerReportsZero) {
+  stat_trackers::percentile_tracker<double> tracker;
+
+  const auto stats = tracker.calculate();
+  EXPECT_EQ(stats.p50, 0);
+  EXPECT_EQ(stats.max, 0);
+}
+
+TEST(PercentileTrackerTest, CallbackOnInterval) {
+  stat_trackers::percentile_tracker<int> tracker;
+  std::size_t reported = 0;
+
+  auto callback = [&](const stat_trackers::percentile_tracker<int>::percentiles_t &stats, std::size_t samples) {
+    reported += samples;
+    EXPECT_EQ(stats.max, 5);
+  };
+
+  tracker.collect_and_callback_on_interval(5, callback, std::chrono::seconds(0));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  tracker.collect_and_callback_on_interval(3, callback, std::chrono::seconds(0));
+
+  EXPECT_EQ(reported, 1);
+}
+
+TEST(PercentileTrackerTest, ReportsP999) {
+  stat_trackers::percentile_tracker<int> tracker;
+
+  for (int i = 1; i <= 1000; ++i) {
+    tracker.collect_and_callback_on_interval(i == 1000 ? 5000 : 1, [](auto &&...) {}, std::chrono::seconds(3600));
+  }
+
+  const auto stats = tracker.calculate();
+  EXPECT_EQ(stats.p99, 1);
+  EXPECT_GE(stats.p999, 4900);
+  EXPECT_EQ(stats.max, 5000);
+}
+
+TEST(HistogramTest, SmallValuesAreExact) {
+  stat_trackers::histogram_t histogram;
+
+  for (std::uint64_t x = 0; x < 128; ++x) {
+    histogram.record(x);
+  }
+
+  EXPECT_EQ(histogram.count(), 128);
+  EXPECT_EQ(histogram.min(), 0);
+  EXPECT_EQ(histogram.max(), 127);
+  EXPECT_DOUBLE_EQ(histogram.mean(), 63.5);
+  EXPECT_EQ(histogram.value_at_percentile(0.5), 64);
+  EXPECT_EQ(histogram.value_at_percentile(1.0), 127);
+}
+
+TEST(HistogramTest, LargeValuesWithinBucketError) {
+  for (std::uint64_t value : {129ull, 1000ull, 123456ull, 987654321ull, 1ull << 39}) {
+    stat_trackers::histogram_t histogram;
+    histogram.record(value);
+    histogram.record(value * 2);
+
+    auto estimate = histogram.value_at_percentile(0.25);
+    EXPECT_GE(estimate, value);
+    EXPECT_LE(estimate - value, value / 64) << "value " << value;
+  }
+}
+
+TEST(HistogramTest, MergeAddsSamples) {
+  stat_trackers::histogram_t a;
+  stat_trackers::histogram_t b;
+
+  for (int x = 0; x < 50; ++x) {
+    a.record(10);
+    b.record(20);
+  }
+  b.record(5000);
+
+  a.merge(b);
+  EXPECT_EQ(a.count(), 101);
+  EXPECT_EQ(a.min(), 10);
+  EXPECT_EQ(a.max(), 5000);
+  EXPECT_EQ(a.value_at_percentile(0.25), 10);
+  EXPECT_EQ(a.value_at_percentile(0.75), 20);
+
+  std::uint64_t buckets = 0;
+  std::uint64_t samples = 0;
+  a.for_each_bucket([&](std::uint64_t, std::uint64_t count) {
+    ++buckets;
+    samples += count;
+  });
+  EXPECT_EQ(buckets, 3);
+  EXPECT_EQ(samples, 101);
+
+  a.reset();
+  EXPECT_EQ(a.count(), 0);
+  EXPECT_EQ(a.value_at_percentile(0.5), 0);
+}
+
+TEST(HistogramTest, ConcurrentRecord) {
+  stat_trackers::histogram_t histogram;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram, t]() {
+      for (int x = 0; x < 10000; ++x) {
+        histogram.record(t * 1000 + x % 100);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(histogram.count(), 40000);
+  EXPECT_EQ(histogram.min(), 0);
+  EXPECT_GE(histogram.max(), 3099);
+}
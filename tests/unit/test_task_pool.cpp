@@ -0,0 +1,149 @@
+/**
+ * @file tests/unit/test_task_pool.cpp
+ * @brief Test src/task_pool.h and src/thread_pool.h.
+ */
+// standard includes
+#include <array>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/thread_pool.h>
+
+using namespace std::literals;
+
+namespace {
+  /**
+   * @brief Run every task that is due.
+   */
+  int run_ready(task_pool_util::TaskPool &pool) {
+    int count = 0;
+    while (auto task = pool.pop()) {
+      task->run();
+      ++count;
+    }
+
+    return count;
+  }
+}  // namespace
+
+TEST(TaskPoolTest, ImmediateTasksRunInOrder) {
+  task_pool_util::TaskPool pool;
+  std::vector<int> order;
+
+  for (int x = 0; x < 5; ++x) {
+    pool.push([&order](int value) {
+      order.push_back(value);
+    }, x);
+  }
+
+  EXPECT_EQ(run_ready(pool), 5);
+  EXPECT_EQ(order, (std::vector<int> {0, 1, 2, 3, 4}));
+}
+
+TEST(TaskPoolTest, DelayedTasksRunByDeadline) {
+  task_pool_util::TaskPool pool;
+  std::vector<int> order;
+
+  for (int x : {3, 1, 4, 0, 2}) {
+    pool.pushDelayed([&order, x]() {
+      order.push_back(x);
+    }, std::chrono::milliseconds {x});
+  }
+
+  std::this_thread::sleep_for(10ms);
+
+  EXPECT_EQ(run_ready(pool), 5);
+  EXPECT_EQ(order, (std::vector<int> {0, 1, 2, 3, 4}));
+  EXPECT_FALSE(pool.next());
+}
+
+TEST(TaskPoolTest, CancelAndDelay) {
+  task_pool_util::TaskPool pool;
+  int ran = 0;
+
+  auto cancelled = pool.pushDelayed([&ran]() {
+    ran += 1;
+  }, 0ms).task_id;
+  auto delayed = pool.pushDelayed([&ran]() {
+    ran += 10;
+  }, 0ms).task_id;
+  pool.pushDelayed([&ran]() {
+    ran += 100;
+  }, 0ms);
+
+  EXPECT_TRUE(pool.cancel(cancelled));
+  EXPECT_FALSE(pool.cancel(cancelled));
+  pool.delay(delayed, 1h);
+
+  std::this_thread::sleep_for(1ms);
+  EXPECT_EQ(run_ready(pool), 1);
+  EXPECT_EQ(ran, 100);
+
+  EXPECT_TRUE(pool.cancel(delayed));
+  EXPECT_FALSE(pool.next());
+}
+
+TEST(TaskPoolTest, StaleIdDoesNotCancelNewTask) {
+  task_pool_util::TaskPool pool;
+
+  auto stale = pool.pushDelayed([]() {}, 0ms).task_id;
+  std::this_thread::sleep_for(1ms);
+  EXPECT_EQ(run_ready(pool), 1);
+
+  // The new task reuses the slot of the one that ran
+  auto fresh = pool.pushDelayed([]() {}, 0ms).task_id;
+  EXPECT_NE(stale, fresh);
+  EXPECT_FALSE(pool.cancel(stale));
+  EXPECT_TRUE(pool.cancel(fresh));
+}
+
+TEST(TaskPoolTest, LargeCallables) {
+  task_pool_util::TaskPool pool;
+  std::array<char, 256> payload {};
+  payload[255] = 42;
+  int seen = 0;
+
+  pool.push([payload, &seen]() {
+    seen = payload[255];
+  });
+
+  EXPECT_EQ(run_ready(pool), 1);
+  EXPECT_EQ(seen, 42);
+}
+
+TEST(TaskPoolTest, TenThousandTimers) {
+  constexpr int timers = 10000;
+
+  thread_pool_util::ThreadPool pool {1};
+  std::atomic<int> ran {0};
+  std::atomic<int> cancelled_ran {0};
+
+  std::mt19937 rng {1234};
+  std::uniform_int_distribution<int> delay_us {0, 1000000};
+
+  auto start = std::chrono::steady_clock::now();
+  for (int x = 0; x < timers; ++x) {
+    pool.pushDelayed([&ran]() {
+      ++ran;
+    }, std::chrono::microseconds {delay_us(rng)});
+
+    // Churn like key repeat does, a timer cancelled right after it was scheduled, due before the last one above
+    auto id = pool.pushDelayed([&cancelled_ran]() {
+      ++cancelled_ran;
+    }, 500ms).task_id;
+    pool.cancel(id);
+  }
+
+  while (ran < timers && std::chrono::steady_clock::now() - start < 5s) {
+    std::this_thread::sleep_for(10ms);
+  }
+
+  EXPECT_EQ(ran, timers);
+  EXPECT_EQ(cancelled_ran, 0);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file tests/unit/test_video_probe_cache.cpp
+ * @brief Test src/video_probe_cache.*.
+ */
+#include "../tests_common.h"
+
+#include <fstream>
+#include <src/video_probe_cache.h>
+
+struct VideoProbeCacheTest: testing::Test {
+  void SetUp() override {
+    path = std::filesystem::temp_directory_path() / "test_encoder_cache.json";
+    std::filesystem::remove(path);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(path);
+  }
+
+  std::filesystem::path path;
+};
+
+TEST_F(VideoProbeCacheTest, SaveAndLoad) {
+  video::probe_cache::entry_t entry {
+    "fingerprint",
+    "nvenc",
+    {0b10111, 0b00111, 0},
+    3,
+    1,
+    std::chrono::milliseconds {4200},
+  };
+  ASSERT_EQ(video::probe_cache::save(path, entry), 0);
+
+  auto loaded = video::probe_cache::load(path, "fingerprint");
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(loaded->encoder, "nvenc");
+  EXPECT_EQ(loaded->capabilities, entry.capabilities);
+  EXPECT_EQ(loaded->hevc_mode, 3);
+  EXPECT_EQ(loaded->av1_mode, 1);
+  EXPECT_EQ(loaded->probe_duration, std::chrono::milliseconds {4200});
+}
+
+TEST_F(VideoProbeCacheTest, FingerprintMismatch) {
+  video::probe_cache::entry_t entry {"fingerprint", "software", {1, 1, 1}, 2, 2, std::chrono::milliseconds {100}};
+  ASSERT_EQ(video::probe_cache::save(path, entry), 0);
+
+  EXPECT_FALSE(video::probe_cache::load(path, "other fingerprint"));
+}
+
+TEST_F(VideoProbeCacheTest, MissingOrCorrupt) {
+  EXPECT_FALSE(video::probe_cache::load(path, "fingerprint"));
+
+  std::ofstream {path} << "{\"fingerprint\": \"fingerprint\", \"encoder\":";
+  EXPECT_FALSE(video::probe_cache::load(path, "fingerprint"));
+}
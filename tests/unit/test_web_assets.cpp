@@ -0,0 +1,98 @@
+/**
+ * @file tests/unit/test_web_assets.cpp
+ * @brief Test src/web_assets.*.
+ */
+// standard includes
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+// test imports
+#include "../tests_common.h"
+
+// local imports
+#include <src/web_assets.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+  class WebAssetsTest: public TempDirTest {
+  protected:
+    void SetUp() override {
+      TempDirTest::SetUp();
+      fs::create_directories(dir / "assets");
+    }
+  };
+}  // namespace
+
+TEST(WebAssetsTypesTest, CompressibleAndImmutable) {
+  EXPECT_TRUE(web_assets::compressible("text/html; charset=utf-8"));
+  EXPECT_TRUE(web_assets::compressible("application/javascript"));
+  EXPECT_TRUE(web_assets::compressible("image/svg+xml"));
+  EXPECT_FALSE(web_assets::compressible("image/png"));
+  EXPECT_FALSE(web_assets::compressible("font/woff2"));
+
+  EXPECT_TRUE(web_assets::immutable("assets/index-B3x_k9-A.js"));
+  EXPECT_FALSE(web_assets::immutable("assets/index.js"));
+  EXPECT_FALSE(web_assets::immutable("index.html"));
+  EXPECT_FALSE(web_assets::immutable("assets/font-awesome.css"));
+}
+
+TEST_F(WebAssetsTest, CompressesTextOnce) {
+  web_assets::cache_t cache;
+
+  std::string html;
+  for (int x = 0; x < 100; ++x) {
+    html += "<div class=\"card\">" + std::to_string(x) + "</div>\n";
+  }
+  auto page = write("index.html", html);
+  auto image = write("logo.png", html);
+
+  auto asset = cache.get(page, "text/html; charset=utf-8");
+  ASSERT_TRUE(asset);
+  EXPECT_EQ(asset->data, html);
+  ASSERT_TRUE(asset->gzip);
+  EXPECT_LT(asset->gzip->size(), html.size());
+  EXPECT_NE(asset->gzip_etag, asset->etag);
+  EXPECT_EQ(cache.get(page, "text/html; charset=utf-8"), asset);
+
+  // Images are already compressed
+  EXPECT_FALSE(cache.get(image, "image/png")->gzip);
+
+  // Tiny files don't get smaller
+  auto tiny = write("tiny.txt", "a");
+  EXPECT_FALSE(cache.get(tiny, "text/plain")->gzip);
+}
+
+TEST_F(WebAssetsTest, ReloadsChangedFiles) {
+  web_assets::cache_t cache;
+  auto path = write("assets/app.js", "first");
+
+  auto first = cache.get(path, "application/javascript");
+  ASSERT_TRUE(first);
+
+  write("assets/app.js", "changed");
+  fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(1));
+
+  auto second = cache.get(path, "application/javascript");
+  ASSERT_TRUE(second);
+  EXPECT_EQ(second->data, "changed");
+  EXPECT_NE(second->etag, first->etag);
+
+  fs::remove(path);
+  EXPECT_FALSE(cache.get(path, "application/javascript"));
+}
+
+TEST_F(WebAssetsTest, Warm) {
+  web_assets::cache_t cache;
+  write("index.html", "index");
+  write("assets/app.js", "app");
+
+  int warmed = 0;
+  cache.warm(dir, [&warmed](const fs::path &) -> std::optional<std::string> {
+    ++warmed;
+    return "text/plain";
+  });
+
+  EXPECT_EQ(warmed, 2);
+}